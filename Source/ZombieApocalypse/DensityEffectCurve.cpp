@@ -0,0 +1,104 @@
+// Copyright University of Inland Norway
+
+#include "DensityEffectCurve.h"
+#include <algorithm>
+#include <cmath>
+
+// Breakpoints count as evenly spaced when every gap is within this fraction of the mean gap
+static constexpr float UniformSpacingTolerance = 1e-3f;
+
+bool FDensityEffectCurve::Validate(const std::vector<std::pair<float, float>>& Points, std::string* OutError)
+{
+    auto Fail = [OutError](const std::string& Message)
+    {
+        if (OutError)
+            *OutError = Message;
+        return false;
+    };
+
+    if (Points.empty())
+        return Fail("density effect table has no rows");
+
+    for (size_t i = 0; i < Points.size(); ++i)
+    {
+        if (!std::isfinite(Points[i].first) || !std::isfinite(Points[i].second))
+            return Fail("row " + std::to_string(i) + " is not a finite number");
+
+        if (i > 0 && !(Points[i].first > Points[i - 1].first))
+        {
+            return Fail("row " + std::to_string(i) + " has PopulationDensity "
+                + std::to_string(Points[i].first) + ", which does not increase from the row before");
+        }
+    }
+    return true;
+}
+
+bool FDensityEffectCurve::Build(const std::vector<std::pair<float, float>>& Points, int32_t ResampleCount, std::string* OutError)
+{
+    if (!Validate(Points, OutError))
+        return false;
+
+    SourcePoints = Points;
+    CurveX.clear();
+    CurveY.clear();
+    for (const std::pair<float, float>& Point : Points)
+    {
+        CurveX.push_back(Point.first);
+        CurveY.push_back(Point.second);
+    }
+    NumPoints = static_cast<int32_t>(Points.size());
+
+    // 1. - Check whether the breakpoints are already evenly spaced
+    bUniform = NumPoints > 1;
+    if (bUniform)
+    {
+        const float MeanGap = (CurveX.back() - CurveX.front()) / static_cast<float>(NumPoints - 1);
+        for (int32_t i = 1; i < NumPoints && bUniform; ++i)
+        {
+            bUniform = std::fabs((CurveX[i] - CurveX[i - 1]) - MeanGap) <= UniformSpacingTolerance * MeanGap;
+        }
+    }
+
+    // 2. - Optionally trade exact breakpoints for O(1) lookups on uneven tables
+    if (!bUniform && NumPoints > 1 && ResampleCount > 1)
+    {
+        std::vector<float> ResampledX(ResampleCount);
+        std::vector<float> ResampledY(ResampleCount);
+        const float X0 = CurveX.front();
+        const float Span = CurveX.back() - X0;
+        for (int32_t i = 0; i < ResampleCount; ++i)
+        {
+            ResampledX[i] = (i == ResampleCount - 1) ? CurveX.back() : X0 + Span * static_cast<float>(i) / static_cast<float>(ResampleCount - 1);
+            ResampledY[i] = Evaluate(ResampledX[i]);
+        }
+        CurveX.swap(ResampledX);
+        CurveY.swap(ResampledY);
+        NumPoints = ResampleCount;
+        bUniform = true;
+    }
+
+    InvSpacing = bUniform ? static_cast<float>(NumPoints - 1) / (CurveX.back() - CurveX.front()) : 0.f;
+    return true;
+}
+
+int32_t FDensityEffectCurve::FindSegment(float X) const
+{
+    const int32_t LastSegment = NumPoints - 2;
+
+    if (!bUniform)
+    {
+        // First breakpoint after the start that is >= X closes the segment
+        const float* End = CurveX.data() + NumPoints;
+        const float* It = std::lower_bound(CurveX.data() + 1, End, X);
+        return static_cast<int32_t>(It - CurveX.data()) - 1;
+    }
+
+    // Direct index, then nudge by a step at most so float spacing never picks the wrong neighbour
+    int32_t Segment = static_cast<int32_t>((X - CurveX[0]) * InvSpacing);
+    Segment = std::min(std::max(Segment, 0), LastSegment);
+    while (Segment < LastSegment && X > CurveX[Segment + 1])
+        ++Segment;
+    while (Segment > 0 && X <= CurveX[Segment])
+        --Segment;
+    return Segment;
+}
@@ -0,0 +1,75 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Compiled piecewise-linear density effect curve (the PopulationDensityEffectTable).
+ *
+ * Built once from the table rows; evaluation finds the segment in O(1) when the
+ * breakpoints are evenly spaced and by binary search otherwise, then interpolates
+ * exactly like the original linear scan did. Optionally the curve can be
+ * resampled onto a uniform grid, which makes every lookup O(1) at the cost of
+ * slightly smoothing any breakpoint that falls between grid points.
+ */
+class FDensityEffectCurve
+{
+public:
+	/** Rejects empty tables, non-finite values and x that is not strictly increasing. */
+	static bool Validate(const std::vector<std::pair<float, float>>& Points, std::string* OutError = nullptr);
+
+	/**
+	 * Compiles the curve, returns false and leaves it untouched if Points is invalid.
+	 * ResampleCount > 1 resamples non-uniform curves onto that many evenly spaced points.
+	 */
+	bool Build(const std::vector<std::pair<float, float>>& Points, int32_t ResampleCount = 0, std::string* OutError = nullptr);
+
+	/** Density effect at X, clamped to the first and last y outside the table, the last y for NaN. 0 if never built. */
+	float Evaluate(float X) const
+	{
+		if (NumPoints == 0)
+			return 0.f;
+
+		const float* Xs = CurveX.data();
+		const float* Ys = CurveY.data();
+		// The upper test is written as "not below the end" so NaN, from a zero LandArea or
+		// NormalPopulationDensity, takes the last y like the original GraphLookup and never reaches FindSegment
+		if (X <= Xs[0])                return Ys[0];
+		if (!(X < Xs[NumPoints - 1]))  return Ys[NumPoints - 1];
+
+		const int32_t Segment = FindSegment(X);
+		const float x0 = Xs[Segment];
+		const float x1 = Xs[Segment + 1];
+		const float y0 = Ys[Segment];
+		const float y1 = Ys[Segment + 1];
+		const float t = (X - x0) / (x1 - x0);
+		return y0 + t * (y1 - y0);
+	}
+
+	bool IsValid() const { return NumPoints > 0; }
+	bool IsUniform() const { return bUniform; }
+	int32_t GetNumPoints() const { return NumPoints; }
+
+	/** The rows the curve was built from, before any resampling. */
+	const std::vector<std::pair<float, float>>& GetSourcePoints() const { return SourcePoints; }
+
+	/** Compiled breakpoints, what Evaluate actually interpolates between. */
+	const std::vector<float>& GetX() const { return CurveX; }
+	const std::vector<float>& GetY() const { return CurveY; }
+
+private:
+	// Segment [i, i + 1] for X strictly inside the table, the first one whose end is >= X
+	int32_t FindSegment(float X) const;
+
+	std::vector<std::pair<float, float>> SourcePoints;
+	std::vector<float> CurveX;
+	std::vector<float> CurveY;
+	int32_t NumPoints{ 0 };
+
+	bool bUniform{ false };
+	float InvSpacing{ 0.f };
+};
@@ -0,0 +1,61 @@
+// Copyright University of Inland Norway
+
+#include "FixedStepScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+void FFixedStepScheduler::Configure(float InStepSeconds, int32_t InHorizonSteps, int32_t InMaxStepsPerFrame)
+{
+    StepSeconds = InStepSeconds;
+    HorizonSteps = InHorizonSteps;
+    MaxStepsPerFrame = InMaxStepsPerFrame;
+}
+
+void FFixedStepScheduler::Reset(int32_t InStepsDone)
+{
+    Accumulator = 0.0;
+    StepsDone = InStepsDone;
+    DroppedSteps = 0;
+}
+
+int32_t FFixedStepScheduler::Advance(float DeltaSeconds)
+{
+    if (IsFinished())
+    {
+        Accumulator = 0.0;
+        return 0;
+    }
+
+    // 1. - Whole steps in the scaled time so far, the remainder stays for next frame
+    int64_t Steps = 0;
+    if (StepSeconds > 0.f)
+    {
+        Accumulator += static_cast<double>(std::max(0.f, DeltaSeconds)) * TimeScale;
+        Steps = static_cast<int64_t>(std::floor(Accumulator / StepSeconds));
+        Accumulator -= static_cast<double>(Steps) * StepSeconds;
+    }
+    else
+    {
+        Steps = TimeScale > 0.f ? std::max(MaxStepsPerFrame, 1) : 0;
+    }
+
+    // 2. - Cap the frame; carry at most one more frame's worth of backlog
+    if (MaxStepsPerFrame > 0 && Steps > MaxStepsPerFrame)
+    {
+        const int64_t Backlog = std::min<int64_t>(Steps - MaxStepsPerFrame, MaxStepsPerFrame);
+        DroppedSteps += Steps - MaxStepsPerFrame - Backlog;
+        Accumulator += static_cast<double>(Backlog) * StepSeconds;
+        Steps = MaxStepsPerFrame;
+    }
+
+    // 3. - Never past the horizon
+    if (HorizonSteps > 0)
+    {
+        Steps = std::min<int64_t>(Steps, HorizonSteps - StepsDone);
+        if (StepsDone + Steps >= HorizonSteps)
+            Accumulator = 0.0;
+    }
+
+    StepsDone += static_cast<int32_t>(Steps);
+    return static_cast<int32_t>(Steps);
+}
@@ -0,0 +1,55 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Fixed-timestep clock that turns frame time into whole simulation steps.
+ *
+ * Frame time, scaled by TimeScale, accumulates and is spent in steps of
+ * StepSeconds, keeping the remainder for the next frame, so the step count
+ * over a run depends only on elapsed time and never on the frame rate. A
+ * frame runs at most MaxStepsPerFrame steps; a backlog beyond one more
+ * frame's budget is dropped rather than carried, so a long hitch cannot
+ * snowball. Steps stop at the horizon.
+ */
+class FFixedStepScheduler
+{
+public:
+	/**
+	 * StepSeconds <= 0 runs MaxStepsPerFrame every frame. HorizonSteps <= 0 never
+	 * finishes, MaxStepsPerFrame <= 0 never caps. Keeps the accumulated time.
+	 */
+	void Configure(float InStepSeconds, int32_t InHorizonSteps, int32_t InMaxStepsPerFrame);
+
+	/** 1 is real time, 0 pauses, 10 fast-forwards ten times. */
+	void SetTimeScale(float InTimeScale) { TimeScale = InTimeScale > 0.f ? InTimeScale : 0.f; }
+	float GetTimeScale() const { return TimeScale; }
+
+	/** Back to StepsDone with an empty accumulator. */
+	void Reset(int32_t InStepsDone = 0);
+
+	/** Adds a frame's time and returns how many steps to run now, already counted as done. */
+	int32_t Advance(float DeltaSeconds);
+
+	int32_t GetStepsDone() const { return StepsDone; }
+	int32_t GetHorizon() const { return HorizonSteps; }
+	bool IsFinished() const { return HorizonSteps > 0 && StepsDone >= HorizonSteps; }
+
+	/** Fraction of the next step already accumulated, for interpolating between states. */
+	float GetAlpha() const { return StepSeconds > 0.f ? static_cast<float>(Accumulator / StepSeconds) : 0.f; }
+
+	/** Steps lost to the backlog limit since Reset. */
+	int64_t GetDroppedSteps() const { return DroppedSteps; }
+
+private:
+	// Double so tiny steps (1000 a second) do not lose time to rounding over long runs
+	double Accumulator{ 0.0 };
+	float StepSeconds{ 1.f };
+	float TimeScale{ 1.f };
+	int32_t HorizonSteps{ 0 };
+	int32_t MaxStepsPerFrame{ 0 };
+	int32_t StepsDone{ 0 };
+	int64_t DroppedSteps{ 0 };
+};
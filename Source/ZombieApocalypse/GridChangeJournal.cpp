@@ -0,0 +1,85 @@
+// Copyright University of Inland Norway
+
+#include "GridChangeJournal.h"
+#include <algorithm>
+
+void FGridChangeJournal::Reset(int32_t InTilesX, int32_t InTilesY, size_t InCapacity)
+{
+    TilesX = InTilesX;
+    TilesY = InTilesY;
+    Capacity = std::max<size_t>(InCapacity, 2);
+
+    DirtyBits.assign((static_cast<size_t>(TilesX) * TilesY + 63) / 64, 0);
+    DirtyTiles.clear();
+    PreviousDirtyTiles.clear();
+    bPreviousAllDirty = false;
+    Invalidate();
+}
+
+void FGridChangeJournal::MarkTile(int32_t X, int32_t Y)
+{
+    const int32_t TileIndex = (Y >> FGridStorage::TileShift) * TilesX + (X >> FGridStorage::TileShift);
+    uint64_t& Word = DirtyBits[TileIndex >> 6];
+    const uint64_t Mask = uint64_t(1) << (TileIndex & 63);
+    if ((Word & Mask) == 0)
+    {
+        Word |= Mask;
+        DirtyTiles.push_back(TileIndex);
+    }
+}
+
+void FGridChangeJournal::Append(const FGridChange& Change)
+{
+    // Drop the older half when full, so the trim is rare and readers close behind keep their range
+    if (Changes.size() >= Capacity)
+    {
+        const size_t Dropped = Changes.size() / 2;
+        Changes.erase(Changes.begin(), Changes.begin() + Dropped);
+        FirstSequence += Dropped;
+    }
+    Changes.push_back(Change);
+    ++Sequence;
+}
+
+void FGridChangeJournal::RecordCell(int32_t X, int32_t Y, EGridCell Before, EGridCell After)
+{
+    MarkTile(X, Y);
+    Append({ X, Y, EGridChangeKind::Cell, static_cast<uint8_t>(Before), static_cast<uint8_t>(After) });
+}
+
+void FGridChangeJournal::RecordFence(int32_t X, int32_t Y, EGridEdge Edge)
+{
+    MarkTile(X, Y);
+    Append({ X, Y, EGridChangeKind::Fence, 0, static_cast<uint8_t>(Edge) });
+}
+
+void FGridChangeJournal::Invalidate()
+{
+    Changes.clear();
+    ++Sequence;
+    FirstSequence = Sequence;
+    bAllDirty = true;
+}
+
+void FGridChangeJournal::BeginFrame()
+{
+    for (int32_t TileIndex : DirtyTiles)
+    {
+        DirtyBits[TileIndex >> 6] = 0;
+    }
+    std::swap(DirtyTiles, PreviousDirtyTiles);
+    DirtyTiles.clear();
+
+    bPreviousAllDirty = bAllDirty;
+    bAllDirty = false;
+}
+
+bool FGridChangeJournal::GetChangesSince(uint64_t Since, const FGridChange*& OutChanges, size_t& OutCount) const
+{
+    if (Since < FirstSequence || Since > Sequence)
+        return false;
+
+    OutChanges = Changes.data() + (Since - FirstSequence);
+    OutCount = static_cast<size_t>(Sequence - Since);
+    return true;
+}
@@ -0,0 +1,85 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "GridStorage.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class EGridChangeKind : uint8_t
+{
+	// Before / After are EGridCell values
+	Cell,
+	// A new fence; the edge is stored as Top (FenceUp) or Right (FenceRight) of (X, Y)
+	Fence
+};
+
+struct FGridChange
+{
+	int32_t X = 0;
+	int32_t Y = 0;
+	EGridChangeKind Kind = EGridChangeKind::Cell;
+	uint8_t Before = 0;
+	uint8_t After = 0;
+};
+
+/**
+ * Record of grid mutations so consumers can catch up in time proportional to
+ * what changed instead of rescanning the map.
+ *
+ * Every change gets a sequence number. A consumer keeps the sequence it last
+ * read and asks for everything since; if that range is gone (the log was
+ * trimmed or a bulk edit went through Invalidate) the answer is false and the
+ * consumer rescans once. Alongside the log, a bitmap marks the 8x8 tiles
+ * touched this frame and the previous one for coarse consumers. Recording is
+ * a push_back and a bit set, cheap enough to stay on in shipping builds.
+ */
+class FGridChangeJournal
+{
+public:
+	static constexpr size_t DefaultCapacity = size_t(1) << 16;
+
+	/** Sizes the tile bitmaps and drops the log. Readers from before will rescan. */
+	void Reset(int32_t InTilesX, int32_t InTilesY, size_t InCapacity = DefaultCapacity);
+
+	void RecordCell(int32_t X, int32_t Y, EGridCell Before, EGridCell After);
+	void RecordFence(int32_t X, int32_t Y, EGridEdge Edge);
+
+	/** For edits too large to log, every reader rescans and every tile is dirty this frame. */
+	void Invalidate();
+
+	/** Closes the frame: this frame's dirty tiles become the previous frame's. */
+	void BeginFrame();
+
+	/** Sequence the next change will get, what a reader stores once it has caught up. */
+	uint64_t GetSequence() const { return Sequence; }
+
+	/** Changes in [Since, GetSequence()), false if part of that range is no longer logged. */
+	bool GetChangesSince(uint64_t Since, const FGridChange*& OutChanges, size_t& OutCount) const;
+
+	/** Tiles touched since BeginFrame, or in the frame before it. */
+	const std::vector<int32_t>& GetDirtyTiles() const { return DirtyTiles; }
+	const std::vector<int32_t>& GetPreviousDirtyTiles() const { return PreviousDirtyTiles; }
+	bool IsTileDirty(int32_t TileIndex) const { return bAllDirty || ((DirtyBits[TileIndex >> 6] >> (TileIndex & 63)) & 1u); }
+	bool AreAllTilesDirty() const { return bAllDirty; }
+	bool WereAllTilesDirty() const { return bPreviousAllDirty; }
+
+private:
+	void MarkTile(int32_t X, int32_t Y);
+	void Append(const FGridChange& Change);
+
+	std::vector<FGridChange> Changes;
+	uint64_t FirstSequence{ 0 };
+	uint64_t Sequence{ 0 };
+	size_t Capacity{ DefaultCapacity };
+
+	std::vector<uint64_t> DirtyBits;
+	std::vector<int32_t> DirtyTiles;
+	std::vector<int32_t> PreviousDirtyTiles;
+	bool bAllDirty{ false };
+	bool bPreviousAllDirty{ false };
+
+	int32_t TilesX{ 0 };
+	int32_t TilesY{ 0 };
+};
@@ -0,0 +1,398 @@
+// Copyright University of Inland Norway
+
+#include "GridConnectivity.h"
+#include <algorithm>
+
+static const int32_t RegionDx[4] = { -1, 1, 0, 0 };
+static const int32_t RegionDy[4] = { 0, 0, -1, 1 };
+
+void FGridConnectivity::Build(const FGridStorage& Grid)
+{
+    Width = Grid.GetWidth();
+    Height = Grid.GetHeight();
+
+    const int32_t NumCells = Width * Height;
+    Region.assign(NumCells, NoRegion);
+    Stamp.assign(NumCells, 0);
+    Generation = 0;
+    Regions.clear();
+    FreeRegions.clear();
+    NumRegions = 0;
+    SafeHumans = 0;
+    CellsRelabelled = 0;
+
+    for (int32_t Index = 0; Index < NumCells; ++Index)
+    {
+        if (Region[Index] == NoRegion && FGridStorage::IsWalkable(Grid.GetCell(Index % Width, Index / Width)))
+        {
+            const int32_t NewRegion = AllocateRegion();
+            FloodRegion(Grid, Index, NoRegion, NewRegion);
+            AdjustRegion(NewRegion, MeasureCells(Grid, FloodCells), 1);
+        }
+    }
+}
+
+int32_t FGridConnectivity::AllocateRegion()
+{
+    ++NumRegions;
+    if (!FreeRegions.empty())
+    {
+        const int32_t Reused = FreeRegions.back();
+        FreeRegions.pop_back();
+        return Reused;
+    }
+    Regions.push_back(FRegionInfo());
+    return static_cast<int32_t>(Regions.size()) - 1;
+}
+
+void FGridConnectivity::ReleaseRegion(int32_t InRegion)
+{
+    AdjustRegion(InRegion, Regions[InRegion], -1);
+    FreeRegions.push_back(InRegion);
+    --NumRegions;
+}
+
+void FGridConnectivity::AdjustRegion(int32_t InRegion, const FRegionInfo& Delta, int32_t Sign)
+{
+    FRegionInfo& Info = Regions[InRegion];
+    if (Info.ZombieEdges == 0)
+        SafeHumans -= Info.Humans;
+
+    const FRegionInfo Applied = Delta;
+    Info.Cells += Sign * Applied.Cells;
+    Info.Humans += Sign * Applied.Humans;
+    Info.ZombieEdges += Sign * Applied.ZombieEdges;
+
+    if (Info.ZombieEdges == 0)
+        SafeHumans += Info.Humans;
+}
+
+int32_t FGridConnectivity::CountZombieEdgesInto(const FGridStorage& Grid, int32_t X, int32_t Y) const
+{
+    int32_t Count = 0;
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const int32_t Nx = X + RegionDx[i];
+        const int32_t Ny = Y + RegionDy[i];
+        if (Grid.IsValidCell(Nx, Ny) && Grid.GetCell(Nx, Ny) == EGridCell::Zombie && !Grid.IsEdgeBlockedByFence(X, Y, Nx, Ny))
+            ++Count;
+    }
+    return Count;
+}
+
+FGridConnectivity::FRegionInfo FGridConnectivity::MeasureCells(const FGridStorage& Grid, const std::vector<int32_t>& Cells) const
+{
+    FRegionInfo Info;
+    for (int32_t Index : Cells)
+    {
+        const int32_t X = Index % Width;
+        const int32_t Y = Index / Width;
+        ++Info.Cells;
+        Info.Humans += (Grid.GetCell(X, Y) == EGridCell::Human) ? 1 : 0;
+        Info.ZombieEdges += CountZombieEdgesInto(Grid, X, Y);
+    }
+    return Info;
+}
+
+void FGridConnectivity::FloodRegion(const FGridStorage& Grid, int32_t Seed, int32_t Match, int32_t NewRegion)
+{
+    FloodCells.clear();
+    FloodCells.push_back(Seed);
+    Region[Seed] = NewRegion;
+
+    for (size_t Head = 0; Head < FloodCells.size(); ++Head)
+    {
+        const int32_t X = FloodCells[Head] % Width;
+        const int32_t Y = FloodCells[Head] / Width;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            const int32_t Nx = X + RegionDx[i];
+            const int32_t Ny = Y + RegionDy[i];
+            if (Grid.CanMoveBetweenCells(X, Y, Nx, Ny) && Region[Nx + Ny * Width] == Match)
+            {
+                Region[Nx + Ny * Width] = NewRegion;
+                FloodCells.push_back(Nx + Ny * Width);
+            }
+        }
+    }
+    CellsRelabelled += static_cast<int32_t>(FloodCells.size());
+}
+
+void FGridConnectivity::MergeInto(const FGridStorage& Grid, int32_t Seed, int32_t From, int32_t To)
+{
+    const FRegionInfo Moved = Regions[From];
+    FloodRegion(Grid, Seed, From, To);
+    ReleaseRegion(From);
+    AdjustRegion(To, Moved, 1);
+}
+
+void FGridConnectivity::SplitRegion(const FGridStorage& Grid, int32_t OldRegion, const int32_t* Seeds, int32_t NumSeeds)
+{
+    if (NumSeeds < 2)
+        return;
+
+    if (++Generation >= (1u << 30))
+    {
+        std::fill(Stamp.begin(), Stamp.end(), 0);
+        Generation = 1;
+    }
+
+    // 1. - One breadth-first front per seed, fronts that touch are the same piece
+    int32_t Root[4];
+    size_t Head[4];
+    bool bDone[4];
+    for (int32_t g = 0; g < NumSeeds; ++g)
+    {
+        Root[g] = g;
+        Head[g] = 0;
+        bDone[g] = false;
+        SplitCells[g].clear();
+        SplitCells[g].push_back(Seeds[g]);
+        Stamp[Seeds[g]] = (Generation << 2) | static_cast<uint32_t>(g);
+    }
+
+    auto FindRoot = [&Root](int32_t g)
+    {
+        while (Root[g] != g)
+            g = Root[g];
+        return g;
+    };
+
+    int32_t NumLive = NumSeeds;
+    while (NumLive > 1)
+    {
+        // 2. - Advance every unfinished front by one cell, round robin, so the cost follows the smaller pieces
+        for (int32_t g = 0; g < NumSeeds; ++g)
+        {
+            if (bDone[FindRoot(g)] || Head[g] == SplitCells[g].size())
+                continue;
+
+            const int32_t Current = SplitCells[g][Head[g]++];
+            const int32_t X = Current % Width;
+            const int32_t Y = Current / Width;
+            for (int32_t i = 0; i < 4; ++i)
+            {
+                const int32_t Nx = X + RegionDx[i];
+                const int32_t Ny = Y + RegionDy[i];
+                if (!Grid.CanMoveBetweenCells(X, Y, Nx, Ny))
+                    continue;
+
+                const int32_t Next = Nx + Ny * Width;
+                if ((Stamp[Next] >> 2) == Generation)
+                {
+                    const int32_t A = FindRoot(g);
+                    const int32_t B = FindRoot(static_cast<int32_t>(Stamp[Next] & 3u));
+                    if (A != B)
+                    {
+                        Root[B] = A;
+                        --NumLive;
+                    }
+                }
+                else
+                {
+                    Stamp[Next] = (Generation << 2) | static_cast<uint32_t>(g);
+                    SplitCells[g].push_back(Next);
+                }
+            }
+        }
+
+        // 3. - A piece whose fronts all ran dry is cut off from the rest, give it its own region
+        for (int32_t r = 0; r < NumSeeds && NumLive > 1; ++r)
+        {
+            if (Root[r] != r || bDone[r])
+                continue;
+
+            bool bExhausted = true;
+            for (int32_t g = 0; g < NumSeeds; ++g)
+            {
+                if (FindRoot(g) == r && Head[g] != SplitCells[g].size())
+                    bExhausted = false;
+            }
+            if (!bExhausted)
+                continue;
+
+            FloodCells.clear();
+            for (int32_t g = 0; g < NumSeeds; ++g)
+            {
+                if (FindRoot(g) == r)
+                    FloodCells.insert(FloodCells.end(), SplitCells[g].begin(), SplitCells[g].end());
+            }
+
+            const int32_t NewRegion = AllocateRegion();
+            for (int32_t Index : FloodCells)
+            {
+                Region[Index] = NewRegion;
+            }
+            CellsRelabelled += static_cast<int32_t>(FloodCells.size());
+
+            const FRegionInfo Piece = MeasureCells(Grid, FloodCells);
+            AdjustRegion(OldRegion, Piece, -1);
+            AdjustRegion(NewRegion, Piece, 1);
+
+            bDone[r] = true;
+            --NumLive;
+        }
+    }
+}
+
+void FGridConnectivity::SetCell(FGridStorage& Grid, int32_t X, int32_t Y, EGridCell State)
+{
+    if (!Grid.IsValidCell(X, Y))
+        return;
+
+    const EGridCell OldState = Grid.GetCell(X, Y);
+    if (OldState == State)
+        return;
+
+    CellsRelabelled = 0;
+    const int32_t Index = X + Y * Width;
+    const bool bWasWalkable = FGridStorage::IsWalkable(OldState);
+    const bool bWalkable = FGridStorage::IsWalkable(State);
+
+    // Empty <-> Human only moves the human count
+    if (bWasWalkable && bWalkable)
+    {
+        Grid.SetCell(X, Y, State);
+        FRegionInfo Delta;
+        Delta.Humans = (State == EGridCell::Human) ? 1 : -1;
+        AdjustRegion(Region[Index], Delta, 1);
+        return;
+    }
+
+    if (bWasWalkable)
+    {
+        // 1. - The cell leaves its region, together with the zombie edges into it
+        const int32_t OldRegion = Region[Index];
+        FRegionInfo Removed;
+        Removed.Cells = 1;
+        Removed.Humans = (OldState == EGridCell::Human) ? 1 : 0;
+        Removed.ZombieEdges = CountZombieEdgesInto(Grid, X, Y);
+        AdjustRegion(OldRegion, Removed, -1);
+        Region[Index] = NoRegion;
+        Grid.SetCell(X, Y, State);
+
+        if (Regions[OldRegion].Cells == 0)
+        {
+            ReleaseRegion(OldRegion);
+            return;
+        }
+
+        // 2. - The new zombie can step into every open neighbour, all still in the old region
+        int32_t Seeds[4];
+        int32_t NumSeeds = 0;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            if (Grid.CanMoveBetweenCells(X, Y, X + RegionDx[i], Y + RegionDy[i]))
+                Seeds[NumSeeds++] = X + RegionDx[i] + (Y + RegionDy[i]) * Width;
+        }
+        FRegionInfo Exposed;
+        Exposed.ZombieEdges = NumSeeds;
+        AdjustRegion(OldRegion, Exposed, 1);
+
+        // 3. - Those neighbours may no longer reach each other
+        SplitRegion(Grid, OldRegion, Seeds, NumSeeds);
+        return;
+    }
+
+    // 1. - The zombie leaving takes its edges into the neighbouring regions with it
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        if (Grid.CanMoveBetweenCells(X, Y, X + RegionDx[i], Y + RegionDy[i]))
+        {
+            FRegionInfo Delta;
+            Delta.ZombieEdges = 1;
+            AdjustRegion(Region[X + RegionDx[i] + (Y + RegionDy[i]) * Width], Delta, -1);
+        }
+    }
+    Grid.SetCell(X, Y, State);
+
+    // 2. - Join the largest neighbouring region, or start a new one
+    int32_t Target = NoRegion;
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        if (Grid.CanMoveBetweenCells(X, Y, X + RegionDx[i], Y + RegionDy[i]))
+        {
+            const int32_t Neighbour = Region[X + RegionDx[i] + (Y + RegionDy[i]) * Width];
+            if (Target == NoRegion || Regions[Neighbour].Cells > Regions[Target].Cells)
+                Target = Neighbour;
+        }
+    }
+    if (Target == NoRegion)
+        Target = AllocateRegion();
+
+    Region[Index] = Target;
+    FRegionInfo Added;
+    Added.Cells = 1;
+    Added.Humans = (State == EGridCell::Human) ? 1 : 0;
+    Added.ZombieEdges = CountZombieEdgesInto(Grid, X, Y);
+    AdjustRegion(Target, Added, 1);
+
+    // 3. - Relabel the smaller regions it now connects
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        if (Grid.CanMoveBetweenCells(X, Y, X + RegionDx[i], Y + RegionDy[i]))
+        {
+            const int32_t Seed = X + RegionDx[i] + (Y + RegionDy[i]) * Width;
+            if (Region[Seed] != Target)
+                MergeInto(Grid, Seed, Region[Seed], Target);
+        }
+    }
+}
+
+void FGridConnectivity::PlaceFence(FGridStorage& Grid, int32_t CellX, int32_t CellY, EGridEdge Edge)
+{
+    FGridPoint A;
+    FGridPoint B;
+    FGridStorage::GetEdgeCells(CellX, CellY, Edge, A, B);
+
+    if (!Grid.IsValidCell(A.X, A.Y) || !Grid.IsValidCell(B.X, B.Y) || Grid.IsEdgeBlockedByFence(A.X, A.Y, B.X, B.Y))
+    {
+        Grid.PlaceFence(CellX, CellY, Edge);
+        return;
+    }
+
+    CellsRelabelled = 0;
+    Grid.PlaceFence(CellX, CellY, Edge);
+
+    const bool bWalkableA = FGridStorage::IsWalkable(Grid.GetCell(A.X, A.Y));
+    const bool bWalkableB = FGridStorage::IsWalkable(Grid.GetCell(B.X, B.Y));
+    if (bWalkableA && bWalkableB)
+    {
+        const int32_t Seeds[2] = { A.X + A.Y * Width, B.X + B.Y * Width };
+        SplitRegion(Grid, Region[Seeds[0]], Seeds, 2);
+    }
+    else if (bWalkableA != bWalkableB)
+    {
+        // A zombie on one side can no longer step through
+        const FGridPoint Open = bWalkableA ? A : B;
+        FRegionInfo Delta;
+        Delta.ZombieEdges = 1;
+        AdjustRegion(Region[Open.X + Open.Y * Width], Delta, -1);
+    }
+}
+
+bool FGridConnectivity::CanReach(const FGridStorage& Grid, FGridPoint From, FGridPoint To) const
+{
+    if (!Grid.IsValidCell(From.X, From.Y) || !Grid.IsValidCell(To.X, To.Y))
+        return false;
+    if (From == To)
+        return true;
+
+    const int32_t Goal = Region[To.X + To.Y * Width];
+    if (Goal == NoRegion)
+        return false;
+
+    const int32_t Start = Region[From.X + From.Y * Width];
+    if (Start != NoRegion)
+        return Start == Goal;
+
+    // A search from a zombie cell still starts by stepping out of it
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const int32_t Nx = From.X + RegionDx[i];
+        const int32_t Ny = From.Y + RegionDy[i];
+        if (Grid.CanMoveBetweenCells(From.X, From.Y, Nx, Ny) && Region[Nx + Ny * Width] == Goal)
+            return true;
+    }
+    return false;
+}
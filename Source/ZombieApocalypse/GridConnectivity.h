@@ -0,0 +1,89 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "GridStorage.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * Connected-region labels over the walkable cells of an FGridStorage.
+ *
+ * Two walkable neighbours share a region when no fence lies between them, so
+ * "can A reach B" is a label compare instead of a search. Edits go through
+ * SetCell / PlaceFence here, which write the grid and patch the labels: a cell
+ * that opens up joins its neighbours' regions (the smaller ones are relabelled
+ * into the largest), and a cell or fence that closes a link searches outward
+ * from the cut on every side at once, relabelling only the pieces that finish
+ * first. Each region also keeps its human count and how many open edges a
+ * zombie could step through into it, which gives the safe human total.
+ */
+class FGridConnectivity
+{
+public:
+	static constexpr int32_t NoRegion = -1;
+
+	/** Labels every cell from scratch, needed after FGridStorage::Init. */
+	void Build(const FGridStorage& Grid);
+
+	bool IsBuilt() const { return Width > 0; }
+
+	/** Writes State into Grid and updates the regions it affects. */
+	void SetCell(FGridStorage& Grid, int32_t X, int32_t Y, EGridCell State);
+
+	/** Places the fence in Grid and splits the region it cuts, if any. */
+	void PlaceFence(FGridStorage& Grid, int32_t CellX, int32_t CellY, EGridEdge Edge);
+
+	/** Region of a walkable cell, NoRegion for zombie cells. */
+	int32_t GetRegion(int32_t X, int32_t Y) const { return Region[X + Y * Width]; }
+
+	/** True exactly when FGridPathfinder::FindPath would find a path, in O(1). */
+	bool CanReach(const FGridStorage& Grid, FGridPoint From, FGridPoint To) const;
+
+	int32_t GetNumRegions() const { return NumRegions; }
+	int32_t GetRegionCells(int32_t InRegion) const { return Regions[InRegion].Cells; }
+	int32_t GetRegionHumans(int32_t InRegion) const { return Regions[InRegion].Humans; }
+
+	/** True if some zombie cell has an unfenced edge into the region. */
+	bool IsRegionExposed(int32_t InRegion) const { return Regions[InRegion].ZombieEdges > 0; }
+
+	/** Humans in regions no zombie can enter. */
+	int32_t GetSafeHumans() const { return SafeHumans; }
+
+	/** Cells given a new label by the last edit, for profiling. */
+	int32_t GetCellsRelabelled() const { return CellsRelabelled; }
+
+private:
+	struct FRegionInfo
+	{
+		int32_t Cells = 0;
+		int32_t Humans = 0;
+		int32_t ZombieEdges = 0;
+	};
+
+	int32_t AllocateRegion();
+	void ReleaseRegion(int32_t InRegion);
+	void AdjustRegion(int32_t InRegion, const FRegionInfo& Delta, int32_t Sign);
+	FRegionInfo MeasureCells(const FGridStorage& Grid, const std::vector<int32_t>& Cells) const;
+	int32_t CountZombieEdgesInto(const FGridStorage& Grid, int32_t X, int32_t Y) const;
+
+	void FloodRegion(const FGridStorage& Grid, int32_t Seed, int32_t Match, int32_t NewRegion);
+	void MergeInto(const FGridStorage& Grid, int32_t Seed, int32_t From, int32_t To);
+	void SplitRegion(const FGridStorage& Grid, int32_t OldRegion, const int32_t* Seeds, int32_t NumSeeds);
+
+	std::vector<int32_t> Region;
+	std::vector<FRegionInfo> Regions;
+	std::vector<int32_t> FreeRegions;
+
+	// Split search scratch: stamp is (Generation << 2) | seed so one array marks both visit and owner
+	std::vector<uint32_t> Stamp;
+	std::vector<int32_t> SplitCells[4];
+	std::vector<int32_t> FloodCells;
+	uint32_t Generation{ 0 };
+
+	int32_t Width{ 0 };
+	int32_t Height{ 0 };
+	int32_t NumRegions{ 0 };
+	int32_t SafeHumans{ 0 };
+	int32_t CellsRelabelled{ 0 };
+};
@@ -0,0 +1,237 @@
+// Copyright University of Inland Norway
+
+#include "GridFlowField.h"
+#include <algorithm>
+
+static const int32_t FlowDx[4] = { -1, 1, 0, 0 };
+static const int32_t FlowDy[4] = { 0, 0, -1, 1 };
+
+bool FGridFlowField::IsTargetCell(const FGridStorage& Grid, int32_t Index) const
+{
+    return Grid.GetCell(Index % Width, Index / Width) == Target;
+}
+
+void FGridFlowField::Build(const FGridStorage& Grid, EGridCell InTarget)
+{
+    Target = InTarget;
+    Width = Grid.GetWidth();
+    Height = Grid.GetHeight();
+    bBuilt = true;
+
+    const int32_t NumCells = Width * Height;
+    Distance.assign(NumCells, Unreachable);
+    Invalid.assign(NumCells, 0);
+    Work.clear();
+    Work.reserve(NumCells);
+
+    // 1. - Every target cell is a source
+    for (int32_t Index = 0; Index < NumCells; ++Index)
+    {
+        if (IsTargetCell(Grid, Index))
+        {
+            Distance[Index] = 0;
+            Work.push_back(Index);
+        }
+    }
+
+    // 2. - Breadth-first over reversed moves: P gets closer through C if P may step into C
+    for (size_t Head = 0; Head < Work.size(); ++Head)
+    {
+        const int32_t Current = Work[Head];
+        const int32_t X = Current % Width;
+        const int32_t Y = Current / Width;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            const int32_t Px = X + FlowDx[i];
+            const int32_t Py = Y + FlowDy[i];
+            if (!Grid.CanMoveBetweenCells(Px, Py, X, Y))
+                continue;
+
+            const int32_t Prev = Px + Py * Width;
+            if (Distance[Prev] == Unreachable)
+            {
+                Distance[Prev] = Distance[Current] + 1;
+                Work.push_back(Prev);
+            }
+        }
+    }
+    CellsTouched = static_cast<int32_t>(Work.size());
+}
+
+bool FGridFlowField::IsSupported(const FGridStorage& Grid, int32_t Index) const
+{
+    // Still has a neighbour it can step into that is exactly one closer and not itself in doubt
+    const int32_t X = Index % Width;
+    const int32_t Y = Index / Width;
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const int32_t Nx = X + FlowDx[i];
+        const int32_t Ny = Y + FlowDy[i];
+        if (!Grid.CanMoveBetweenCells(X, Y, Nx, Ny))
+            continue;
+
+        const int32_t Next = Nx + Ny * Width;
+        if (!Invalid[Next] && Distance[Next] != Unreachable && Distance[Next] + 1 == Distance[Index])
+            return true;
+    }
+    return false;
+}
+
+uint32_t FGridFlowField::BestFromNeighbours(const FGridStorage& Grid, int32_t Index) const
+{
+    const int32_t X = Index % Width;
+    const int32_t Y = Index / Width;
+    uint32_t Best = Unreachable;
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const int32_t Nx = X + FlowDx[i];
+        const int32_t Ny = Y + FlowDy[i];
+        if (!Grid.CanMoveBetweenCells(X, Y, Nx, Ny))
+            continue;
+
+        const uint32_t Next = Distance[Nx + Ny * Width];
+        if (Next != Unreachable)
+            Best = std::min(Best, Next + 1);
+    }
+    return Best;
+}
+
+void FGridFlowField::Propagate(const FGridStorage& Grid)
+{
+    std::make_heap(Open.begin(), Open.end());
+    while (!Open.empty())
+    {
+        std::pop_heap(Open.begin(), Open.end());
+        const FOpenCell Cell = Open.back();
+        Open.pop_back();
+        if (Cell.Distance != Distance[Cell.Index])
+            continue;
+
+        const int32_t X = Cell.Index % Width;
+        const int32_t Y = Cell.Index / Width;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            const int32_t Px = X + FlowDx[i];
+            const int32_t Py = Y + FlowDy[i];
+            if (!Grid.CanMoveBetweenCells(Px, Py, X, Y))
+                continue;
+
+            const int32_t Prev = Px + Py * Width;
+            if (Distance[Prev] > Cell.Distance + 1)
+            {
+                Distance[Prev] = Cell.Distance + 1;
+                Open.push_back({ Distance[Prev], Prev });
+                std::push_heap(Open.begin(), Open.end());
+                ++CellsTouched;
+            }
+        }
+    }
+}
+
+void FGridFlowField::Update(const FGridStorage& Grid, const std::vector<FGridPoint>& ChangedCells)
+{
+    if (!bBuilt || Width != Grid.GetWidth() || Height != Grid.GetHeight())
+    {
+        Build(Grid, Target);
+        return;
+    }
+
+    CellsTouched = 0;
+    Work.clear();
+    Cleared.clear();
+    Open.clear();
+
+    auto PushWithNeighbours = [this, &Grid](std::vector<int32_t>& Into, const FGridPoint& Cell)
+    {
+        if (Grid.IsValidCell(Cell.X, Cell.Y))
+            Into.push_back(Cell.X + Cell.Y * Width);
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            if (Grid.IsValidCell(Cell.X + FlowDx[i], Cell.Y + FlowDy[i]))
+                Into.push_back(Cell.X + FlowDx[i] + (Cell.Y + FlowDy[i]) * Width);
+        }
+    };
+
+    // 1. - Find every cell that lost its shortest route, following dependents outward
+    for (const FGridPoint& Cell : ChangedCells)
+    {
+        PushWithNeighbours(Work, Cell);
+    }
+
+    while (!Work.empty())
+    {
+        const int32_t Index = Work.back();
+        Work.pop_back();
+
+        if (Invalid[Index] || Distance[Index] == Unreachable)
+            continue;
+        if (IsTargetCell(Grid, Index) || IsSupported(Grid, Index))
+            continue;
+
+        Invalid[Index] = 1;
+        Cleared.push_back(Index);
+
+        const int32_t X = Index % Width;
+        const int32_t Y = Index / Width;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            const int32_t Px = X + FlowDx[i];
+            const int32_t Py = Y + FlowDy[i];
+            if (Grid.IsValidCell(Px, Py) && Distance[Px + Py * Width] == Distance[Index] + 1)
+                Work.push_back(Px + Py * Width);
+        }
+    }
+
+    // 2. - Forget their distances, then re-seed them from whatever valid neighbours remain
+    for (int32_t Index : Cleared)
+    {
+        Distance[Index] = Unreachable;
+    }
+    for (int32_t Index : Cleared)
+    {
+        Invalid[Index] = 0;
+        Distance[Index] = BestFromNeighbours(Grid, Index);
+        if (Distance[Index] != Unreachable)
+            Open.push_back({ Distance[Index], Index });
+    }
+    CellsTouched += static_cast<int32_t>(Cleared.size());
+
+    // 3. - Changed cells may now be targets or have opened a shorter way for their neighbours
+    for (const FGridPoint& Cell : ChangedCells)
+    {
+        PushWithNeighbours(Work, Cell);
+    }
+    for (int32_t Index : Work)
+    {
+        const uint32_t Best = IsTargetCell(Grid, Index) ? 0 : BestFromNeighbours(Grid, Index);
+        if (Best < Distance[Index])
+            Distance[Index] = Best;
+        if (Distance[Index] != Unreachable)
+            Open.push_back({ Distance[Index], Index });
+    }
+    Work.clear();
+
+    Propagate(Grid);
+}
+
+bool FGridFlowField::GetNextStep(const FGridStorage& Grid, int32_t X, int32_t Y, FGridPoint& OutNext) const
+{
+    if (!bBuilt || !Grid.IsValidCell(X, Y))
+        return false;
+
+    const uint32_t Here = Distance[X + Y * Width];
+    if (Here == 0 || Here == Unreachable)
+        return false;
+
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const int32_t Nx = X + FlowDx[i];
+        const int32_t Ny = Y + FlowDy[i];
+        if (Grid.CanMoveBetweenCells(X, Y, Nx, Ny) && Distance[Nx + Ny * Width] + 1 == Here)
+        {
+            OutNext = { Nx, Ny };
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,68 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "GridStorage.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * Multi-source distance field toward every cell holding a target state.
+ *
+ * Distances follow the same moves as CanMoveBetweenCells, so any agent can
+ * read its next step toward the nearest target in O(1) instead of running
+ * its own search. After edits, Update repairs only the cells whose distance
+ * actually changes: cells that lost their shortest route are cleared and
+ * re-seeded from their neighbours, then improvements are propagated outward.
+ */
+class FGridFlowField
+{
+public:
+	static constexpr uint32_t Unreachable = 0xFFFFFFFFu;
+
+	/** Full rebuild, one breadth-first sweep from all target cells at once. */
+	void Build(const FGridStorage& Grid, EGridCell Target);
+
+	/**
+	 * Incremental repair after cell state or fence edits. ChangedCells lists
+	 * every cell whose state changed and both cells on either side of a new
+	 * fence. Falls back to Build if the grid was resized.
+	 */
+	void Update(const FGridStorage& Grid, const std::vector<FGridPoint>& ChangedCells);
+
+	bool IsBuilt() const { return bBuilt; }
+	EGridCell GetTarget() const { return Target; }
+
+	uint32_t GetDistance(int32_t X, int32_t Y) const { return Distance[X + Y * Width]; }
+
+	/** Neighbour one step closer to the nearest target, false at a target or when none is reachable. */
+	bool GetNextStep(const FGridStorage& Grid, int32_t X, int32_t Y, FGridPoint& OutNext) const;
+
+	/** Cells whose distance changed in the last Build or Update, for profiling. */
+	int32_t GetCellsTouched() const { return CellsTouched; }
+
+private:
+	bool IsTargetCell(const FGridStorage& Grid, int32_t Index) const;
+	bool IsSupported(const FGridStorage& Grid, int32_t Index) const;
+	uint32_t BestFromNeighbours(const FGridStorage& Grid, int32_t Index) const;
+	void Propagate(const FGridStorage& Grid);
+
+	struct FOpenCell
+	{
+		uint32_t Distance;
+		int32_t Index;
+		bool operator<(const FOpenCell& Other) const { return Distance > Other.Distance; }
+	};
+
+	std::vector<uint32_t> Distance;
+	std::vector<uint8_t> Invalid;
+	std::vector<int32_t> Work;
+	std::vector<int32_t> Cleared;
+	std::vector<FOpenCell> Open;
+
+	int32_t Width{ 0 };
+	int32_t Height{ 0 };
+	EGridCell Target{ EGridCell::Human };
+	bool bBuilt{ false };
+	int32_t CellsTouched{ 0 };
+};
@@ -0,0 +1,494 @@
+// Copyright University of Inland Norway
+
+#include "GridInfectionModel.h"
+#include "SimulationSnapshot.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+// Same side order as FGridStorage::GetNeighbors; side s and side s ^ 1 face each other
+static const int32_t InfectionDx[4] = { -1, 1, 0, 0 };
+static const int32_t InfectionDy[4] = { 0, 0, -1, 1 };
+
+// Independent random streams per cell and day
+static constexpr uint32_t BiteStream = 0;
+static constexpr uint32_t MoveChanceStream = 1;
+static constexpr uint32_t MoveSideStream = 2;
+static constexpr uint32_t AcceptStream = 3;
+
+static int64_t CountTileBits(uint64_t Mask)
+{
+    return FGridStorage::CountBits(Mask);
+}
+
+FGridInfectionModel::FGridInfectionModel(FWorkStealingPool* InPool)
+    : Pool(InPool)
+{
+}
+
+FWorkStealingPool& FGridInfectionModel::GetPool() const
+{
+    // Not bound in the constructor, so default objects (an actor's CDO) never start the shared pool
+    return Pool ? *Pool : FWorkStealingPool::Get();
+}
+
+void FGridInfectionModel::Reset(const FGridStorage& Grid)
+{
+    Width = Grid.GetWidth();
+    Height = Grid.GetHeight();
+    TilesX = Grid.GetTilesX();
+    TilesY = Grid.GetTilesY();
+    Day = 0;
+
+    const size_t NumTiles = static_cast<size_t>(TilesX) * TilesY;
+    const size_t NumCells = static_cast<size_t>(Width) * Height;
+    AfterBites.assign(NumTiles, FStatePlanes());
+    Next.assign(NumTiles, FStatePlanes());
+    DaysToTurn.assign(NumCells, 0);
+    AfterBitesDaysToTurn.assign(NumCells, 0);
+    WantedSide.assign(NumCells, -1);
+    NextDaysToTurn.assign(NumCells, 0);
+    RowChanges.assign(TilesY, std::vector<FGridPoint>());
+    RowCounts.assign(TilesY, FGridInfectionCounts());
+    ChangedCells.clear();
+
+    Counts = FGridInfectionCounts();
+    Counts.Susceptible = Grid.CountCells(EGridCell::Human);
+    Counts.Zombies = Grid.CountCells(EGridCell::Zombie);
+}
+
+// Bite timers are sparse next to the grid, only the running ones are saved
+struct FGridBiteTimer
+{
+    int32_t Index;
+    uint16_t DaysToTurn;
+};
+
+void FGridInfectionModel::SaveState(FSnapshotWriter& Writer) const
+{
+    std::vector<FGridBiteTimer> Timers;
+    for (size_t Index = 0; Index < DaysToTurn.size(); ++Index)
+    {
+        if (DaysToTurn[Index] > 0)
+        {
+            Timers.push_back({ static_cast<int32_t>(Index), DaysToTurn[Index] });
+        }
+    }
+
+    Writer.Write(Width);
+    Writer.Write(Height);
+    Writer.Write(Day);
+    Writer.WriteArray(Timers);
+}
+
+bool FGridInfectionModel::LoadState(const FGridStorage& Grid, FSnapshotReader& Reader)
+{
+    int32_t SavedWidth = 0;
+    int32_t SavedHeight = 0;
+    int32_t SavedDay = 0;
+    std::vector<FGridBiteTimer> Timers;
+    if (!Reader.Read(SavedWidth) || !Reader.Read(SavedHeight) || !Reader.Read(SavedDay)
+        || SavedWidth != Grid.GetWidth() || SavedHeight != Grid.GetHeight()
+        || !Reader.ReadArray(Timers, static_cast<size_t>(Grid.GetNumCells())))
+    {
+        return false;
+    }
+
+    Reset(Grid);
+    Day = SavedDay;
+    for (const FGridBiteTimer& Timer : Timers)
+    {
+        if (Timer.Index >= 0 && Timer.Index < Grid.GetNumCells())
+        {
+            DaysToTurn[Timer.Index] = Timer.DaysToTurn;
+            ++Counts.Bitten;
+        }
+    }
+
+    // Same split Step reports, bitten humans are still Human cells
+    Counts.Susceptible -= Counts.Bitten;
+    return true;
+}
+
+void FGridInfectionModel::ClearCell(int32_t X, int32_t Y)
+{
+    if (static_cast<uint32_t>(X) < static_cast<uint32_t>(Width) && static_cast<uint32_t>(Y) < static_cast<uint32_t>(Height))
+        DaysToTurn[X + Y * Width] = 0;
+}
+
+float FGridInfectionModel::Random(int32_t Index, uint32_t Stream) const
+{
+    // SplitMix64 finaliser over (seed, day, cell, stream), the same draw on any thread
+    uint64_t Hash = Params.Seed + 0x9E3779B97F4A7C15ull * ((static_cast<uint64_t>(Day) << 32) ^ (static_cast<uint64_t>(Index) << 2) ^ Stream);
+    Hash = (Hash ^ (Hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    Hash = (Hash ^ (Hash >> 27)) * 0x94D049BB133111EBull;
+    Hash ^= Hash >> 31;
+    return static_cast<float>(Hash >> 40) * (1.f / 16777216.f);
+}
+
+// Maps up to this many cells run both passes on the calling thread, handing their few rows to the pool costs more than it saves
+static constexpr int32_t GridInfectionInlineCells = 64 * 64;
+
+// Map size as compile-time constants, so index math and bounds checks fold away and the tile loops unroll
+template <int32_t InWidth, int32_t InHeight>
+struct TGridInfectionFixedDims
+{
+    static constexpr int32_t Width = InWidth;
+    static constexpr int32_t Height = InHeight;
+    static constexpr int32_t TilesX = (InWidth + FGridStorage::TileMask) >> FGridStorage::TileShift;
+    static constexpr int32_t TilesY = (InHeight + FGridStorage::TileMask) >> FGridStorage::TileShift;
+};
+
+// Any other size, the same kernels reading it at runtime
+struct FGridInfectionRuntimeDims
+{
+    int32_t Width;
+    int32_t Height;
+    int32_t TilesX;
+    int32_t TilesY;
+};
+
+/** Calls Body with the kernel dimensions for a map, a fixed instantiation when one exists and bFixed allows it. */
+template <typename FBody>
+static void DispatchGridInfectionDims(int32_t Width, int32_t Height, bool bFixed, FBody&& Body)
+{
+    // AGridManager's default map first, then the sizes maps usually come in
+    if (bFixed && Width == Height)
+    {
+        switch (Width)
+        {
+        case 10: Body(TGridInfectionFixedDims<10, 10>()); return;
+        case 16: Body(TGridInfectionFixedDims<16, 16>()); return;
+        case 32: Body(TGridInfectionFixedDims<32, 32>()); return;
+        case 64: Body(TGridInfectionFixedDims<64, 64>()); return;
+        default: break;
+        }
+    }
+    const FGridInfectionRuntimeDims Dims = { Width, Height, (Width + FGridStorage::TileMask) >> FGridStorage::TileShift,
+        (Height + FGridStorage::TileMask) >> FGridStorage::TileShift };
+    Body(Dims);
+}
+
+template <typename TDims>
+static inline bool IsInfectionCellInside(const TDims& Dims, int32_t X, int32_t Y)
+{
+    return static_cast<uint32_t>(X) < static_cast<uint32_t>(Dims.Width) && static_cast<uint32_t>(Y) < static_cast<uint32_t>(Dims.Height);
+}
+
+template <typename TDims>
+static inline const FGridTile& GetInfectionTile(const FGridTile* Tiles, const TDims& Dims, int32_t X, int32_t Y)
+{
+    return Tiles[(Y >> FGridStorage::TileShift) * Dims.TilesX + (X >> FGridStorage::TileShift)];
+}
+
+template <typename TDims>
+static inline EGridCell GetInfectionCell(const FGridTile* Tiles, const TDims& Dims, int32_t X, int32_t Y)
+{
+    const FGridTile& Tile = GetInfectionTile(Tiles, Dims, X, Y);
+    const uint32_t Bit = FGridStorage::GetBit(X, Y);
+    return static_cast<EGridCell>(((Tile.StateLo >> Bit) & 1u) | (((Tile.StateHi >> Bit) & 1u) << 1));
+}
+
+// Fence on side Side of (X, Y), which must have a neighbour there; each edge is stored on its lower cell
+template <typename TDims>
+static inline bool HasInfectionFence(const FGridTile* Tiles, const TDims& Dims, int32_t X, int32_t Y, int32_t Side)
+{
+    const int32_t Ex = X + (Side == 0 ? -1 : 0);
+    const int32_t Ey = Y + (Side == 2 ? -1 : 0);
+    const FGridTile& Tile = GetInfectionTile(Tiles, Dims, Ex, Ey);
+    return (((Side < 2) ? Tile.FenceRight : Tile.FenceUp) >> FGridStorage::GetBit(Ex, Ey)) & 1u;
+}
+
+bool FGridInfectionModel::HasFixedKernel(int32_t InWidth, int32_t InHeight)
+{
+    bool bFixed = false;
+    DispatchGridInfectionDims(InWidth, InHeight, true, [&bFixed](const auto& Dims)
+    {
+        bFixed = !std::is_same<std::decay_t<decltype(Dims)>, FGridInfectionRuntimeDims>::value;
+    });
+    return bFixed;
+}
+
+template <typename TDims>
+EGridCell FGridInfectionModel::ReadCell(const std::vector<FStatePlanes>& Planes, const TDims& Dims, int32_t X, int32_t Y) const
+{
+    const FStatePlanes& Tile = Planes[(Y >> FGridStorage::TileShift) * Dims.TilesX + (X >> FGridStorage::TileShift)];
+    const uint32_t Bit = FGridStorage::GetBit(X, Y);
+    return static_cast<EGridCell>(((Tile.Lo >> Bit) & 1u) | (((Tile.Hi >> Bit) & 1u) << 1));
+}
+
+template <typename TDims>
+void FGridInfectionModel::BiteTileRow(const FGridStorage& Grid, const TDims& Dims, int32_t TileY)
+{
+    const FGridTile* Tiles = Grid.GetTiles().data();
+    const float BitesPerSide = Params.NormalNumberOfBites * 0.25f;
+    const float Delay = std::ceil(Params.DaysToBecomeInfectedFromBite);
+    const uint16_t DelaySteps = static_cast<uint16_t>(std::min(65535.f, std::max(1.f, Delay)));
+
+    const int32_t MinY = TileY << FGridStorage::TileShift;
+    const int32_t MaxY = std::min<int32_t>(Dims.Height, MinY + FGridStorage::TileSize);
+    for (int32_t TileX = 0; TileX < Dims.TilesX; ++TileX)
+    {
+        const int32_t TileIndex = TileY * Dims.TilesX + TileX;
+        const FGridTile& Tile = Tiles[TileIndex];
+        FStatePlanes Out = { Tile.StateLo, Tile.StateHi };
+        const uint64_t Humans = Tile.StateLo & ~Tile.StateHi;
+
+        const int32_t MinX = TileX << FGridStorage::TileShift;
+        const int32_t MaxX = std::min<int32_t>(Dims.Width, MinX + FGridStorage::TileSize);
+        for (int32_t Y = MinY; Y < MaxY; ++Y)
+        {
+            for (int32_t X = MinX; X < MaxX; ++X)
+            {
+                const int32_t Index = X + Y * Dims.Width;
+                const uint32_t Bit = FGridStorage::GetBit(X, Y);
+                if (((Humans >> Bit) & 1u) == 0)
+                {
+                    AfterBitesDaysToTurn[Index] = 0;
+                    WantedSide[Index] = ((Tile.StateHi >> Bit) & 1u) ? static_cast<int8_t>(PickMove(Grid, Dims, X, Y, EGridCell::Zombie)) : int8_t(-1);
+                    continue;
+                }
+
+                // 1. - Already bitten, count down and turn
+                uint16_t Timer = DaysToTurn[Index];
+                if (Timer > 0)
+                {
+                    if (--Timer == 0)
+                    {
+                        Out.Lo &= ~(uint64_t(1) << Bit);
+                        Out.Hi |= uint64_t(1) << Bit;
+                    }
+                    AfterBitesDaysToTurn[Index] = Timer;
+                    WantedSide[Index] = static_cast<int8_t>(PickMove(Grid, Dims, X, Y, Timer == 0 ? EGridCell::Zombie : EGridCell::Human));
+                    continue;
+                }
+
+                // 2. - Zombies that could step in through an unfenced side
+                int32_t Attackers = 0;
+                for (int32_t i = 0; i < 4; ++i)
+                {
+                    const int32_t Nx = X + InfectionDx[i];
+                    const int32_t Ny = Y + InfectionDy[i];
+                    if (IsInfectionCellInside(Dims, Nx, Ny) && GetInfectionCell(Tiles, Dims, Nx, Ny) == EGridCell::Zombie
+                        && !HasInfectionFence(Tiles, Dims, X, Y, i))
+                        ++Attackers;
+                }
+                if (Attackers > 0)
+                {
+                    // 3. - Local density effect from the humans in the 3x3 window
+                    int32_t Cells = 0;
+                    int32_t People = 0;
+                    for (int32_t Wy = std::max(0, Y - 1); Wy <= std::min<int32_t>(Dims.Height - 1, Y + 1); ++Wy)
+                    {
+                        for (int32_t Wx = std::max(0, X - 1); Wx <= std::min<int32_t>(Dims.Width - 1, X + 1); ++Wx)
+                        {
+                            ++Cells;
+                            People += (GetInfectionCell(Tiles, Dims, Wx, Wy) == EGridCell::Human) ? 1 : 0;
+                        }
+                    }
+                    const float Density = static_cast<float>(People) / static_cast<float>(Cells);
+                    const float DensityRatio = Params.NormalPopulationDensity > 0.f ? Density / Params.NormalPopulationDensity : 0.f;
+                    const float PerZombie = std::min(1.f, std::max(0.f, BitesPerSide * Curve.Evaluate(DensityRatio)));
+                    const float BiteChance = 1.f - std::pow(1.f - PerZombie, static_cast<float>(Attackers));
+                    if (Random(Index, BiteStream) < BiteChance)
+                        Timer = DelaySteps;
+                }
+                AfterBitesDaysToTurn[Index] = Timer;
+                WantedSide[Index] = static_cast<int8_t>(PickMove(Grid, Dims, X, Y, EGridCell::Human));
+            }
+        }
+        AfterBites[TileIndex] = Out;
+    }
+}
+
+template <typename TDims>
+int32_t FGridInfectionModel::PickMove(const FGridStorage& Grid, const TDims& Dims, int32_t X, int32_t Y, EGridCell Cell) const
+{
+    // Bites never empty or fill a cell, so the targets can be judged on the grid before them
+    const int32_t Index = X + Y * Dims.Width;
+    const float Chance = (Cell == EGridCell::Zombie) ? Params.ZombieMoveChance : Params.HumanMoveChance;
+    if (Random(Index, MoveChanceStream) >= Chance)
+        return -1;
+
+    const FGridTile* Tiles = Grid.GetTiles().data();
+    const int32_t Side = std::min(3, static_cast<int32_t>(Random(Index, MoveSideStream) * 4.f));
+    const int32_t Nx = X + InfectionDx[Side];
+    const int32_t Ny = Y + InfectionDy[Side];
+    if (!IsInfectionCellInside(Dims, Nx, Ny) || HasInfectionFence(Tiles, Dims, X, Y, Side) || GetInfectionCell(Tiles, Dims, Nx, Ny) != EGridCell::Empty)
+        return -1;
+    return Side;
+}
+
+template <typename TDims>
+int32_t FGridInfectionModel::GetAcceptedMover(const TDims& Dims, int32_t X, int32_t Y) const
+{
+    // Candidates are tried from a random side so no direction is favoured
+    const int32_t First = std::min(3, static_cast<int32_t>(Random(X + Y * Dims.Width, AcceptStream) * 4.f));
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const int32_t Side = (First + i) & 3;
+        const int32_t Nx = X + InfectionDx[Side];
+        const int32_t Ny = Y + InfectionDy[Side];
+        if (IsInfectionCellInside(Dims, Nx, Ny) && WantedSide[Nx + Ny * Dims.Width] == (Side ^ 1))
+            return Side;
+    }
+    return -1;
+}
+
+template <typename TDims>
+void FGridInfectionModel::MoveTileRow(const FGridStorage& Grid, const TDims& Dims, int32_t TileY)
+{
+    auto IsTileOccupied = [this, &Dims](int32_t Tx, int32_t Ty)
+    {
+        if (Tx < 0 || Ty < 0 || Tx >= Dims.TilesX || Ty >= Dims.TilesY)
+            return false;
+        const FStatePlanes& Planes = AfterBites[Ty * Dims.TilesX + Tx];
+        return (Planes.Lo | Planes.Hi) != 0;
+    };
+
+    std::vector<FGridPoint>& Changes = RowChanges[TileY];
+    FGridInfectionCounts& RowCount = RowCounts[TileY];
+    Changes.clear();
+    RowCount = FGridInfectionCounts();
+
+    const int32_t MinY = TileY << FGridStorage::TileShift;
+    const int32_t MaxY = std::min<int32_t>(Dims.Height, MinY + FGridStorage::TileSize);
+    for (int32_t TileX = 0; TileX < Dims.TilesX; ++TileX)
+    {
+        const int32_t TileIndex = TileY * Dims.TilesX + TileX;
+        const int32_t MinX = TileX << FGridStorage::TileShift;
+        const int32_t MaxX = std::min<int32_t>(Dims.Width, MinX + FGridStorage::TileSize);
+
+        FStatePlanes Out;
+        const bool bQuiet = !IsTileOccupied(TileX, TileY) && !IsTileOccupied(TileX - 1, TileY) && !IsTileOccupied(TileX + 1, TileY)
+            && !IsTileOccupied(TileX, TileY - 1) && !IsTileOccupied(TileX, TileY + 1);
+
+        for (int32_t Y = MinY; Y < MaxY; ++Y)
+        {
+            for (int32_t X = MinX; X < MaxX; ++X)
+            {
+                const int32_t Index = X + Y * Dims.Width;
+                if (bQuiet)
+                {
+                    NextDaysToTurn[Index] = 0;
+                    continue;
+                }
+
+                EGridCell Cell = ReadCell(AfterBites, Dims, X, Y);
+                uint16_t Timer = AfterBitesDaysToTurn[Index];
+                if (Cell != EGridCell::Empty)
+                {
+                    // 1. - Leave only if the target cell picked this agent
+                    const int32_t Side = WantedSide[Index];
+                    if (Side >= 0 && GetAcceptedMover(Dims, X + InfectionDx[Side], Y + InfectionDy[Side]) == (Side ^ 1))
+                    {
+                        Cell = EGridCell::Empty;
+                        Timer = 0;
+                    }
+                }
+                else
+                {
+                    // 2. - Pull in the accepted neighbour, bite timer and all
+                    const int32_t Side = GetAcceptedMover(Dims, X, Y);
+                    if (Side >= 0)
+                    {
+                        const int32_t Nx = X + InfectionDx[Side];
+                        const int32_t Ny = Y + InfectionDy[Side];
+                        Cell = ReadCell(AfterBites, Dims, Nx, Ny);
+                        Timer = AfterBitesDaysToTurn[Nx + Ny * Dims.Width];
+                    }
+                }
+
+                const uint32_t Bit = FGridStorage::GetBit(X, Y);
+                const uint32_t Value = static_cast<uint32_t>(Cell);
+                Out.Lo |= uint64_t(Value & 1u) << Bit;
+                Out.Hi |= uint64_t((Value >> 1) & 1u) << Bit;
+                NextDaysToTurn[Index] = Timer;
+                RowCount.Bitten += (Timer > 0) ? 1 : 0;
+            }
+        }
+        Next[TileIndex] = Out;
+
+        // 3. - Count and list what differs from the grid as it stands
+        const FGridTile& Tile = Grid.GetTiles()[TileIndex];
+        const uint64_t Changed = (Out.Lo ^ Tile.StateLo) | (Out.Hi ^ Tile.StateHi);
+        if (Changed != 0)
+        {
+            for (int32_t Y = MinY; Y < MaxY; ++Y)
+            {
+                for (int32_t X = MinX; X < MaxX; ++X)
+                {
+                    if ((Changed >> FGridStorage::GetBit(X, Y)) & 1u)
+                        Changes.push_back({ X, Y });
+                }
+            }
+        }
+        RowCount.Susceptible += CountTileBits(Out.Lo & ~Out.Hi);
+        RowCount.Zombies += CountTileBits(Out.Hi & ~Out.Lo);
+    }
+}
+
+template <typename TDims>
+void FGridInfectionModel::StepRows(const FGridStorage& Grid, const TDims& Dims)
+{
+    if (Dims.Width * Dims.Height <= GridInfectionInlineCells)
+    {
+        for (int32_t TileY = 0; TileY < Dims.TilesY; ++TileY)
+            BiteTileRow(Grid, Dims, TileY);
+        for (int32_t TileY = 0; TileY < Dims.TilesY; ++TileY)
+            MoveTileRow(Grid, Dims, TileY);
+        return;
+    }
+
+    // Both passes only read the buffer before them, so tile rows run in any order
+    GetPool().ParallelFor(Dims.TilesY, 1, [this, &Grid, &Dims](int64_t Begin, int64_t End)
+    {
+        for (int64_t TileY = Begin; TileY < End; ++TileY)
+            BiteTileRow(Grid, Dims, static_cast<int32_t>(TileY));
+    });
+    GetPool().ParallelFor(Dims.TilesY, 1, [this, &Grid, &Dims](int64_t Begin, int64_t End)
+    {
+        for (int64_t TileY = Begin; TileY < End; ++TileY)
+            MoveTileRow(Grid, Dims, static_cast<int32_t>(TileY));
+    });
+}
+
+void FGridInfectionModel::Step(const FGridStorage& Grid)
+{
+    if (Grid.GetWidth() != Width || Grid.GetHeight() != Height)
+        Reset(Grid);
+
+    // 1. - Both passes, with the kernels compiled for this map size when there are some
+    DispatchGridInfectionDims(Width, Height, bFixedKernels, [this, &Grid](const auto& Dims)
+    {
+        StepRows(Grid, Dims);
+    });
+    std::swap(DaysToTurn, NextDaysToTurn);
+
+    // 2. - Gather the per-row results in row order
+    ChangedCells.clear();
+    Counts = FGridInfectionCounts();
+    for (int32_t TileY = 0; TileY < TilesY; ++TileY)
+    {
+        ChangedCells.insert(ChangedCells.end(), RowChanges[TileY].begin(), RowChanges[TileY].end());
+        Counts.Susceptible += RowCounts[TileY].Susceptible;
+        Counts.Bitten += RowCounts[TileY].Bitten;
+        Counts.Zombies += RowCounts[TileY].Zombies;
+    }
+    // Bitten humans are still Human cells
+    Counts.Susceptible -= Counts.Bitten;
+    ++Day;
+}
+
+void FGridInfectionModel::Apply(FGridStorage& Grid) const
+{
+    if (Grid.GetWidth() != Width || Grid.GetHeight() != Height)
+        return;
+
+    for (size_t TileIndex = 0; TileIndex < Next.size(); ++TileIndex)
+    {
+        Grid.SetTileStates(static_cast<int32_t>(TileIndex), Next[TileIndex].Lo, Next[TileIndex].Hi);
+    }
+}
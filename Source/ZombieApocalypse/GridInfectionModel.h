@@ -0,0 +1,160 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "DensityEffectCurve.h"
+#include "GridStorage.h"
+#include <cstdint>
+#include <vector>
+
+class FSnapshotReader;
+class FSnapshotWriter;
+class FWorkStealingPool;
+
+struct FGridInfectionParams
+{
+	// Same meaning as the FSDParams fields, with one cell as one unit of land area
+	float NormalNumberOfBites = 1.f;
+	float NormalPopulationDensity = 0.1f;
+	float DaysToBecomeInfectedFromBite = 15.f;
+
+	// Chance per day that an agent tries a step to a random side
+	float HumanMoveChance = 0.25f;
+	float ZombieMoveChance = 0.5f;
+
+	uint64_t Seed = 1;
+};
+
+struct FGridInfectionCounts
+{
+	int64_t Susceptible = 0;
+	int64_t Bitten = 0;
+	int64_t Zombies = 0;
+};
+
+/**
+ * Per-cell infection and movement automaton over an FGridStorage.
+ *
+ * Each day runs two gather passes, every cell reading only the previous
+ * buffer and writing its own cell of the next one, so rows of tiles update
+ * in parallel and the result does not depend on the thread count:
+ *  1. Bites - a susceptible human is bitten with 1 - (1 - q)^k, k being the
+ *     zombies that can step into it past fences and q = NormalNumberOfBites *
+ *     DensityEffect / 4 (a zombie's daily bites shared over its four sides).
+ *     The density effect reads the human share of the 3x3 window against
+ *     NormalPopulationDensity, like the SD model reads population per area.
+ *     Bitten humans turn after max(1, ceil(DaysToBecomeInfectedFromBite))
+ *     days, the same delay as the discrete conveyor.
+ *  2. Movement - agents pick a random side; an empty cell accepts one of the
+ *     agents aiming at it, and the mover vacates only if it was the one taken.
+ * Random draws hash (Seed, Day, cell), never a shared generator. Maps of up
+ * to 64x64 cells run both passes on the calling thread.
+ *
+ * Step leaves the grid alone: the caller writes the result back with Apply,
+ * or cell by cell from GetChangedCells when only a few changed.
+ */
+class FGridInfectionModel
+{
+public:
+	/** Without a pool the shared one is used, looked up only once there is work for it. */
+	explicit FGridInfectionModel(FWorkStealingPool* InPool = nullptr);
+
+	void SetParams(const FGridInfectionParams& InParams) { Params = InParams; }
+	const FGridInfectionParams& GetParams() const { return Params; }
+
+	void SetCurve(const FDensityEffectCurve& InCurve) { Curve = InCurve; }
+
+	/** Sizes the buffers for Grid, forgets every bite and restarts at day 0. */
+	void Reset(const FGridStorage& Grid);
+
+	/** Computes the next day from Grid. Resets first if Grid was resized. */
+	void Step(const FGridStorage& Grid);
+
+	/**
+	 * Square maps of 10, 16, 32 and 64 cells step with kernels compiled for that size. Off forces
+	 * the runtime-sized kernels, which give the same result; only there for comparing the two.
+	 */
+	static bool HasFixedKernel(int32_t InWidth, int32_t InHeight);
+	void SetFixedKernels(bool bEnable) { bFixedKernels = bEnable; }
+
+	/** Writes the whole computed day into Grid. */
+	void Apply(FGridStorage& Grid) const;
+
+	/** Cells whose state differs between Grid and the computed day, in tile row order. */
+	const std::vector<FGridPoint>& GetChangedCells() const { return ChangedCells; }
+	EGridCell GetNextCell(int32_t X, int32_t Y) const { return ReadCell(Next, X, Y); }
+
+	/** Forgets a bite, for cells edited from outside between steps. */
+	void ClearCell(int32_t X, int32_t Y);
+
+	/** The day and the running bite timers, the random draws follow from Seed and day alone. */
+	void SaveState(FSnapshotWriter& Writer) const;
+
+	/** Restores over Grid, which must already hold the cells of the same save. */
+	bool LoadState(const FGridStorage& Grid, FSnapshotReader& Reader);
+
+	bool IsBitten(int32_t X, int32_t Y) const { return DaysToTurn[X + Y * Width] > 0; }
+	const FGridInfectionCounts& GetCounts() const { return Counts; }
+	int32_t GetDay() const { return Day; }
+
+private:
+	struct FStatePlanes
+	{
+		uint64_t Lo = 0;
+		uint64_t Hi = 0;
+	};
+
+	EGridCell ReadCell(const std::vector<FStatePlanes>& Planes, int32_t X, int32_t Y) const
+	{
+		const FStatePlanes& Tile = Planes[(Y >> FGridStorage::TileShift) * TilesX + (X >> FGridStorage::TileShift)];
+		const uint32_t Bit = FGridStorage::GetBit(X, Y);
+		return static_cast<EGridCell>(((Tile.Lo >> Bit) & 1u) | (((Tile.Hi >> Bit) & 1u) << 1));
+	}
+
+	float Random(int32_t Index, uint32_t Stream) const;
+
+	// Kernels over the map size TDims, a compile-time one for common sizes or the runtime one
+	template <typename TDims>
+	EGridCell ReadCell(const std::vector<FStatePlanes>& Planes, const TDims& Dims, int32_t X, int32_t Y) const;
+	template <typename TDims>
+	void StepRows(const FGridStorage& Grid, const TDims& Dims);
+	template <typename TDims>
+	void BiteTileRow(const FGridStorage& Grid, const TDims& Dims, int32_t TileY);
+	template <typename TDims>
+	int32_t PickMove(const FGridStorage& Grid, const TDims& Dims, int32_t X, int32_t Y, EGridCell Cell) const;
+	template <typename TDims>
+	int32_t GetAcceptedMover(const TDims& Dims, int32_t X, int32_t Y) const;
+	template <typename TDims>
+	void MoveTileRow(const FGridStorage& Grid, const TDims& Dims, int32_t TileY);
+
+	FWorkStealingPool& GetPool() const;
+
+	// Null for the shared pool
+	FWorkStealingPool* Pool{ nullptr };
+	FGridInfectionParams Params;
+	FDensityEffectCurve Curve;
+
+	// States after the bite pass, then after movement; bite timers travel with their agent
+	std::vector<FStatePlanes> AfterBites;
+	std::vector<FStatePlanes> Next;
+	std::vector<uint16_t> DaysToTurn;
+	std::vector<uint16_t> AfterBitesDaysToTurn;
+	std::vector<uint16_t> NextDaysToTurn;
+
+	// Side each agent tries to step to this day, -1 for none, picked during the bite pass
+	std::vector<int8_t> WantedSide;
+
+	// Written per tile row by the workers, gathered in row order afterwards
+	std::vector<std::vector<FGridPoint>> RowChanges;
+	std::vector<FGridInfectionCounts> RowCounts;
+
+	std::vector<FGridPoint> ChangedCells;
+	FGridInfectionCounts Counts;
+
+	int32_t Width{ 0 };
+	int32_t Height{ 0 };
+	int32_t TilesX{ 0 };
+	int32_t TilesY{ 0 };
+	int32_t Day{ 0 };
+	bool bFixedKernels{ true };
+};
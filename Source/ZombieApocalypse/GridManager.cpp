@@ -1,130 +1,546 @@
 #include "GridManager.h"
-#include "Containers/Queue.h"
+#include "Serialization/CustomVersion.h"
+#include "SimulationSnapshot.h"
+#include "ZombieSimStats.h"
  
+static_assert(static_cast<uint8>(ECellState::Zombie) == static_cast<uint8>(EGridCell::Zombie), "ECellState and EGridCell must match");
+static_assert(static_cast<uint8>(EEdgeDirection::Right) == static_cast<uint8>(EGridEdge::Right), "EEdgeDirection and EGridEdge must match");
+
+// Levels saved before the cells were serialized carry no grid blob
+struct FGridManagerVersion
+{
+    enum Type
+    {
+        BeforeCustomVersion = 0,
+        SerializedStorage = 1,
+        LatestVersion = SerializedStorage
+    };
+
+    static const FGuid GUID;
+};
+
+const FGuid FGridManagerVersion::GUID(0x5A3C91E2, 0x7B4D4F08, 0x9E61C2D7, 0x3F0A85B4);
+static FCustomVersionRegistration GRegisterGridManagerVersion(FGridManagerVersion::GUID, FGridManagerVersion::LatestVersion, TEXT("GridManagerVer"));
+
 AGridManager::AGridManager()
 {
-    Grid.SetNum(GridSize * GridSize);
-    for (int32 i = 0; i < Grid.Num(); ++i)
+    PrimaryActorTick.bCanEverTick = true;
+    Storage.Init(GridWidth, GridHeight);
+    Connectivity.Build(Storage);
+    InfectionModel.Reset(Storage);
+    Journal.Reset(Storage.GetTilesX(), Storage.GetTilesY());
+}
+
+void AGridManager::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    Journal.BeginFrame();
+
+    DispatchPathRequests();
+}
+
+void AGridManager::BeginPlay()
+{
+    Super::BeginPlay();
+
+    if (Storage.GetWidth() != GridWidth || Storage.GetHeight() != GridHeight)
     {
-        Grid[i].State = ECellState::Empty;
+        InitializeGrid(GridWidth, GridHeight);
     }
- 
-    HorizontalFence.Init(false, GridSize * (GridSize + 1));
-    VerticalFence.Init(false, (GridSize + 1) * GridSize);
+}
+
+void AGridManager::Serialize(FArchive& Ar)
+{
+    Super::Serialize(Ar);
+
+    Ar.UsingCustomVersion(FGridManagerVersion::GUID);
+    if (Ar.CustomVer(FGridManagerVersion::GUID) < FGridManagerVersion::SerializedStorage)
+        return;
+
+    // 1. - Same layout as the snapshot's grid part, so saving reuses FGridStorage::SaveState
+    TArray<uint8> Bytes;
+    if (Ar.IsSaving())
+    {
+        std::vector<uint8_t> Buffer;
+        FSnapshotWriter Writer(Buffer);
+        Storage.SaveState(Writer);
+        Bytes.Append(Buffer.data(), static_cast<int32>(Buffer.size()));
+    }
+    Ar << Bytes;
+
+    // 2. - Loading swaps the cells in only if the blob reads back whole and still matches GridWidth/GridHeight,
+    // a grid resized in the details panel starts empty in BeginPlay as before
+    if (Ar.IsLoading())
+    {
+        FSnapshotReader Reader(Bytes.GetData(), static_cast<size_t>(Bytes.Num()));
+        FGridStorage Loaded;
+        if (!Loaded.LoadState(Reader))
+        {
+            UE_LOG(LogTemp, Error, TEXT("GridManager: saved cells of %s could not be read, the grid starts empty"), *GetName());
+            return;
+        }
+        if (Loaded.GetWidth() != GridWidth || Loaded.GetHeight() != GridHeight)
+            return;
+
+        Storage = MoveTemp(Loaded);
+        Connectivity.Build(Storage);
+        InfectionModel.Reset(Storage);
+        Journal.Reset(Storage.GetTilesX(), Storage.GetTilesY());
+        ResetFlowFields();
+        SpatialIndex = FGridSpatialIndex();
+    }
+}
+
+bool AGridManager::InitializeGrid(int32 Width, int32 Height)
+{
+    if (!Storage.Init(Width, Height))
+    {
+        UE_LOG(LogTemp, Error, TEXT("GridManager: %dx%d is outside 1..%d"), Width, Height, FGridStorage::MaxDimension);
+        return false;
+    }
+
+    GridWidth = Width;
+    GridHeight = Height;
+    Connectivity.Build(Storage);
+    InfectionModel.Reset(Storage);
+    Journal.Reset(Storage.GetTilesX(), Storage.GetTilesY());
+    UE_LOG(LogTemp, Log, TEXT("GridManager: %dx%d grid uses %lld bytes"), Width, Height, GetMemoryFootprintBytes());
+    return true;
+}
+
+ECellState AGridManager::GetCellState(int32 X, int32 Y) const
+{
+    return IsValidCell(X, Y) ? static_cast<ECellState>(Storage.GetCell(X, Y)) : ECellState::Empty;
+}
+
+void AGridManager::SetCellState(int32 X, int32 Y, ECellState State)
+{
+    if (!IsValidCell(X, Y) || Storage.GetCell(X, Y) == static_cast<EGridCell>(State))
+        return;
+
+    Journal.RecordCell(X, Y, Storage.GetCell(X, Y), static_cast<EGridCell>(State));
+    Connectivity.SetCell(Storage, X, Y, static_cast<EGridCell>(State));
+    InfectionModel.ClearCell(X, Y);
+}
+
+int64 AGridManager::CountCells(ECellState State) const
+{
+    return Storage.CountCells(static_cast<EGridCell>(State));
+}
+
+int64 AGridManager::CountCellsInRect(ECellState State, int32 MinX, int32 MinY, int32 MaxX, int32 MaxY) const
+{
+    return Storage.CountCellsInRect(static_cast<EGridCell>(State), MinX, MinY, MaxX, MaxY);
+}
+
+int64 AGridManager::GetMemoryFootprintBytes() const
+{
+    return static_cast<int64>(Storage.GetMemoryFootprintBytes());
 }
  
 bool AGridManager::IsValidCell(int32 X, int32 Y) const
 {
-    return X >= 0 && X < GridSize && Y >= 0 && Y < GridSize;
+    return Storage.IsValidCell(X, Y);
 }
  
 void AGridManager::PlaceFence(int32 CellX, int32 CellY, EEdgeDirection Edge)
 {
-    switch (Edge)
-    {
-    case EEdgeDirection::Top:
-        if (IsValidCell(CellX, CellY))
-            HorizontalFence[GetHorizontalFenceIndex(CellX, CellY)] = true;
-        break;
-    case EEdgeDirection::Bottom:
-        if (IsValidCell(CellX, CellY - 1))
-            HorizontalFence[GetHorizontalFenceIndex(CellX, CellY - 1)] = true;
-        break;
-    case EEdgeDirection::Left:
-        if (IsValidCell(CellX - 1, CellY))
-            VerticalFence[GetVerticalFenceIndex(CellX - 1, CellY)] = true;
-        break;
-    case EEdgeDirection::Right:
-        if (IsValidCell(CellX, CellY))
-            VerticalFence[GetVerticalFenceIndex(CellX, CellY)] = true;
-        break;
+    // Logged once, as the Top or Right edge of the lower / left cell, and only if it is new
+    FGridPoint A;
+    FGridPoint B;
+    FGridStorage::GetEdgeCells(CellX, CellY, static_cast<EGridEdge>(Edge), A, B);
+    if (Storage.IsValidCell(A.X, A.Y) && Storage.IsValidCell(B.X, B.Y) && !Storage.IsEdgeBlockedByFence(A.X, A.Y, B.X, B.Y))
+    {
+        Journal.RecordFence(A.X, A.Y, A.X == B.X ? EGridEdge::Top : EGridEdge::Right);
     }
+    Connectivity.PlaceFence(Storage, CellX, CellY, static_cast<EGridEdge>(Edge));
 }
  
 bool AGridManager::IsEdgeBlockedByFence(int32 X1, int32 Y1, int32 X2, int32 Y2) const
 {
-    if (!IsValidCell(X1, Y1) || !IsValidCell(X2, Y2))
-        return true;
- 
-    if (X1 == X2)
+    return Storage.IsEdgeBlockedByFence(X1, Y1, X2, Y2);
+}
+
+bool AGridManager::CanMoveBetweenCells(int32 FromX, int32 FromY, int32 ToX, int32 ToY) const
+{
+    return Storage.CanMoveBetweenCells(FromX, FromY, ToX, ToY);
+}
+
+void AGridManager::GetNeighbors(const FGridNode& Node, TArray<FGridNode>& OutNeighbors) const
+{
+    FGridPoint Neighbors[4];
+    const int32 Count = Storage.GetNeighbors(Node.X, Node.Y, Neighbors);
+    for (int32 i = 0; i < Count; ++i)
     {
-        int32 MinY = FMath::Min(Y1, Y2);
-        return HorizontalFence[GetHorizontalFenceIndex(X1, MinY)];
+        OutNeighbors.Add(FGridNode(Neighbors[i].X, Neighbors[i].Y));
     }
-    else if (Y1 == Y2)
+}
+
+
+bool AGridManager::FindPath(const FGridNode& Start, const FGridNode& End, TArray<FGridNode>& OutPath) const
+{
+    return FindPath(Start, End, OutPath, EGridPathMode::BFS);
+}
+
+bool AGridManager::FindPath(const FGridNode& Start, const FGridNode& End, TArray<FGridNode>& OutPath, EGridPathMode Mode) const
+{
+    // Different regions would only fail after searching all of Start's region
+    if (!CanReach(Start, End))
+        return false;
+
+    const FGridPathHierarchy* Hierarchy = Mode == EGridPathMode::Hierarchical ? &EnsurePathHierarchy() : nullptr;
+
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_PathQuery);
+    const bool bFound = Pathfinder.FindPath(Storage, { Start.X, Start.Y }, { End.X, End.Y }, Mode, Hierarchy);
+    ZOMBIESIM_COUNTER_ADD(STAT_ZombieSim_PathQueries, 1);
+    ZOMBIESIM_COUNTER_ADD(STAT_ZombieSim_NodesExpanded, Pathfinder.GetNodesExpanded());
+    if (!bFound)
+        return false;
+
+    const std::vector<FGridPoint>& Path = Pathfinder.GetPath();
+    OutPath.Reset(static_cast<int32>(Path.size()));
+    for (const FGridPoint& Point : Path)
     {
-        int32 MinX = FMath::Min(X1, X2);
-        return VerticalFence[GetVerticalFenceIndex(MinX, Y1)];
+        OutPath.Emplace(Point.X, Point.Y);
     }
     return true;
 }
 
-bool AGridManager::CanMoveBetweenCells(int32 FromX, int32 FromY, int32 ToX, int32 ToY) const
+bool AGridManager::CanReach(const FGridNode& Start, const FGridNode& End) const
 {
-    return IsValidCell(ToX, ToY)
-        && !IsEdgeBlockedByFence(FromX, FromY, ToX, ToY)
-        && Grid[GetGridIndex(ToX, ToY)].IsWalkable();
+    return Connectivity.CanReach(Storage, { Start.X, Start.Y }, { End.X, End.Y });
 }
 
-void AGridManager::GetNeighbors(const FGridNode& Node, TArray<FGridNode>& OutNeighbors) const
+int32 AGridManager::GetSafeHumanCount() const
 {
-    static const int32 Dx[4] = { -1, 1, 0, 0 };
-    static const int32 Dy[4] = { 0, 0, -1, 1 };
- 
-    for (int32 i = 0; i < 4; ++i)
+    return Connectivity.GetSafeHumans();
+}
+
+int32 AGridManager::RequestPathAsync(const FGridNode& Start, const FGridNode& End, EGridPathMode Mode, FOnGridPathFound Callback)
+{
+    const int32 RequestId = static_cast<int32>(PathService.Request({ Start.X, Start.Y }, { End.X, End.Y }, Mode));
+    bHierarchicalRequested |= Mode == EGridPathMode::Hierarchical;
+    if (Callback.IsBound())
     {
-        int32 Nx = Node.X + Dx[i];
-        int32 Ny = Node.Y + Dy[i];
-        if (CanMoveBetweenCells(Node.X, Node.Y, Nx, Ny))
-            OutNeighbors.Add(FGridNode(Nx, Ny));
+        PathCallbacks.Add(RequestId, MoveTemp(Callback));
     }
+    return RequestId;
 }
 
+void AGridManager::RequestPathsAsync(const TArray<TPair<FGridNode, FGridNode>>& Queries, TArray<int32>& OutRequestIds, EGridPathMode Mode)
+{
+    OutRequestIds.Reset(Queries.Num());
+    for (const TPair<FGridNode, FGridNode>& Query : Queries)
+    {
+        OutRequestIds.Add(RequestPathAsync(Query.Key, Query.Value, Mode));
+    }
+}
 
-bool AGridManager::FindPath(const FGridNode& Start, const FGridNode& End, TArray<FGridNode>& OutPath) const
+bool AGridManager::PollPathResult(int32 RequestId, bool& bOutFound, TArray<FGridNode>& OutPath)
 {
-    if (!IsValidCell(Start.X, Start.Y) || !IsValidCell(End.X, End.Y))
+    TPair<bool, TArray<FGridNode>> Result;
+    if (!FinishedPaths.RemoveAndCopyValue(RequestId, Result))
         return false;
- 
-    TMap<FGridNode, FGridNode> CameFrom;
-    TQueue<FGridNode> Queue;
-    TSet<FGridNode> Visited;
- 
-    Queue.Enqueue(Start);
-    Visited.Add(Start);
- 
-    while (!Queue.IsEmpty())
+
+    bOutFound = Result.Key;
+    OutPath = MoveTemp(Result.Value);
+    return true;
+}
+
+void AGridManager::DispatchPathRequests()
+{
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_PathDispatch);
+
+    // 1. - Hand out what finished since last frame
+    std::vector<FGridPathResult> Results;
+    PathService.PollResults(Results);
+    for (FGridPathResult& Result : Results)
     {
-        FGridNode Current;
-        Queue.Dequeue(Current);
- 
-        if (Current == End)
+        ZOMBIESIM_COUNTER_ADD(STAT_ZombieSim_PathQueries, 1);
+        ZOMBIESIM_COUNTER_ADD(STAT_ZombieSim_NodesExpanded, Result.NodesExpanded);
+
+        TArray<FGridNode> Path;
+        Path.Reserve(static_cast<int32>(Result.Path.size()));
+        for (const FGridPoint& Point : Result.Path)
         {
-            OutPath.Empty();
- 
-            FGridNode Node = End;
-            while (!(Node == Start))
+            Path.Emplace(Point.X, Point.Y);
+        }
+
+        const int32 RequestId = static_cast<int32>(Result.RequestId);
+        FOnGridPathFound Callback;
+        if (PathCallbacks.RemoveAndCopyValue(RequestId, Callback))
+        {
+            Callback.ExecuteIfBound(Result.bFound, Path);
+        }
+        else
+        {
+            FinishedPaths.Add(RequestId, TPair<bool, TArray<FGridNode>>(Result.bFound, MoveTemp(Path)));
+        }
+    }
+
+    // 2. - Start this frame's budget against an up to date snapshot
+    SET_DWORD_STAT(STAT_ZombieSim_PathQueueDepth, PathService.GetNumQueued());
+    SET_DWORD_STAT(STAT_ZombieSim_PathsInFlight, PathService.GetNumInFlight());
+    if (PathService.GetNumQueued() == 0)
+        return;
+
+    const bool bSnapshotStale = !PathSnapshot || PathSnapshotSequence != Journal.GetSequence();
+    if (bSnapshotStale)
+    {
+        PathSnapshot = std::make_shared<const FGridStorage>(Storage);
+        PathSnapshotSequence = Journal.GetSequence();
+        PathHierarchySnapshot.reset();
+    }
+    if (PathHierarchySnapshot && PathHierarchySnapshot->GetClusterSize() != GetPathClusterSize())
+    {
+        PathHierarchySnapshot.reset();
+    }
+    if (bHierarchicalRequested && !PathHierarchySnapshot)
+    {
+        PathHierarchySnapshot = std::make_shared<const FGridPathHierarchy>(EnsurePathHierarchy());
+    }
+    PathService.Dispatch(PathSnapshot, MaxPathQueriesPerFrame, PathHierarchySnapshot);
+    bHierarchicalRequested &= PathService.GetNumQueued() > 0;
+}
+
+void AGridManager::StepInfectionDay(const FGridInfectionParams& Params, const FDensityEffectCurve& Curve)
+{
+    {
+        ZOMBIESIM_SCOPE(STAT_ZombieSim_GridDay);
+        InfectionModel.SetParams(Params);
+        InfectionModel.SetCurve(Curve);
+        InfectionModel.Step(Storage);
+    }
+
+    const std::vector<FGridPoint>& Changes = InfectionModel.GetChangedCells();
+    ZOMBIESIM_COUNTER_ADD(STAT_ZombieSim_CellsChanged, static_cast<int32>(Changes.size()));
+    if (Changes.empty())
+        return;
+
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_GridUpdate);
+
+    // Few changes patch the region labels and flow fields in place, a busy day rebuilds them
+    if (static_cast<int32>(Changes.size()) > Storage.GetNumCells() / 16)
+    {
+        InfectionModel.Apply(Storage);
+        Connectivity.Build(Storage);
+        Journal.Invalidate();
+    }
+    else
+    {
+        for (const FGridPoint& Cell : Changes)
+        {
+            const EGridCell NextState = InfectionModel.GetNextCell(Cell.X, Cell.Y);
+            Journal.RecordCell(Cell.X, Cell.Y, Storage.GetCell(Cell.X, Cell.Y), NextState);
+            Connectivity.SetCell(Storage, Cell.X, Cell.Y, NextState);
+        }
+    }
+}
+
+void AGridManager::SaveSnapshot(FSnapshotWriter& Writer) const
+{
+    Storage.SaveState(Writer);
+    Writer.Pad(FSnapshotStore::PageSize);
+    InfectionModel.SaveState(Writer);
+}
+
+bool AGridManager::LoadSnapshot(FSnapshotReader& Reader)
+{
+    // Neither the grid nor the automaton changes unless both parts read back
+    FGridStorage Loaded;
+    if (!Loaded.LoadState(Reader) || !Reader.Pad(FSnapshotStore::PageSize) || !InfectionModel.LoadState(Loaded, Reader))
+        return false;
+
+    const bool bResized = Loaded.GetWidth() != Storage.GetWidth() || Loaded.GetHeight() != Storage.GetHeight();
+    Storage = MoveTemp(Loaded);
+    GridWidth = Storage.GetWidth();
+    GridHeight = Storage.GetHeight();
+
+    // Fences can disappear on a rewind, which the journal cannot log, so everything downstream starts over
+    Connectivity.Build(Storage);
+    if (bResized)
+    {
+        Journal.Reset(Storage.GetTilesX(), Storage.GetTilesY());
+    }
+    else
+    {
+        Journal.Invalidate();
+    }
+    ResetFlowFields();
+    SpatialIndex = FGridSpatialIndex();
+    return true;
+}
+
+const FGridFlowField& AGridManager::GetFlowField(ECellState Target)
+{
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_FlowField);
+
+    // 1. - Repair every field already in use with the edits logged since the last query
+    if (FlowFieldSequence != Journal.GetSequence())
+    {
+        const FGridChange* Changes = nullptr;
+        size_t NumChanges = 0;
+        const bool bLogged = Journal.GetChangesSince(FlowFieldSequence, Changes, NumChanges);
+
+        // Repair only pays off for local edits, after a large batch a fresh sweep is cheaper
+        if (!bLogged || NumChanges >= static_cast<size_t>(Storage.GetNumCells() / 8))
+        {
+            ResetFlowFields();
+        }
+        else
+        {
+            FlowFieldChanges.clear();
+            for (size_t i = 0; i < NumChanges; ++i)
             {
-                OutPath.Insert(Node, 0);
-                Node = CameFrom[Node];
+                FlowFieldChanges.push_back({ Changes[i].X, Changes[i].Y });
+            }
+            for (FGridFlowField& Field : FlowFields)
+            {
+                if (Field.IsBuilt())
+                {
+                    Field.Update(Storage, FlowFieldChanges);
+                }
             }
-            OutPath.Insert(Start, 0);
- 
-            return true;
         }
- 
-        TArray<FGridNode> Neighbors;
-        GetNeighbors(Current, Neighbors);
- 
-        for (const FGridNode& Neighbor : Neighbors)
+        FlowFieldSequence = Journal.GetSequence();
+    }
+
+    // 2. - First query for this target sweeps the whole grid once
+    FGridFlowField& Field = FlowFields[static_cast<uint8>(Target)];
+    if (!Field.IsBuilt())
+    {
+        Field.Build(Storage, static_cast<EGridCell>(Target));
+    }
+    return Field;
+}
+
+bool AGridManager::GetFlowStep(const FGridNode& From, ECellState Target, FGridNode& OutNext)
+{
+    FGridPoint Next;
+    if (!GetFlowField(Target).GetNextStep(Storage, From.X, From.Y, Next))
+        return false;
+
+    OutNext = FGridNode(Next.X, Next.Y);
+    return true;
+}
+
+int32 AGridManager::GetFlowDistance(int32 X, int32 Y, ECellState Target)
+{
+    if (!IsValidCell(X, Y))
+        return -1;
+
+    const uint32 Distance = GetFlowField(Target).GetDistance(X, Y);
+    return Distance == FGridFlowField::Unreachable ? -1 : static_cast<int32>(Distance);
+}
+
+const FGridSpatialIndex& AGridManager::GetSpatialIndex()
+{
+    // Same catch-up as the flow fields, but a tile re-mark is so cheap that only a lost range rebuilds
+    if (!SpatialIndex.IsBuilt())
+    {
+        SpatialIndex.Build(Storage);
+        SpatialIndexSequence = Journal.GetSequence();
+    }
+    else if (SpatialIndexSequence != Journal.GetSequence())
+    {
+        const FGridChange* Changes = nullptr;
+        size_t NumChanges = 0;
+        if (Journal.GetChangesSince(SpatialIndexSequence, Changes, NumChanges))
         {
-            if (!Visited.Contains(Neighbor))
+            SpatialIndexChanges.clear();
+            for (size_t i = 0; i < NumChanges; ++i)
             {
-                Queue.Enqueue(Neighbor);
-                Visited.Add(Neighbor);
-                CameFrom.Add(Neighbor, Current);
+                if (Changes[i].Kind == EGridChangeKind::Cell)
+                {
+                    SpatialIndexChanges.push_back({ Changes[i].X, Changes[i].Y });
+                }
             }
+            SpatialIndex.Update(Storage, SpatialIndexChanges);
+        }
+        else
+        {
+            SpatialIndex.Build(Storage);
         }
+        SpatialIndexSequence = Journal.GetSequence();
+    }
+    return SpatialIndex;
+}
+
+bool AGridManager::FindNearestCell(int32 X, int32 Y, ECellState State, int32 MaxRadius, int32& OutX, int32& OutY)
+{
+    thread_local std::vector<FGridNeighbor> Nearest;
+    if (GetSpatialIndex().FindNearest(Storage, X, Y, static_cast<EGridCell>(State), 1, MaxRadius, Nearest) == 0)
+        return false;
+
+    OutX = Nearest[0].Cell.X;
+    OutY = Nearest[0].Cell.Y;
+    return true;
+}
+
+int32 AGridManager::FindCellsInRadius(int32 X, int32 Y, int32 Radius, ECellState State, TArray<FIntPoint>& OutCells)
+{
+    thread_local std::vector<FGridNeighbor> Found;
+    Found.clear();
+    GetSpatialIndex().FindInRadius(Storage, X, Y, Radius, static_cast<EGridCell>(State), Found);
+
+    OutCells.Reset(static_cast<int32>(Found.size()));
+    for (const FGridNeighbor& Cell : Found)
+    {
+        OutCells.Add(FIntPoint(Cell.Cell.X, Cell.Cell.Y));
+    }
+    return OutCells.Num();
+}
+
+void AGridManager::FindNearestForAll(ECellState From, ECellState Target, int32 MaxRadius, std::vector<FGridNearestPair>& OutPairs)
+{
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_SpatialQuery);
+    GetSpatialIndex().FindNearestForAll(Storage, static_cast<EGridCell>(From), static_cast<EGridCell>(Target), MaxRadius, OutPairs);
+}
+
+int32 AGridManager::GetPathClusterSize() const
+{
+    return FMath::Clamp(PathClusterSize, FGridPathHierarchy::MinClusterSize, FGridPathHierarchy::MaxClusterSize);
+}
+
+const FGridPathHierarchy& AGridManager::EnsurePathHierarchy() const
+{
+    // A new cluster size invalidates every cluster, so it always takes the full rebuild below
+    const bool bUsable = PathHierarchy.IsBuilt() && PathHierarchy.GetClusterSize() == GetPathClusterSize();
+    if (bUsable && PathHierarchySequence == Journal.GetSequence())
+        return PathHierarchy;
+
+    // Fence edits log one cell of the edge, the clusters on both sides are re-run
+    const FGridChange* Changes = nullptr;
+    size_t NumChanges = 0;
+    if (bUsable && Journal.GetChangesSince(PathHierarchySequence, Changes, NumChanges))
+    {
+        PathHierarchyChanges.clear();
+        for (size_t i = 0; i < NumChanges; ++i)
+        {
+            FGridPoint A = { Changes[i].X, Changes[i].Y };
+            FGridPoint B = A;
+            if (Changes[i].Kind == EGridChangeKind::Fence)
+            {
+                FGridStorage::GetEdgeCells(A.X, A.Y, static_cast<EGridEdge>(Changes[i].After), A, B);
+                PathHierarchyChanges.push_back(B);
+            }
+            PathHierarchyChanges.push_back(A);
+        }
+        PathHierarchy.Update(Storage, PathHierarchyChanges);
+    }
+    else
+    {
+        PathHierarchy.Build(Storage, GetPathClusterSize());
+    }
+    PathHierarchySequence = Journal.GetSequence();
+    return PathHierarchy;
+}
+
+void AGridManager::ResetFlowFields()
+{
+    for (FGridFlowField& Field : FlowFields)
+    {
+        Field = FGridFlowField();
     }
-    return false;
 }
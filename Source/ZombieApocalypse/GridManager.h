@@ -4,6 +4,16 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "GridChangeJournal.h"
+#include "GridConnectivity.h"
+#include "GridFlowField.h"
+#include "GridInfectionModel.h"
+#include "GridPathfinder.h"
+#include "GridPathService.h"
+#include "GridSpatialIndex.h"
+#include "GridStorage.h"
+#include <memory>
+#include <vector>
 #include "GridManager.generated.h"
 
 
@@ -57,6 +67,9 @@ struct FGridNode
 };
 
 
+// Fired on the game thread when an async path request finishes
+DECLARE_DELEGATE_TwoParams(FOnGridPathFound, bool /*bFound*/, const TArray<FGridNode>& /*Path*/);
+
 
 UCLASS()
 class ZOMBIEAPOCALYPSE_API AGridManager : public AActor
@@ -65,25 +78,58 @@ class ZOMBIEAPOCALYPSE_API AGridManager : public AActor
 
 public:
 
-    static constexpr int32 GridSize = 10;
+    static constexpr int32 DefaultGridSize = 10;
     
     AGridManager();
 
-    // Flattened 2D grid using TArray
-    UPROPERTY(EditAnywhere, BlueprintReadWrite)
-    TArray<FGridCell> Grid;
- 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite)
-    TArray<bool> HorizontalFence; // size = GridSize * (GridSize + 1)
- 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite)
-    TArray<bool> VerticalFence;   // size = (GridSize + 1) * GridSize
+    // Grid dimensions, applied in BeginPlay or by calling InitializeGrid
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = "1", ClampMax = "4096"))
+    int32 GridWidth = DefaultGridSize;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = "1", ClampMax = "4096"))
+    int32 GridHeight = DefaultGridSize;
+
+    // Upper bound on unique async path searches started per frame
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pathfinding", meta = (ClampMin = "1"))
+    int32 MaxPathQueriesPerFrame = 256;
+
+    // Side of the square clusters EGridPathMode::Hierarchical plans over, a change rebuilds the cluster graph on its next use
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pathfinding", meta = (ClampMin = "4", ClampMax = "64"))
+    int32 PathClusterSize = FGridPathHierarchy::DefaultClusterSize;
+
+    virtual void Tick(float DeltaTime) override;
+
+    // Cells and fences are not UPROPERTYs, so they are saved with the level as one FGridStorage blob
+    virtual void Serialize(FArchive& Ar) override;
+
+    // Read-only view of the cells and fences, mutate through the functions below
+    const FGridStorage& GetStorage() const { return Storage; }
+
+    // Resizes the grid, clearing every cell and fence. Returns false for sizes outside 1..4096
+    UFUNCTION(BlueprintCallable, Category = "Grid")
+    bool InitializeGrid(int32 Width, int32 Height);
 
+    UFUNCTION(BlueprintPure, Category = "Grid")
+    ECellState GetCellState(int32 X, int32 Y) const;
 
-    // Index helpers for 2D access
-    FORCEINLINE int32 GetGridIndex(int32 X, int32 Y) const { return X + Y * GridSize; }
-    FORCEINLINE int32 GetHorizontalFenceIndex(int32 X, int32 Y) const { return X + Y * GridSize; }
-    FORCEINLINE int32 GetVerticalFenceIndex(int32 X, int32 Y) const { return X + Y * (GridSize + 1); }
+    UFUNCTION(BlueprintCallable, Category = "Grid")
+    void SetCellState(int32 X, int32 Y, ECellState State);
+
+    // Cells in State on the whole grid, kept current by every write so this is O(1)
+    UFUNCTION(BlueprintPure, Category = "Grid")
+    int64 CountCells(ECellState State) const;
+
+    // Cells in State inside the inclusive rectangle, clamped to the grid. Costs a few tree lookups
+    // plus the tiles along its border, not its area. Per-enclosure humans come from GetConnectivity().
+    UFUNCTION(BlueprintPure, Category = "Grid")
+    int64 CountCellsInRect(ECellState State, int32 MinX, int32 MinY, int32 MaxX, int32 MaxY) const;
+
+    // Bytes used by cells and fences, for planning large maps
+    UFUNCTION(BlueprintPure, Category = "Grid")
+    int64 GetMemoryFootprintBytes() const;
+
+    // Index helper for 2D access
+    FORCEINLINE int32 GetGridIndex(int32 X, int32 Y) const { return Storage.GetIndex(X, Y); }
 
     
     bool IsValidCell(int32 X, int32 Y) const;
@@ -100,4 +146,125 @@ public:
     void GetNeighbors(const FGridNode& Node, TArray<FGridNode>& OutNeighbors) const;
  
     bool FindPath(const FGridNode& Start, const FGridNode& End, TArray<FGridNode>& OutPath) const;
+
+    // Same as above with a choice of search, OutPath keeps its allocation between calls
+    bool FindPath(const FGridNode& Start, const FGridNode& End, TArray<FGridNode>& OutPath, EGridPathMode Mode) const;
+
+    // O(1) answer to whether FindPath would succeed, from the region labels
+    bool CanReach(const FGridNode& Start, const FGridNode& End) const;
+
+    // Humans in regions that no zombie can walk into
+    UFUNCTION(BlueprintPure, Category = "Grid")
+    int32 GetSafeHumanCount() const;
+
+    // Advances the cell automaton one day and writes the result into the grid
+    void StepInfectionDay(const FGridInfectionParams& Params, const FDensityEffectCurve& Curve);
+
+    // Susceptible, bitten and zombie cells after the last StepInfectionDay
+    const FGridInfectionCounts& GetInfectionCounts() const { return InfectionModel.GetCounts(); }
+    int32 GetInfectionDay() const { return InfectionModel.GetDay(); }
+
+    // Human cell waiting to turn after a bite
+    bool IsCellBitten(int32 X, int32 Y) const { return IsValidCell(X, Y) && InfectionModel.IsBitten(X, Y); }
+
+    // Every cell and fence edit in order, for systems that want to catch up on just what changed
+    const FGridChangeJournal& GetChangeJournal() const { return Journal; }
+
+    // Connected regions of walkable cells, kept up to date by SetCellState and PlaceFence
+    const FGridConnectivity& GetConnectivity() const { return Connectivity; }
+
+    // Cells, fences and the automaton's day and bite timers, the tiles page aligned so unchanged ones share pages.
+    // Loading may resize the grid; regions are rebuilt and every journal reader rescans once.
+    void SaveSnapshot(FSnapshotWriter& Writer) const;
+    bool LoadSnapshot(FSnapshotReader& Reader);
+
+    // Queues a path search that runs on worker threads against a snapshot of the grid.
+    // The result arrives through Callback, or through PollPathResult from the next frame on.
+    int32 RequestPathAsync(const FGridNode& Start, const FGridNode& End, EGridPathMode Mode = EGridPathMode::BFS, FOnGridPathFound Callback = FOnGridPathFound());
+
+    // Queues one request per (Start, End) pair, ids come back in the same order
+    void RequestPathsAsync(const TArray<TPair<FGridNode, FGridNode>>& Queries, TArray<int32>& OutRequestIds, EGridPathMode Mode = EGridPathMode::BFS);
+
+    // Takes a finished result without a callback, false while it is still pending
+    bool PollPathResult(int32 RequestId, bool& bOutFound, TArray<FGridNode>& OutPath);
+
+    // Next step from From toward the nearest Target cell, read from a shared flow field.
+    // False when From is a Target cell itself or none can be reached.
+    bool GetFlowStep(const FGridNode& From, ECellState Target, FGridNode& OutNext);
+
+    // Steps from (X, Y) to the nearest Target cell, -1 when none can be reached
+    UFUNCTION(BlueprintCallable, Category = "Pathfinding")
+    int32 GetFlowDistance(int32 X, int32 Y, ECellState Target);
+
+    // Field toward Target, built on first use and repaired after grid edits
+    const FGridFlowField& GetFlowField(ECellState Target);
+
+    // Brings the cluster graph for hierarchical searches up to date and returns it: built on first use or when
+    // PathClusterSize changed, otherwise edits re-run only the clusters they touch
+    const FGridPathHierarchy& EnsurePathHierarchy() const;
+
+    // Nearest State cell to (X, Y) in a straight line, ignoring fences; MaxRadius < 0 searches the whole grid
+    UFUNCTION(BlueprintCallable, Category = "Grid")
+    bool FindNearestCell(int32 X, int32 Y, ECellState State, int32 MaxRadius, int32& OutX, int32& OutY);
+
+    // Every State cell within Radius of (X, Y), in tile order like FGridSpatialIndex::FindInRadius
+    UFUNCTION(BlueprintCallable, Category = "Grid")
+    int32 FindCellsInRadius(int32 X, int32 Y, int32 Radius, ECellState State, TArray<FIntPoint>& OutCells);
+
+    // Nearest Target cell within MaxRadius of every From cell at once, e.g. the closest human to each zombie
+    void FindNearestForAll(ECellState From, ECellState Target, int32 MaxRadius, std::vector<FGridNearestPair>& OutPairs);
+
+    // Occupied-tile index for kNN and radius queries, refreshed from the journal on first use after edits
+    const FGridSpatialIndex& GetSpatialIndex();
+
+private:
+    void DispatchPathRequests();
+    void ResetFlowFields();
+
+    // PathClusterSize as FGridPathHierarchy::Build clamps it
+    int32 GetPathClusterSize() const;
+
+    // Bit-packed cells and fences, see FGridStorage for the layout
+    FGridStorage Storage;
+
+    // Region labels over Storage, every cell or fence edit goes through it
+    FGridConnectivity Connectivity;
+
+    // Log of edits; the path snapshot and flow fields compare sequences instead of dirty flags
+    FGridChangeJournal Journal;
+
+    // Scratch for game-thread FindPath calls, other threads need their own FGridPathfinder
+    mutable FGridPathfinder Pathfinder;
+
+    // Async path queries, workers only ever see PathSnapshot, which is rebuilt after edits
+    FGridPathService PathService;
+    std::shared_ptr<const FGridStorage> PathSnapshot;
+    uint64 PathSnapshotSequence = 0;
+
+    // Cluster graph over Storage, caught up with the journal up to PathHierarchySequence. Workers get a
+    // copy matching PathSnapshot, made only while hierarchical requests may be queued
+    mutable FGridPathHierarchy PathHierarchy;
+    mutable uint64 PathHierarchySequence = 0;
+    mutable std::vector<FGridPoint> PathHierarchyChanges;
+    std::shared_ptr<const FGridPathHierarchy> PathHierarchySnapshot;
+    bool bHierarchicalRequested = false;
+
+    TMap<int32, FOnGridPathFound> PathCallbacks;
+    TMap<int32, TPair<bool, TArray<FGridNode>>> FinishedPaths;
+
+    // Per-cell infection automaton, holds the bite timers the grid itself has no room for
+    FGridInfectionModel InfectionModel;
+
+    // One distance field per cell state, repaired from the journal up to FlowFieldSequence
+    FGridFlowField FlowFields[3];
+    uint64 FlowFieldSequence = 0;
+    std::vector<FGridPoint> FlowFieldChanges;
+
+    // Tiles holding humans or zombies, caught up with the journal up to SpatialIndexSequence
+    FGridSpatialIndex SpatialIndex;
+    uint64 SpatialIndexSequence = 0;
+    std::vector<FGridPoint> SpatialIndexChanges;
+
+protected:
+    virtual void BeginPlay() override;
 };
\ No newline at end of file
@@ -0,0 +1,326 @@
+// Copyright University of Inland Norway
+
+#include "GridOccupantRenderer.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "GridManager.h"
+#include "ZombieSimStats.h"
+
+// Custom data layout read by the vertex animation material
+static constexpr int32 OccupantAnimIndexData = 0;
+static constexpr int32 OccupantAnimStartData = 1;
+static constexpr int32 OccupantCustomDataFloats = 2;
+
+static constexpr uint8 OccupantAnimUnset = 0xFF;
+
+UGridOccupantRenderer::UGridOccupantRenderer()
+{
+    PrimaryComponentTick.bCanEverTick = true;
+    // The simulation steps the grid during the regular actor tick
+    PrimaryComponentTick.TickGroup = TG_PostPhysics;
+}
+
+void UGridOccupantRenderer::BeginPlay()
+{
+    Super::BeginPlay();
+
+    if (!GridManager)
+    {
+        GridManager = Cast<AGridManager>(GetOwner());
+    }
+    if (!GridManager)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("GridOccupantRenderer: no GridManager assigned!"));
+    }
+
+    Instances.Reset();
+    Instances.Add(CreateInstances(HumanMesh, TEXT("HumanInstances")));
+    Instances.Add(CreateInstances(ZombieMesh, TEXT("ZombieInstances")));
+    ResetMirror();
+}
+
+void UGridOccupantRenderer::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    for (UHierarchicalInstancedStaticMeshComponent* Component : Instances)
+    {
+        if (Component)
+        {
+            Component->DestroyComponent();
+        }
+    }
+    Instances.Reset();
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void UGridOccupantRenderer::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+    Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_OccupantRenderer);
+    SyncFromGrid();
+}
+
+UHierarchicalInstancedStaticMeshComponent* UGridOccupantRenderer::CreateInstances(UStaticMesh* Mesh, FName Name)
+{
+    if (!Mesh)
+        return nullptr;
+
+    UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(GetOwner(), Name);
+    Component->SetStaticMesh(Mesh);
+    Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+    Component->SetCastShadow(bCastShadows);
+    Component->SetNumCustomDataFloats(OccupantCustomDataFloats);
+    Component->SetupAttachment(this);
+    Component->RegisterComponent();
+    return Component;
+}
+
+void UGridOccupantRenderer::ResetMirror()
+{
+    for (int32 Kind = 0; Kind < 2; ++Kind)
+    {
+        if (Instances.IsValidIndex(Kind) && Instances[Kind])
+        {
+            Instances[Kind]->ClearInstances();
+        }
+        FreeSlots[Kind].Reset();
+        PendingTransforms[Kind].Reset();
+        PendingCells[Kind].Reset();
+    }
+
+    // An all-empty shadow makes the next sync place every occupant
+    const FGridStorage* Grid = GridManager ? &GridManager->GetStorage() : nullptr;
+    MirrorWidth = Grid ? Grid->GetWidth() : 0;
+    MirrorHeight = Grid ? Grid->GetHeight() : 0;
+    const int32 NumTiles = Grid ? Grid->GetTilesX() * Grid->GetTilesY() : 0;
+    const int32 NumCells = MirrorWidth * MirrorHeight;
+
+    ShadowLo.Init(0, NumTiles);
+    ShadowHi.Init(0, NumTiles);
+    CellSlot.Init(INDEX_NONE, NumCells);
+    CellAnim.Init(OccupantAnimUnset, NumCells);
+    AnimCheckStamp.Init(0, NumCells);
+    AnimCheckGeneration = 0;
+    MirrorDay = -1;
+    bMirrorStale = true;
+}
+
+FTransform UGridOccupantRenderer::GetCellTransform(int32 X, int32 Y) const
+{
+    return FTransform(FVector((X + 0.5f) * CellSize, (Y + 0.5f) * CellSize, 0.f));
+}
+
+void UGridOccupantRenderer::ReleaseSlot(int32 CellIndex, uint8 OldState)
+{
+    const int32 Slot = CellSlot[CellIndex];
+    if (OldState == 0 || Slot == INDEX_NONE)
+        return;
+
+    // Parked at zero scale so no other instance index moves
+    const int32 Kind = OldState - 1;
+    Instances[Kind]->UpdateInstanceTransform(Slot, FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector), false, false, true);
+    FreeSlots[Kind].Add(Slot);
+    CellSlot[CellIndex] = INDEX_NONE;
+    ++LastUpdateCount;
+}
+
+void UGridOccupantRenderer::AcquireSlot(int32 X, int32 Y, uint8 NewState)
+{
+    const int32 Kind = NewState - 1;
+    if (NewState == 0 || !Instances[Kind])
+        return;
+
+    const int32 CellIndex = X + Y * MirrorWidth;
+    CellAnim[CellIndex] = OccupantAnimUnset;
+    ++LastUpdateCount;
+
+    if (FreeSlots[Kind].Num() > 0)
+    {
+        const int32 Slot = FreeSlots[Kind].Pop(EAllowShrinking::No);
+        Instances[Kind]->UpdateInstanceTransform(Slot, GetCellTransform(X, Y), false, false, true);
+        CellSlot[CellIndex] = Slot;
+        return;
+    }
+
+    PendingTransforms[Kind].Add(GetCellTransform(X, Y));
+    PendingCells[Kind].Add(CellIndex);
+}
+
+void UGridOccupantRenderer::QueueAnimCheck(int32 X, int32 Y)
+{
+    if (X < 0 || Y < 0 || X >= MirrorWidth || Y >= MirrorHeight)
+        return;
+
+    const int32 CellIndex = X + Y * MirrorWidth;
+    if (AnimCheckStamp[CellIndex] != AnimCheckGeneration)
+    {
+        AnimCheckStamp[CellIndex] = AnimCheckGeneration;
+        AnimChecks.Add(CellIndex);
+    }
+}
+
+EGridOccupantAnim UGridOccupantRenderer::PickAnim(int32 X, int32 Y, uint8 State) const
+{
+    if (State == static_cast<uint8>(EGridCell::Human))
+        return GridManager->IsCellBitten(X, Y) ? EGridOccupantAnim::WrithingInPain : EGridOccupantAnim::Idle;
+
+    // A zombie with a human it could step onto is biting
+    const FGridStorage& Grid = GridManager->GetStorage();
+    FGridPoint Neighbors[4];
+    const int32 Count = Grid.GetNeighbors(X, Y, Neighbors);
+    for (int32 i = 0; i < Count; ++i)
+    {
+        if (Grid.GetCell(Neighbors[i].X, Neighbors[i].Y) == EGridCell::Human)
+            return EGridOccupantAnim::ZombieNeckBite;
+    }
+    return EGridOccupantAnim::ZombieWalking;
+}
+
+void UGridOccupantRenderer::SyncTile(const FGridStorage& Grid, int32 TileIndex)
+{
+    // Move instances only for cells whose state bits differ from the shadow copy
+    const FGridTile& Tile = Grid.GetTiles()[TileIndex];
+    uint64 Changed = (Tile.StateLo ^ ShadowLo[TileIndex]) | (Tile.StateHi ^ ShadowHi[TileIndex]);
+    const int32 TilesX = Grid.GetTilesX();
+    while (Changed != 0)
+    {
+        const uint32 Bit = static_cast<uint32>(FMath::CountTrailingZeros64(Changed));
+        Changed &= Changed - 1;
+
+        const int32 X = ((TileIndex % TilesX) << FGridStorage::TileShift) + static_cast<int32>(Bit & FGridStorage::TileMask);
+        const int32 Y = ((TileIndex / TilesX) << FGridStorage::TileShift) + static_cast<int32>(Bit >> FGridStorage::TileShift);
+        const uint8 OldState = static_cast<uint8>(((ShadowLo[TileIndex] >> Bit) & 1u) | (((ShadowHi[TileIndex] >> Bit) & 1u) << 1));
+        const uint8 NewState = static_cast<uint8>(Grid.GetCell(X, Y));
+
+        ReleaseSlot(X + Y * MirrorWidth, OldState);
+        AcquireSlot(X, Y, NewState);
+
+        QueueAnimCheck(X, Y);
+        QueueAnimCheck(X - 1, Y);
+        QueueAnimCheck(X + 1, Y);
+        QueueAnimCheck(X, Y - 1);
+        QueueAnimCheck(X, Y + 1);
+    }
+    ShadowLo[TileIndex] = Tile.StateLo;
+    ShadowHi[TileIndex] = Tile.StateHi;
+}
+
+void UGridOccupantRenderer::SyncFromGrid()
+{
+    LastUpdateCount = 0;
+    if (!GridManager)
+        return;
+
+    const FGridStorage& Grid = GridManager->GetStorage();
+    if (Grid.GetWidth() != MirrorWidth || Grid.GetHeight() != MirrorHeight)
+    {
+        ResetMirror();
+    }
+
+    if (++AnimCheckGeneration == 0)
+    {
+        AnimCheckStamp.Init(0, AnimCheckStamp.Num());
+        AnimCheckGeneration = 1;
+    }
+    AnimChecks.Reset();
+
+    // 1. - Only tiles the journal logged a cell change in, every tile if the log cannot cover the gap
+    const FGridChangeJournal& Journal = GridManager->GetChangeJournal();
+    const FGridChange* Changes = nullptr;
+    size_t NumChanges = 0;
+    if (!bMirrorStale && Journal.GetChangesSince(MirrorSequence, Changes, NumChanges))
+    {
+        for (size_t i = 0; i < NumChanges; ++i)
+        {
+            const FGridChange& Change = Changes[i];
+            if (Change.Kind == EGridChangeKind::Cell)
+            {
+                SyncTile(Grid, (Change.Y >> FGridStorage::TileShift) * Grid.GetTilesX() + (Change.X >> FGridStorage::TileShift));
+            }
+            else
+            {
+                // A fence can stop a zombie from biting its neighbour
+                const bool bTop = Change.After == static_cast<uint8>(EGridEdge::Top);
+                QueueAnimCheck(Change.X, Change.Y);
+                QueueAnimCheck(Change.X + (bTop ? 0 : 1), Change.Y + (bTop ? 1 : 0));
+            }
+        }
+    }
+    else
+    {
+        for (int32 TileIndex = 0; TileIndex < static_cast<int32>(Grid.GetTiles().size()); ++TileIndex)
+        {
+            SyncTile(Grid, TileIndex);
+        }
+    }
+    MirrorSequence = Journal.GetSequence();
+    bMirrorStale = false;
+
+    // 2. - New occupants beyond the parked slots go in as one batch per mesh
+    for (int32 Kind = 0; Kind < 2; ++Kind)
+    {
+        if (PendingTransforms[Kind].Num() == 0)
+            continue;
+
+        const TArray<int32> NewSlots = Instances[Kind]->AddInstances(PendingTransforms[Kind], true, false);
+        for (int32 i = 0; i < NewSlots.Num(); ++i)
+        {
+            CellSlot[PendingCells[Kind][i]] = NewSlots[i];
+        }
+        PendingTransforms[Kind].Reset();
+        PendingCells[Kind].Reset();
+    }
+
+    // 3. - Bites land once per simulated day, recheck every human then
+    if (GridManager->GetInfectionDay() != MirrorDay)
+    {
+        const std::vector<FGridTile>& Tiles = Grid.GetTiles();
+        const int32 TilesX = Grid.GetTilesX();
+        MirrorDay = GridManager->GetInfectionDay();
+        for (int32 TileIndex = 0; TileIndex < static_cast<int32>(Tiles.size()); ++TileIndex)
+        {
+            uint64 Humans = Tiles[TileIndex].StateLo & ~Tiles[TileIndex].StateHi;
+            while (Humans != 0)
+            {
+                const uint32 Bit = static_cast<uint32>(FMath::CountTrailingZeros64(Humans));
+                Humans &= Humans - 1;
+                QueueAnimCheck(((TileIndex % TilesX) << FGridStorage::TileShift) + static_cast<int32>(Bit & FGridStorage::TileMask),
+                    ((TileIndex / TilesX) << FGridStorage::TileShift) + static_cast<int32>(Bit >> FGridStorage::TileShift));
+            }
+        }
+    }
+
+    // 4. - Custom data only for instances whose animation actually changed
+    const float Now = GetWorld() ? static_cast<float>(GetWorld()->GetTimeSeconds()) : 0.f;
+    for (int32 CellIndex : AnimChecks)
+    {
+        const int32 X = CellIndex % MirrorWidth;
+        const int32 Y = CellIndex / MirrorWidth;
+        const uint8 State = static_cast<uint8>(Grid.GetCell(X, Y));
+        const int32 Slot = CellSlot[CellIndex];
+        if (State == 0 || Slot == INDEX_NONE)
+            continue;
+
+        const EGridOccupantAnim Anim = PickAnim(X, Y, State);
+        if (CellAnim[CellIndex] == static_cast<uint8>(Anim))
+            continue;
+
+        CellAnim[CellIndex] = static_cast<uint8>(Anim);
+        UHierarchicalInstancedStaticMeshComponent* Component = Instances[State - 1];
+        Component->SetCustomDataValue(Slot, OccupantAnimIndexData, static_cast<float>(Anim), false);
+        Component->SetCustomDataValue(Slot, OccupantAnimStartData, Now, false);
+        ++LastUpdateCount;
+    }
+
+    if (LastUpdateCount > 0)
+    {
+        for (UHierarchicalInstancedStaticMeshComponent* Component : Instances)
+        {
+            if (Component)
+            {
+                Component->MarkRenderStateDirty();
+            }
+        }
+    }
+}
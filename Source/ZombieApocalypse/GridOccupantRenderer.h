@@ -0,0 +1,111 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "GridOccupantRenderer.generated.h"
+
+class AGridManager;
+class FGridStorage;
+class UHierarchicalInstancedStaticMeshComponent;
+class UStaticMesh;
+
+// Animation picked per instance, written to custom data float 0 for the vertex animation material
+UENUM(BlueprintType)
+enum class EGridOccupantAnim : uint8
+{
+	Idle			UMETA(DisplayName = "Idle"),
+	ZombieWalking	UMETA(DisplayName = "ZombieWalking"),
+	ZombieNeckBite	UMETA(DisplayName = "ZombieNeckBite"),
+	WrithingInPain	UMETA(DisplayName = "WrithingInPain")
+};
+
+/**
+ * Draws one instance per occupied grid cell instead of one actor per agent.
+ *
+ * Humans and zombies each live in a hierarchical instanced static mesh. Every
+ * tick the tiles the grid's change journal logged are compared against a
+ * shadow copy of the state bitplanes, and only cells that changed get their
+ * instance moved, so a quiet frame costs nothing. Freed instances are parked
+ * at zero scale and reused rather than removed, which keeps every other
+ * instance index stable. Animation is chosen per instance through custom
+ * data: float 0 is the EGridOccupantAnim, float 1 the world time it started.
+ *
+ * The Girl and Zombie characters are skeletal meshes; assign static meshes
+ * baked from them with vertex animation textures for the clips above.
+ */
+UCLASS(ClassGroup = (Simulation), meta = (BlueprintSpawnableComponent))
+class ZOMBIEAPOCALYPSE_API UGridOccupantRenderer : public USceneComponent
+{
+	GENERATED_BODY()
+
+public:
+	UGridOccupantRenderer();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Grid to mirror, the owning actor is used when it is a grid manager
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Rendering")
+	AGridManager* GridManager{ nullptr };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Rendering")
+	UStaticMesh* HumanMesh{ nullptr };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Rendering")
+	UStaticMesh* ZombieMesh{ nullptr };
+
+	// World units per cell, cell (0, 0) is centred at half a cell from this component
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Rendering", meta = (ClampMin = "1"))
+	float CellSize{ 100.f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Rendering")
+	bool bCastShadows{ false };
+
+	// Instances touched by the last tick, for profiling
+	int32 GetLastUpdateCount() const { return LastUpdateCount; }
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	UHierarchicalInstancedStaticMeshComponent* CreateInstances(UStaticMesh* Mesh, FName Name);
+	void ResetMirror();
+	void SyncFromGrid();
+	void SyncTile(const FGridStorage& Grid, int32 TileIndex);
+	void ReleaseSlot(int32 CellIndex, uint8 OldState);
+	void AcquireSlot(int32 X, int32 Y, uint8 NewState);
+	void QueueAnimCheck(int32 X, int32 Y);
+	EGridOccupantAnim PickAnim(int32 X, int32 Y, uint8 State) const;
+	FTransform GetCellTransform(int32 X, int32 Y) const;
+
+	// Index 0 humans, 1 zombies, EGridCell minus one
+	UPROPERTY(Transient)
+	TArray<UHierarchicalInstancedStaticMeshComponent*> Instances;
+
+	// Parked slots per mesh, and new instances to add in one batch at the end of the tick
+	TArray<int32> FreeSlots[2];
+	TArray<FTransform> PendingTransforms[2];
+	TArray<int32> PendingCells[2];
+
+	// What the instances currently show: state planes per tile, slot and animation per cell
+	TArray<uint64> ShadowLo;
+	TArray<uint64> ShadowHi;
+	TArray<int32> CellSlot;
+	TArray<uint8> CellAnim;
+	int32 MirrorWidth{ 0 };
+	int32 MirrorHeight{ 0 };
+	int32 MirrorDay{ -1 };
+
+	// Journal position the mirror has caught up to, stale forces one full tile scan
+	uint64 MirrorSequence{ 0 };
+	bool bMirrorStale{ true };
+
+	// Cells whose animation may have changed this tick, deduplicated with a stamp
+	TArray<int32> AnimChecks;
+	TArray<uint32> AnimCheckStamp;
+	uint32 AnimCheckGeneration{ 0 };
+
+	int32 LastUpdateCount{ 0 };
+};
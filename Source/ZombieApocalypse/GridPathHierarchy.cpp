@@ -0,0 +1,264 @@
+// Copyright University of Inland Norway
+
+#include "GridPathHierarchy.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+// Same neighbour order as FGridStorage::GetNeighbors
+static const int32_t HierarchyDx[4] = { -1, 1, 0, 0 };
+static const int32_t HierarchyDy[4] = { 0, 0, -1, 1 };
+
+// Border runs at least this long get a transition at each end instead of one in the middle
+static constexpr int32_t LongEntranceLength = 6;
+
+void FGridPathHierarchy::Build(const FGridStorage& Grid, int32_t InClusterSize, FWorkStealingPool* Pool)
+{
+    ClusterSize = std::min(std::max(InClusterSize, MinClusterSize), MaxClusterSize);
+    Width = Grid.GetWidth();
+    Height = Grid.GetHeight();
+    ClustersX = (Width + ClusterSize - 1) / ClusterSize;
+    ClustersY = (Height + ClusterSize - 1) / ClusterSize;
+
+    Clusters.assign(static_cast<size_t>(ClustersX) * ClustersY, FCluster());
+    std::vector<int32_t> ToBuild(Clusters.size());
+    for (size_t Cluster = 0; Cluster < ToBuild.size(); ++Cluster)
+    {
+        ToBuild[Cluster] = static_cast<int32_t>(Cluster);
+    }
+    BuildClusters(Grid, ToBuild, Pool);
+    UpdateOffsets();
+    bBuilt = true;
+}
+
+int32_t FGridPathHierarchy::Update(const FGridStorage& Grid, const std::vector<FGridPoint>& ChangedCells, FWorkStealingPool* Pool)
+{
+    if (!Matches(Grid))
+    {
+        Build(Grid, ClusterSize, Pool);
+        return GetNumClusters();
+    }
+
+    // 1. - The cluster of every edited cell, and the one across the border when the cell sits on it
+    std::vector<int32_t> ToBuild;
+    for (const FGridPoint& Cell : ChangedCells)
+    {
+        if (!Grid.IsValidCell(Cell.X, Cell.Y))
+            continue;
+
+        const int32_t Cluster = GetClusterOf(Cell.X, Cell.Y);
+        ToBuild.push_back(Cluster);
+        for (int32_t Side = 0; Side < 4; ++Side)
+        {
+            const int32_t Nx = Cell.X + HierarchyDx[Side];
+            const int32_t Ny = Cell.Y + HierarchyDy[Side];
+            if (Grid.IsValidCell(Nx, Ny) && GetClusterOf(Nx, Ny) != Cluster)
+                ToBuild.push_back(GetClusterOf(Nx, Ny));
+        }
+    }
+    std::sort(ToBuild.begin(), ToBuild.end());
+    ToBuild.erase(std::unique(ToBuild.begin(), ToBuild.end()), ToBuild.end());
+
+    // 2. - Rebuilt clusters keep their slot, only the node numbering moves
+    BuildClusters(Grid, ToBuild, Pool);
+    UpdateOffsets();
+    return static_cast<int32_t>(ToBuild.size());
+}
+
+void FGridPathHierarchy::BuildClusters(const FGridStorage& Grid, const std::vector<int32_t>& ToBuild, FWorkStealingPool* Pool)
+{
+    if (ToBuild.size() < 8)
+    {
+        FGridClusterScratch Scratch;
+        for (const int32_t Cluster : ToBuild)
+            BuildCluster(Grid, Cluster, Scratch);
+        return;
+    }
+
+    // Clusters only read the grid and write their own slot
+    FWorkStealingPool& Workers = Pool ? *Pool : FWorkStealingPool::Get();
+    Workers.ParallelFor(static_cast<int64_t>(ToBuild.size()), 16, [this, &Grid, &ToBuild](int64_t Begin, int64_t End)
+    {
+        FGridClusterScratch Scratch;
+        for (int64_t i = Begin; i < End; ++i)
+            BuildCluster(Grid, ToBuild[i], Scratch);
+    });
+}
+
+void FGridPathHierarchy::BuildCluster(const FGridStorage& Grid, int32_t Cluster, FGridClusterScratch& Scratch)
+{
+    FCluster& Entry = Clusters[Cluster];
+    Entry.Nodes.clear();
+
+    // 1. - Transitions on each border the cluster shares with a neighbour
+    const int32_t ClusterX = Cluster % ClustersX;
+    const int32_t ClusterY = Cluster / ClustersX;
+    if (ClusterX > 0)
+        AddBorderNodes(Grid, Cluster, 0, Entry.Nodes);
+    if (ClusterX + 1 < ClustersX)
+        AddBorderNodes(Grid, Cluster, 1, Entry.Nodes);
+    if (ClusterY > 0)
+        AddBorderNodes(Grid, Cluster, 2, Entry.Nodes);
+    if (ClusterY + 1 < ClustersY)
+        AddBorderNodes(Grid, Cluster, 3, Entry.Nodes);
+
+    std::sort(Entry.Nodes.begin(), Entry.Nodes.end());
+    Entry.Nodes.erase(std::unique(Entry.Nodes.begin(), Entry.Nodes.end()), Entry.Nodes.end());
+
+    // 2. - Walking distance between every pair of nodes without leaving the cluster
+    const int32_t NumNodes = static_cast<int32_t>(Entry.Nodes.size());
+    Entry.Costs.assign(static_cast<size_t>(NumNodes) * NumNodes, Unreachable);
+    for (int32_t From = 0; From < NumNodes; ++From)
+    {
+        SearchCluster(Grid, Cluster, { Entry.Nodes[From] % Width, Entry.Nodes[From] / Width }, Scratch);
+        for (int32_t To = 0; To < NumNodes; ++To)
+        {
+            const int32_t Distance = Scratch.Distance[GetLocalIndex(Cluster, Entry.Nodes[To] % Width, Entry.Nodes[To] / Width)];
+            if (Distance >= 0)
+                Entry.Costs[From * NumNodes + To] = static_cast<uint16_t>(Distance);
+        }
+    }
+}
+
+void FGridPathHierarchy::AddBorderNodes(const FGridStorage& Grid, int32_t Cluster, int32_t Side, std::vector<int32_t>& OutNodes) const
+{
+    // 1. - The border as a line of cell pairs, ours first, walked in increasing X or Y from either side
+    const int32_t MinX = (Cluster % ClustersX) * ClusterSize;
+    const int32_t MinY = (Cluster / ClustersX) * ClusterSize;
+    const int32_t MaxX = std::min(MinX + ClusterSize, Width) - 1;
+    const int32_t MaxY = std::min(MinY + ClusterSize, Height) - 1;
+
+    const int32_t AcrossX = HierarchyDx[Side];
+    const int32_t AcrossY = HierarchyDy[Side];
+    const int32_t AlongX = AcrossY != 0 ? 1 : 0;
+    const int32_t AlongY = AcrossX != 0 ? 1 : 0;
+    const int32_t Length = AlongX ? MaxX - MinX + 1 : MaxY - MinY + 1;
+    const FGridPoint First = { AcrossX > 0 ? MaxX : MinX, AcrossY > 0 ? MaxY : MinY };
+
+    // 2. - A pair is open when it can be crossed both ways. Runs of open pairs are entrances, but a fence
+    // along the border on either side ends one, so every cell of an entrance reaches its transition
+    auto IsOpen = [&](int32_t Step)
+    {
+        const int32_t X = First.X + AlongX * Step;
+        const int32_t Y = First.Y + AlongY * Step;
+        return Grid.CanMoveBetweenCells(X, Y, X + AcrossX, Y + AcrossY) && Grid.CanMoveBetweenCells(X + AcrossX, Y + AcrossY, X, Y);
+    };
+    auto Continues = [&](int32_t Step)
+    {
+        const int32_t X = First.X + AlongX * Step;
+        const int32_t Y = First.Y + AlongY * Step;
+        return !Grid.IsEdgeBlockedByFence(X - AlongX, Y - AlongY, X, Y)
+            && !Grid.IsEdgeBlockedByFence(X - AlongX + AcrossX, Y - AlongY + AcrossY, X + AcrossX, Y + AcrossY);
+    };
+    auto AddNode = [&](int32_t Step)
+    {
+        OutNodes.push_back(Grid.GetIndex(First.X + AlongX * Step, First.Y + AlongY * Step));
+    };
+
+    int32_t RunStart = -1;
+    for (int32_t Step = 0; Step <= Length; ++Step)
+    {
+        const bool bOpen = Step < Length && IsOpen(Step);
+        if (bOpen && RunStart >= 0 && Continues(Step))
+            continue;
+
+        if (RunStart >= 0)
+        {
+            const int32_t RunLength = Step - RunStart;
+            if (RunLength >= LongEntranceLength)
+            {
+                AddNode(RunStart);
+                AddNode(Step - 1);
+            }
+            else
+            {
+                AddNode(RunStart + RunLength / 2);
+            }
+        }
+        RunStart = bOpen ? Step : -1;
+    }
+}
+
+void FGridPathHierarchy::UpdateOffsets()
+{
+    NodeOffsets.resize(Clusters.size() + 1);
+    NodeOffsets[0] = 0;
+    for (size_t Cluster = 0; Cluster < Clusters.size(); ++Cluster)
+    {
+        NodeOffsets[Cluster + 1] = NodeOffsets[Cluster] + static_cast<int32_t>(Clusters[Cluster].Nodes.size());
+    }
+}
+
+int32_t FGridPathHierarchy::GetNodeCluster(int32_t Node) const
+{
+    // Empty clusters share their offset with the next one, the last cluster starting at or before Node owns it
+    return static_cast<int32_t>(std::upper_bound(NodeOffsets.begin(), NodeOffsets.end(), Node) - NodeOffsets.begin()) - 1;
+}
+
+int32_t FGridPathHierarchy::FindNode(int32_t Cluster, int32_t CellIndex) const
+{
+    const std::vector<int32_t>& Nodes = Clusters[Cluster].Nodes;
+    const auto Found = std::lower_bound(Nodes.begin(), Nodes.end(), CellIndex);
+    return Found != Nodes.end() && *Found == CellIndex ? static_cast<int32_t>(Found - Nodes.begin()) : -1;
+}
+
+int32_t FGridPathHierarchy::SearchCluster(const FGridStorage& Grid, int32_t Cluster, FGridPoint From, FGridClusterScratch& Scratch,
+    const FGridPoint* Until) const
+{
+    const int32_t MinX = (Cluster % ClustersX) * ClusterSize;
+    const int32_t MinY = (Cluster / ClustersX) * ClusterSize;
+    const int32_t MaxX = std::min(MinX + ClusterSize, Width) - 1;
+    const int32_t MaxY = std::min(MinY + ClusterSize, Height) - 1;
+
+    const size_t NumLocal = static_cast<size_t>(ClusterSize) * ClusterSize;
+    Scratch.Distance.assign(NumLocal, -1);
+    Scratch.Parent.resize(NumLocal);
+    Scratch.Queue.resize(NumLocal);
+
+    const int32_t StartLocal = GetLocalIndex(Cluster, From.X, From.Y);
+    const int32_t UntilLocal = Until ? GetLocalIndex(Cluster, Until->X, Until->Y) : -1;
+    int32_t Head = 0;
+    int32_t Tail = 0;
+    Scratch.Queue[Tail++] = StartLocal;
+    Scratch.Distance[StartLocal] = 0;
+    Scratch.Parent[StartLocal] = StartLocal;
+
+    while (Head < Tail)
+    {
+        const int32_t Current = Scratch.Queue[Head++];
+        if (Current == UntilLocal)
+            return Head;
+
+        const int32_t X = MinX + Current % ClusterSize;
+        const int32_t Y = MinY + Current / ClusterSize;
+        for (int32_t Side = 0; Side < 4; ++Side)
+        {
+            const int32_t Nx = X + HierarchyDx[Side];
+            const int32_t Ny = Y + HierarchyDy[Side];
+            if (Nx < MinX || Nx > MaxX || Ny < MinY || Ny > MaxY || !Grid.CanMoveBetweenCells(X, Y, Nx, Ny))
+                continue;
+
+            const int32_t Next = (Ny - MinY) * ClusterSize + (Nx - MinX);
+            if (Scratch.Distance[Next] < 0)
+            {
+                Scratch.Distance[Next] = Scratch.Distance[Current] + 1;
+                Scratch.Parent[Next] = Current;
+                Scratch.Queue[Tail++] = Next;
+            }
+        }
+    }
+    return Tail;
+}
+
+void FGridPathHierarchy::AppendClusterPath(int32_t Cluster, FGridPoint To, const FGridClusterScratch& Scratch, std::vector<FGridPoint>& OutPath) const
+{
+    const int32_t MinX = (Cluster % ClustersX) * ClusterSize;
+    const int32_t MinY = (Cluster / ClustersX) * ClusterSize;
+
+    // Walk the parents back to the start, which is left out, then flip what was added
+    const size_t First = OutPath.size();
+    for (int32_t Local = GetLocalIndex(Cluster, To.X, To.Y); Scratch.Distance[Local] != 0; Local = Scratch.Parent[Local])
+    {
+        OutPath.push_back({ MinX + Local % ClusterSize, MinY + Local / ClusterSize });
+    }
+    std::reverse(OutPath.begin() + First, OutPath.end());
+}
@@ -0,0 +1,123 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "GridStorage.h"
+#include <cstdint>
+#include <vector>
+
+class FWorkStealingPool;
+
+/** Scratch for a search confined to one cluster, one per thread. */
+struct FGridClusterScratch
+{
+	std::vector<int32_t> Distance;
+	std::vector<int32_t> Parent;
+	std::vector<int32_t> Queue;
+};
+
+/**
+ * Abstract graph for hierarchical path search (HPA*).
+ *
+ * The grid is cut into square clusters. Along every border between two
+ * clusters, each run of cell pairs that can be crossed both ways (no fence,
+ * neither cell a zombie) gets one transition in its middle, or one at each end
+ * when it is 6 cells or longer. Both cells of a transition become nodes of
+ * their cluster, and each cluster stores the in-cluster walking distance
+ * between every pair of its nodes. Crossings between clusters are not stored:
+ * two nodes facing each other across a border are linked whenever the grid
+ * allows the step.
+ *
+ * A cluster's nodes depend only on its own cells and the cells just across its
+ * borders, so an edit re-runs the cluster it lands in and, on a border, the
+ * one across it; nothing else is touched. FGridPathfinder answers
+ * EGridPathMode::Hierarchical queries on this graph and refines each abstract
+ * step with a search inside one cluster. Paths are near-shortest, on large
+ * maps typically within a few percent of the flat search's.
+ */
+class FGridPathHierarchy
+{
+public:
+	static constexpr int32_t DefaultClusterSize = 16;
+	static constexpr int32_t MinClusterSize = 4;
+	static constexpr int32_t MaxClusterSize = 64;
+	static constexpr uint16_t Unreachable = 0xFFFF;
+
+	/** Every cluster from scratch, clusters are split across the pool, the default one unless given. */
+	void Build(const FGridStorage& Grid, int32_t InClusterSize = DefaultClusterSize, FWorkStealingPool* Pool = nullptr);
+
+	/**
+	 * Re-runs the clusters ChangedCells can affect. ChangedCells lists every cell whose
+	 * state changed and both cells on either side of a new fence. Falls back to Build if
+	 * the grid was resized. Returns how many clusters were rebuilt.
+	 */
+	int32_t Update(const FGridStorage& Grid, const std::vector<FGridPoint>& ChangedCells, FWorkStealingPool* Pool = nullptr);
+
+	bool IsBuilt() const { return bBuilt; }
+	bool Matches(const FGridStorage& Grid) const { return bBuilt && Grid.GetWidth() == Width && Grid.GetHeight() == Height; }
+
+	int32_t GetClusterSize() const { return ClusterSize; }
+	int32_t GetNumClusters() const { return ClustersX * ClustersY; }
+	int32_t GetNumNodes() const { return NodeOffsets.empty() ? 0 : NodeOffsets.back(); }
+
+	int32_t GetClusterOf(int32_t X, int32_t Y) const { return (Y / ClusterSize) * ClustersX + X / ClusterSize; }
+
+	/** Node cell indices of a cluster, ascending; node ids run from GetFirstNode(Cluster) in the same order. */
+	const std::vector<int32_t>& GetNodes(int32_t Cluster) const { return Clusters[Cluster].Nodes; }
+	int32_t GetFirstNode(int32_t Cluster) const { return NodeOffsets[Cluster]; }
+
+	/** Cluster a node id belongs to. */
+	int32_t GetNodeCluster(int32_t Node) const;
+
+	/** Local index of cell CellIndex among its cluster's nodes, -1 if it is not a node. */
+	int32_t FindNode(int32_t Cluster, int32_t CellIndex) const;
+
+	/** In-cluster distance between two local nodes, Unreachable if the cluster alone does not connect them. */
+	uint16_t GetCost(int32_t Cluster, int32_t From, int32_t To) const
+	{
+		const FCluster& Entry = Clusters[Cluster];
+		return Entry.Costs[From * static_cast<int32_t>(Entry.Nodes.size()) + To];
+	}
+
+	/**
+	 * Breadth-first search from From without leaving Cluster. Afterwards Scratch.Distance holds
+	 * the steps to every cell of the cluster (local index, -1 unreached), or only up to Until
+	 * when given. Returns cells expanded.
+	 */
+	int32_t SearchCluster(const FGridStorage& Grid, int32_t Cluster, FGridPoint From, FGridClusterScratch& Scratch,
+		const FGridPoint* Until = nullptr) const;
+
+	/** Appends the cells after the search's start up to and including To, To must have been reached. */
+	void AppendClusterPath(int32_t Cluster, FGridPoint To, const FGridClusterScratch& Scratch, std::vector<FGridPoint>& OutPath) const;
+
+	/** Local index of a cell inside its cluster, as used by FGridClusterScratch. */
+	int32_t GetLocalIndex(int32_t Cluster, int32_t X, int32_t Y) const
+	{
+		return (Y - (Cluster / ClustersX) * ClusterSize) * ClusterSize + (X - (Cluster % ClustersX) * ClusterSize);
+	}
+
+private:
+	struct FCluster
+	{
+		std::vector<int32_t> Nodes;
+		std::vector<uint16_t> Costs;
+	};
+
+	void BuildCluster(const FGridStorage& Grid, int32_t Cluster, FGridClusterScratch& Scratch);
+	// Side in FGridStorage::GetNeighbors order: -X, +X, -Y, +Y
+	void AddBorderNodes(const FGridStorage& Grid, int32_t Cluster, int32_t Side, std::vector<int32_t>& OutNodes) const;
+	void BuildClusters(const FGridStorage& Grid, const std::vector<int32_t>& ToBuild, FWorkStealingPool* Pool);
+	void UpdateOffsets();
+
+	std::vector<FCluster> Clusters;
+
+	// First node id of every cluster, plus the total at the end
+	std::vector<int32_t> NodeOffsets;
+
+	int32_t ClusterSize{ DefaultClusterSize };
+	int32_t ClustersX{ 0 };
+	int32_t ClustersY{ 0 };
+	int32_t Width{ 0 };
+	int32_t Height{ 0 };
+	bool bBuilt{ false };
+};
@@ -0,0 +1,140 @@
+// Copyright University of Inland Norway
+
+#include "GridPathService.h"
+#include "WorkStealingPool.h"
+#include "ZombieSimStats.h"
+#include <algorithm>
+#include <thread>
+
+// Queries per pool task, enough to amortise the task overhead on short paths
+static constexpr size_t PathQueriesPerTask = 8;
+
+FGridPathService::FGridPathService(FWorkStealingPool* InPool)
+    : Pool(InPool)
+{
+}
+
+FWorkStealingPool& FGridPathService::GetPool() const
+{
+    // Not bound in the constructor, so default objects (an actor's CDO) never start the shared pool
+    return Pool ? *Pool : FWorkStealingPool::Get();
+}
+
+FGridPathService::~FGridPathService()
+{
+    Flush();
+}
+
+bool FGridPathService::MakeKey(FGridPoint Start, FGridPoint End, EGridPathMode Mode, uint64_t& OutKey)
+{
+    // Only coordinates that can be on a grid get a key, anything else is searched (and fails) on its own
+    const uint32_t Limit = static_cast<uint32_t>(FGridStorage::MaxDimension);
+    if (static_cast<uint32_t>(Start.X) >= Limit || static_cast<uint32_t>(Start.Y) >= Limit
+        || static_cast<uint32_t>(End.X) >= Limit || static_cast<uint32_t>(End.Y) >= Limit)
+        return false;
+
+    OutKey = (static_cast<uint64_t>(Mode) << 56)
+        | (static_cast<uint64_t>(Start.X) << 42)
+        | (static_cast<uint64_t>(Start.Y) << 28)
+        | (static_cast<uint64_t>(End.X) << 14)
+        | static_cast<uint64_t>(End.Y);
+    return true;
+}
+
+uint32_t FGridPathService::Request(FGridPoint Start, FGridPoint End, EGridPathMode Mode)
+{
+    const uint32_t RequestId = NextRequestId++;
+    if (NextRequestId == 0)
+        NextRequestId = 1;
+
+    uint64_t Key = 0;
+    if (MakeKey(Start, End, Mode, Key))
+    {
+        const auto Found = QueuedByKey.find(Key);
+        if (Found != QueuedByKey.end())
+        {
+            Queued[Found->second].RequestIds.push_back(RequestId);
+            return RequestId;
+        }
+        QueuedByKey.emplace(Key, Queued.size());
+    }
+
+    Queued.push_back({ Start, End, Mode, { RequestId } });
+    return RequestId;
+}
+
+int32_t FGridPathService::Dispatch(const std::shared_ptr<const FGridStorage>& Snapshot, int32_t MaxQueries,
+    const std::shared_ptr<const FGridPathHierarchy>& Hierarchy)
+{
+    if (Queued.empty() || !Snapshot)
+        return 0;
+
+    const size_t Count = (MaxQueries <= 0) ? Queued.size() : std::min(Queued.size(), static_cast<size_t>(MaxQueries));
+
+    // 1. - Move the oldest queries into a batch the workers share
+    auto Batch = std::make_shared<std::vector<FQuery>>(
+        std::make_move_iterator(Queued.begin()), std::make_move_iterator(Queued.begin() + Count));
+    Queued.erase(Queued.begin(), Queued.begin() + Count);
+
+    QueuedByKey.clear();
+    for (size_t i = 0; i < Queued.size(); ++i)
+    {
+        uint64_t Key = 0;
+        if (MakeKey(Queued[i].Start, Queued[i].End, Queued[i].Mode, Key))
+            QueuedByKey.emplace(Key, i);
+    }
+
+    // 2. - One task per few queries, each worker reuses its own pathfinder
+    for (size_t Begin = 0; Begin < Count; Begin += PathQueriesPerTask)
+    {
+        const size_t End = std::min(Count, Begin + PathQueriesPerTask);
+        InFlight.fetch_add(1, std::memory_order_acq_rel);
+        GetPool().Submit([this, Batch, Snapshot, Hierarchy, Begin, End]()
+        {
+            static thread_local FGridPathfinder Pathfinder;
+
+            std::vector<FGridPathResult> Results;
+            for (size_t i = Begin; i < End; ++i)
+            {
+                ZOMBIESIM_SCOPE(STAT_ZombieSim_PathQuery);
+                const FQuery& Query = (*Batch)[i];
+                const bool bFound = Pathfinder.FindPath(*Snapshot, Query.Start, Query.End, Query.Mode, Hierarchy.get());
+                for (uint32_t RequestId : Query.RequestIds)
+                {
+                    FGridPathResult Result;
+                    Result.RequestId = RequestId;
+                    Result.bFound = bFound;
+                    Result.NodesExpanded = Pathfinder.GetNodesExpanded();
+                    if (bFound)
+                        Result.Path = Pathfinder.GetPath();
+                    Results.push_back(std::move(Result));
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> Lock(CompletedMutex);
+                for (FGridPathResult& Result : Results)
+                    Completed.push_back(std::move(Result));
+            }
+            InFlight.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+    return static_cast<int32_t>(Count);
+}
+
+void FGridPathService::PollResults(std::vector<FGridPathResult>& OutResults)
+{
+    std::lock_guard<std::mutex> Lock(CompletedMutex);
+    for (FGridPathResult& Result : Completed)
+        OutResults.push_back(std::move(Result));
+    Completed.clear();
+}
+
+void FGridPathService::Flush()
+{
+    while (InFlight.load(std::memory_order_acquire) > 0)
+    {
+        if (!GetPool().RunOneTask())
+            std::this_thread::yield();
+    }
+}
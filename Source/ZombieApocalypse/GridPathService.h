@@ -0,0 +1,88 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "GridPathfinder.h"
+#include "GridStorage.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class FWorkStealingPool;
+
+struct FGridPathResult
+{
+	uint32_t RequestId = 0;
+	bool bFound = false;
+	int32_t NodesExpanded = 0;
+	std::vector<FGridPoint> Path;
+};
+
+/**
+ * Batches path requests and answers them on the work-stealing pool.
+ *
+ * Requests queue up on the calling thread; Dispatch hands up to a budget of
+ * them to the workers together with an immutable grid snapshot, and finished
+ * results are picked up later with PollResults. Identical (Start, End, Mode)
+ * requests waiting for the same dispatch are searched only once.
+ */
+class FGridPathService
+{
+public:
+	/** Without a pool the shared one is used, looked up only once there is work for it. */
+	explicit FGridPathService(FWorkStealingPool* InPool = nullptr);
+
+	/** Blocks until every dispatched query has finished. */
+	~FGridPathService();
+
+	FGridPathService(const FGridPathService&) = delete;
+	FGridPathService& operator=(const FGridPathService&) = delete;
+
+	/** Queues a query and returns its id, never 0. */
+	uint32_t Request(FGridPoint Start, FGridPoint End, EGridPathMode Mode = EGridPathMode::BFS);
+
+	/**
+	 * Starts up to MaxQueries unique queries against Snapshot, oldest first, and
+	 * returns how many were started. MaxQueries <= 0 starts all of them.
+	 * Hierarchical queries use Hierarchy, which must be built over Snapshot, or run as AStar without it.
+	 */
+	int32_t Dispatch(const std::shared_ptr<const FGridStorage>& Snapshot, int32_t MaxQueries = 0,
+		const std::shared_ptr<const FGridPathHierarchy>& Hierarchy = nullptr);
+
+	/** Appends every finished result to OutResults, in no particular order. */
+	void PollResults(std::vector<FGridPathResult>& OutResults);
+
+	/** Waits for every dispatched query, helping the pool meanwhile. */
+	void Flush();
+
+	int32_t GetNumQueued() const { return static_cast<int32_t>(Queued.size()); }
+	int32_t GetNumInFlight() const { return InFlight.load(std::memory_order_acquire); }
+
+private:
+	struct FQuery
+	{
+		FGridPoint Start;
+		FGridPoint End;
+		EGridPathMode Mode;
+		std::vector<uint32_t> RequestIds;
+	};
+
+	static bool MakeKey(FGridPoint Start, FGridPoint End, EGridPathMode Mode, uint64_t& OutKey);
+
+	FWorkStealingPool& GetPool() const;
+
+	// Null for the shared pool
+	FWorkStealingPool* Pool{ nullptr };
+
+	// Unique queries waiting for Dispatch, and where to find them by key
+	std::vector<FQuery> Queued;
+	std::unordered_map<uint64_t, size_t> QueuedByKey;
+	uint32_t NextRequestId{ 1 };
+
+	std::mutex CompletedMutex;
+	std::vector<FGridPathResult> Completed;
+	std::atomic<int32_t> InFlight{ 0 };
+};
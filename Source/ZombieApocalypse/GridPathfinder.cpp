@@ -0,0 +1,379 @@
+// Copyright University of Inland Norway
+
+#include "GridPathfinder.h"
+#include <algorithm>
+#include <cstdlib>
+
+// Same neighbour order as FGridStorage::GetNeighbors, which keeps BFS paths identical
+static const int32_t PathDx[4] = { -1, 1, 0, 0 };
+static const int32_t PathDy[4] = { 0, 0, -1, 1 };
+
+void FGridPathfinder::Reserve(int32_t NumCells)
+{
+    if (static_cast<int32_t>(VisitStamp.size()) >= NumCells)
+        return;
+
+    VisitStamp.assign(NumCells, 0);
+    Parent.resize(NumCells);
+    Cost.resize(NumCells);
+    Queue.resize(NumCells);
+    Open.reserve(NumCells);
+    Path.reserve(NumCells);
+    Generation = 0;
+}
+
+void FGridPathfinder::BeginQuery(int32_t NumCells)
+{
+    Reserve(NumCells);
+
+    // Stamp 0 means "never visited", so wrap back to 1 and wipe the stamps once every 4 billion queries
+    if (++Generation == 0)
+    {
+        std::fill(VisitStamp.begin(), VisitStamp.end(), 0);
+        Generation = 1;
+    }
+
+    NodesExpanded = 0;
+    Path.clear();
+}
+
+bool FGridPathfinder::FindPath(const FGridStorage& Grid, FGridPoint Start, FGridPoint End, EGridPathMode Mode, const FGridPathHierarchy* Hierarchy)
+{
+    if (!Grid.IsValidCell(Start.X, Start.Y) || !Grid.IsValidCell(End.X, End.Y))
+        return false;
+
+    if (Mode == EGridPathMode::Hierarchical)
+    {
+        if (Hierarchy && Hierarchy->Matches(Grid))
+        {
+            // Abstract nodes plus the start and end share the flat search's arrays
+            BeginQuery(std::max(Grid.GetNumCells(), Hierarchy->GetNumNodes() + 2));
+            return SearchHierarchical(Grid, *Hierarchy, Start, End);
+        }
+        Mode = EGridPathMode::AStar;
+    }
+
+    BeginQuery(Grid.GetNumCells());
+
+    const int32_t StartIndex = Grid.GetIndex(Start.X, Start.Y);
+    const int32_t EndIndex = Grid.GetIndex(End.X, End.Y);
+
+    const bool bFound = (Mode == EGridPathMode::AStar)
+        ? SearchAStar(Grid, StartIndex, EndIndex)
+        : SearchBFS(Grid, StartIndex, EndIndex);
+
+    if (bFound)
+        BuildPath(Grid, StartIndex, EndIndex);
+    return bFound;
+}
+
+bool FGridPathfinder::SearchBFS(const FGridStorage& Grid, int32_t StartIndex, int32_t EndIndex)
+{
+    const int32_t Width = Grid.GetWidth();
+
+    int32_t Head = 0;
+    int32_t Tail = 0;
+    Queue[Tail++] = StartIndex;
+    VisitStamp[StartIndex] = Generation;
+    Parent[StartIndex] = StartIndex;
+
+    while (Head < Tail)
+    {
+        const int32_t Current = Queue[Head++];
+        ++NodesExpanded;
+
+        if (Current == EndIndex)
+            return true;
+
+        const int32_t X = Current % Width;
+        const int32_t Y = Current / Width;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            const int32_t Nx = X + PathDx[i];
+            const int32_t Ny = Y + PathDy[i];
+            if (!Grid.CanMoveBetweenCells(X, Y, Nx, Ny))
+                continue;
+
+            const int32_t Next = Nx + Ny * Width;
+            if (VisitStamp[Next] != Generation)
+            {
+                VisitStamp[Next] = Generation;
+                Parent[Next] = Current;
+                Queue[Tail++] = Next;
+            }
+        }
+    }
+    return false;
+}
+
+bool FGridPathfinder::SearchAStar(const FGridStorage& Grid, int32_t StartIndex, int32_t EndIndex)
+{
+    const int32_t Width = Grid.GetWidth();
+    const int32_t EndX = EndIndex % Width;
+    const int32_t EndY = EndIndex / Width;
+
+    auto Heuristic = [EndX, EndY](int32_t X, int32_t Y)
+    {
+        return static_cast<uint32_t>(std::abs(X - EndX) + std::abs(Y - EndY));
+    };
+
+    Open.clear();
+    VisitStamp[StartIndex] = Generation;
+    Parent[StartIndex] = StartIndex;
+    Cost[StartIndex] = 0;
+    Open.push_back({ Heuristic(StartIndex % Width, StartIndex / Width), 0, StartIndex });
+
+    while (!Open.empty())
+    {
+        std::pop_heap(Open.begin(), Open.end(), IsWorseEntry);
+        const FOpenEntry Entry = Open.back();
+        Open.pop_back();
+
+        // A cheaper route to this cell was queued after this entry
+        if (Entry.G != Cost[Entry.Index])
+            continue;
+
+        ++NodesExpanded;
+        if (Entry.Index == EndIndex)
+            return true;
+
+        const int32_t X = Entry.Index % Width;
+        const int32_t Y = Entry.Index / Width;
+        const uint32_t NextCost = Entry.G + 1;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            const int32_t Nx = X + PathDx[i];
+            const int32_t Ny = Y + PathDy[i];
+            if (!Grid.CanMoveBetweenCells(X, Y, Nx, Ny))
+                continue;
+
+            const int32_t Next = Nx + Ny * Width;
+            if (VisitStamp[Next] != Generation || NextCost < Cost[Next])
+            {
+                VisitStamp[Next] = Generation;
+                Parent[Next] = Entry.Index;
+                Cost[Next] = NextCost;
+                Open.push_back({ NextCost + Heuristic(Nx, Ny), NextCost, Next });
+                std::push_heap(Open.begin(), Open.end(), IsWorseEntry);
+            }
+        }
+    }
+    return false;
+}
+
+bool FGridPathfinder::SearchHierarchical(const FGridStorage& Grid, const FGridPathHierarchy& Hierarchy, FGridPoint Start, FGridPoint End)
+{
+    if (Start == End)
+    {
+        Path.push_back(Start);
+        return true;
+    }
+    if (!FGridStorage::IsWalkable(Grid.GetCell(End.X, End.Y)))
+        return false;
+
+    const int32_t Width = Grid.GetWidth();
+    const int32_t StartCluster = Hierarchy.GetClusterOf(Start.X, Start.Y);
+    const int32_t EndCluster = Hierarchy.GetClusterOf(End.X, End.Y);
+    const int32_t StartId = Hierarchy.GetNumNodes();
+    const int32_t EndId = StartId + 1;
+
+    // 1. - Link the start and end to the nodes of their clusters; End is walkable, so distances toward it read the same both ways
+    NodesExpanded += Hierarchy.SearchCluster(Grid, StartCluster, Start, StartScratch);
+    NodesExpanded += Hierarchy.SearchCluster(Grid, EndCluster, End, EndScratch);
+
+    // A zombie may step off its cell into the next cluster where no transition is, so first steps across a border search from there
+    int32_t NumExits = 0;
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const FGridPoint Exit = { Start.X + PathDx[i], Start.Y + PathDy[i] };
+        if (Grid.IsValidCell(Exit.X, Exit.Y) && Hierarchy.GetClusterOf(Exit.X, Exit.Y) != StartCluster && Grid.CanMoveBetweenCells(Start.X, Start.Y, Exit.X, Exit.Y))
+        {
+            Exits[NumExits] = Exit;
+            NodesExpanded += Hierarchy.SearchCluster(Grid, Hierarchy.GetClusterOf(Exit.X, Exit.Y), Exit, ExitScratch[NumExits]);
+            ++NumExits;
+        }
+    }
+
+    auto GetCell = [&](int32_t Id)
+    {
+        if (Id == StartId)
+            return Start;
+        if (Id == EndId)
+            return End;
+        const int32_t Cluster = Hierarchy.GetNodeCluster(Id);
+        const int32_t CellIndex = Hierarchy.GetNodes(Cluster)[Id - Hierarchy.GetFirstNode(Cluster)];
+        return FGridPoint{ CellIndex % Width, CellIndex / Width };
+    };
+    auto Heuristic = [&End](FGridPoint Cell)
+    {
+        return static_cast<uint32_t>(std::abs(Cell.X - End.X) + std::abs(Cell.Y - End.Y));
+    };
+
+    Open.clear();
+    auto Relax = [&](int32_t From, uint32_t FromCost, int32_t Next, uint32_t StepCost)
+    {
+        const uint32_t NextCost = FromCost + StepCost;
+        if (VisitStamp[Next] != Generation || NextCost < Cost[Next])
+        {
+            VisitStamp[Next] = Generation;
+            Parent[Next] = From;
+            Cost[Next] = NextCost;
+            Open.push_back({ NextCost + (Next == EndId ? 0 : Heuristic(GetCell(Next))), NextCost, Next });
+            std::push_heap(Open.begin(), Open.end(), IsWorseEntry);
+        }
+    };
+
+    VisitStamp[StartId] = Generation;
+    Parent[StartId] = StartId;
+    Cost[StartId] = 0;
+    Open.push_back({ Heuristic(Start), 0, StartId });
+
+    // 2. - A* over the abstract graph
+    bool bFound = false;
+    while (!Open.empty())
+    {
+        std::pop_heap(Open.begin(), Open.end(), IsWorseEntry);
+        const FOpenEntry Entry = Open.back();
+        Open.pop_back();
+        if (Entry.G != Cost[Entry.Index])
+            continue;
+
+        ++NodesExpanded;
+        if (Entry.Index == EndId)
+        {
+            bFound = true;
+            break;
+        }
+
+        if (Entry.Index == StartId)
+        {
+            for (int32_t Exit = -1; Exit < NumExits; ++Exit)
+            {
+                const int32_t Cluster = Exit < 0 ? StartCluster : Hierarchy.GetClusterOf(Exits[Exit].X, Exits[Exit].Y);
+                const FGridClusterScratch& Scratch = Exit < 0 ? StartScratch : ExitScratch[Exit];
+                const int32_t FirstStep = Exit < 0 ? 0 : 1;
+
+                const std::vector<int32_t>& Nodes = Hierarchy.GetNodes(Cluster);
+                for (size_t Local = 0; Local < Nodes.size(); ++Local)
+                {
+                    const int32_t Distance = Scratch.Distance[Hierarchy.GetLocalIndex(Cluster, Nodes[Local] % Width, Nodes[Local] / Width)];
+                    if (Distance >= 0)
+                        Relax(StartId, 0, Hierarchy.GetFirstNode(Cluster) + static_cast<int32_t>(Local), FirstStep + Distance);
+                }
+                const int32_t Direct = Cluster == EndCluster ? Scratch.Distance[Hierarchy.GetLocalIndex(Cluster, End.X, End.Y)] : -1;
+                if (Direct >= 0)
+                    Relax(StartId, 0, EndId, FirstStep + Direct);
+            }
+            continue;
+        }
+
+        const int32_t Cluster = Hierarchy.GetNodeCluster(Entry.Index);
+        const int32_t FirstNode = Hierarchy.GetFirstNode(Cluster);
+        const int32_t Local = Entry.Index - FirstNode;
+        const int32_t NumNodes = static_cast<int32_t>(Hierarchy.GetNodes(Cluster).size());
+        const FGridPoint Cell = GetCell(Entry.Index);
+
+        // Within the cluster, precomputed
+        for (int32_t Other = 0; Other < NumNodes; ++Other)
+        {
+            const uint16_t StepCost = Hierarchy.GetCost(Cluster, Local, Other);
+            if (Other != Local && StepCost != FGridPathHierarchy::Unreachable)
+                Relax(Entry.Index, Entry.G, FirstNode + Other, StepCost);
+        }
+        if (Cluster == EndCluster)
+        {
+            const int32_t Distance = EndScratch.Distance[Hierarchy.GetLocalIndex(EndCluster, Cell.X, Cell.Y)];
+            if (Distance >= 0)
+                Relax(Entry.Index, Entry.G, EndId, Distance);
+        }
+
+        // Across a border, a single step to a facing node
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            const int32_t Nx = Cell.X + PathDx[i];
+            const int32_t Ny = Cell.Y + PathDy[i];
+            if (!Grid.IsValidCell(Nx, Ny))
+                continue;
+
+            const int32_t NextCluster = Hierarchy.GetClusterOf(Nx, Ny);
+            if (NextCluster == Cluster || !Grid.CanMoveBetweenCells(Cell.X, Cell.Y, Nx, Ny))
+                continue;
+
+            const int32_t NextLocal = Hierarchy.FindNode(NextCluster, Grid.GetIndex(Nx, Ny));
+            if (NextLocal >= 0)
+                Relax(Entry.Index, Entry.G, Hierarchy.GetFirstNode(NextCluster) + NextLocal, 1);
+        }
+    }
+    if (!bFound)
+        return false;
+
+    // 3. - Refine: the legs out of the start and into the end reuse their searches, other in-cluster legs search again
+    AbstractPath.clear();
+    for (int32_t Id = EndId; Id != StartId; Id = Parent[Id])
+    {
+        AbstractPath.push_back(Id);
+    }
+    std::reverse(AbstractPath.begin(), AbstractPath.end());
+
+    Path.push_back(Start);
+    int32_t Previous = StartId;
+    for (const int32_t Id : AbstractPath)
+    {
+        const FGridPoint To = GetCell(Id);
+        if (Previous == StartId)
+        {
+            // Whichever of the start's searches gives the cost the abstract search settled on
+            const int32_t ToCluster = Hierarchy.GetClusterOf(To.X, To.Y);
+            int32_t Exit = -1;
+            if (ToCluster != StartCluster || StartScratch.Distance[Hierarchy.GetLocalIndex(ToCluster, To.X, To.Y)] != static_cast<int32_t>(Cost[Id]))
+            {
+                for (Exit = 0; Exit + 1 < NumExits; ++Exit)
+                {
+                    if (Hierarchy.GetClusterOf(Exits[Exit].X, Exits[Exit].Y) == ToCluster
+                        && ExitScratch[Exit].Distance[Hierarchy.GetLocalIndex(ToCluster, To.X, To.Y)] + 1 == static_cast<int32_t>(Cost[Id]))
+                        break;
+                }
+            }
+
+            if (Exit < 0)
+            {
+                Hierarchy.AppendClusterPath(StartCluster, To, StartScratch, Path);
+            }
+            else
+            {
+                Path.push_back(Exits[Exit]);
+                Hierarchy.AppendClusterPath(ToCluster, To, ExitScratch[Exit], Path);
+            }
+        }
+        else
+        {
+            const FGridPoint From = GetCell(Previous);
+            const int32_t FromCluster = Hierarchy.GetClusterOf(From.X, From.Y);
+            if (Id == EndId || FromCluster == Hierarchy.GetClusterOf(To.X, To.Y))
+            {
+                NodesExpanded += Hierarchy.SearchCluster(Grid, FromCluster, From, RefineScratch, &To);
+                Hierarchy.AppendClusterPath(FromCluster, To, RefineScratch, Path);
+            }
+            else
+            {
+                Path.push_back(To);
+            }
+        }
+        Previous = Id;
+    }
+    return true;
+}
+
+void FGridPathfinder::BuildPath(const FGridStorage& Grid, int32_t StartIndex, int32_t EndIndex)
+{
+    const int32_t Width = Grid.GetWidth();
+
+    // Walk the parents back from the goal, then flip in place
+    for (int32_t Node = EndIndex; ; Node = Parent[Node])
+    {
+        Path.push_back({ Node % Width, Node / Width });
+        if (Node == StartIndex)
+            break;
+    }
+    std::reverse(Path.begin(), Path.end());
+}
@@ -0,0 +1,85 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "GridPathHierarchy.h"
+#include "GridStorage.h"
+#include <cstdint>
+#include <vector>
+
+enum class EGridPathMode : uint8_t
+{
+	// Breadth-first, same path as the original AGridManager::FindPath
+	BFS,
+	// A* with a Manhattan heuristic, a shortest path with far fewer expansions on open maps
+	AStar,
+	// A* over the cluster graph of an FGridPathHierarchy, refined cluster by cluster; near-shortest paths
+	// whose cost grows with the number of clusters crossed rather than the area searched
+	Hierarchical
+};
+
+/**
+ * Reusable pathfinding context for FGridStorage.
+ *
+ * Visited/parent data lives in flat arrays indexed like GetGridIndex and is
+ * invalidated by bumping a generation stamp, so after the first query on a
+ * given grid size a search does no heap allocation at all. One context per
+ * thread; the grid itself is only read.
+ */
+class FGridPathfinder
+{
+public:
+	/**
+	 * Finds a path from Start to End inclusive, readable through GetPath() on success.
+	 * Hierarchical needs a Hierarchy built over Grid and runs as AStar without one.
+	 */
+	bool FindPath(const FGridStorage& Grid, FGridPoint Start, FGridPoint End, EGridPathMode Mode = EGridPathMode::BFS,
+		const FGridPathHierarchy* Hierarchy = nullptr);
+
+	const std::vector<FGridPoint>& GetPath() const { return Path; }
+
+	/** Nodes popped from the open list by the last query. */
+	int32_t GetNodesExpanded() const { return NodesExpanded; }
+
+	/** Grows the scratch arrays up front, e.g. before a batch of queries. */
+	void Reserve(int32_t NumCells);
+
+private:
+	struct FOpenEntry
+	{
+		uint32_t F;
+		uint32_t G;
+		int32_t Index;
+	};
+
+	// Heap order: lower F first, on ties the deeper node so A* runs straight at the goal
+	static bool IsWorseEntry(const FOpenEntry& A, const FOpenEntry& B)
+	{
+		return A.F > B.F || (A.F == B.F && A.G < B.G);
+	}
+
+	void BeginQuery(int32_t NumCells);
+	bool SearchBFS(const FGridStorage& Grid, int32_t StartIndex, int32_t EndIndex);
+	bool SearchAStar(const FGridStorage& Grid, int32_t StartIndex, int32_t EndIndex);
+	bool SearchHierarchical(const FGridStorage& Grid, const FGridPathHierarchy& Hierarchy, FGridPoint Start, FGridPoint End);
+	void BuildPath(const FGridStorage& Grid, int32_t StartIndex, int32_t EndIndex);
+
+	std::vector<uint32_t> VisitStamp;
+	std::vector<int32_t> Parent;
+	std::vector<uint32_t> Cost;
+	std::vector<int32_t> Queue;
+	std::vector<FOpenEntry> Open;
+	std::vector<FGridPoint> Path;
+
+	// Hierarchical: searches from the start, from its first steps into other clusters, toward the end,
+	// and for refining one abstract step
+	FGridClusterScratch StartScratch;
+	FGridClusterScratch ExitScratch[2];
+	FGridPoint Exits[2];
+	FGridClusterScratch EndScratch;
+	FGridClusterScratch RefineScratch;
+	std::vector<int32_t> AbstractPath;
+
+	uint32_t Generation{ 0 };
+	int32_t NodesExpanded{ 0 };
+};
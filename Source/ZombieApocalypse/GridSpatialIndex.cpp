@@ -0,0 +1,301 @@
+// Copyright University of Inland Norway
+
+#include "GridSpatialIndex.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static uint64_t GetSpatialTileMask(const FGridTile& Tile, EGridCell State)
+{
+    return State == EGridCell::Human ? FGridStorage::GetHumanMask(Tile) : FGridStorage::GetZombieMask(Tile);
+}
+
+// Cells of tile (TileX, TileY) inside the square of half-width sqrt(BoundSq) around (X, Y), the only ones that can beat the bound
+static uint64_t GetSpatialWindowMask(int32_t X, int32_t Y, int32_t TileX, int32_t TileY, int32_t BoundSq)
+{
+    const int32_t Reach = static_cast<int32_t>(std::sqrt(static_cast<double>(BoundSq)));
+    const int32_t MinX = std::max(X - Reach - (TileX << FGridStorage::TileShift), 0);
+    const int32_t MaxX = std::min(X + Reach - (TileX << FGridStorage::TileShift), FGridStorage::TileMask);
+    const int32_t MinY = std::max(Y - Reach - (TileY << FGridStorage::TileShift), 0);
+    const int32_t MaxY = std::min(Y + Reach - (TileY << FGridStorage::TileShift), FGridStorage::TileMask);
+    if (MinX > MaxX || MinY > MaxY)
+        return 0;
+
+    const uint64_t RowBits = ((uint64_t(1) << (MaxX - MinX + 1)) - 1) << MinX;
+    const uint64_t Rows = (~uint64_t(0) >> (8 * (FGridStorage::TileMask - MaxY))) & (~uint64_t(0) << (8 * MinY));
+    return Rows & (RowBits * 0x0101010101010101ull);
+}
+
+// Squared search limit, negative is unlimited; capped so bounds fit in int32
+static int64_t GetSpatialLimitSq(int32_t MaxRadius)
+{
+    const int64_t Unlimited = std::numeric_limits<int32_t>::max();
+    return MaxRadius < 0 ? Unlimited : std::min(int64_t(MaxRadius) * MaxRadius, Unlimited);
+}
+
+// Closer first, then lower row-major index
+static bool IsCloserNeighbor(const FGridNeighbor& A, const FGridNeighbor& B)
+{
+    if (A.DistanceSq != B.DistanceSq)
+        return A.DistanceSq < B.DistanceSq;
+    return A.Cell.Y != B.Cell.Y ? A.Cell.Y < B.Cell.Y : A.Cell.X < B.Cell.X;
+}
+
+void FGridSpatialIndex::Build(const FGridStorage& Grid)
+{
+    Width = Grid.GetWidth();
+    Height = Grid.GetHeight();
+    TilesX = Grid.GetTilesX();
+    TilesY = Grid.GetTilesY();
+
+    const size_t NumWords = (static_cast<size_t>(TilesX) * TilesY + 63) / 64;
+    HumanTiles.assign(NumWords, 0);
+    ZombieTiles.assign(NumWords, 0);
+
+    const std::vector<FGridTile>& Tiles = Grid.GetTiles();
+    for (size_t TileIndex = 0; TileIndex < Tiles.size(); ++TileIndex)
+    {
+        const uint64_t Bit = uint64_t(1) << (TileIndex & 63);
+        if (FGridStorage::GetHumanMask(Tiles[TileIndex]))
+            HumanTiles[TileIndex >> 6] |= Bit;
+        if (FGridStorage::GetZombieMask(Tiles[TileIndex]))
+            ZombieTiles[TileIndex >> 6] |= Bit;
+    }
+    bBuilt = true;
+}
+
+void FGridSpatialIndex::Update(const FGridStorage& Grid, const std::vector<FGridPoint>& ChangedCells)
+{
+    if (!bBuilt || Grid.GetWidth() != Width || Grid.GetHeight() != Height)
+    {
+        Build(Grid);
+        return;
+    }
+
+    for (const FGridPoint& Cell : ChangedCells)
+    {
+        if (!Grid.IsValidCell(Cell.X, Cell.Y))
+            continue;
+
+        MarkTile(Grid, (Cell.Y >> FGridStorage::TileShift) * TilesX + (Cell.X >> FGridStorage::TileShift));
+    }
+}
+
+void FGridSpatialIndex::MarkTile(const FGridStorage& Grid, int32_t TileIndex)
+{
+    const FGridTile& Tile = Grid.GetTiles()[TileIndex];
+    const uint64_t Bit = uint64_t(1) << (TileIndex & 63);
+    HumanTiles[TileIndex >> 6] = FGridStorage::GetHumanMask(Tile) ? HumanTiles[TileIndex >> 6] | Bit : HumanTiles[TileIndex >> 6] & ~Bit;
+    ZombieTiles[TileIndex >> 6] = FGridStorage::GetZombieMask(Tile) ? ZombieTiles[TileIndex >> 6] | Bit : ZombieTiles[TileIndex >> 6] & ~Bit;
+}
+
+int32_t FGridSpatialIndex::GetTileDistanceSq(int32_t X, int32_t Y, int32_t TileX, int32_t TileY)
+{
+    const int32_t MinX = TileX << FGridStorage::TileShift;
+    const int32_t MinY = TileY << FGridStorage::TileShift;
+    const int32_t Dx = std::max({ MinX - X, X - (MinX + FGridStorage::TileMask), 0 });
+    const int32_t Dy = std::max({ MinY - Y, Y - (MinY + FGridStorage::TileMask), 0 });
+    return Dx * Dx + Dy * Dy;
+}
+
+void FGridSpatialIndex::SearchNearest(const FGridStorage& Grid, int32_t X, int32_t Y, EGridCell State, int32_t K, int64_t LimitSq,
+    std::vector<FGridNeighbor>& Best) const
+{
+    Best.clear();
+    const std::vector<uint64_t>& Bits = *GetBits(State);
+    const std::vector<FGridTile>& Tiles = Grid.GetTiles();
+    const int32_t CenterX = X >> FGridStorage::TileShift;
+    const int32_t CenterY = Y >> FGridStorage::TileShift;
+    const int32_t MaxRing = std::max({ CenterX, TilesX - 1 - CenterX, CenterY, TilesY - 1 - CenterY });
+
+    auto GetBound = [&]()
+    {
+        return static_cast<int32_t>(static_cast<int32_t>(Best.size()) < K ? LimitSq : std::min<int64_t>(LimitSq, Best.back().DistanceSq));
+    };
+
+    auto VisitTile = [&](int32_t TileX, int32_t TileY)
+    {
+        const int32_t TileIndex = TileY * TilesX + TileX;
+        const int32_t Bound = GetBound();
+        if (!((Bits[TileIndex >> 6] >> (TileIndex & 63)) & 1u) || GetTileDistanceSq(X, Y, TileX, TileY) > Bound)
+            return;
+
+        uint64_t Mask = GetSpatialTileMask(Tiles[TileIndex], State) & GetSpatialWindowMask(X, Y, TileX, TileY, Bound);
+        while (Mask)
+        {
+            const int32_t Bit = FGridStorage::FindLowestBit(Mask);
+            Mask &= Mask - 1;
+
+            FGridNeighbor Candidate;
+            Candidate.Cell.X = (TileX << FGridStorage::TileShift) | (Bit & FGridStorage::TileMask);
+            Candidate.Cell.Y = (TileY << FGridStorage::TileShift) | (Bit >> FGridStorage::TileShift);
+            const int32_t Dx = Candidate.Cell.X - X;
+            const int32_t Dy = Candidate.Cell.Y - Y;
+            Candidate.DistanceSq = Dx * Dx + Dy * Dy;
+            if (Candidate.DistanceSq > LimitSq)
+                continue;
+            if (static_cast<int32_t>(Best.size()) == K && !IsCloserNeighbor(Candidate, Best.back()))
+                continue;
+
+            Best.insert(std::upper_bound(Best.begin(), Best.end(), Candidate, IsCloserNeighbor), Candidate);
+            if (static_cast<int32_t>(Best.size()) > K)
+                Best.pop_back();
+        }
+    };
+
+    // Ring R holds the tiles R steps from the centre tile, none of their cells is closer than 8 * (R - 1) + 1
+    for (int32_t Ring = 0; Ring <= MaxRing; ++Ring)
+    {
+        const int64_t Closest = Ring == 0 ? 0 : int64_t(FGridStorage::TileSize) * (Ring - 1) + 1;
+        if (Closest * Closest > GetBound())
+            break;
+
+        const int32_t MinTileX = std::max(CenterX - Ring, 0);
+        const int32_t MaxTileX = std::min(CenterX + Ring, TilesX - 1);
+        for (int32_t TileY = std::max(CenterY - Ring, 0); TileY <= std::min(CenterY + Ring, TilesY - 1); ++TileY)
+        {
+            if (TileY == CenterY - Ring || TileY == CenterY + Ring)
+            {
+                for (int32_t TileX = MinTileX; TileX <= MaxTileX; ++TileX)
+                    VisitTile(TileX, TileY);
+            }
+            else
+            {
+                if (CenterX - Ring >= 0)
+                    VisitTile(CenterX - Ring, TileY);
+                if (CenterX + Ring < TilesX)
+                    VisitTile(CenterX + Ring, TileY);
+            }
+        }
+    }
+}
+
+int32_t FGridSpatialIndex::FindNearest(const FGridStorage& Grid, int32_t X, int32_t Y, EGridCell State, int32_t K, int32_t MaxRadius,
+    std::vector<FGridNeighbor>& OutNeighbors) const
+{
+    OutNeighbors.clear();
+    if (!bBuilt || !GetBits(State) || K <= 0 || !Grid.IsValidCell(X, Y))
+        return 0;
+
+    const int64_t LimitSq = GetSpatialLimitSq(MaxRadius);
+    SearchNearest(Grid, X, Y, State, K, LimitSq, OutNeighbors);
+    return static_cast<int32_t>(OutNeighbors.size());
+}
+
+int32_t FGridSpatialIndex::FindInRadius(const FGridStorage& Grid, int32_t X, int32_t Y, int32_t Radius, EGridCell State,
+    std::vector<FGridNeighbor>& OutNeighbors) const
+{
+    const std::vector<uint64_t>* Bits = GetBits(State);
+    if (!bBuilt || !Bits || Radius < 0 || !Grid.IsValidCell(X, Y))
+        return 0;
+
+    // Radius is capped by the grid's diagonal, so the square stays in int32 range
+    Radius = std::min(Radius, Width + Height);
+    const int32_t RadiusSq = Radius * Radius;
+    const size_t FirstAdded = OutNeighbors.size();
+    const std::vector<FGridTile>& Tiles = Grid.GetTiles();
+
+    const int32_t MinTileX = std::max(X - Radius, 0) >> FGridStorage::TileShift;
+    const int32_t MaxTileX = std::min(X + Radius, Width - 1) >> FGridStorage::TileShift;
+    const int32_t MinTileY = std::max(Y - Radius, 0) >> FGridStorage::TileShift;
+    const int32_t MaxTileY = std::min(Y + Radius, Height - 1) >> FGridStorage::TileShift;
+    for (int32_t TileY = MinTileY; TileY <= MaxTileY; ++TileY)
+    {
+        for (int32_t TileX = MinTileX; TileX <= MaxTileX; ++TileX)
+        {
+            const int32_t TileIndex = TileY * TilesX + TileX;
+            if (!(((*Bits)[TileIndex >> 6] >> (TileIndex & 63)) & 1u) || GetTileDistanceSq(X, Y, TileX, TileY) > RadiusSq)
+                continue;
+
+            uint64_t Mask = GetSpatialTileMask(Tiles[TileIndex], State);
+            while (Mask)
+            {
+                const int32_t Bit = FGridStorage::FindLowestBit(Mask);
+                Mask &= Mask - 1;
+
+                FGridNeighbor Found;
+                Found.Cell.X = (TileX << FGridStorage::TileShift) | (Bit & FGridStorage::TileMask);
+                Found.Cell.Y = (TileY << FGridStorage::TileShift) | (Bit >> FGridStorage::TileShift);
+                const int32_t Dx = Found.Cell.X - X;
+                const int32_t Dy = Found.Cell.Y - Y;
+                Found.DistanceSq = Dx * Dx + Dy * Dy;
+                if (Found.DistanceSq <= RadiusSq)
+                    OutNeighbors.push_back(Found);
+            }
+        }
+    }
+    return static_cast<int32_t>(OutNeighbors.size() - FirstAdded);
+}
+
+int32_t FGridSpatialIndex::CountInRadius(const FGridStorage& Grid, int32_t X, int32_t Y, int32_t Radius, EGridCell State) const
+{
+    // A radius query that covers the whole grid is the storage's running total
+    if (bBuilt && GetBits(State) && Radius >= 0 && Grid.IsValidCell(X, Y))
+    {
+        const int64_t FarX = std::max(X, Width - 1 - X);
+        const int64_t FarY = std::max(Y, Height - 1 - Y);
+        if (FarX * FarX + FarY * FarY <= int64_t(Radius) * Radius)
+            return static_cast<int32_t>(Grid.CountCells(State));
+    }
+
+    thread_local std::vector<FGridNeighbor> Found;
+    Found.clear();
+    return FindInRadius(Grid, X, Y, Radius, State, Found);
+}
+
+void FGridSpatialIndex::FindNearestForAll(const FGridStorage& Grid, EGridCell From, EGridCell Target, int32_t MaxRadius,
+    std::vector<FGridNearestPair>& OutPairs, FWorkStealingPool* Pool) const
+{
+    OutPairs.clear();
+    const std::vector<uint64_t>* FromBits = GetBits(From);
+    if (!bBuilt || !FromBits || !GetBits(Target))
+        return;
+
+    const int64_t LimitSq = GetSpatialLimitSq(MaxRadius);
+    const std::vector<FGridTile>& Tiles = Grid.GetTiles();
+
+    // 1. - Every tile row searches on its own, sources in tile order within the row
+    std::vector<std::vector<FGridNearestPair>> RowPairs(TilesY);
+    FWorkStealingPool& Workers = Pool ? *Pool : FWorkStealingPool::Get();
+    Workers.ParallelFor(TilesY, 1, [&](int64_t Begin, int64_t End)
+    {
+        std::vector<FGridNeighbor> Best;
+        for (int32_t TileY = static_cast<int32_t>(Begin); TileY < End; ++TileY)
+        {
+            std::vector<FGridNearestPair>& Pairs = RowPairs[TileY];
+            for (int32_t TileX = 0; TileX < TilesX; ++TileX)
+            {
+                const int32_t TileIndex = TileY * TilesX + TileX;
+                if (!(((*FromBits)[TileIndex >> 6] >> (TileIndex & 63)) & 1u))
+                    continue;
+
+                uint64_t Mask = GetSpatialTileMask(Tiles[TileIndex], From);
+                while (Mask)
+                {
+                    const int32_t Bit = FGridStorage::FindLowestBit(Mask);
+                    Mask &= Mask - 1;
+
+                    FGridNearestPair Pair;
+                    Pair.Source.X = (TileX << FGridStorage::TileShift) | (Bit & FGridStorage::TileMask);
+                    Pair.Source.Y = (TileY << FGridStorage::TileShift) | (Bit >> FGridStorage::TileShift);
+                    SearchNearest(Grid, Pair.Source.X, Pair.Source.Y, Target, 1, LimitSq, Best);
+                    if (!Best.empty())
+                    {
+                        Pair.Target = Best[0].Cell;
+                        Pair.DistanceSq = Best[0].DistanceSq;
+                    }
+                    Pairs.push_back(Pair);
+                }
+            }
+        }
+    });
+
+    // 2. - Rows joined in order so the result does not depend on scheduling
+    size_t NumPairs = 0;
+    for (const std::vector<FGridNearestPair>& Pairs : RowPairs)
+        NumPairs += Pairs.size();
+    OutPairs.reserve(NumPairs);
+    for (const std::vector<FGridNearestPair>& Pairs : RowPairs)
+        OutPairs.insert(OutPairs.end(), Pairs.begin(), Pairs.end());
+}
@@ -0,0 +1,101 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "GridStorage.h"
+#include <cstdint>
+#include <vector>
+
+class FWorkStealingPool;
+
+/** A cell found by a spatial query and its squared distance from the query point. */
+struct FGridNeighbor
+{
+	FGridPoint Cell;
+	int32_t DistanceSq = 0;
+};
+
+/** Result of a batched nearest query, DistanceSq is -1 when Source has no target in range. */
+struct FGridNearestPair
+{
+	FGridPoint Source;
+	FGridPoint Target;
+	int32_t DistanceSq = -1;
+};
+
+/**
+ * Nearest-neighbour and radius queries over the agents on a grid.
+ *
+ * The grid's 8x8 tiles already are occupancy bitmasks per state, so the index
+ * only adds one bit per tile and state marking tiles that hold any such agent.
+ * That bitmap is 1/256th the size of the tiles, so scanning outward through
+ * empty country stays in cache, and only tiles with agents closer than the
+ * best found so far are opened and walked bit by bit.
+ *
+ * Distances are Euclidean between cell centres and ignore fences, ties go to
+ * the lower row-major index so results do not depend on scan order. Only
+ * Human and Zombie can be queried. Queries are const and safe to run from
+ * several threads while nothing writes the grid.
+ */
+class FGridSpatialIndex
+{
+public:
+	/** Marks every occupied tile of Grid. */
+	void Build(const FGridStorage& Grid);
+
+	/** Re-marks the tiles holding ChangedCells. Falls back to Build if the grid was resized. */
+	void Update(const FGridStorage& Grid, const std::vector<FGridPoint>& ChangedCells);
+
+	bool IsBuilt() const { return bBuilt; }
+
+	/** Whether tile TileIndex holds any State agent. */
+	bool IsTileOccupied(EGridCell State, int32_t TileIndex) const
+	{
+		const std::vector<uint64_t>* Bits = GetBits(State);
+		return Bits && ((*Bits)[TileIndex >> 6] >> (TileIndex & 63)) & 1u;
+	}
+
+	/**
+	 * Up to K State cells nearest to (X, Y), closest first, (X, Y) itself included.
+	 * MaxRadius < 0 searches the whole grid. Returns how many were found.
+	 */
+	int32_t FindNearest(const FGridStorage& Grid, int32_t X, int32_t Y, EGridCell State, int32_t K, int32_t MaxRadius,
+		std::vector<FGridNeighbor>& OutNeighbors) const;
+
+	/** Appends every State cell within Radius of (X, Y), in tile order. Returns how many were added. */
+	int32_t FindInRadius(const FGridStorage& Grid, int32_t X, int32_t Y, int32_t Radius, EGridCell State,
+		std::vector<FGridNeighbor>& OutNeighbors) const;
+
+	int32_t CountInRadius(const FGridStorage& Grid, int32_t X, int32_t Y, int32_t Radius, EGridCell State) const;
+
+	/**
+	 * Nearest Target cell within MaxRadius of every From cell, one pair per From cell in tile order.
+	 * Tile rows are split across the pool, the default one unless given.
+	 */
+	void FindNearestForAll(const FGridStorage& Grid, EGridCell From, EGridCell Target, int32_t MaxRadius,
+		std::vector<FGridNearestPair>& OutPairs, FWorkStealingPool* Pool = nullptr) const;
+
+private:
+	const std::vector<uint64_t>* GetBits(EGridCell State) const
+	{
+		return State == EGridCell::Human ? &HumanTiles : State == EGridCell::Zombie ? &ZombieTiles : nullptr;
+	}
+
+	void MarkTile(const FGridStorage& Grid, int32_t TileIndex);
+
+	// Keeps the K best of State in Best, sorted, scanning tile rings outward from (X, Y)
+	void SearchNearest(const FGridStorage& Grid, int32_t X, int32_t Y, EGridCell State, int32_t K, int64_t LimitSq,
+		std::vector<FGridNeighbor>& Best) const;
+
+	// Squared distance from (X, Y) to the closest cell of a tile
+	static int32_t GetTileDistanceSq(int32_t X, int32_t Y, int32_t TileX, int32_t TileY);
+
+	// One bit per tile, row-major over the tiles like FGridStorage
+	std::vector<uint64_t> HumanTiles;
+	std::vector<uint64_t> ZombieTiles;
+	int32_t Width{ 0 };
+	int32_t Height{ 0 };
+	int32_t TilesX{ 0 };
+	int32_t TilesY{ 0 };
+	bool bBuilt{ false };
+};
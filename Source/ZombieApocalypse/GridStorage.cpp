@@ -0,0 +1,296 @@
+// Copyright University of Inland Norway
+
+#include "GridStorage.h"
+#include "SimulationSnapshot.h"
+#include <algorithm>
+
+static void WriteGridBit(uint64_t& Word, uint32_t Bit, bool bValue)
+{
+    Word = (Word & ~(uint64_t(1) << Bit)) | (uint64_t(bValue ? 1 : 0) << Bit);
+}
+
+bool FGridStorage::Init(int32_t InWidth, int32_t InHeight)
+{
+    if (InWidth < 1 || InHeight < 1 || InWidth > MaxDimension || InHeight > MaxDimension)
+        return false;
+
+    Width = InWidth;
+    Height = InHeight;
+    TilesX = (Width + TileMask) >> TileShift;
+    TilesY = (Height + TileMask) >> TileShift;
+
+    Tiles.assign(static_cast<size_t>(TilesX) * TilesY, FGridTile());
+    Tiles.shrink_to_fit();
+    RebuildPopulation();
+    return true;
+}
+
+void FGridStorage::SetCell(int32_t X, int32_t Y, EGridCell State)
+{
+    FGridTile& Tile = GetMutableTile(X, Y);
+    const uint64_t OldHumans = GetHumanMask(Tile);
+    const uint64_t OldZombies = GetZombieMask(Tile);
+
+    const uint32_t Bit = GetBit(X, Y);
+    const uint32_t Value = static_cast<uint32_t>(State);
+    WriteGridBit(Tile.StateLo, Bit, (Value & 1u) != 0);
+    WriteGridBit(Tile.StateHi, Bit, (Value & 2u) != 0);
+
+    UpdatePopulation((Y >> TileShift) * TilesX + (X >> TileShift), OldHumans, OldZombies);
+}
+
+void FGridStorage::SetTileStates(int32_t TileIndex, uint64_t StateLo, uint64_t StateHi)
+{
+    FGridTile& Tile = Tiles[TileIndex];
+    const uint64_t OldHumans = GetHumanMask(Tile);
+    const uint64_t OldZombies = GetZombieMask(Tile);
+    Tile.StateLo = StateLo;
+    Tile.StateHi = StateHi;
+    UpdatePopulation(TileIndex, OldHumans, OldZombies);
+}
+
+void FGridStorage::UpdatePopulation(int32_t TileIndex, uint64_t OldHumans, uint64_t OldZombies)
+{
+    const FGridTile& Tile = Tiles[TileIndex];
+    const int32_t HumanDelta = CountBits(GetHumanMask(Tile)) - CountBits(OldHumans);
+    const int32_t ZombieDelta = CountBits(GetZombieMask(Tile)) - CountBits(OldZombies);
+    if (HumanDelta == 0 && ZombieDelta == 0)
+        return;
+
+    const int32_t TileX = TileIndex % TilesX;
+    const int32_t TileY = TileIndex / TilesX;
+    if (HumanDelta != 0)
+    {
+        NumHumans += HumanDelta;
+        AddToTree(HumanTree, TileX, TileY, HumanDelta);
+    }
+    if (ZombieDelta != 0)
+    {
+        NumZombies += ZombieDelta;
+        AddToTree(ZombieTree, TileX, TileY, ZombieDelta);
+    }
+}
+
+void FGridStorage::RebuildPopulation()
+{
+    // 1. - Per-tile counts in place
+    HumanTree.assign(Tiles.size(), 0);
+    ZombieTree.assign(Tiles.size(), 0);
+    NumHumans = 0;
+    NumZombies = 0;
+    for (size_t TileIndex = 0; TileIndex < Tiles.size(); ++TileIndex)
+    {
+        HumanTree[TileIndex] = CountBits(GetHumanMask(Tiles[TileIndex]));
+        ZombieTree[TileIndex] = CountBits(GetZombieMask(Tiles[TileIndex]));
+        NumHumans += HumanTree[TileIndex];
+        NumZombies += ZombieTree[TileIndex];
+    }
+
+    // 2. - Linear-time Fenwick build, each node pushes its sum to its parent along rows and then along columns
+    for (std::vector<int32_t>* Tree : { &HumanTree, &ZombieTree })
+    {
+        int32_t* Nodes = Tree->data();
+        for (int32_t TileY = 0; TileY < TilesY; ++TileY)
+        {
+            for (int32_t Node = 1; Node <= TilesX; ++Node)
+            {
+                const int32_t Parent = Node + (Node & -Node);
+                if (Parent <= TilesX)
+                    Nodes[TileY * TilesX + Parent - 1] += Nodes[TileY * TilesX + Node - 1];
+            }
+        }
+        for (int32_t Node = 1; Node <= TilesY; ++Node)
+        {
+            const int32_t Parent = Node + (Node & -Node);
+            if (Parent > TilesY)
+                continue;
+            for (int32_t TileX = 0; TileX < TilesX; ++TileX)
+            {
+                Nodes[(Parent - 1) * TilesX + TileX] += Nodes[(Node - 1) * TilesX + TileX];
+            }
+        }
+    }
+}
+
+void FGridStorage::AddToTree(std::vector<int32_t>& Tree, int32_t TileX, int32_t TileY, int32_t Delta)
+{
+    for (int32_t NodeY = TileY + 1; NodeY <= TilesY; NodeY += NodeY & -NodeY)
+    {
+        for (int32_t NodeX = TileX + 1; NodeX <= TilesX; NodeX += NodeX & -NodeX)
+        {
+            Tree[(NodeY - 1) * TilesX + NodeX - 1] += Delta;
+        }
+    }
+}
+
+int64_t FGridStorage::SumTree(const std::vector<int32_t>& Tree, int32_t TileX, int32_t TileY) const
+{
+    // Tiles [0, TileX] x [0, TileY], empty when either is negative
+    int64_t Sum = 0;
+    for (int32_t NodeY = TileY + 1; NodeY > 0; NodeY -= NodeY & -NodeY)
+    {
+        for (int32_t NodeX = TileX + 1; NodeX > 0; NodeX -= NodeX & -NodeX)
+        {
+            Sum += Tree[(NodeY - 1) * TilesX + NodeX - 1];
+        }
+    }
+    return Sum;
+}
+
+int64_t FGridStorage::CountCells(EGridCell State) const
+{
+    switch (State)
+    {
+    case EGridCell::Human:  return NumHumans;
+    case EGridCell::Zombie: return NumZombies;
+    default:                return static_cast<int64_t>(GetNumCells()) - NumHumans - NumZombies;
+    }
+}
+
+int64_t FGridStorage::CountCellsInRect(EGridCell State, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY) const
+{
+    MinX = std::max(MinX, 0);
+    MinY = std::max(MinY, 0);
+    MaxX = std::min(MaxX, Width - 1);
+    MaxY = std::min(MaxY, Height - 1);
+    if (MinX > MaxX || MinY > MaxY)
+        return 0;
+
+    if (State != EGridCell::Human && State != EGridCell::Zombie)
+    {
+        const int64_t Area = static_cast<int64_t>(MaxX - MinX + 1) * (MaxY - MinY + 1);
+        return Area - CountCellsInRect(EGridCell::Human, MinX, MinY, MaxX, MaxY) - CountCellsInRect(EGridCell::Zombie, MinX, MinY, MaxX, MaxY);
+    }
+    const bool bHumans = State == EGridCell::Human;
+    const std::vector<int32_t>& Tree = bHumans ? HumanTree : ZombieTree;
+
+    // 1. - Tiles the rectangle covers completely, the padding past the map edge holds no agents so edge tiles count as covered
+    const int32_t FullX0 = (MinX + TileMask) >> TileShift;
+    const int32_t FullY0 = (MinY + TileMask) >> TileShift;
+    const int32_t FullX1 = MaxX == Width - 1 ? TilesX - 1 : ((MaxX + 1) >> TileShift) - 1;
+    const int32_t FullY1 = MaxY == Height - 1 ? TilesY - 1 : ((MaxY + 1) >> TileShift) - 1;
+    const bool bHasFull = FullX0 <= FullX1 && FullY0 <= FullY1;
+
+    int64_t Count = 0;
+    if (bHasFull)
+    {
+        Count += SumTree(Tree, FullX1, FullY1) - SumTree(Tree, FullX0 - 1, FullY1)
+            - SumTree(Tree, FullX1, FullY0 - 1) + SumTree(Tree, FullX0 - 1, FullY0 - 1);
+    }
+
+    // 2. - The ring of partly covered tiles, one masked popcount each
+    auto CountPartialTile = [&](int32_t TileX, int32_t TileY)
+    {
+        const int32_t LocalX0 = std::max(MinX - (TileX << TileShift), 0);
+        const int32_t LocalX1 = std::min(MaxX - (TileX << TileShift), TileMask);
+        const int32_t LocalY0 = std::max(MinY - (TileY << TileShift), 0);
+        const int32_t LocalY1 = std::min(MaxY - (TileY << TileShift), TileMask);
+
+        const uint64_t RowBits = ((uint64_t(1) << (LocalX1 - LocalX0 + 1)) - 1) << LocalX0;
+        const uint64_t Rows = (~uint64_t(0) >> (8 * (TileMask - LocalY1))) & (~uint64_t(0) << (8 * LocalY0));
+        const uint64_t Mask = Rows & (RowBits * 0x0101010101010101ull);
+
+        const FGridTile& Tile = Tiles[TileY * TilesX + TileX];
+        return CountBits((bHumans ? GetHumanMask(Tile) : GetZombieMask(Tile)) & Mask);
+    };
+
+    const int32_t TileX0 = MinX >> TileShift;
+    const int32_t TileX1 = MaxX >> TileShift;
+    for (int32_t TileY = MinY >> TileShift; TileY <= (MaxY >> TileShift); ++TileY)
+    {
+        if (bHasFull && TileY >= FullY0 && TileY <= FullY1)
+        {
+            for (int32_t TileX = TileX0; TileX < FullX0; ++TileX) Count += CountPartialTile(TileX, TileY);
+            for (int32_t TileX = FullX1 + 1; TileX <= TileX1; ++TileX) Count += CountPartialTile(TileX, TileY);
+        }
+        else
+        {
+            for (int32_t TileX = TileX0; TileX <= TileX1; ++TileX) Count += CountPartialTile(TileX, TileY);
+        }
+    }
+    return Count;
+}
+
+void FGridStorage::SetFenceUp(int32_t X, int32_t Y, bool bFence)
+{
+    WriteGridBit(GetMutableTile(X, Y).FenceUp, GetBit(X, Y), bFence);
+}
+
+void FGridStorage::SetFenceRight(int32_t X, int32_t Y, bool bFence)
+{
+    WriteGridBit(GetMutableTile(X, Y).FenceRight, GetBit(X, Y), bFence);
+}
+
+void FGridStorage::PlaceFence(int32_t CellX, int32_t CellY, EGridEdge Edge)
+{
+    switch (Edge)
+    {
+    case EGridEdge::Top:
+        if (IsValidCell(CellX, CellY))
+            SetFenceUp(CellX, CellY, true);
+        break;
+    case EGridEdge::Bottom:
+        if (IsValidCell(CellX, CellY - 1))
+            SetFenceUp(CellX, CellY - 1, true);
+        break;
+    case EGridEdge::Left:
+        if (IsValidCell(CellX - 1, CellY))
+            SetFenceRight(CellX - 1, CellY, true);
+        break;
+    case EGridEdge::Right:
+        if (IsValidCell(CellX, CellY))
+            SetFenceRight(CellX, CellY, true);
+        break;
+    }
+}
+
+int32_t FGridStorage::GetNeighbors(int32_t X, int32_t Y, FGridPoint OutNeighbors[4]) const
+{
+    static const int32_t Dx[4] = { -1, 1, 0, 0 };
+    static const int32_t Dy[4] = { 0, 0, -1, 1 };
+
+    int32_t Count = 0;
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const int32_t Nx = X + Dx[i];
+        const int32_t Ny = Y + Dy[i];
+        if (CanMoveBetweenCells(X, Y, Nx, Ny))
+            OutNeighbors[Count++] = { Nx, Ny };
+    }
+    return Count;
+}
+
+size_t FGridStorage::EstimateMemoryFootprintBytes(int32_t InWidth, int32_t InHeight)
+{
+    const size_t NumTiles = static_cast<size_t>((InWidth + TileMask) >> TileShift) * static_cast<size_t>((InHeight + TileMask) >> TileShift);
+    return sizeof(FGridStorage) + NumTiles * (sizeof(FGridTile) + 2 * sizeof(int32_t));
+}
+
+void FGridStorage::SaveState(FSnapshotWriter& Writer) const
+{
+    Writer.Write(Width);
+    Writer.Write(Height);
+    Writer.WriteArray(Tiles);
+}
+
+bool FGridStorage::LoadState(FSnapshotReader& Reader)
+{
+    int32_t LoadedWidth = 0;
+    int32_t LoadedHeight = 0;
+    if (!Reader.Read(LoadedWidth) || !Reader.Read(LoadedHeight))
+        return false;
+
+    FGridStorage Loaded;
+    if (!Loaded.Init(LoadedWidth, LoadedHeight))
+        return false;
+
+    const size_t NumTiles = Loaded.Tiles.size();
+    if (!Reader.ReadArray(Loaded.Tiles, NumTiles) || Loaded.Tiles.size() != NumTiles)
+        return false;
+
+    // Derived from the tiles, so snapshots stay the same size
+    Loaded.RebuildPopulation();
+
+    *this = std::move(Loaded);
+    return true;
+}
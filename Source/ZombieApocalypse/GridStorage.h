@@ -0,0 +1,223 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+	#include <intrin.h>
+#endif
+
+class FSnapshotReader;
+class FSnapshotWriter;
+
+/**
+ * Engine-free, bit-packed storage behind AGridManager.
+ *
+ * The grid is cut into 8x8 tiles of 32 bytes each: the 2-bit cell states as two
+ * 64-bit planes plus one 64-bit fence mask per edge direction, so two tiles share
+ * a cache line and a move check touches at most two tiles. A 4096x4096 map is
+ * 8 MB. Mirrors ECellState / EEdgeDirection without depending on UObject.
+ *
+ * Every cell write also keeps the population counts current: a total per state,
+ * and per-tile human and zombie counts in a 2D Fenwick tree, so region counts
+ * never scan the cells they cover.
+ */
+
+enum class EGridCell : uint8_t
+{
+	Empty = 0,
+	Human = 1,
+	Zombie = 2
+};
+
+enum class EGridEdge : uint8_t
+{
+	Top,
+	Bottom,
+	Left,
+	Right
+};
+
+struct FGridPoint
+{
+	int32_t X = 0;
+	int32_t Y = 0;
+
+	bool operator==(const FGridPoint& Other) const { return X == Other.X && Y == Other.Y; }
+	bool operator!=(const FGridPoint& Other) const { return !(*this == Other); }
+};
+
+struct alignas(32) FGridTile
+{
+	uint64_t StateLo = 0;   // bit 0 of each cell's EGridCell
+	uint64_t StateHi = 0;   // bit 1 of each cell's EGridCell
+	uint64_t FenceUp = 0;   // fence between (x, y) and (x, y + 1), the old HorizontalFence
+	uint64_t FenceRight = 0;// fence between (x, y) and (x + 1, y), the old VerticalFence
+};
+
+class FGridStorage
+{
+public:
+	static constexpr int32_t TileShift = 3;
+	static constexpr int32_t TileSize = 1 << TileShift;
+	static constexpr int32_t TileMask = TileSize - 1;
+	static constexpr int32_t MaxDimension = 4096;
+
+	/** Resizes to Width x Height, all cells Empty and no fences. False if a side is outside [1, MaxDimension]. */
+	bool Init(int32_t InWidth, int32_t InHeight);
+
+	int32_t GetWidth() const { return Width; }
+	int32_t GetHeight() const { return Height; }
+	int32_t GetNumCells() const { return Width * Height; }
+	int32_t GetTilesX() const { return TilesX; }
+	int32_t GetTilesY() const { return TilesY; }
+
+	/** Row-major cell index, the flat index AGridManager has always used. */
+	int32_t GetIndex(int32_t X, int32_t Y) const { return X + Y * Width; }
+
+	bool IsValidCell(int32_t X, int32_t Y) const
+	{
+		return static_cast<uint32_t>(X) < static_cast<uint32_t>(Width) && static_cast<uint32_t>(Y) < static_cast<uint32_t>(Height);
+	}
+
+	EGridCell GetCell(int32_t X, int32_t Y) const
+	{
+		const FGridTile& Tile = GetTile(X, Y);
+		const uint32_t Bit = GetBit(X, Y);
+		return static_cast<EGridCell>(((Tile.StateLo >> Bit) & 1u) | (((Tile.StateHi >> Bit) & 1u) << 1));
+	}
+
+	void SetCell(int32_t X, int32_t Y, EGridCell State);
+
+	/** Overwrites all 64 cell states of a tile at once, fences are kept. */
+	void SetTileStates(int32_t TileIndex, uint64_t StateLo, uint64_t StateHi);
+
+	/** Cells in State on the whole grid, O(1). */
+	int64_t CountCells(EGridCell State) const;
+
+	/**
+	 * Cells in State inside [MinX, MaxX] x [MinY, MaxY], clamped to the grid. Whole tiles
+	 * come from the Fenwick tree in O(log^2 tiles), the tiles the border cuts through
+	 * cost one masked popcount each.
+	 */
+	int64_t CountCellsInRect(EGridCell State, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY) const;
+
+	/** Set bits in a state plane or mask, a single instruction where the target has one. */
+	static int32_t CountBits(uint64_t Mask)
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+		return static_cast<int32_t>(__popcnt64(Mask));
+#elif defined(__GNUC__) || defined(__clang__)
+		return __builtin_popcountll(Mask);
+#else
+		return static_cast<int32_t>(std::bitset<64>(Mask).count());
+#endif
+	}
+
+	/** Index of the lowest set bit, Mask must not be zero. */
+	static int32_t FindLowestBit(uint64_t Mask)
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+		unsigned long Index;
+		_BitScanForward64(&Index, Mask);
+		return static_cast<int32_t>(Index);
+#elif defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctzll(Mask);
+#else
+		return CountBits((Mask & (0 - Mask)) - 1);
+#endif
+	}
+
+	/** Human and zombie bits of a tile's state planes. */
+	static uint64_t GetHumanMask(const FGridTile& Tile) { return Tile.StateLo & ~Tile.StateHi; }
+	static uint64_t GetZombieMask(const FGridTile& Tile) { return Tile.StateHi & ~Tile.StateLo; }
+
+	static bool IsWalkable(EGridCell State) { return State != EGridCell::Zombie; }
+
+	bool HasFenceUp(int32_t X, int32_t Y) const { return (GetTile(X, Y).FenceUp >> GetBit(X, Y)) & 1u; }
+	bool HasFenceRight(int32_t X, int32_t Y) const { return (GetTile(X, Y).FenceRight >> GetBit(X, Y)) & 1u; }
+	void SetFenceUp(int32_t X, int32_t Y, bool bFence);
+	void SetFenceRight(int32_t X, int32_t Y, bool bFence);
+
+	/** Same edge rules as AGridManager::PlaceFence, edges off the map are ignored. */
+	void PlaceFence(int32_t CellX, int32_t CellY, EGridEdge Edge);
+
+	/** The two cells an edge of (CellX, CellY) separates, lower / left one first. Either may be off the map. */
+	static void GetEdgeCells(int32_t CellX, int32_t CellY, EGridEdge Edge, FGridPoint& OutA, FGridPoint& OutB)
+	{
+		OutA = { CellX, CellY };
+		OutB = { CellX, CellY };
+		switch (Edge)
+		{
+		case EGridEdge::Top:    OutB.Y += 1; break;
+		case EGridEdge::Bottom: OutA.Y -= 1; break;
+		case EGridEdge::Left:   OutA.X -= 1; break;
+		case EGridEdge::Right:  OutB.X += 1; break;
+		}
+	}
+
+	bool IsEdgeBlockedByFence(int32_t X1, int32_t Y1, int32_t X2, int32_t Y2) const
+	{
+		if (!IsValidCell(X1, Y1) || !IsValidCell(X2, Y2))
+			return true;
+
+		if (X1 == X2)
+			return HasFenceUp(X1, Y1 < Y2 ? Y1 : Y2);
+		if (Y1 == Y2)
+			return HasFenceRight(X1 < X2 ? X1 : X2, Y1);
+		return true;
+	}
+
+	bool CanMoveBetweenCells(int32_t FromX, int32_t FromY, int32_t ToX, int32_t ToY) const
+	{
+		return IsValidCell(ToX, ToY)
+			&& !IsEdgeBlockedByFence(FromX, FromY, ToX, ToY)
+			&& IsWalkable(GetCell(ToX, ToY));
+	}
+
+	/** Writes the reachable 4-neighbours of (X, Y) in -X, +X, -Y, +Y order, returns how many. */
+	int32_t GetNeighbors(int32_t X, int32_t Y, FGridPoint OutNeighbors[4]) const;
+
+	const std::vector<FGridTile>& GetTiles() const { return Tiles; }
+	const FGridTile& GetTile(int32_t X, int32_t Y) const { return Tiles[(Y >> TileShift) * TilesX + (X >> TileShift)]; }
+	static uint32_t GetBit(int32_t X, int32_t Y) { return static_cast<uint32_t>(((Y & TileMask) << TileShift) | (X & TileMask)); }
+
+	/** Dimensions and every tile as is, a 4096x4096 grid is the same 8 MB on disk. */
+	void SaveState(FSnapshotWriter& Writer) const;
+
+	/** Resizes to the saved dimensions. A failed load leaves the grid as it was. */
+	bool LoadState(FSnapshotReader& Reader);
+
+	/** Bytes held by this grid, and what a grid of the given size would take. */
+	size_t GetMemoryFootprintBytes() const
+	{
+		return sizeof(*this) + Tiles.capacity() * sizeof(FGridTile) + (HumanTree.capacity() + ZombieTree.capacity()) * sizeof(int32_t);
+	}
+	static size_t EstimateMemoryFootprintBytes(int32_t InWidth, int32_t InHeight);
+
+private:
+	FGridTile& GetMutableTile(int32_t X, int32_t Y) { return Tiles[(Y >> TileShift) * TilesX + (X >> TileShift)]; }
+
+	// Moves the counts of one tile from its old planes to its current ones
+	void UpdatePopulation(int32_t TileIndex, uint64_t OldHumans, uint64_t OldZombies);
+	void RebuildPopulation();
+	void AddToTree(std::vector<int32_t>& Tree, int32_t TileX, int32_t TileY, int32_t Delta);
+	int64_t SumTree(const std::vector<int32_t>& Tree, int32_t TileX, int32_t TileY) const;
+
+	std::vector<FGridTile> Tiles;
+
+	// Fenwick trees over the tiles, TilesX x TilesY row-major
+	std::vector<int32_t> HumanTree;
+	std::vector<int32_t> ZombieTree;
+	int64_t NumHumans{ 0 };
+	int64_t NumZombies{ 0 };
+
+	int32_t Width{ 0 };
+	int32_t Height{ 0 };
+	int32_t TilesX{ 0 };
+	int32_t TilesY{ 0 };
+};
@@ -0,0 +1,132 @@
+// Copyright University of Inland Norway
+
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+    #if defined(WITH_ENGINE)
+        // Inside the module this file may share a unity blob with engine code
+        #include "Windows/WindowsHWrapper.h"
+    #else
+        #define WIN32_LEAN_AND_MEAN
+        #define NOMINMAX
+        #include <windows.h>
+    #endif
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+static bool WidenMappedPath(const std::string& Path, std::wstring& OutWide)
+{
+    const int WideLength = MultiByteToWideChar(CP_UTF8, 0, Path.c_str(), -1, nullptr, 0);
+    OutWide.assign(WideLength > 0 ? WideLength : 0, L'\0');
+    return WideLength > 0 && MultiByteToWideChar(CP_UTF8, 0, Path.c_str(), -1, &OutWide[0], WideLength) != 0;
+}
+#endif
+
+std::FILE* OpenUtf8File(const std::string& Path, const char* Mode)
+{
+#if defined(_WIN32)
+    std::wstring WidePath;
+    std::wstring WideMode;
+    if (!WidenMappedPath(Path, WidePath) || !WidenMappedPath(Mode, WideMode))
+        return nullptr;
+    return _wfopen(WidePath.c_str(), WideMode.c_str());
+#else
+    return std::fopen(Path.c_str(), Mode);
+#endif
+}
+
+bool FMappedFile::Open(const std::string& Path, std::string* OutError)
+{
+    Close();
+
+    auto Fail = [&](const char* Reason)
+    {
+        if (OutError) *OutError = std::string(Reason) + " " + Path;
+        return false;
+    };
+
+#if defined(_WIN32)
+    std::wstring WidePath;
+    if (!WidenMappedPath(Path, WidePath))
+        return Fail("invalid path");
+
+    HANDLE File = CreateFileW(WidePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return Fail("cannot open");
+
+    LARGE_INTEGER FileSize;
+    if (!GetFileSizeEx(File, &FileSize))
+    {
+        CloseHandle(File);
+        return Fail("cannot stat");
+    }
+
+    if (FileSize.QuadPart > 0)
+    {
+        // The view keeps the mapping alive, both handles can go right away
+        HANDLE Mapping = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* View = Mapping ? MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (Mapping)
+        {
+            CloseHandle(Mapping);
+        }
+        if (!View)
+        {
+            CloseHandle(File);
+            return Fail("cannot map");
+        }
+        Data = static_cast<const uint8_t*>(View);
+        Size = static_cast<size_t>(FileSize.QuadPart);
+    }
+    CloseHandle(File);
+#else
+    const int File = ::open(Path.c_str(), O_RDONLY);
+    if (File < 0)
+        return Fail("cannot open");
+
+    struct stat Stat;
+    if (::fstat(File, &Stat) != 0)
+    {
+        ::close(File);
+        return Fail("cannot stat");
+    }
+
+    if (Stat.st_size > 0)
+    {
+        // The mapping outlives the descriptor
+        void* View = ::mmap(nullptr, static_cast<size_t>(Stat.st_size), PROT_READ, MAP_PRIVATE, File, 0);
+        if (View == MAP_FAILED)
+        {
+            ::close(File);
+            return Fail("cannot map");
+        }
+        ::madvise(View, static_cast<size_t>(Stat.st_size), MADV_SEQUENTIAL);
+        Data = static_cast<const uint8_t*>(View);
+        Size = static_cast<size_t>(Stat.st_size);
+    }
+    ::close(File);
+#endif
+
+    bOpen = true;
+    return true;
+}
+
+void FMappedFile::Close()
+{
+    if (Data)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(Data);
+#else
+        ::munmap(const_cast<uint8_t*>(Data), Size);
+#endif
+    }
+    Data = nullptr;
+    Size = 0;
+    bOpen = false;
+}
@@ -0,0 +1,41 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file.
+ *
+ * Pages are faulted in by the OS as they are touched, so opening a file of any
+ * size is cheap and only what is read ends up resident. Empty files open with
+ * a null GetData and size 0.
+ */
+class FMappedFile
+{
+public:
+	FMappedFile() = default;
+	~FMappedFile() { Close(); }
+
+	FMappedFile(const FMappedFile&) = delete;
+	FMappedFile& operator=(const FMappedFile&) = delete;
+
+	/** Path is UTF-8. False if the file cannot be opened or mapped. */
+	bool Open(const std::string& Path, std::string* OutError = nullptr);
+	void Close();
+
+	bool IsOpen() const { return bOpen; }
+	const uint8_t* GetData() const { return Data; }
+	size_t GetSize() const { return Size; }
+
+private:
+	const uint8_t* Data{ nullptr };
+	size_t Size{ 0 };
+	bool bOpen{ false };
+};
+
+/** std::fopen for a UTF-8 Path; on Windows it goes through _wfopen, since fopen reads paths in the ANSI code page. */
+std::FILE* OpenUtf8File(const std::string& Path, const char* Mode);
@@ -0,0 +1,360 @@
+// Copyright University of Inland Norway
+
+#include "SDBatchEngine.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define SDBATCH_AVX2 1
+#elif defined(__SSE4_1__)
+    #include <smmintrin.h>
+    #define SDBATCH_SSE4 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SDBATCH_SSE2 1
+#endif
+
+// Thin wrapper so the step kernel is written once for every instruction set.
+// Min and Max take their arguments in std::min / std::max order and keep their
+// exact semantics, which is what keeps the lanes identical to FSDEngine.
+#if SDBATCH_AVX2
+
+struct FSDVec
+{
+    static constexpr int32_t Width = 8;
+    __m256 V;
+
+    static FSDVec Load(const float* P) { return { _mm256_loadu_ps(P) }; }
+    static FSDVec Set1(float F) { return { _mm256_set1_ps(F) }; }
+    void Store(float* P) const { _mm256_storeu_ps(P, V); }
+
+    friend FSDVec operator+(FSDVec A, FSDVec B) { return { _mm256_add_ps(A.V, B.V) }; }
+    friend FSDVec operator-(FSDVec A, FSDVec B) { return { _mm256_sub_ps(A.V, B.V) }; }
+    friend FSDVec operator*(FSDVec A, FSDVec B) { return { _mm256_mul_ps(A.V, B.V) }; }
+    friend FSDVec operator/(FSDVec A, FSDVec B) { return { _mm256_div_ps(A.V, B.V) }; }
+
+    static FSDVec Min(FSDVec A, FSDVec B) { return { _mm256_min_ps(B.V, A.V) }; }
+    static FSDVec Max(FSDVec A, FSDVec B) { return { _mm256_max_ps(B.V, A.V) }; }
+    static FSDVec Floor(FSDVec A) { return { _mm256_floor_ps(A.V) }; }
+
+    static FSDVec Greater(FSDVec A, FSDVec B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_GT_OQ) }; }
+    static FSDVec Less(FSDVec A, FSDVec B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_LT_OQ) }; }
+    static FSDVec LessEqual(FSDVec A, FSDVec B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_LE_OQ) }; }
+
+    // Mask ? A : B
+    static FSDVec Select(FSDVec Mask, FSDVec A, FSDVec B) { return { _mm256_blendv_ps(B.V, A.V, Mask.V) }; }
+};
+
+#elif SDBATCH_SSE4 || SDBATCH_SSE2
+
+struct FSDVec
+{
+    static constexpr int32_t Width = 4;
+    __m128 V;
+
+    static FSDVec Load(const float* P) { return { _mm_loadu_ps(P) }; }
+    static FSDVec Set1(float F) { return { _mm_set1_ps(F) }; }
+    void Store(float* P) const { _mm_storeu_ps(P, V); }
+
+    friend FSDVec operator+(FSDVec A, FSDVec B) { return { _mm_add_ps(A.V, B.V) }; }
+    friend FSDVec operator-(FSDVec A, FSDVec B) { return { _mm_sub_ps(A.V, B.V) }; }
+    friend FSDVec operator*(FSDVec A, FSDVec B) { return { _mm_mul_ps(A.V, B.V) }; }
+    friend FSDVec operator/(FSDVec A, FSDVec B) { return { _mm_div_ps(A.V, B.V) }; }
+
+    static FSDVec Min(FSDVec A, FSDVec B) { return { _mm_min_ps(B.V, A.V) }; }
+    static FSDVec Max(FSDVec A, FSDVec B) { return { _mm_max_ps(B.V, A.V) }; }
+
+    static FSDVec Greater(FSDVec A, FSDVec B) { return { _mm_cmpgt_ps(A.V, B.V) }; }
+    static FSDVec Less(FSDVec A, FSDVec B) { return { _mm_cmplt_ps(A.V, B.V) }; }
+    static FSDVec LessEqual(FSDVec A, FSDVec B) { return { _mm_cmple_ps(A.V, B.V) }; }
+
+#if SDBATCH_SSE4
+    static FSDVec Floor(FSDVec A) { return { _mm_floor_ps(A.V) }; }
+    static FSDVec Select(FSDVec Mask, FSDVec A, FSDVec B) { return { _mm_blendv_ps(B.V, A.V, Mask.V) }; }
+#else
+    static FSDVec Select(FSDVec Mask, FSDVec A, FSDVec B)
+    {
+        return { _mm_or_ps(_mm_and_ps(Mask.V, A.V), _mm_andnot_ps(Mask.V, B.V)) };
+    }
+
+    static FSDVec Floor(FSDVec A)
+    {
+        // Truncate, step down where that rounded up, and leave |x| >= 2^23 alone (already whole)
+        const __m128 Truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(A.V));
+        const __m128 RoundedUp = _mm_and_ps(_mm_cmpgt_ps(Truncated, A.V), _mm_set1_ps(1.f));
+        const __m128 Floored = _mm_sub_ps(Truncated, RoundedUp);
+        const __m128 AbsA = _mm_andnot_ps(_mm_set1_ps(-0.f), A.V);
+        const __m128 Small = _mm_cmplt_ps(AbsA, _mm_set1_ps(8388608.f));
+        return Select({ Small }, { Floored }, A);
+    }
+#endif
+};
+
+#else
+
+// No SIMD available, one lane per "vector" and the compiler does what it can
+struct FSDVec
+{
+    static constexpr int32_t Width = 1;
+    float V;
+
+    static FSDVec Load(const float* P) { return { *P }; }
+    static FSDVec Set1(float F) { return { F }; }
+    void Store(float* P) const { *P = V; }
+
+    friend FSDVec operator+(FSDVec A, FSDVec B) { return { A.V + B.V }; }
+    friend FSDVec operator-(FSDVec A, FSDVec B) { return { A.V - B.V }; }
+    friend FSDVec operator*(FSDVec A, FSDVec B) { return { A.V * B.V }; }
+    friend FSDVec operator/(FSDVec A, FSDVec B) { return { A.V / B.V }; }
+
+    static FSDVec Min(FSDVec A, FSDVec B) { return { std::min(A.V, B.V) }; }
+    static FSDVec Max(FSDVec A, FSDVec B) { return { std::max(A.V, B.V) }; }
+    static FSDVec Floor(FSDVec A) { return { std::floor(A.V) }; }
+
+    static FSDVec Greater(FSDVec A, FSDVec B) { return { A.V > B.V ? 1.f : 0.f }; }
+    static FSDVec Less(FSDVec A, FSDVec B) { return { A.V < B.V ? 1.f : 0.f }; }
+    static FSDVec LessEqual(FSDVec A, FSDVec B) { return { A.V <= B.V ? 1.f : 0.f }; }
+    static FSDVec Select(FSDVec Mask, FSDVec A, FSDVec B) { return { Mask.V != 0.f ? A.V : B.V }; }
+};
+
+#endif
+
+int32_t FSDBatchEngine::GetLaneWidth()
+{
+    return FSDVec::Width;
+}
+
+const char* FSDBatchEngine::GetInstructionSet()
+{
+#if SDBATCH_AVX2
+    return "AVX2";
+#elif SDBATCH_SSE4
+    return "SSE4.1";
+#elif SDBATCH_SSE2
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
+
+bool FSDBatchEngine::SetGraph(const std::vector<std::pair<float, float>>& GraphPts, std::string* OutError)
+{
+    FDensityEffectCurve Curve;
+    if (!Curve.Build(GraphPts, 0, OutError))
+        return false;
+
+    SetCurve(Curve);
+    return true;
+}
+
+void FSDBatchEngine::SetCurve(const FDensityEffectCurve& Curve)
+{
+    CurveX = Curve.GetX();
+    CurveY = Curve.GetY();
+}
+
+void FSDBatchEngine::Reset(const std::vector<FSDParams>& Scenarios, const FSDState& InitialState)
+{
+    NumScenarios = static_cast<int32_t>(Scenarios.size());
+    Stride = (NumScenarios + FSDVec::Width - 1) / FSDVec::Width * FSDVec::Width;
+    Day = 0;
+
+    // Padding lanes get harmless parameters so they never produce NaNs
+    BittenCapacity.assign(Stride, 0.f);
+    NormalNumberOfBites.assign(Stride, 0.f);
+    LandArea.assign(Stride, 1.f);
+    NormalPopulationDensity.assign(Stride, 1.f);
+    DelaySteps.assign(Stride, 1);
+
+    RingSize = 1;
+    for (int32_t i = 0; i < NumScenarios; ++i)
+    {
+        const FSDParams& Params = Scenarios[i];
+        BittenCapacity[i] = Params.BittenCapacity;
+        NormalNumberOfBites[i] = Params.NormalNumberOfBites;
+        LandArea[i] = Params.LandArea;
+        NormalPopulationDensity[i] = Params.NormalPopulationDensity;
+
+        // A batch leaves on the first step its remaining days drop to <= 0
+        const float Delay = std::min(std::ceil(Params.DaysToBecomeInfectedFromBite), static_cast<float>(MaxDelayDays));
+        DelaySteps[i] = std::max(1, static_cast<int32_t>(Delay));
+        RingSize = std::max(RingSize, DelaySteps[i]);
+    }
+
+    bUniformDelay = true;
+    for (int32_t i = 1; i < NumScenarios; ++i)
+    {
+        bUniformDelay &= DelaySteps[i] == DelaySteps[0];
+    }
+
+    // Lanes normally agree on rounding. A mixed batch steps as whole people and masks the rounding off in
+    // the fractional lanes, slower than either pure variant but still exact per lane
+    bWholePeople = NumScenarios == 0;
+    bMixedRounding = false;
+    WholePeopleLanes.assign(Stride, 1.f);
+    for (int32_t i = 0; i < NumScenarios; ++i)
+    {
+        WholePeopleLanes[i] = Scenarios[i].bWholePeople ? 1.f : 0.f;
+        bWholePeople |= Scenarios[i].bWholePeople;
+        bMixedRounding |= Scenarios[i].bWholePeople != Scenarios[0].bWholePeople;
+    }
+
+    // Susceptible plus the conveyor never grows, so in whole people a capacity of at least the starting
+    // Susceptible never clamps; floats count whole people exactly up to 2^24
+    bCapacityLimit = false;
+    for (int32_t i = 0; i < NumScenarios; ++i)
+    {
+        const bool bNeverBinds = std::isinf(BittenCapacity[i])
+            || (Scenarios[i].bWholePeople && InitialState.Susceptible <= 16777216.f && BittenCapacity[i] >= InitialState.Susceptible);
+        bCapacityLimit |= !bNeverBinds;
+    }
+
+    Susceptible.assign(Stride, 0.f);
+    Bitten.assign(Stride, 0.f);
+    Zombies.assign(Stride, 0.f);
+    std::fill(Susceptible.begin(), Susceptible.begin() + NumScenarios, InitialState.Susceptible);
+    std::fill(Zombies.begin(), Zombies.begin() + NumScenarios, InitialState.Zombies);
+
+    // Like FSDEngine::Reset the conveyor starts empty, so Bitten starts at 0
+    Slots.assign(static_cast<size_t>(RingSize) * Stride, 0.f);
+    Inflow.assign(Stride, 0.f);
+    RingHead = 0;
+}
+
+FSDState FSDBatchEngine::GetState(int32_t Scenario) const
+{
+    FSDState State;
+    State.Susceptible = Susceptible[Scenario];
+    State.Bitten = Bitten[Scenario];
+    State.Zombies = Zombies[Scenario];
+    State.Day = Day;
+    return State;
+}
+
+void FSDBatchEngine::Run(int32_t NumDays)
+{
+    for (int32_t i = 0; i < NumDays; ++i)
+    {
+        Step();
+    }
+}
+
+void FSDBatchEngine::Step()
+{
+    DispatchSDStepPolicy(bWholePeople, bCapacityLimit, [this](auto Policy)
+    {
+        StepLanes<decltype(Policy)>();
+    });
+}
+
+template <typename TPolicy>
+void FSDBatchEngine::StepLanes()
+{
+    const FSDVec Zero = FSDVec::Set1(0.f);
+    const FSDVec One = FSDVec::Set1(1.f);
+    const FSDVec Half = FSDVec::Set1(0.5f);
+
+    const int32_t NumPts = static_cast<int32_t>(CurveX.size());
+
+    float* OutSlot = Slots.data() + static_cast<size_t>(RingHead) * Stride;
+    const int32_t NextHead = RingHead + 1 == RingSize ? 0 : RingHead + 1;
+
+    // With one shared delay the inflow can go straight into its slot
+    float* InSlot = Inflow.data();
+    if (bUniformDelay)
+    {
+        const int32_t Target = (RingHead + DelaySteps[0]) % RingSize;
+        InSlot = Slots.data() + static_cast<size_t>(Target) * Stride;
+    }
+
+    for (int32_t i = 0; i < Stride; i += FSDVec::Width)
+    {
+        FSDVec S = FSDVec::Load(Susceptible.data() + i);
+        FSDVec Z = FSDVec::Load(Zombies.data() + i);
+        const FSDVec B = FSDVec::Load(Bitten.data() + i);
+
+        // 2. - Auxiliaries
+        const FSDVec NonZombiePopulation = B + S;
+        const FSDVec PopulationDensity = NonZombiePopulation / FSDVec::Load(LandArea.data() + i);
+        const FSDVec X = PopulationDensity / FSDVec::Load(NormalPopulationDensity.data() + i);
+
+        // Branch-free piecewise linear lookup: walk the breakpoints and keep the segment X is past
+        FSDVec DensityEffect = Zero;
+        if (NumPts > 0)
+        {
+            FSDVec X0 = FSDVec::Set1(CurveX[0]);
+            FSDVec Y0 = FSDVec::Set1(CurveY[0]);
+            FSDVec X1 = FSDVec::Set1(CurveX[std::min(1, NumPts - 1)]);
+            FSDVec Y1 = FSDVec::Set1(CurveY[std::min(1, NumPts - 1)]);
+            for (int32_t j = 1; j + 1 < NumPts; ++j)
+            {
+                const FSDVec Past = FSDVec::Greater(X, FSDVec::Set1(CurveX[j]));
+                X0 = FSDVec::Select(Past, FSDVec::Set1(CurveX[j]), X0);
+                Y0 = FSDVec::Select(Past, FSDVec::Set1(CurveY[j]), Y0);
+                X1 = FSDVec::Select(Past, FSDVec::Set1(CurveX[j + 1]), X1);
+                Y1 = FSDVec::Select(Past, FSDVec::Set1(CurveY[j + 1]), Y1);
+            }
+            const FSDVec T = (X - X0) / (X1 - X0);
+            DensityEffect = Y0 + T * (Y1 - Y0);
+            // Past the end written as "not below it", so a NaN density takes the last y like FDensityEffectCurve::Evaluate
+            DensityEffect = FSDVec::Select(FSDVec::Less(X, FSDVec::Set1(CurveX[NumPts - 1])), DensityEffect, FSDVec::Set1(CurveY[NumPts - 1]));
+            DensityEffect = FSDVec::Select(FSDVec::LessEqual(X, FSDVec::Set1(CurveX[0])), FSDVec::Set1(CurveY[0]), DensityEffect);
+        }
+
+        // Rounding to whole people, kept only in the lanes that asked for it when the batch is mixed
+        const FSDVec WholeLanes = bMixedRounding ? FSDVec::Greater(FSDVec::Load(WholePeopleLanes.data() + i), Half) : Zero;
+        const auto Whole = [this, &WholeLanes](FSDVec Value, FSDVec Rounded)
+        {
+            return bMixedRounding ? FSDVec::Select(WholeLanes, Rounded, Value) : Rounded;
+        };
+
+        const FSDVec BitesPerZombieDay = FSDVec::Load(NormalNumberOfBites.data() + i) * DensityEffect;
+        FSDVec TotalBittenPerDay = Z * BitesPerZombieDay;
+        if (TPolicy::bWholePeople)
+            TotalBittenPerDay = Whole(TotalBittenPerDay, FSDVec::Floor(TotalBittenPerDay + Half));
+
+        const FSDVec Denom = FSDVec::Max(NonZombiePopulation, One);
+        FSDVec BitesOnSusceptible = (S / Denom) * TotalBittenPerDay;
+        if (TPolicy::bWholePeople)
+            BitesOnSusceptible = Whole(BitesOnSusceptible, FSDVec::Floor(BitesOnSusceptible + Half));
+
+        // 3. - Getting bitten
+        const FSDVec GettingBitten = FSDVec::Min(BitesOnSusceptible, TPolicy::bWholePeople ? Whole(S, FSDVec::Floor(S)) : S);
+
+        // 4. - Conveyor: pop the slot that is due, then fill up to capacity
+        const FSDVec Outflow = FSDVec::Load(OutSlot + i);
+        Zero.Store(OutSlot + i);
+
+        const FSDVec CurrentContent = B - Outflow;
+        FSDVec InflowPeople = FSDVec::Max(Zero, GettingBitten);
+        if (TPolicy::bCapacityLimit)
+        {
+            const FSDVec FreeCapacity = FSDVec::Max(Zero, FSDVec::Load(BittenCapacity.data() + i) - CurrentContent);
+            InflowPeople = FSDVec::Max(Zero, FSDVec::Min(GettingBitten, FreeCapacity));
+        }
+        InflowPeople.Store(InSlot + i);
+
+        // 5 - Stock updates
+        S = FSDVec::Max(Zero, S - GettingBitten);
+        Z = FSDVec::Max(Zero, Z + Outflow);
+
+        S.Store(Susceptible.data() + i);
+        Z.Store(Zombies.data() + i);
+        (CurrentContent + InflowPeople).Store(Bitten.data() + i);
+    }
+
+    if (!bUniformDelay)
+    {
+        for (int32_t i = 0; i < NumScenarios; ++i)
+        {
+            int32_t Target = RingHead + DelaySteps[i];
+            if (Target >= RingSize)
+                Target -= RingSize;
+            Slots[static_cast<size_t>(Target) * Stride + i] = Inflow[i];
+        }
+    }
+
+    RingHead = NextHead;
+    ++Day;
+}
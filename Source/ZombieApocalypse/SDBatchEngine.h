@@ -0,0 +1,92 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "DensityEffectCurve.h"
+#include "SDModel.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Structure-of-arrays version of FSDEngine that advances many scenarios at once.
+ *
+ * Each scenario is one SIMD lane: stocks, parameters and conveyor slots are kept
+ * in separate arrays and the whole step, density effect lookup included, runs
+ * without branches on AVX2 (8 lanes) or SSE (4 lanes), with a plain loop on
+ * other targets. The conveyor is a shared ring of delay slots, the lane-wise
+ * counterpart of FSDConveyor. Results match FSDEngine exactly as long as the flows are
+ * whole people, which the model's rounding guarantees unless BittenCapacity
+ * itself is fractional. Only ESDConveyorDelay::Discrete is supported, the
+ * DelayMode of the scenarios is ignored.
+ *
+ * The step is compiled once per TSDStepPolicy and Reset picks the variant:
+ * whole people if any scenario counts them (a mixed batch masks the rounding
+ * per lane), and the capacity clamp is dropped when no lane's BittenCapacity
+ * can ever bind.
+ */
+class FSDBatchEngine
+{
+public:
+	/** Lanes per vector for the instruction set this file was compiled for. */
+	static int32_t GetLaneWidth();
+	static const char* GetInstructionSet();
+
+	bool SetGraph(const std::vector<std::pair<float, float>>& GraphPts, std::string* OutError = nullptr);
+	void SetCurve(const FDensityEffectCurve& Curve);
+
+	/** Starts every scenario from InitialState with an empty conveyor. */
+	void Reset(const std::vector<FSDParams>& Scenarios, const FSDState& InitialState);
+
+	/** Advances every scenario by one day. */
+	void Step();
+	void Run(int32_t NumDays);
+
+	int32_t GetNumScenarios() const { return NumScenarios; }
+	int32_t GetDay() const { return Day; }
+	FSDState GetState(int32_t Scenario) const;
+
+	const float* GetSusceptible() const { return Susceptible.data(); }
+	const float* GetBitten() const { return Bitten.data(); }
+	const float* GetZombies() const { return Zombies.data(); }
+
+	/** Delays beyond this are clamped, they only differ from FSDEngine on longer runs. */
+	static constexpr int32_t MaxDelayDays = 1 << 16;
+
+private:
+	template <typename TPolicy>
+	void StepLanes();
+
+	int32_t NumScenarios{ 0 };
+	int32_t Stride{ 0 };          // NumScenarios rounded up to the lane width
+	int32_t Day{ 0 };
+
+	// Compiled density effect breakpoints, the lanes walk all of them without branching
+	std::vector<float> CurveX;
+	std::vector<float> CurveY;
+
+	// Per-lane parameters
+	std::vector<float> BittenCapacity;
+	std::vector<float> NormalNumberOfBites;
+	std::vector<float> LandArea;
+	std::vector<float> NormalPopulationDensity;
+	std::vector<int32_t> DelaySteps;
+	bool bUniformDelay{ true };
+	bool bWholePeople{ true };
+	bool bCapacityLimit{ true };
+
+	// 1 for lanes counting whole people, only read when the scenarios disagree
+	std::vector<float> WholePeopleLanes;
+	bool bMixedRounding{ false };
+
+	// Per-lane stocks, Bitten doubles as the running conveyor total
+	std::vector<float> Susceptible;
+	std::vector<float> Bitten;
+	std::vector<float> Zombies;
+
+	// Conveyor ring, slot s of lane i lives at Slots[s * Stride + i]
+	std::vector<float> Slots;
+	std::vector<float> Inflow;
+	int32_t RingSize{ 1 };
+	int32_t RingHead{ 0 };
+};
@@ -0,0 +1,162 @@
+// Copyright University of Inland Norway
+
+#include "SDConveyor.h"
+#include "SimulationSnapshot.h"
+#include <algorithm>
+#include <cmath>
+
+// Delays are clamped here, anything longer only matters for runs of 180+ years
+static constexpr int32_t ConveyorMaxSteps = 1 << 16;
+
+static int32_t ClampConveyorSteps(float Steps)
+{
+    return std::max(1, static_cast<int32_t>(std::min(Steps, static_cast<float>(ConveyorMaxSteps))));
+}
+
+void FSDConveyor::SetDelay(float DelayDays, ESDConveyorDelay Mode, float SpreadDays)
+{
+    if (DelayDays == CurrentDelay && Mode == CurrentMode && SpreadDays == CurrentSpread)
+        return;
+
+    CurrentDelay = DelayDays;
+    CurrentMode = Mode;
+    CurrentSpread = SpreadDays;
+
+    Weights.clear();
+
+    switch (Mode)
+    {
+    case ESDConveyorDelay::Fractional:
+    {
+        const float Lower = std::floor(DelayDays);
+        const float Fraction = DelayDays - Lower;
+        FirstStep = ClampConveyorSteps(Lower);
+        if (DelayDays <= 1.f || Fraction <= 0.f)
+        {
+            Weights.push_back(1.f);
+        }
+        else
+        {
+            Weights.push_back(1.f - Fraction);
+            Weights.push_back(Fraction);
+        }
+        break;
+    }
+    case ESDConveyorDelay::Distributed:
+    {
+        // A delay t leaves on step ceil(t), so step k gets the share of the window inside (k - 1, k]
+        const float Low = std::max(0.f, DelayDays - 0.5f * SpreadDays);
+        const float High = DelayDays + 0.5f * SpreadDays;
+        if (High - Low > 0.f)
+        {
+            FirstStep = ClampConveyorSteps(std::floor(Low) + 1.f);
+            const int32_t LastStep = ClampConveyorSteps(std::ceil(High));
+            for (int32_t Step = FirstStep; Step <= LastStep; ++Step)
+            {
+                const float Overlap = std::min(High, static_cast<float>(Step)) - std::max(Low, static_cast<float>(Step - 1));
+                Weights.push_back(std::max(0.f, Overlap) / (High - Low));
+            }
+            break;
+        }
+        // Zero-width window is just the discrete delay
+        FirstStep = ClampConveyorSteps(std::ceil(DelayDays));
+        Weights.push_back(1.f);
+        break;
+    }
+    case ESDConveyorDelay::Discrete:
+    default:
+        // Same as counting RemainingDays down by one until it is <= 0
+        FirstStep = ClampConveyorSteps(std::ceil(DelayDays));
+        Weights.push_back(1.f);
+        break;
+    }
+
+    Reserve(FirstStep + static_cast<int32_t>(Weights.size()) - 1);
+}
+
+void FSDConveyor::Reserve(int32_t NewCapacity)
+{
+    const int32_t OldCapacity = GetCapacity();
+    if (NewCapacity <= OldCapacity)
+        return;
+
+    // Unroll the ring so the head lands on slot 0, people in transit keep their remaining steps
+    std::vector<float> NewSlots(NewCapacity, 0.f);
+    for (int32_t i = 0; i < OldCapacity; ++i)
+    {
+        NewSlots[i] = Slots[(Head + i) % OldCapacity];
+    }
+    Slots.swap(NewSlots);
+    Head = 0;
+}
+
+void FSDConveyor::Clear()
+{
+    std::fill(Slots.begin(), Slots.end(), 0.f);
+    Head = 0;
+    Total = 0.f;
+}
+
+float FSDConveyor::Advance()
+{
+    const float Outflow = Slots[Head];
+    Slots[Head] = 0.f;
+    Total -= Outflow;
+
+    if (++Head == GetCapacity())
+    {
+        // Once per lap, rebuild the running total so rounding cannot build up
+        Head = 0;
+        Total = 0.f;
+        for (float Slot : Slots)
+            Total += Slot;
+    }
+    return Outflow;
+}
+
+void FSDConveyor::Add(float Amount)
+{
+    const int32_t Capacity = GetCapacity();
+    int32_t Slot = (Head + FirstStep - 1) % Capacity;
+    for (float Weight : Weights)
+    {
+        Slots[Slot] += Amount * Weight;
+        if (++Slot == Capacity)
+            Slot = 0;
+    }
+    Total += Amount;
+}
+
+float FSDConveyor::GetSlot(int32_t Steps) const
+{
+    return Slots[(Head + Steps) % GetCapacity()];
+}
+
+void FSDConveyor::SaveState(FSnapshotWriter& Writer) const
+{
+    // The ring as is, so the running total and the lap it is rebuilt on replay exactly
+    Writer.Write(Head);
+    Writer.Write(Total);
+    Writer.WriteArray(Slots);
+}
+
+bool FSDConveyor::LoadState(FSnapshotReader& Reader)
+{
+    int32_t LoadedHead = 0;
+    float LoadedTotal = 0.f;
+    std::vector<float> LoadedSlots;
+    if (!Reader.Read(LoadedHead) || !Reader.Read(LoadedTotal)
+        || !Reader.ReadArray(LoadedSlots, static_cast<size_t>(ConveyorMaxSteps) * 2)
+        || LoadedSlots.empty() || LoadedHead < 0 || LoadedHead >= static_cast<int32_t>(LoadedSlots.size()))
+    {
+        return false;
+    }
+
+    Slots.swap(LoadedSlots);
+    Head = LoadedHead;
+    Total = LoadedTotal;
+
+    // The delay may have changed since the save, the ring must still fit it
+    Reserve(FirstStep + static_cast<int32_t>(Weights.size()) - 1);
+    return true;
+}
@@ -0,0 +1,68 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class FSnapshotReader;
+class FSnapshotWriter;
+
+/** How a conveyor turns DaysToBecomeInfectedFromBite into whole simulation steps. */
+enum class ESDConveyorDelay : uint8_t
+{
+	// Everyone leaves after ceil(Delay) steps, the original batch-list behaviour
+	Discrete,
+	// Split between floor and ceil so the mean delay is exactly Delay
+	Fractional,
+	// Spread uniformly over [Delay - Spread / 2, Delay + Spread / 2]
+	Distributed
+};
+
+/**
+ * FIFO delay line for the Bitten stock.
+ *
+ * Slot k ahead of the head holds the people leaving k + 1 steps from now, so
+ * inflow, outflow and content are all O(1) and the ring is only reallocated
+ * when the delay grows past its capacity. Changing the delay mid-run leaves
+ * people already on the conveyor where they are, like the old batch list.
+ */
+class FSDConveyor
+{
+public:
+	void SetDelay(float DelayDays, ESDConveyorDelay Mode = ESDConveyorDelay::Discrete, float SpreadDays = 0.f);
+
+	/** Drops everyone on the conveyor, keeps the delay and capacity. */
+	void Clear();
+
+	/** Moves the conveyor one step and returns the people that reached the end. */
+	float Advance();
+
+	/** Puts people on the conveyor according to the current delay. */
+	void Add(float Amount);
+
+	float GetContent() const { return Total; }
+	int32_t GetCapacity() const { return static_cast<int32_t>(Slots.size()); }
+
+	/** People due in Steps + 1 steps, 0 <= Steps < GetCapacity(). */
+	float GetSlot(int32_t Steps) const;
+
+	/** The ring and everyone in transit. Loading keeps the current delay and only grows the ring to fit it. */
+	void SaveState(FSnapshotWriter& Writer) const;
+	bool LoadState(FSnapshotReader& Reader);
+
+private:
+	void Reserve(int32_t NewCapacity);
+
+	std::vector<float> Slots{ 0.f };
+	int32_t Head{ 0 };
+	float Total{ 0.f };
+
+	// Share of each inflow leaving after FirstStep + i steps
+	std::vector<float> Weights{ 1.f };
+	int32_t FirstStep{ 1 };
+
+	float CurrentDelay{ 1.f };
+	ESDConveyorDelay CurrentMode{ ESDConveyorDelay::Discrete };
+	float CurrentSpread{ 0.f };
+};
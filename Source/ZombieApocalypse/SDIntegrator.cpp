@@ -0,0 +1,367 @@
+// Copyright University of Inland Norway
+
+#include "SDIntegrator.h"
+#include "DensityEffectCurve.h"
+#include "SDModel.h"
+#include "SimulationSnapshot.h"
+#include <algorithm>
+#include <cmath>
+
+// Steps below this are accepted whatever their error, so a kink in the curve cannot stall a day
+static constexpr double SDMinAdaptiveStep = 1e-6;
+
+// Gauss-Legendre nodes and weights on [0, 1] for averaging I over a Distributed delay window
+static constexpr double SDGaussNodes[3] = { 0.1127016653792583, 0.5, 0.8872983346207417 };
+static constexpr double SDGaussWeights[3] = { 5.0 / 18.0, 8.0 / 18.0, 5.0 / 18.0 };
+
+void FSDContinuousModel::SetParams(const FSDParams& Params)
+{
+    double Low = std::max(0.0, static_cast<double>(Params.DaysToBecomeInfectedFromBite));
+    double High = Low;
+    switch (Params.DelayMode)
+    {
+    case ESDConveyorDelay::Discrete:
+        // Same whole number of days the conveyor holds people for
+        Low = High = std::max(1.0, std::ceil(Low));
+        break;
+    case ESDConveyorDelay::Distributed:
+        High = Low + 0.5 * Params.DelaySpreadDays;
+        Low = std::max(0.0, Low - 0.5 * Params.DelaySpreadDays);
+        break;
+    case ESDConveyorDelay::Fractional:
+    default:
+        break;
+    }
+
+    const double NewCapacity = Params.BittenCapacity;
+    const double NewBites = Params.NormalNumberOfBites;
+    const double NewArea = Params.LandArea;
+    const double NewDensity = Params.NormalPopulationDensity;
+    if (Low != DelayLow || High != DelayHigh || NewCapacity != BittenCapacity || NewBites != NormalNumberOfBites
+        || NewArea != LandArea || NewDensity != NormalPopulationDensity)
+    {
+        bRatesValid = false;
+    }
+
+    DelayLow = Low;
+    DelayHigh = High;
+    BittenCapacity = NewCapacity;
+    NormalNumberOfBites = NewBites;
+    LandArea = NewArea;
+    NormalPopulationDensity = NewDensity;
+
+    Integrator = Params.Integrator;
+    StepDays = std::min(1.0, std::max(1e-4, static_cast<double>(Params.StepDays)));
+    Tolerance = std::max(1e-12, static_cast<double>(Params.Tolerance));
+}
+
+void FSDContinuousModel::Reset(double InSusceptible, double InZombies)
+{
+    Time = 0.0;
+    Susceptible = std::max(0.0, InSusceptible);
+    Infected = 0.0;
+    ZombieBase = InZombies;
+    bRatesValid = false;
+    AdaptiveStep = StepDays;
+    History.clear();
+    HistoryStart = 0;
+    Evaluations = 0;
+}
+
+void FSDContinuousModel::SetStocks(double InSusceptible, double InZombies)
+{
+    Susceptible = std::max(0.0, InSusceptible);
+    ZombieBase = InZombies - Lagged(Time);
+    bRatesValid = false;
+}
+
+double FSDContinuousModel::InterpolateI(double T, double* OutRate) const
+{
+    // Nobody was bitten before the run started
+    if (T <= 0.0 || HistoryStart >= History.size())
+    {
+        if (OutRate) *OutRate = 0.0;
+        return 0.0;
+    }
+
+    const FNode& Last = History.back();
+    if (T >= Last.T)
+    {
+        // Only reached when the delay is shorter than a step
+        if (OutRate) *OutRate = Last.Rate;
+        return Last.I + Last.Rate * (T - Last.T);
+    }
+
+    const auto Begin = History.begin() + static_cast<std::ptrdiff_t>(HistoryStart);
+    const auto Upper = std::upper_bound(Begin, History.end(), T, [](double Value, const FNode& Node) { return Value < Node.T; });
+    if (Upper == Begin)
+    {
+        if (OutRate) *OutRate = Begin->Rate;
+        return Begin->I;
+    }
+
+    // Cubic Hermite on the bracketing nodes, with the stored inflow as the slope
+    const FNode& A = *(Upper - 1);
+    const FNode& B = *Upper;
+    const double H = B.T - A.T;
+    const double S = (T - A.T) / H;
+    const double S2 = S * S;
+    const double S3 = S2 * S;
+
+    if (OutRate)
+    {
+        *OutRate = (6.0 * S2 - 6.0 * S) / H * (A.I - B.I)
+            + (3.0 * S2 - 4.0 * S + 1.0) * A.Rate
+            + (3.0 * S2 - 2.0 * S) * B.Rate;
+    }
+    return (2.0 * S3 - 3.0 * S2 + 1.0) * A.I
+        + (S3 - 2.0 * S2 + S) * H * A.Rate
+        + (-2.0 * S3 + 3.0 * S2) * B.I
+        + (S3 - S2) * H * B.Rate;
+}
+
+double FSDContinuousModel::Lagged(double T, double* OutRate) const
+{
+    if (DelayHigh <= DelayLow)
+        return InterpolateI(T - DelayLow, OutRate);
+
+    // Everyone bitten at s turns somewhere in [s + DelayLow, s + DelayHigh], so L is the window average of I
+    const double Width = DelayHigh - DelayLow;
+    const int32_t Pieces = std::max(1, static_cast<int32_t>(std::ceil(Width * 4.0)));
+    const double PieceWidth = Width / Pieces;
+
+    double Sum = 0.0;
+    for (int32_t Piece = 0; Piece < Pieces; ++Piece)
+    {
+        const double From = T - DelayHigh + Piece * PieceWidth;
+        for (int32_t Node = 0; Node < 3; ++Node)
+        {
+            Sum += SDGaussWeights[Node] * InterpolateI(From + SDGaussNodes[Node] * PieceWidth);
+        }
+    }
+
+    if (OutRate)
+    {
+        *OutRate = (InterpolateI(T - DelayLow) - InterpolateI(T - DelayHigh)) / Width;
+    }
+    return Sum / Pieces;
+}
+
+FSDContinuousModel::FRates FSDContinuousModel::Evaluate(const FDensityEffectCurve& Curve, double T, double S, double I)
+{
+    ++Evaluations;
+
+    double Outflow = 0.0;
+    const double L = Lagged(T, &Outflow);
+    const double Zombies = ZombieBase + L;
+    const double Bitten = I - L;
+
+    const double NonZombiePopulation = S + Bitten;
+    const double X = NonZombiePopulation / LandArea / NormalPopulationDensity;
+    const double DensityEffect = Curve.Evaluate(static_cast<float>(X));
+
+    const double GettingBitten = (S > 0.0 && Zombies > 0.0)
+        ? Zombies * NormalNumberOfBites * DensityEffect * S / std::max(NonZombiePopulation, 1.0)
+        : 0.0;
+
+    // A full conveyor only takes in as many as it lets out, the rest of the bitten are lost like in the discrete step
+    const double Inflow = Bitten >= BittenCapacity ? std::min(GettingBitten, std::max(0.0, Outflow)) : GettingBitten;
+
+    return { -GettingBitten, Inflow, DensityEffect };
+}
+
+void FSDContinuousModel::Accept(double NewTime, double NewS, double NewI, const FRates& NewRates)
+{
+    Time = NewTime;
+    Susceptible = std::max(0.0, NewS);
+    Infected = NewI;
+    Rates = NewRates;
+    History.push_back({ Time, Infected, Rates.dI });
+
+    // Keep one node older than the longest delay so the lookup can still bracket it
+    const double Cutoff = Time - DelayHigh;
+    while (HistoryStart + 1 < History.size() && History[HistoryStart + 1].T <= Cutoff)
+    {
+        ++HistoryStart;
+    }
+    if (HistoryStart >= 1024 && HistoryStart * 2 >= History.size())
+    {
+        History.erase(History.begin(), History.begin() + static_cast<std::ptrdiff_t>(HistoryStart));
+        HistoryStart = 0;
+    }
+}
+
+void FSDContinuousModel::AdvanceDay(const FDensityEffectCurve& Curve, FSDFlows& OutFlows)
+{
+    // 1. - The derivative at the start is every method's first stage, and the slope of the history node there
+    if (!bRatesValid)
+    {
+        Rates = Evaluate(Curve, Time, Susceptible, Infected);
+        bRatesValid = true;
+        if (History.empty() || History.back().T != Time)
+        {
+            History.push_back({ Time, Infected, Rates.dI });
+        }
+        else
+        {
+            History.back().Rate = Rates.dI;
+        }
+    }
+
+    const double StartS = Susceptible;
+    const double StartI = Infected;
+    const double StartL = Lagged(Time);
+
+    // 2. - Integrate, days always end on a whole number so sub-day steps cannot drift
+    const double EndTime = std::round(Time) + 1.0;
+    if (Integrator == ESDIntegrator::RK45)
+    {
+        StepAdaptive(Curve, EndTime);
+    }
+    else
+    {
+        StepFixed(Curve, EndTime);
+    }
+
+    // 3. - The day's totals, in the same terms the discrete step reports
+    OutFlows.DensityEffect = static_cast<float>(Rates.DensityEffect);
+    OutFlows.GettingBitten = static_cast<float>(StartS - Susceptible);
+    OutFlows.Inflow = static_cast<float>(Infected - StartI);
+    OutFlows.BecomingInfected = static_cast<float>(Lagged(Time) - StartL);
+}
+
+void FSDContinuousModel::StepFixed(const FDensityEffectCurve& Curve, double EndTime)
+{
+    const double StartTime = Time;
+    const int32_t NumSteps = std::max(1, static_cast<int32_t>(std::lround(1.0 / StepDays)));
+    const double H = (EndTime - StartTime) / NumSteps;
+
+    for (int32_t Step = 1; Step <= NumSteps; ++Step)
+    {
+        const double T = Time;
+        const double S = Susceptible;
+        const double I = Infected;
+        const FRates K1 = Rates;
+        const double NewTime = Step == NumSteps ? EndTime : StartTime + Step * H;
+
+        double NewS;
+        double NewI;
+        if (Integrator == ESDIntegrator::Euler)
+        {
+            NewS = S + H * K1.dS;
+            NewI = I + H * K1.dI;
+        }
+        else
+        {
+            const FRates K2 = Evaluate(Curve, T + 0.5 * H, S + 0.5 * H * K1.dS, I + 0.5 * H * K1.dI);
+            const FRates K3 = Evaluate(Curve, T + 0.5 * H, S + 0.5 * H * K2.dS, I + 0.5 * H * K2.dI);
+            const FRates K4 = Evaluate(Curve, T + H, S + H * K3.dS, I + H * K3.dI);
+            NewS = S + H / 6.0 * (K1.dS + 2.0 * K2.dS + 2.0 * K3.dS + K4.dS);
+            NewI = I + H / 6.0 * (K1.dI + 2.0 * K2.dI + 2.0 * K3.dI + K4.dI);
+        }
+
+        Accept(NewTime, NewS, NewI, Evaluate(Curve, NewTime, std::max(0.0, NewS), NewI));
+    }
+}
+
+void FSDContinuousModel::StepAdaptive(const FDensityEffectCurve& Curve, double EndTime)
+{
+    // Dormand-Prince 5(4); the last stage lands on the new point and is reused as the next first stage
+    static constexpr double A21 = 1.0 / 5.0;
+    static constexpr double A31 = 3.0 / 40.0, A32 = 9.0 / 40.0;
+    static constexpr double A41 = 44.0 / 45.0, A42 = -56.0 / 15.0, A43 = 32.0 / 9.0;
+    static constexpr double A51 = 19372.0 / 6561.0, A52 = -25360.0 / 2187.0, A53 = 64448.0 / 6561.0, A54 = -212.0 / 729.0;
+    static constexpr double A61 = 9017.0 / 3168.0, A62 = -355.0 / 33.0, A63 = 46732.0 / 5247.0, A64 = 49.0 / 176.0, A65 = -5103.0 / 18656.0;
+    static constexpr double B1 = 35.0 / 384.0, B3 = 500.0 / 1113.0, B4 = 125.0 / 192.0, B5 = -2187.0 / 6784.0, B6 = 11.0 / 84.0;
+    static constexpr double E1 = 71.0 / 57600.0, E3 = -71.0 / 16695.0, E4 = 71.0 / 1920.0, E5 = -17253.0 / 339200.0, E6 = 22.0 / 525.0, E7 = -1.0 / 40.0;
+
+    while (Time < EndTime)
+    {
+        // 1. - Never step across the day's end or the moment the first bitten start turning
+        double H = std::min(AdaptiveStep, EndTime - Time);
+        bool bClipped = H < AdaptiveStep;
+        for (const double Break : { DelayLow, DelayHigh })
+        {
+            if (Time < Break - SDMinAdaptiveStep && Time + H > Break)
+            {
+                H = Break - Time;
+                bClipped = true;
+            }
+        }
+        const double NewTime = Time + H >= EndTime ? EndTime : Time + H;
+
+        // 2. - Stages
+        const double T = Time;
+        const double S = Susceptible;
+        const double I = Infected;
+        const FRates K1 = Rates;
+        const FRates K2 = Evaluate(Curve, T + H / 5.0, S + H * A21 * K1.dS, I + H * A21 * K1.dI);
+        const FRates K3 = Evaluate(Curve, T + H * 3.0 / 10.0,
+            S + H * (A31 * K1.dS + A32 * K2.dS),
+            I + H * (A31 * K1.dI + A32 * K2.dI));
+        const FRates K4 = Evaluate(Curve, T + H * 4.0 / 5.0,
+            S + H * (A41 * K1.dS + A42 * K2.dS + A43 * K3.dS),
+            I + H * (A41 * K1.dI + A42 * K2.dI + A43 * K3.dI));
+        const FRates K5 = Evaluate(Curve, T + H * 8.0 / 9.0,
+            S + H * (A51 * K1.dS + A52 * K2.dS + A53 * K3.dS + A54 * K4.dS),
+            I + H * (A51 * K1.dI + A52 * K2.dI + A53 * K3.dI + A54 * K4.dI));
+        const FRates K6 = Evaluate(Curve, NewTime,
+            S + H * (A61 * K1.dS + A62 * K2.dS + A63 * K3.dS + A64 * K4.dS + A65 * K5.dS),
+            I + H * (A61 * K1.dI + A62 * K2.dI + A63 * K3.dI + A64 * K4.dI + A65 * K5.dI));
+
+        const double NewS = S + H * (B1 * K1.dS + B3 * K3.dS + B4 * K4.dS + B5 * K5.dS + B6 * K6.dS);
+        const double NewI = I + H * (B1 * K1.dI + B3 * K3.dI + B4 * K4.dI + B5 * K5.dI + B6 * K6.dI);
+        const FRates K7 = Evaluate(Curve, NewTime, std::max(0.0, NewS), NewI);
+
+        // 3. - Error of the embedded 4th order solution, relative to the size of each stock
+        const double ErrorS = H * (E1 * K1.dS + E3 * K3.dS + E4 * K4.dS + E5 * K5.dS + E6 * K6.dS + E7 * K7.dS);
+        const double ErrorI = H * (E1 * K1.dI + E3 * K3.dI + E4 * K4.dI + E5 * K5.dI + E6 * K6.dI + E7 * K7.dI);
+        const double Error = std::max(
+            std::fabs(ErrorS) / (Tolerance * (1.0 + std::max(std::fabs(S), std::fabs(NewS)))),
+            std::fabs(ErrorI) / (Tolerance * (1.0 + std::max(std::fabs(I), std::fabs(NewI)))));
+
+        const double Factor = Error > 0.0 ? std::min(5.0, std::max(0.2, 0.9 * std::pow(Error, -0.2))) : 5.0;
+        if (Error <= 1.0 || H <= SDMinAdaptiveStep)
+        {
+            Accept(NewTime, NewS, NewI, K7);
+
+            // A step shortened to hit a boundary says little about how large the next one may be
+            if (!bClipped || Factor < 1.0)
+            {
+                AdaptiveStep = std::min(StepDays, std::max(SDMinAdaptiveStep, H * Factor));
+            }
+        }
+        else
+        {
+            AdaptiveStep = std::max(SDMinAdaptiveStep, H * Factor);
+        }
+    }
+}
+
+void FSDContinuousModel::SaveState(FSnapshotWriter& Writer) const
+{
+    Writer.Write(Time);
+    Writer.Write(Susceptible);
+    Writer.Write(Infected);
+    Writer.Write(ZombieBase);
+    Writer.Write(Rates);
+    Writer.Write(bRatesValid);
+    Writer.Write(AdaptiveStep);
+    Writer.Write(Evaluations);
+    Writer.WriteArray(History.data() + HistoryStart, History.size() - HistoryStart);
+}
+
+bool FSDContinuousModel::LoadState(FSnapshotReader& Reader)
+{
+    std::vector<FNode> LoadedHistory;
+    if (!Reader.Read(Time) || !Reader.Read(Susceptible) || !Reader.Read(Infected) || !Reader.Read(ZombieBase)
+        || !Reader.Read(Rates) || !Reader.Read(bRatesValid) || !Reader.Read(AdaptiveStep) || !Reader.Read(Evaluations)
+        || !Reader.ReadArray(LoadedHistory, size_t(1) << 26))
+    {
+        return false;
+    }
+
+    History.swap(LoadedHistory);
+    HistoryStart = 0;
+    return true;
+}
@@ -0,0 +1,119 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FDensityEffectCurve;
+class FSnapshotReader;
+class FSnapshotWriter;
+struct FSDParams;
+struct FSDFlows;
+
+/** How FSDEngine advances a day. */
+enum class ESDIntegrator : uint8_t
+{
+	// The classic model: one step per day in whole people, bitten people ride the conveyor
+	Discrete,
+	// The continuous equations below with fixed sub-day steps
+	Euler,
+	RK4,
+	// Dormand-Prince 5(4), step size picked per step to stay within Tolerance
+	RK45
+};
+
+/**
+ * The stock-and-flow model as a delay differential equation, without rounding.
+ *
+ *   dS/dt = -g            g = Z * NormalNumberOfBites * DensityEffect * S / max(S + B, 1)
+ *   dI/dt = inflow        inflow = g, or min(g, outflow) once B is at BittenCapacity
+ *   Z = Z0 + L(t)         L(t) = I(t - Delay), averaged over the spread for Distributed
+ *   B = I - L(t)
+ *
+ * I is everyone ever bitten, so the conveyor becomes a lookup into its own
+ * history instead of a ring of whole-day slots and sub-day steps see exactly
+ * the delay they should. History keeps I and inflow at every accepted step and
+ * is read back by cubic Hermite interpolation, which is accurate enough not to
+ * limit RK4 or RK45. Discrete delays use ceil(Delay) like the conveyor, the other
+ * modes use Delay itself.
+ */
+class FSDContinuousModel
+{
+public:
+	/** Takes the constants, integrator, step and tolerance; history is kept. */
+	void SetParams(const FSDParams& Params);
+
+	/** Starts over at t = 0 with nobody bitten, InitialBitten is ignored like the discrete conveyor does. */
+	void Reset(double InSusceptible, double InZombies);
+
+	/** Overrides S and Z at the current time, people already bitten stay on their way. */
+	void SetStocks(double InSusceptible, double InZombies);
+
+	/** Integrates one day with the configured integrator, OutFlows gets the day's totals. */
+	void AdvanceDay(const FDensityEffectCurve& Curve, FSDFlows& OutFlows);
+
+	double GetTime() const { return Time; }
+	double GetSusceptible() const { return Susceptible; }
+	double GetBitten() const { return Infected - Lagged(Time); }
+	double GetZombies() const { return ZombieBase + Lagged(Time); }
+
+	/** Right-hand side evaluations since Reset, the cost measure for comparing integrators. */
+	int64_t GetEvaluations() const { return Evaluations; }
+
+	/** Stocks, history back to the longest delay and step size; the constants come from SetParams. */
+	void SaveState(FSnapshotWriter& Writer) const;
+	bool LoadState(FSnapshotReader& Reader);
+
+private:
+	struct FNode
+	{
+		double T;
+		double I;
+		double Rate;
+	};
+
+	struct FRates
+	{
+		double dS;
+		double dI;
+		double DensityEffect;
+	};
+
+	double InterpolateI(double T, double* OutRate = nullptr) const;
+	double Lagged(double T, double* OutRate = nullptr) const;
+	FRates Evaluate(const FDensityEffectCurve& Curve, double T, double S, double I);
+
+	void StepFixed(const FDensityEffectCurve& Curve, double EndTime);
+	void StepAdaptive(const FDensityEffectCurve& Curve, double EndTime);
+	void Accept(double NewTime, double NewS, double NewI, const FRates& NewRates);
+
+	// Constants
+	ESDIntegrator Integrator{ ESDIntegrator::RK4 };
+	double DelayLow{ 15.0 };
+	double DelayHigh{ 15.0 };
+	double BittenCapacity{ 100.0 };
+	double NormalNumberOfBites{ 1.0 };
+	double LandArea{ 1000.0 };
+	double NormalPopulationDensity{ 0.1 };
+	double StepDays{ 1.0 };
+	double Tolerance{ 1e-4 };
+
+	// State at Time, Rates is the derivative there and doubles as the next step's first stage
+	double Time{ 0.0 };
+	double Susceptible{ 0.0 };
+	double Infected{ 0.0 };
+	double ZombieBase{ 0.0 };
+	FRates Rates{ 0.0, 0.0, 0.0 };
+	bool bRatesValid{ false };
+
+	// Step size the adaptive integrator settled on, carried over to the next day
+	double AdaptiveStep{ 1.0 };
+
+	// Accepted steps back to the longest delay, older nodes are dropped in bulk
+	std::vector<FNode> History;
+	size_t HistoryStart{ 0 };
+
+	int64_t Evaluations{ 0 };
+};
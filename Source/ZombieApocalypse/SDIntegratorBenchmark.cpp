@@ -0,0 +1,144 @@
+// Copyright University of Inland Norway
+
+#include "SDIntegratorBenchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+struct FSDDailyStocks
+{
+    double Susceptible;
+    double Bitten;
+    double Zombies;
+};
+
+// Runs one configuration, keeping the stocks at the end of every day
+static void RunSDBenchmarkCase(const FSDIntegratorBenchmarkConfig& Config, const FDensityEffectCurve& Curve, const FSDParams& Params,
+    std::vector<FSDDailyStocks>& OutDays, int64_t& OutEvaluations, double& OutSeconds)
+{
+    FSDEngine Engine;
+    Engine.SetCurve(Curve);
+    Engine.SetParams(Params);
+
+    OutSeconds = 0.0;
+    for (int32_t Repeat = 0; Repeat < std::max(1, Config.Repeats); ++Repeat)
+    {
+        OutDays.clear();
+        Engine.Reset(Config.InitialState);
+
+        const auto Start = std::chrono::steady_clock::now();
+        for (int32_t Day = 0; Day < Config.NumDays; ++Day)
+        {
+            Engine.Step();
+
+            if (Params.Integrator == ESDIntegrator::Discrete)
+            {
+                const FSDState& State = Engine.GetState();
+                OutDays.push_back({ State.Susceptible, State.Bitten, State.Zombies });
+            }
+            else
+            {
+                const FSDContinuousModel& Model = Engine.GetContinuous();
+                OutDays.push_back({ Model.GetSusceptible(), Model.GetBitten(), Model.GetZombies() });
+            }
+        }
+        const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+        OutSeconds = Repeat == 0 ? Seconds : std::min(OutSeconds, Seconds);
+    }
+
+    // The discrete step has no right-hand side, count its one pass per day instead
+    OutEvaluations = Params.Integrator == ESDIntegrator::Discrete ? Config.NumDays : Engine.GetContinuous().GetEvaluations();
+}
+
+static double GetSDMaxError(const std::vector<FSDDailyStocks>& Days, const std::vector<FSDDailyStocks>& Reference)
+{
+    double MaxError = 0.0;
+    for (size_t Day = 0; Day < std::min(Days.size(), Reference.size()); ++Day)
+    {
+        MaxError = std::max(MaxError, std::fabs(Days[Day].Susceptible - Reference[Day].Susceptible));
+        MaxError = std::max(MaxError, std::fabs(Days[Day].Bitten - Reference[Day].Bitten));
+        MaxError = std::max(MaxError, std::fabs(Days[Day].Zombies - Reference[Day].Zombies));
+    }
+    return MaxError;
+}
+
+std::vector<FSDIntegratorBenchmarkRow> RunSDIntegratorBenchmark(const FSDIntegratorBenchmarkConfig& Config)
+{
+    std::vector<FSDIntegratorBenchmarkRow> Rows;
+    FDensityEffectCurve Curve;
+    if (!Curve.Build(Config.GraphPts))
+        return Rows;
+
+    std::vector<FSDDailyStocks> Days;
+    int64_t Evaluations = 0;
+    double Seconds = 0.0;
+
+    // 1. - Reference trajectory
+    FSDParams ReferenceParams = Config.Params;
+    ReferenceParams.Integrator = ESDIntegrator::RK45;
+    ReferenceParams.StepDays = 0.05f;
+    ReferenceParams.Tolerance = 1e-11f;
+    std::vector<FSDDailyStocks> Reference;
+    FSDIntegratorBenchmarkConfig ReferenceConfig = Config;
+    ReferenceConfig.Repeats = 1;
+    RunSDBenchmarkCase(ReferenceConfig, Curve, ReferenceParams, Reference, Evaluations, Seconds);
+
+    auto AddRow = [&](ESDIntegrator Integrator, float StepDays, float Tolerance)
+    {
+        FSDParams Params = Config.Params;
+        Params.Integrator = Integrator;
+        Params.StepDays = StepDays;
+        Params.Tolerance = Tolerance;
+        RunSDBenchmarkCase(Config, Curve, Params, Days, Evaluations, Seconds);
+
+        FSDIntegratorBenchmarkRow Row;
+        Row.Integrator = Integrator;
+        Row.StepDays = StepDays;
+        Row.Tolerance = Tolerance;
+        Row.Evaluations = Evaluations;
+        Row.Seconds = Seconds;
+        Row.MaxError = GetSDMaxError(Days, Reference);
+        Rows.push_back(Row);
+    };
+
+    // 2. - The classic step, then every fixed step size, then every tolerance
+    AddRow(ESDIntegrator::Discrete, 1.f, 0.f);
+    for (const ESDIntegrator Integrator : { ESDIntegrator::Euler, ESDIntegrator::RK4 })
+    {
+        for (const float StepDays : Config.StepDays)
+        {
+            AddRow(Integrator, StepDays, 0.f);
+        }
+    }
+    for (const float Tolerance : Config.Tolerances)
+    {
+        AddRow(ESDIntegrator::RK45, Config.Params.StepDays, Tolerance);
+    }
+    return Rows;
+}
+
+const char* GetSDIntegratorName(ESDIntegrator Integrator)
+{
+    switch (Integrator)
+    {
+    case ESDIntegrator::Discrete: return "Discrete";
+    case ESDIntegrator::Euler:    return "Euler";
+    case ESDIntegrator::RK4:      return "RK4";
+    case ESDIntegrator::RK45:     return "RK45";
+    }
+    return "Unknown";
+}
+
+std::string FormatSDIntegratorBenchmark(const std::vector<FSDIntegratorBenchmarkRow>& Rows)
+{
+    std::string Text = "Integrator,StepDays,Tolerance,Evaluations,Microseconds,MaxError\n";
+    char Line[160];
+    for (const FSDIntegratorBenchmarkRow& Row : Rows)
+    {
+        std::snprintf(Line, sizeof(Line), "%s,%g,%g,%lld,%.1f,%.3e\n", GetSDIntegratorName(Row.Integrator), Row.StepDays, Row.Tolerance,
+            static_cast<long long>(Row.Evaluations), Row.Seconds * 1e6, Row.MaxError);
+        Text += Line;
+    }
+    return Text;
+}
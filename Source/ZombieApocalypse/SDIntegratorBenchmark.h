@@ -0,0 +1,53 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "SDModel.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Error against cost for every integrator on one scenario.
+ *
+ * The reference is RK45 at a tolerance far below anything benchmarked. Each
+ * row runs one integrator at one step size or tolerance for NumDays and
+ * reports the worst daily difference to the reference over all three stocks,
+ * in people, next to the right-hand side evaluations and wall time it took.
+ * Pick the cheapest row under the accuracy you need.
+ */
+struct FSDIntegratorBenchmarkConfig
+{
+	FSDParams Params;
+	FSDState InitialState;
+	std::vector<std::pair<float, float>> GraphPts;
+	int32_t NumDays{ 50 };
+
+	/** Euler and RK4 are run at each of these. */
+	std::vector<float> StepDays{ 1.f, 0.5f, 0.25f, 0.1f, 0.05f, 0.01f };
+
+	/** RK45 is run at each of these, with Params.StepDays as its largest step. */
+	std::vector<float> Tolerances{ 1e-2f, 1e-3f, 1e-4f, 1e-5f, 1e-6f, 1e-7f };
+
+	/** Runs per row, the fastest is reported. */
+	int32_t Repeats{ 5 };
+};
+
+struct FSDIntegratorBenchmarkRow
+{
+	ESDIntegrator Integrator{ ESDIntegrator::Discrete };
+	float StepDays{ 1.f };
+	float Tolerance{ 0.f };
+	int64_t Evaluations{ 0 };
+	double Seconds{ 0.0 };
+	double MaxError{ 0.0 };
+};
+
+/** One Discrete row, then Euler, RK4 and RK45 rows. Empty if GraphPts is invalid. */
+std::vector<FSDIntegratorBenchmarkRow> RunSDIntegratorBenchmark(const FSDIntegratorBenchmarkConfig& Config);
+
+const char* GetSDIntegratorName(ESDIntegrator Integrator);
+
+/** Header line plus one comma separated line per row. */
+std::string FormatSDIntegratorBenchmark(const std::vector<FSDIntegratorBenchmarkRow>& Rows);
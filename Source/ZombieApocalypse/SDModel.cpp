@@ -0,0 +1,160 @@
+// Copyright University of Inland Norway
+
+#include "SDModel.h"
+#include "SimulationSnapshot.h"
+#include <algorithm>
+#include <cmath>
+
+// Same rounding as FMath::RoundToFloat, so the engine matches the old actor step bit for bit
+static inline float SDRoundToFloat(float F)
+{
+    return std::floor(F + 0.5f);
+}
+
+void FSDEngine::SetParams(const FSDParams& InParams)
+{
+    Params = InParams;
+    Conveyor.SetDelay(Params.DaysToBecomeInfectedFromBite, Params.DelayMode, Params.DelaySpreadDays);
+    Continuous.SetParams(Params);
+}
+
+void FSDEngine::Reset(const FSDState& InitialState)
+{
+    State = InitialState;
+    LastFlows = FSDFlows();
+    Conveyor.Clear();
+
+    ActiveIntegrator = Params.Integrator;
+    Continuous.Reset(InitialState.Susceptible, InitialState.Zombies);
+    if (ActiveIntegrator != ESDIntegrator::Discrete)
+    {
+        // Bitten starts from an empty conveyor in both models
+        State.Bitten = 0.f;
+    }
+}
+
+void FSDEngine::SetStocks(float InSusceptible, float InZombies)
+{
+    // The continuous model keeps doubles, only hand it values that were actually changed from outside
+    if (ActiveIntegrator != ESDIntegrator::Discrete && (InSusceptible != State.Susceptible || InZombies != State.Zombies))
+    {
+        Continuous.SetStocks(InSusceptible, InZombies);
+    }
+
+    State.Susceptible = InSusceptible;
+    State.Zombies = InZombies;
+}
+
+void FSDEngine::SaveState(FSnapshotWriter& Writer) const
+{
+    Writer.Write(State);
+    Writer.Write(LastFlows);
+    Writer.Write(ActiveIntegrator);
+    Conveyor.SaveState(Writer);
+    Continuous.SaveState(Writer);
+}
+
+bool FSDEngine::LoadState(FSnapshotReader& Reader)
+{
+    // Read into a copy so a truncated snapshot cannot leave half a state behind
+    FSDEngine Loaded = *this;
+    if (!Reader.Read(Loaded.State) || !Reader.Read(Loaded.LastFlows) || !Reader.Read(Loaded.ActiveIntegrator)
+        || !Loaded.Conveyor.LoadState(Reader) || !Loaded.Continuous.LoadState(Reader))
+    {
+        return false;
+    }
+
+    *this = std::move(Loaded);
+    return true;
+}
+
+void FSDEngine::Run(int32_t NumDays)
+{
+    for (int32_t Day = 0; Day < NumDays; ++Day)
+    {
+        Step();
+    }
+}
+
+void FSDEngine::Step()
+{
+    if (ActiveIntegrator == ESDIntegrator::Discrete)
+    {
+        // An infinite capacity can never clamp the inflow, that variant leaves the clamp out
+        DispatchSDStepPolicy(Params.bWholePeople, !std::isinf(Params.BittenCapacity), [this](auto Policy)
+        {
+            StepDiscrete<decltype(Policy)>();
+        });
+        return;
+    }
+
+    Continuous.AdvanceDay(Curve, LastFlows);
+    State.Susceptible = static_cast<float>(Continuous.GetSusceptible());
+    State.Bitten = static_cast<float>(Continuous.GetBitten());
+    State.Zombies = static_cast<float>(Continuous.GetZombies());
+    ++State.Day;
+}
+
+template <typename TPolicy>
+void FSDEngine::StepDiscrete()
+{
+    float& Susceptible = State.Susceptible;
+    float& Bitten = State.Bitten;
+    float& Zombies = State.Zombies;
+
+    // 1. - Update bitten
+    Bitten = ConveyorContent();
+
+    // 2. - Auxiliaries
+    const float NonZombiePopulation = Bitten + Susceptible;
+    const float PopulationDensity   = NonZombiePopulation / Params.LandArea;
+    const float X                   = PopulationDensity / Params.NormalPopulationDensity;
+
+    const float DensityEffect = GraphLookup(X);
+    const float BitesPerZombieDay = Params.NormalNumberOfBites * DensityEffect;
+
+    float TotalBittenPerDay = Zombies * BitesPerZombieDay;
+    if (TPolicy::bWholePeople)
+        TotalBittenPerDay = SDRoundToFloat(TotalBittenPerDay);
+
+    const float Denom = std::max(NonZombiePopulation, 1.f);
+    float BitesOnSusceptible = (Susceptible / Denom) * TotalBittenPerDay;
+    if (TPolicy::bWholePeople)
+        BitesOnSusceptible = SDRoundToFloat(BitesOnSusceptible);
+
+    // 3. - Getting bitten
+    const float GettingBitten = std::min(BitesOnSusceptible, TPolicy::bWholePeople ? std::floor(Susceptible) : Susceptible);
+
+    // 4. - CONVEYOR MECHANICS
+    // 4.1 - Advance the delay line, the slot that falls off is the raw outflow
+    const float RawOutflowPeople = Conveyor.Advance();
+
+    // 4.2 - inflow
+    float InflowPeople = std::max(0.f, GettingBitten);
+    if (TPolicy::bCapacityLimit)
+    {
+        const float CurrentContent = Conveyor.GetContent();
+        const float FreeCapacity = std::max(0.f, Params.BittenCapacity - CurrentContent);
+        InflowPeople = std::max(0.f, std::min(GettingBitten, FreeCapacity));
+    }
+
+    if (InflowPeople > 0.f)
+    {
+        Conveyor.Add(InflowPeople);
+    }
+
+    // 4.3 - Outflow -> New Zombie
+    const float BecomingInfected = RawOutflowPeople;
+
+    // 5 - STOCK UPDATES
+    Susceptible = std::max(0.f, Susceptible - GettingBitten);
+    Zombies = std::max(0.f, Zombies + BecomingInfected);
+
+    Bitten = ConveyorContent();
+
+    LastFlows.DensityEffect = DensityEffect;
+    LastFlows.GettingBitten = GettingBitten;
+    LastFlows.Inflow = InflowPeople;
+    LastFlows.BecomingInfected = BecomingInfected;
+    ++State.Day;
+}
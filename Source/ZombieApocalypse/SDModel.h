@@ -0,0 +1,160 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "DensityEffectCurve.h"
+#include "SDConveyor.h"
+#include "SDIntegrator.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Engine-free core of the zombie stock-and-flow (SD) model.
+ *
+ * Nothing in this header depends on CoreMinimal or UObject, so the exact step
+ * that ASimulationController runs once per simulated day can also be linked
+ * into a plain C++ executable and stepped as fast as the CPU allows.
+ */
+
+/** Model constants, mirrors the "Simulation Constants" on ASimulationController. */
+struct FSDParams
+{
+	float DaysToBecomeInfectedFromBite{ 15.f };
+	float BittenCapacity{ 100.f };
+	float NormalNumberOfBites{ 1.f };
+	float LandArea{ 1000.f };
+	float NormalPopulationDensity{ 0.1f };
+
+	/** How DaysToBecomeInfectedFromBite maps onto whole days, Discrete is the classic model. */
+	ESDConveyorDelay DelayMode{ ESDConveyorDelay::Discrete };
+	float DelaySpreadDays{ 0.f };
+
+	/** Discrete integrator only: off lets the daily step move fractional people instead of rounding every flow. */
+	bool bWholePeople{ true };
+
+	/** Picked up by Reset, Discrete keeps the classic whole-people step and ignores the two below. */
+	ESDIntegrator Integrator{ ESDIntegrator::Discrete };
+
+	/** Euler and RK4 step size in days (rounded to a whole number of steps per day), the largest step RK45 may take. */
+	float StepDays{ 1.f };
+
+	/** RK45 error allowed per step, relative to the size of each stock. */
+	float Tolerance{ 1e-4f };
+};
+
+/** The three stocks plus the number of days simulated so far. */
+struct FSDState
+{
+	float Susceptible{ 100.f };
+	float Bitten{ 0.f };
+	float Zombies{ 1.f };
+	int32_t Day{ 0 };
+};
+
+/**
+ * Compile-time shape of the discrete day step, so each variant compiles without the branches of the others.
+ * WholePeople rounds the flows like the classic model. Without CapacityLimit the BittenCapacity clamp is
+ * left out, which callers only pick when it is infinite or provably cannot bind.
+ */
+template <bool bInWholePeople, bool bInCapacityLimit>
+struct TSDStepPolicy
+{
+	static constexpr bool bWholePeople = bInWholePeople;
+	static constexpr bool bCapacityLimit = bInCapacityLimit;
+};
+
+/**
+ * Calls Body with the TSDStepPolicy matching the runtime flags, the one place a
+ * step kernel goes from runtime settings to its compiled variant.
+ */
+template <typename FBody>
+void DispatchSDStepPolicy(bool bWholePeople, bool bCapacityLimit, FBody&& Body)
+{
+	if (bWholePeople)
+	{
+		if (bCapacityLimit)
+			Body(TSDStepPolicy<true, true>());
+		else
+			Body(TSDStepPolicy<true, false>());
+	}
+	else
+	{
+		if (bCapacityLimit)
+			Body(TSDStepPolicy<false, true>());
+		else
+			Body(TSDStepPolicy<false, false>());
+	}
+}
+
+/** Flows of the most recent step, useful for logging and output. */
+struct FSDFlows
+{
+	float DensityEffect{ 0.f };
+	float GettingBitten{ 0.f };
+	float Inflow{ 0.f };
+	float BecomingInfected{ 0.f };
+};
+
+class FSDEngine
+{
+public:
+	FSDEngine() { SetParams(Params); }
+
+	void SetParams(const FSDParams& InParams);
+	const FSDParams& GetParams() const { return Params; }
+
+	/**
+	 * Density effect curve as (PopulationDensity, NormalPopulationDensity) points.
+	 * Invalid tables are rejected with a reason and leave the current curve in place.
+	 */
+	bool SetGraph(const std::vector<std::pair<float, float>>& InGraphPts, std::string* OutError = nullptr) { return Curve.Build(InGraphPts, 0, OutError); }
+	void SetCurve(const FDensityEffectCurve& InCurve) { Curve = InCurve; }
+	const FDensityEffectCurve& GetCurve() const { return Curve; }
+	const std::vector<std::pair<float, float>>& GetGraph() const { return Curve.GetSourcePoints(); }
+
+	/** Empties the conveyor and starts over from the given stocks, with the integrator from the current params. */
+	void Reset(const FSDState& InitialState);
+
+	/** Overrides the Susceptible and Zombies stocks without touching the conveyor. */
+	void SetStocks(float InSusceptible, float InZombies);
+
+	/** Advances the model by one day, in one step or many depending on the integrator. */
+	void Step();
+
+	/** Advances the model by NumDays days. */
+	void Run(int32_t NumDays);
+
+	const FSDState& GetState() const { return State; }
+	const FSDFlows& GetLastFlows() const { return LastFlows; }
+
+	float GraphLookup(float X) const { return Curve.Evaluate(X); }
+	float ConveyorContent() const { return Conveyor.GetContent(); }
+	const FSDConveyor& GetConveyor() const { return Conveyor; }
+
+	ESDIntegrator GetIntegrator() const { return ActiveIntegrator; }
+
+	/** The continuous model behind every integrator but Discrete, in full precision. */
+	const FSDContinuousModel& GetContinuous() const { return Continuous; }
+
+	/**
+	 * Everything Step changes: stocks, the conveyor, the continuous model and the integrator in use.
+	 * Params and the curve are left to the caller. A failed load leaves the engine as it was.
+	 */
+	void SaveState(FSnapshotWriter& Writer) const;
+	bool LoadState(FSnapshotReader& Reader);
+
+private:
+	template <typename TPolicy>
+	void StepDiscrete();
+
+	FSDParams Params;
+	FSDState State;
+	FSDFlows LastFlows;
+
+	FDensityEffectCurve Curve;
+	FSDConveyor Conveyor;
+
+	FSDContinuousModel Continuous;
+	ESDIntegrator ActiveIntegrator{ ESDIntegrator::Discrete };
+};
@@ -0,0 +1,283 @@
+// Copyright University of Inland Norway
+
+#include "SDSweep.h"
+#include "SDBatchEngine.h"
+#include "ScenarioFile.h"
+#include "TrajectoryWriter.h"
+#include "WorkStealingPool.h"
+#include "ZombieSimStats.h"
+#include <algorithm>
+#include <limits>
+
+// Records a chunk buffers before handing them to the writer in one locked append
+static constexpr size_t SweepOutputBatch = 1 << 14;
+
+static FTrajectoryRecord MakeSweepRecord(int64_t Scenario, int32_t Day, float Susceptible, float Bitten, float Zombies)
+{
+    const float NoFlow = std::numeric_limits<float>::quiet_NaN();
+    return { Scenario, Day, Susceptible, Bitten, Zombies, NoFlow, NoFlow, NoFlow };
+}
+
+static void FlushSweepOutput(const FSDSweepConfig& Config, std::vector<FTrajectoryRecord>& Records, bool bForce)
+{
+    if (Records.empty() || (!bForce && Records.size() < SweepOutputBatch))
+        return;
+
+    Config.Output->Append(Records.data(), Records.size());
+    Records.clear();
+}
+
+static size_t AxisSize(const std::vector<float>& Axis)
+{
+    return Axis.empty() ? 1 : Axis.size();
+}
+
+// Picks the next digit of a mixed-radix index off one axis
+static float TakeAxisValue(const std::vector<float>& Axis, float Fallback, int64_t& Index)
+{
+    if (Axis.empty())
+        return Fallback;
+
+    const int64_t Size = static_cast<int64_t>(Axis.size());
+    const float Value = Axis[static_cast<size_t>(Index % Size)];
+    Index /= Size;
+    return Value;
+}
+
+int64_t FSDParamGrid::NumScenarios() const
+{
+    return static_cast<int64_t>(AxisSize(DaysToBecomeInfectedFromBite))
+        * static_cast<int64_t>(AxisSize(BittenCapacity))
+        * static_cast<int64_t>(AxisSize(NormalNumberOfBites))
+        * static_cast<int64_t>(AxisSize(LandArea))
+        * static_cast<int64_t>(AxisSize(NormalPopulationDensity));
+}
+
+FSDParams FSDParamGrid::GetScenario(int64_t Index) const
+{
+    FSDParams Params;
+    Params.DaysToBecomeInfectedFromBite = TakeAxisValue(DaysToBecomeInfectedFromBite, Base.DaysToBecomeInfectedFromBite, Index);
+    Params.BittenCapacity = TakeAxisValue(BittenCapacity, Base.BittenCapacity, Index);
+    Params.NormalNumberOfBites = TakeAxisValue(NormalNumberOfBites, Base.NormalNumberOfBites, Index);
+    Params.LandArea = TakeAxisValue(LandArea, Base.LandArea, Index);
+    Params.NormalPopulationDensity = TakeAxisValue(NormalPopulationDensity, Base.NormalPopulationDensity, Index);
+    return Params;
+}
+
+// SplitMix64, cheap and stateless so any scenario can be generated on any thread
+static uint64_t SweepSplitMix64(uint64_t& State)
+{
+    uint64_t Z = (State += 0x9E3779B97F4A7C15ull);
+    Z = (Z ^ (Z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    Z = (Z ^ (Z >> 27)) * 0x94D049BB133111EBull;
+    return Z ^ (Z >> 31);
+}
+
+static float SweepLerp(float A, float B, uint64_t& State)
+{
+    const float T = static_cast<float>(SweepSplitMix64(State) >> 40) * (1.f / 16777216.f);
+    return A + (B - A) * T;
+}
+
+FSDParams FSDParamRanges::GetScenario(int64_t Index) const
+{
+    uint64_t State = Seed ^ (static_cast<uint64_t>(Index) * 0xD1B54A32D192ED03ull);
+
+    FSDParams Params;
+    Params.DaysToBecomeInfectedFromBite = SweepLerp(Min.DaysToBecomeInfectedFromBite, Max.DaysToBecomeInfectedFromBite, State);
+    Params.BittenCapacity = SweepLerp(Min.BittenCapacity, Max.BittenCapacity, State);
+    Params.NormalNumberOfBites = SweepLerp(Min.NormalNumberOfBites, Max.NormalNumberOfBites, State);
+    Params.LandArea = SweepLerp(Min.LandArea, Max.LandArea, State);
+    Params.NormalPopulationDensity = SweepLerp(Min.NormalPopulationDensity, Max.NormalPopulationDensity, State);
+    return Params;
+}
+
+// Index into the compiled curves, 0 is GraphPts
+static size_t PickSweepCurve(const FSDSweepConfig& Config, int64_t Scenario)
+{
+    if (!Config.CurveOf)
+        return 0;
+
+    const int32_t Curve = Config.CurveOf(Scenario);
+    return Curve >= 0 && static_cast<size_t>(Curve) < Config.Curves.size() ? static_cast<size_t>(Curve) + 1 : 0;
+}
+
+static void RunScalarChunk(const FSDSweepConfig& Config, const std::vector<FDensityEffectCurve>& Curves, const FSDScenarioSource& Source, int64_t Begin, int64_t End, FSDSweepResult& Result)
+{
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_SweepChunk);
+    const int32_t RecordEvery = std::max(1, Config.RecordEvery);
+    const int32_t NumDays = std::max(0, Config.NumDays);
+
+    // One engine per chunk, the curve is only copied in again when the scenario switches curves
+    FSDEngine Engine;
+    size_t EngineCurve = 0;
+    Engine.SetCurve(Curves[0]);
+
+    std::vector<FTrajectoryRecord> Records;
+
+    for (int64_t Scenario = Begin; Scenario < End; ++Scenario)
+    {
+        const size_t Curve = PickSweepCurve(Config, Scenario);
+        if (Curve != EngineCurve)
+        {
+            Engine.SetCurve(Curves[Curve]);
+            EngineCurve = Curve;
+        }
+        Engine.SetParams(Source(Scenario));
+        Engine.Reset(Config.InitialState);
+
+        FSDTrajectoryPoint* Out = Result.Trajectories.data() + Scenario * Result.SamplesPerScenario;
+        const FSDState& State = Engine.GetState();
+        auto Record = [&](int32_t Day)
+        {
+            if (Day == NumDays || (Config.bKeepTrajectories && Day % RecordEvery == 0))
+            {
+                *Out++ = { State.Susceptible, State.Bitten, State.Zombies };
+            }
+            if (Config.Output)
+            {
+                // Nothing has flowed yet on day 0
+                const FSDFlows& Flows = Engine.GetLastFlows();
+                Records.push_back({ Scenario, Day, State.Susceptible, State.Bitten, State.Zombies,
+                    Day > 0 ? Flows.Inflow : 0.f, Day > 0 ? Flows.BecomingInfected : 0.f, Day > 0 ? Flows.DensityEffect : 0.f });
+            }
+        };
+
+        Record(0);
+        for (int32_t Day = 1; Day <= NumDays; ++Day)
+        {
+            Engine.Step();
+            if (Day % RecordEvery == 0 || Day == NumDays)
+            {
+                Record(Day);
+            }
+        }
+
+        if (Config.Output)
+        {
+            FlushSweepOutput(Config, Records, false);
+        }
+    }
+
+    if (Config.Output)
+    {
+        FlushSweepOutput(Config, Records, true);
+    }
+}
+
+FSDSweepResult RunSDSweep(const FSDSweepConfig& Config, int64_t NumScenarios, const FSDScenarioSource& Source, FWorkStealingPool* Pool)
+{
+    FSDSweepResult Result;
+    std::vector<FDensityEffectCurve> Curves(1 + Config.Curves.size());
+    if (NumScenarios <= 0 || !Curves[0].Build(Config.GraphPts))
+        return Result;
+    for (size_t Curve = 0; Curve < Config.Curves.size(); ++Curve)
+    {
+        if (!Curves[Curve + 1].Build(Config.Curves[Curve]))
+            return Result;
+    }
+
+    const int32_t RecordEvery = std::max(1, Config.RecordEvery);
+    const int32_t NumDays = std::max(0, Config.NumDays);
+
+    Result.NumScenarios = NumScenarios;
+    // The final day is its own sample when RecordEvery does not divide NumDays
+    Result.SamplesPerScenario = Config.bKeepTrajectories ? 1 + (NumDays + RecordEvery - 1) / RecordEvery : 1;
+    Result.Trajectories.resize(static_cast<size_t>(NumScenarios * Result.SamplesPerScenario));
+
+    FWorkStealingPool& Workers = Pool ? *Pool : FWorkStealingPool::Get();
+
+    if (Config.bVectorized)
+    {
+        // Chunks are whole multiples of the lane width so only the last one has padding
+        const int64_t Grain = static_cast<int64_t>(FSDBatchEngine::GetLaneWidth()) * 64;
+        Workers.ParallelFor(NumScenarios, Grain, [&](int64_t Begin, int64_t End)
+        {
+            std::vector<FSDParams> Scenarios;
+            Scenarios.reserve(static_cast<size_t>(End - Begin));
+            const size_t ChunkCurve = PickSweepCurve(Config, Begin);
+            for (int64_t Scenario = Begin; Scenario < End; ++Scenario)
+            {
+                // The lanes share one curve and one rounding
+                Scenarios.push_back(Source(Scenario));
+                if (Scenarios.back().DelayMode != ESDConveyorDelay::Discrete || Scenarios.back().Integrator != ESDIntegrator::Discrete
+                    || Scenarios.back().bWholePeople != Scenarios.front().bWholePeople || PickSweepCurve(Config, Scenario) != ChunkCurve)
+                {
+                    RunScalarChunk(Config, Curves, Source, Begin, End, Result);
+                    return;
+                }
+            }
+
+            ZOMBIESIM_SCOPE(STAT_ZombieSim_SweepChunk);
+            FSDBatchEngine Engine;
+            Engine.SetCurve(Curves[ChunkCurve]);
+            Engine.Reset(Scenarios, Config.InitialState);
+
+            const int32_t Count = static_cast<int32_t>(End - Begin);
+            std::vector<FTrajectoryRecord> Records;
+            auto Record = [&](int32_t Day)
+            {
+                if (Day == NumDays || (Config.bKeepTrajectories && Day % RecordEvery == 0))
+                {
+                    const int32_t Sample = Day == NumDays ? Result.SamplesPerScenario - 1 : Day / RecordEvery;
+                    for (int32_t Lane = 0; Lane < Count; ++Lane)
+                    {
+                        Result.Trajectories[static_cast<size_t>((Begin + Lane) * Result.SamplesPerScenario + Sample)] =
+                            { Engine.GetSusceptible()[Lane], Engine.GetBitten()[Lane], Engine.GetZombies()[Lane] };
+                    }
+                }
+                if (Config.Output)
+                {
+                    for (int32_t Lane = 0; Lane < Count; ++Lane)
+                    {
+                        Records.push_back(MakeSweepRecord(Begin + Lane, Day, Engine.GetSusceptible()[Lane], Engine.GetBitten()[Lane], Engine.GetZombies()[Lane]));
+                    }
+                    FlushSweepOutput(Config, Records, false);
+                }
+            };
+
+            Record(0);
+            for (int32_t Day = 1; Day <= NumDays; ++Day)
+            {
+                Engine.Step();
+                if (Day % RecordEvery == 0 || Day == NumDays)
+                {
+                    Record(Day);
+                }
+            }
+
+            if (Config.Output)
+            {
+                FlushSweepOutput(Config, Records, true);
+            }
+        });
+        return Result;
+    }
+
+    Workers.ParallelFor(NumScenarios, 0, [&](int64_t Begin, int64_t End)
+    {
+        RunScalarChunk(Config, Curves, Source, Begin, End, Result);
+    });
+
+    return Result;
+}
+
+FSDSweepResult RunSDSweep(const FSDSweepConfig& Config, const FSDParamGrid& Grid, FWorkStealingPool* Pool)
+{
+    return RunSDSweep(Config, Grid.NumScenarios(), [&Grid](int64_t Index) { return Grid.GetScenario(Index); }, Pool);
+}
+
+FSDSweepResult RunSDSweep(const FSDSweepConfig& Config, const FSDParamRanges& Ranges, int64_t NumSamples, FWorkStealingPool* Pool)
+{
+    return RunSDSweep(Config, NumSamples, [&Ranges](int64_t Index) { return Ranges.GetScenario(Index); }, Pool);
+}
+
+FSDSweepResult RunSDSweep(const FSDSweepConfig& Config, const FScenarioFile& File, FWorkStealingPool* Pool)
+{
+    if (!File.HasCurveColumn())
+        return RunSDSweep(Config, File.GetNumScenarios(), [&File](int64_t Index) { return File.GetScenario(Index); }, Pool);
+
+    FSDSweepConfig FileConfig = Config;
+    FileConfig.CurveOf = [&File](int64_t Index) { return File.GetCurveIndex(Index); };
+    return RunSDSweep(FileConfig, File.GetNumScenarios(), [&File](int64_t Index) { return File.GetScenario(Index); }, Pool);
+}
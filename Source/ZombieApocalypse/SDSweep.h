@@ -0,0 +1,116 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "SDModel.h"
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+class FScenarioFile;
+class FTrajectoryWriter;
+class FWorkStealingPool;
+
+/**
+ * Parameter sweeps over the SD model.
+ *
+ * Every scenario gets its own FSDEngine and runs on the shared work-stealing
+ * pool, results land in one preallocated block so workers never contend.
+ */
+
+/** Full factorial grid, every combination of the listed values is one scenario. */
+struct FSDParamGrid
+{
+	std::vector<float> DaysToBecomeInfectedFromBite;
+	std::vector<float> BittenCapacity;
+	std::vector<float> NormalNumberOfBites;
+	std::vector<float> LandArea;
+	std::vector<float> NormalPopulationDensity;
+
+	/** An empty axis counts as a single value taken from Base. */
+	FSDParams Base;
+
+	int64_t NumScenarios() const;
+	FSDParams GetScenario(int64_t Index) const;
+};
+
+/** Uniform random samples, scenario i is always the same for a given Seed. */
+struct FSDParamRanges
+{
+	FSDParams Min;
+	FSDParams Max;
+	uint64_t Seed{ 0 };
+
+	FSDParams GetScenario(int64_t Index) const;
+};
+
+struct FSDSweepConfig
+{
+	int32_t NumDays{ 50 };
+
+	/** Record every Nth day, the initial state is always the first sample and the final day always the last. */
+	int32_t RecordEvery{ 1 };
+
+	/**
+	 * Step scenarios in SIMD lanes with FSDBatchEngine instead of one FSDEngine each.
+	 * Only the discrete conveyor delay and integrator are vectorized, chunks containing
+	 * other modes or mixing bWholePeople quietly fall back to FSDEngine.
+	 */
+	bool bVectorized{ false };
+
+	/** Every recorded day of every scenario is also streamed here, flows are NaN for vectorized chunks. */
+	FTrajectoryWriter* Output{ nullptr };
+
+	/** Off keeps only the final state in the result, for sweeps too large to hold in memory that stream to Output instead. */
+	bool bKeepTrajectories{ true };
+
+	FSDState InitialState;
+	std::vector<std::pair<float, float>> GraphPts;
+
+	/** Further density effect curves, scenario i uses Curves[CurveOf(i)] and GraphPts when CurveOf is unset or out of range. */
+	std::vector<std::vector<std::pair<float, float>>> Curves;
+	std::function<int32_t(int64_t Index)> CurveOf;
+};
+
+struct FSDTrajectoryPoint
+{
+	float Susceptible;
+	float Bitten;
+	float Zombies;
+};
+
+struct FSDSweepResult
+{
+	int64_t NumScenarios{ 0 };
+	int32_t SamplesPerScenario{ 0 };
+
+	/** Scenario-major, SamplesPerScenario points per scenario: day 0, every RecordEvery-th day, then day NumDays if not already in. */
+	std::vector<FSDTrajectoryPoint> Trajectories;
+
+	const FSDTrajectoryPoint* GetTrajectory(int64_t Scenario) const
+	{
+		return Trajectories.data() + Scenario * SamplesPerScenario;
+	}
+
+	/** State after NumDays, whatever RecordEvery was. */
+	const FSDTrajectoryPoint& GetFinal(int64_t Scenario) const
+	{
+		return GetTrajectory(Scenario)[SamplesPerScenario - 1];
+	}
+};
+
+using FSDScenarioSource = std::function<FSDParams(int64_t Index)>;
+
+/**
+ * Runs NumScenarios scenarios produced by Source, on the default pool unless one is given.
+ * Curves are compiled once up front; an invalid GraphPts or entry of Curves gives an empty result.
+ */
+FSDSweepResult RunSDSweep(const FSDSweepConfig& Config, int64_t NumScenarios, const FSDScenarioSource& Source, FWorkStealingPool* Pool = nullptr);
+
+FSDSweepResult RunSDSweep(const FSDSweepConfig& Config, const FSDParamGrid& Grid, FWorkStealingPool* Pool = nullptr);
+
+FSDSweepResult RunSDSweep(const FSDSweepConfig& Config, const FSDParamRanges& Ranges, int64_t NumSamples, FWorkStealingPool* Pool = nullptr);
+
+/** Scenarios read on demand from a mapped file, its Curve column (if any) indexes Config.Curves. */
+FSDSweepResult RunSDSweep(const FSDSweepConfig& Config, const FScenarioFile& File, FWorkStealingPool* Pool = nullptr);
@@ -0,0 +1,466 @@
+// Copyright University of Inland Norway
+
+#include "ScenarioFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+static constexpr char ScenarioFileMagic[4] = { 'Z', 'S', 'C', 'N' };
+static constexpr uint32_t ScenarioFileVersion = 2;
+
+// Name slot per column, version 1 had 16 bytes and cut the longer field names
+static constexpr size_t ScenarioFileNameBytes = 32;
+
+// Rows between CSV index entries, a cold lookup scans at most this many lines
+static constexpr int64_t ScenarioFileIndexStride = 256;
+
+// Columns a scenario file can set, by index
+static const char* const ScenarioFieldNames[] =
+{
+    "DaysToBecomeInfectedFromBite",
+    "BittenCapacity",
+    "NormalNumberOfBites",
+    "LandArea",
+    "NormalPopulationDensity",
+    "DelayMode",
+    "DelaySpreadDays",
+    "Integrator",
+    "StepDays",
+    "Tolerance",
+    "bWholePeople",
+    "Curve",
+};
+static constexpr int32_t NumScenarioFields = sizeof(ScenarioFieldNames) / sizeof(ScenarioFieldNames[0]);
+static constexpr int32_t ScenarioCurveField = NumScenarioFields - 1;
+
+static std::atomic<uint64_t> NextScenarioFileId{ 1 };
+
+// Where the calling thread stopped reading, sweeps walk their ranges in order
+struct FScenarioFileCursor
+{
+    uint64_t FileId{ 0 };
+    int64_t Row{ -1 };
+    const uint8_t* Line{ nullptr };
+};
+static thread_local FScenarioFileCursor ScenarioFileCursor;
+
+static const uint8_t* FindScenarioLineEnd(const uint8_t* Line, const uint8_t* End)
+{
+    const void* Newline = std::memchr(Line, '\n', static_cast<size_t>(End - Line));
+    return Newline ? static_cast<const uint8_t*>(Newline) : End;
+}
+
+// Start of the line after Line, blank lines are skipped so they never count as rows
+static const uint8_t* NextScenarioLine(const uint8_t* Line, const uint8_t* End)
+{
+    Line = FindScenarioLineEnd(Line, End);
+    while (Line < End)
+    {
+        ++Line;
+        if (Line < End && *Line != '\n' && *Line != '\r')
+            break;
+    }
+    return Line;
+}
+
+// Splits one line into trimmed cells, quotes and a trailing '\r' are dropped
+static void SplitScenarioLine(const uint8_t* Line, const uint8_t* End, std::vector<std::pair<const char*, size_t>>& OutCells)
+{
+    OutCells.clear();
+    const uint8_t* LineEnd = FindScenarioLineEnd(Line, End);
+    const char* Cell = reinterpret_cast<const char*>(Line);
+    const char* const Stop = reinterpret_cast<const char*>(LineEnd);
+    for (;;)
+    {
+        const char* CellEnd = Cell;
+        while (CellEnd < Stop && *CellEnd != ',')
+        {
+            ++CellEnd;
+        }
+
+        const char* First = Cell;
+        const char* Last = CellEnd;
+        while (First < Last && (*First == ' ' || *First == '\t' || *First == '"')) ++First;
+        while (Last > First && (Last[-1] == ' ' || Last[-1] == '\t' || Last[-1] == '"' || Last[-1] == '\r')) --Last;
+        OutCells.emplace_back(First, static_cast<size_t>(Last - First));
+
+        if (CellEnd >= Stop)
+            break;
+        Cell = CellEnd + 1;
+    }
+}
+
+// NaN for an empty cell, false if the cell is not a number
+static bool ParseScenarioCell(const char* Cell, size_t Length, float& OutValue)
+{
+    OutValue = std::numeric_limits<float>::quiet_NaN();
+    if (Length == 0)
+        return true;
+
+    // The mapping is not null terminated, strtof gets a bounded copy
+    char Buffer[64];
+    if (Length >= sizeof(Buffer))
+        return false;
+    std::memcpy(Buffer, Cell, Length);
+    Buffer[Length] = '\0';
+
+    char* ParseEnd = nullptr;
+    const float Value = std::strtof(Buffer, &ParseEnd);
+    if (ParseEnd != Buffer + Length)
+        return false;
+    OutValue = Value;
+    return true;
+}
+
+static int32_t FindScenarioField(const std::string& Name)
+{
+    for (int32_t Field = 0; Field < NumScenarioFields; ++Field)
+    {
+        if (Name == ScenarioFieldNames[Field])
+            return Field;
+    }
+    return -1;
+}
+
+FScenarioFile::FScenarioFile()
+    : Id(NextScenarioFileId++)
+{
+}
+
+bool FScenarioFile::Open(const std::string& Path, std::string* OutError)
+{
+    Close();
+    if (!File.Open(Path, OutError))
+        return false;
+
+    auto Fail = [&](const std::string& Reason)
+    {
+        if (OutError) *OutError = Path + ": " + Reason;
+        Close();
+        return false;
+    };
+
+    const uint8_t* const Data = File.GetData();
+    const uint8_t* const End = Data + File.GetSize();
+
+    // 1. - Column names, from the binary header or the first CSV line
+    bBinary = File.GetSize() >= sizeof(ScenarioFileMagic) && std::memcmp(Data, ScenarioFileMagic, sizeof(ScenarioFileMagic)) == 0;
+    if (bBinary)
+    {
+        uint32_t Version = 0;
+        uint32_t NumColumns = 0;
+        uint64_t Rows = 0;
+        const size_t Fixed = sizeof(ScenarioFileMagic) + sizeof(Version) + sizeof(NumColumns);
+        if (File.GetSize() < Fixed)
+            return Fail("truncated header");
+        std::memcpy(&Version, Data + 4, sizeof(Version));
+        std::memcpy(&NumColumns, Data + 8, sizeof(NumColumns));
+
+        // Version 1 cut the longer field names, its rows would silently read as Base for those columns
+        if (Version == 1)
+            return Fail("version 1 file with cut column names, convert the CSV again");
+        if (Version != ScenarioFileVersion)
+            return Fail("unsupported version");
+
+        const size_t HeaderSize = Fixed + NumColumns * ScenarioFileNameBytes + sizeof(Rows);
+        if (NumColumns == 0 || File.GetSize() < HeaderSize)
+            return Fail("truncated header");
+
+        for (uint32_t Column = 0; Column < NumColumns; ++Column)
+        {
+            const char* Name = reinterpret_cast<const char*>(Data + Fixed + Column * ScenarioFileNameBytes);
+            ColumnNames.emplace_back(Name, strnlen(Name, ScenarioFileNameBytes));
+        }
+        std::memcpy(&Rows, Data + HeaderSize - sizeof(Rows), sizeof(Rows));
+
+        const uint64_t RowBytes = static_cast<uint64_t>(NumColumns) * sizeof(float);
+        if (Rows > (File.GetSize() - HeaderSize) / RowBytes)
+            return Fail("truncated rows");
+
+        RowData = Data + HeaderSize;
+        NumRows = static_cast<int64_t>(Rows);
+    }
+    else
+    {
+        std::vector<std::pair<const char*, size_t>> Cells;
+        SplitScenarioLine(Data, End, Cells);
+        for (const auto& Cell : Cells)
+        {
+            ColumnNames.emplace_back(Cell.first, Cell.second);
+        }
+
+        // 2. - One pass over the line ends, nothing is parsed until a row is read
+        for (const uint8_t* Line = NextScenarioLine(Data, End); Line < End; Line = NextScenarioLine(Line, End))
+        {
+            if (NumRows % ScenarioFileIndexStride == 0)
+            {
+                RowIndex.push_back(static_cast<size_t>(Line - Data));
+            }
+            ++NumRows;
+        }
+    }
+
+    for (const std::string& Name : ColumnNames)
+    {
+        const int32_t Field = FindScenarioField(Name);
+        if (Field == ScenarioCurveField)
+        {
+            CurveColumn = static_cast<int32_t>(ColumnFields.size());
+        }
+        ColumnFields.push_back(Field);
+    }
+
+    if (std::none_of(ColumnFields.begin(), ColumnFields.end(), [](int32_t Field) { return Field >= 0; }))
+        return Fail("no known columns in the header");
+
+    // A reopened file must not resume from cursors into the old mapping
+    Id = NextScenarioFileId++;
+    return true;
+}
+
+void FScenarioFile::Close()
+{
+    File.Close();
+    bBinary = false;
+    NumRows = 0;
+    ColumnNames.clear();
+    ColumnFields.clear();
+    CurveColumn = -1;
+    RowData = nullptr;
+    RowIndex.clear();
+    MalformedRows = 0;
+}
+
+const uint8_t* FScenarioFile::FindCsvRow(int64_t Index) const
+{
+    const uint8_t* const End = File.GetData() + File.GetSize();
+    FScenarioFileCursor& Cursor = ScenarioFileCursor;
+
+    // Resume from this thread's last row when it is close behind, else start from the index
+    int64_t Row = 0;
+    const uint8_t* Line = nullptr;
+    if (Cursor.FileId == Id && Cursor.Row <= Index && Index - Cursor.Row < ScenarioFileIndexStride)
+    {
+        Row = Cursor.Row;
+        Line = Cursor.Line;
+    }
+    else
+    {
+        const size_t Entry = static_cast<size_t>(Index / ScenarioFileIndexStride);
+        Row = static_cast<int64_t>(Entry) * ScenarioFileIndexStride;
+        Line = File.GetData() + RowIndex[Entry];
+    }
+
+    for (; Row < Index; ++Row)
+    {
+        Line = NextScenarioLine(Line, End);
+    }
+
+    Cursor.FileId = Id;
+    Cursor.Row = Index;
+    Cursor.Line = Line;
+    return Line;
+}
+
+bool FScenarioFile::ReadRow(int64_t Index, float* Values) const
+{
+    const size_t NumColumns = ColumnFields.size();
+    if (bBinary)
+    {
+        std::memcpy(Values, RowData + static_cast<size_t>(Index) * NumColumns * sizeof(float), NumColumns * sizeof(float));
+        return true;
+    }
+
+    static thread_local std::vector<std::pair<const char*, size_t>> Cells;
+    SplitScenarioLine(FindCsvRow(Index), File.GetData() + File.GetSize(), Cells);
+
+    bool bParsed = Cells.size() == NumColumns;
+    for (size_t Column = 0; Column < NumColumns; ++Column)
+    {
+        if (Column >= Cells.size() || ColumnFields[Column] < 0)
+        {
+            Values[Column] = std::numeric_limits<float>::quiet_NaN();
+            continue;
+        }
+        bParsed &= ParseScenarioCell(Cells[Column].first, Cells[Column].second, Values[Column]);
+    }
+    return bParsed;
+}
+
+FSDParams FScenarioFile::GetScenario(int64_t Index) const
+{
+    FSDParams Params = Base;
+    if (Index < 0 || Index >= NumRows)
+        return Params;
+
+    float Values[64];
+    std::unique_ptr<float[]> Wide;
+    float* Row = Values;
+    if (ColumnFields.size() > 64)
+    {
+        Wide.reset(new float[ColumnFields.size()]);
+        Row = Wide.get();
+    }
+
+    if (!ReadRow(Index, Row))
+    {
+        ++MalformedRows;
+    }
+
+    // Empty or unparsable cells come back as NaN and leave Base alone
+    for (size_t Column = 0; Column < ColumnFields.size(); ++Column)
+    {
+        const float Value = Row[Column];
+        if (std::isnan(Value))
+            continue;
+
+        switch (ColumnFields[Column])
+        {
+        case 0: Params.DaysToBecomeInfectedFromBite = Value; break;
+        case 1: Params.BittenCapacity = Value; break;
+        case 2: Params.NormalNumberOfBites = Value; break;
+        case 3: Params.LandArea = Value; break;
+        case 4: Params.NormalPopulationDensity = Value; break;
+        case 5: Params.DelayMode = static_cast<ESDConveyorDelay>(std::clamp(static_cast<int32_t>(Value), 0, static_cast<int32_t>(ESDConveyorDelay::Distributed))); break;
+        case 6: Params.DelaySpreadDays = Value; break;
+        case 7: Params.Integrator = static_cast<ESDIntegrator>(std::clamp(static_cast<int32_t>(Value), 0, static_cast<int32_t>(ESDIntegrator::RK45))); break;
+        case 8: Params.StepDays = Value; break;
+        case 9: Params.Tolerance = Value; break;
+        case 10: Params.bWholePeople = Value != 0.f; break;
+        default: break;
+        }
+    }
+    return Params;
+}
+
+int32_t FScenarioFile::GetCurveIndex(int64_t Index) const
+{
+    if (CurveColumn < 0 || Index < 0 || Index >= NumRows)
+        return -1;
+
+    float Value = 0.f;
+    if (bBinary)
+    {
+        std::memcpy(&Value, RowData + (static_cast<size_t>(Index) * ColumnFields.size() + CurveColumn) * sizeof(float), sizeof(float));
+    }
+    else
+    {
+        // Usually the row GetScenario just read, so the cursor is already on it
+        static thread_local std::vector<std::pair<const char*, size_t>> Cells;
+        SplitScenarioLine(FindCsvRow(Index), File.GetData() + File.GetSize(), Cells);
+        if (static_cast<size_t>(CurveColumn) >= Cells.size()
+            || !ParseScenarioCell(Cells[CurveColumn].first, Cells[CurveColumn].second, Value))
+            return -1;
+    }
+    return std::isnan(Value) ? -1 : static_cast<int32_t>(Value);
+}
+
+bool FScenarioFile::ConvertCsvToBinary(const std::string& CsvPath, const std::string& BinaryPath, std::string* OutError)
+{
+    FScenarioFile Source;
+    if (!Source.Open(CsvPath, OutError))
+        return false;
+
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> Out(OpenUtf8File(BinaryPath, "wb"), &std::fclose);
+    if (!Out)
+    {
+        if (OutError) *OutError = "cannot create " + BinaryPath;
+        return false;
+    }
+
+    // 1. - Header. Every field name fits its slot; a column the reader would ignore anyway is stored
+    // unnamed rather than cut, so a cut name can never turn into a match
+    const uint32_t NumColumns = static_cast<uint32_t>(Source.ColumnNames.size());
+    const uint64_t Rows = static_cast<uint64_t>(Source.NumRows);
+    bool bWritten = std::fwrite(ScenarioFileMagic, sizeof(ScenarioFileMagic), 1, Out.get()) == 1
+        && std::fwrite(&ScenarioFileVersion, sizeof(ScenarioFileVersion), 1, Out.get()) == 1
+        && std::fwrite(&NumColumns, sizeof(NumColumns), 1, Out.get()) == 1;
+    for (size_t Column = 0; Column < Source.ColumnNames.size(); ++Column)
+    {
+        const std::string& Name = Source.ColumnNames[Column];
+        char Slot[ScenarioFileNameBytes] = {};
+        if (Source.ColumnFields[Column] >= 0)
+        {
+            if (Name.size() > sizeof(Slot))
+            {
+                if (OutError) *OutError = CsvPath + ": column " + Name + " does not fit the binary header";
+                return false;
+            }
+            std::memcpy(Slot, Name.data(), Name.size());
+        }
+        bWritten &= std::fwrite(Slot, sizeof(Slot), 1, Out.get()) == 1;
+    }
+    bWritten &= std::fwrite(&Rows, sizeof(Rows), 1, Out.get()) == 1;
+
+    // 2. - Rows in blocks, empty cells stay NaN so they still fall back to Base
+    std::vector<float> Block;
+    const size_t BlockRows = 4096;
+    for (int64_t Row = 0; Row < Source.NumRows && bWritten; )
+    {
+        const size_t Count = static_cast<size_t>(std::min<int64_t>(BlockRows, Source.NumRows - Row));
+        Block.resize(Count * NumColumns);
+        for (size_t Offset = 0; Offset < Count; ++Offset, ++Row)
+        {
+            if (!Source.ReadRow(Row, Block.data() + Offset * NumColumns))
+            {
+                if (OutError) *OutError = CsvPath + ": row " + std::to_string(Row + 1) + " is malformed";
+                return false;
+            }
+        }
+        bWritten = std::fwrite(Block.data(), sizeof(float), Block.size(), Out.get()) == Block.size();
+    }
+
+    if (!bWritten)
+    {
+        if (OutError) *OutError = "cannot write " + BinaryPath;
+        return false;
+    }
+    return true;
+}
+
+bool FScenarioFile::LoadCurveCsv(const std::string& Path, std::vector<std::pair<float, float>>& OutPoints, std::string* OutError)
+{
+    FMappedFile Curve;
+    if (!Curve.Open(Path, OutError))
+        return false;
+
+    const uint8_t* const Data = Curve.GetData();
+    const uint8_t* const End = Data + Curve.GetSize();
+
+    // 1. - Header, the DataTable export names its key column "---"
+    std::vector<std::pair<const char*, size_t>> Cells;
+    SplitScenarioLine(Data, End, Cells);
+    size_t XColumn = 1;
+    size_t YColumn = 2;
+    for (size_t Column = 0; Column < Cells.size(); ++Column)
+    {
+        const std::string Name(Cells[Column].first, Cells[Column].second);
+        if (Name == "PopulationDensity") XColumn = Column;
+        if (Name == "NormalPopulationDensity") YColumn = Column;
+    }
+
+    // 2. - Points, the curve itself checks their order when it is built
+    OutPoints.clear();
+    int32_t LineNumber = 1;
+    for (const uint8_t* Line = NextScenarioLine(Data, End); Line < End; Line = NextScenarioLine(Line, End))
+    {
+        ++LineNumber;
+        SplitScenarioLine(Line, End, Cells);
+
+        float X = 0.f;
+        float Y = 0.f;
+        if (std::max(XColumn, YColumn) >= Cells.size()
+            || !ParseScenarioCell(Cells[XColumn].first, Cells[XColumn].second, X) || std::isnan(X)
+            || !ParseScenarioCell(Cells[YColumn].first, Cells[YColumn].second, Y) || std::isnan(Y))
+        {
+            if (OutError) *OutError = Path + ": line " + std::to_string(LineNumber) + " is not a curve point";
+            return false;
+        }
+        OutPoints.emplace_back(X, Y);
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "MappedFile.h"
+#include "SDModel.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Sweep scenarios read straight out of a memory-mapped file.
+ *
+ * Two formats, told apart by their first bytes:
+ *   CSV, a header row naming the columns, then one scenario per row. Opening
+ *   only scans for line ends to index every ScenarioFileIndexStride-th row, a
+ *   row's numbers are parsed when it is asked for, and each thread resumes from
+ *   the row it read last, so the sequential ranges a sweep hands out parse
+ *   every row exactly once.
+ *   Binary (see ConvertCsvToBinary), "ZSCN", uint32 version, uint32 column
+ *   count, 32 name bytes per column, uint64 row count, then the rows as packed
+ *   float32. A row is read in place from the mapping.
+ *
+ * Columns are matched by FSDParams field name, plus "Curve", an index into the
+ * curves passed to the sweep; bool fields read any nonzero value as true.
+ * Unknown columns are skipped, missing ones come from Base. Nothing is copied
+ * or materialized up front, so a file of any size costs its index and
+ * whichever pages the sweep touches.
+ */
+class FScenarioFile
+{
+public:
+	FScenarioFile();
+	~FScenarioFile() = default;
+
+	FScenarioFile(const FScenarioFile&) = delete;
+	FScenarioFile& operator=(const FScenarioFile&) = delete;
+
+	/** Maps Path and reads its header. False if the file is missing, empty of columns or not a version this build knows. */
+	bool Open(const std::string& Path, std::string* OutError = nullptr);
+	void Close();
+
+	bool IsOpen() const { return File.IsOpen(); }
+	bool IsBinary() const { return bBinary; }
+	int64_t GetNumScenarios() const { return NumRows; }
+
+	/** Whether the file assigns curves, without a Curve column every scenario uses the sweep's GraphPts. */
+	bool HasCurveColumn() const { return CurveColumn >= 0; }
+
+	/** Thread-safe. A field that fails to parse keeps its Base value and counts the row as malformed. */
+	FSDParams GetScenario(int64_t Index) const;
+
+	/** The Curve column of scenario Index, -1 without one. */
+	int32_t GetCurveIndex(int64_t Index) const;
+
+	int64_t GetNumMalformedRows() const { return MalformedRows; }
+
+	/** Values for columns the file leaves out. */
+	FSDParams Base;
+
+	/** Streams a CSV scenario file into the binary format, which opens and reads without parsing. */
+	static bool ConvertCsvToBinary(const std::string& CsvPath, const std::string& BinaryPath, std::string* OutError = nullptr);
+
+	/**
+	 * Reads a density effect curve in the PopulationDensityEffect.csv shape, a row name column
+	 * then PopulationDensity and NormalPopulationDensity (found by header name, else the 2nd and 3rd columns).
+	 */
+	static bool LoadCurveCsv(const std::string& Path, std::vector<std::pair<float, float>>& OutPoints, std::string* OutError = nullptr);
+
+private:
+	// Reads row Index into Values, one per file column, NaN where a cell does not parse
+	bool ReadRow(int64_t Index, float* Values) const;
+	const uint8_t* FindCsvRow(int64_t Index) const;
+
+	FMappedFile File;
+	bool bBinary{ false };
+	int64_t NumRows{ 0 };
+
+	// What each file column feeds, see the .cpp for the field list; -1 is ignored
+	std::vector<std::string> ColumnNames;
+	std::vector<int32_t> ColumnFields;
+	int32_t CurveColumn{ -1 };
+
+	// Binary: start of the packed rows
+	const uint8_t* RowData{ nullptr };
+
+	// CSV: offset of every ScenarioFileIndexStride-th row
+	std::vector<size_t> RowIndex;
+
+	// Tells this file apart in the per-thread resume cursor, even at a reused address
+	uint64_t Id;
+
+	mutable std::atomic<int64_t> MalformedRows{ 0 };
+};
@@ -0,0 +1,523 @@
+// Copyright University of Inland Norway
+
+#include "SimulationBenchmark.h"
+#include "DensityEffectCurve.h"
+#include "GridInfectionModel.h"
+#include "GridPathfinder.h"
+#include "GridSpatialIndex.h"
+#include "GridStorage.h"
+#include "SDBatchEngine.h"
+#include "SDConveyor.h"
+#include "SDModel.h"
+#include "SDSweep.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// Results are folded in here so the optimizer cannot drop the timed work
+static volatile float SimBenchmarkSink = 0.f;
+
+// The table shipped as PopulationDensityEffect.csv
+static const std::vector<std::pair<float, float>> SimBenchmarkGraph =
+{
+    { 0.0f, 0.014f }, { 0.2f, 0.041f }, { 0.4f, 0.101f }, { 0.6f, 0.189f }, { 0.8f, 0.433f }, { 1.0f, 1.0f },
+    { 1.2f, 1.217f }, { 1.4f, 1.282f }, { 1.6f, 1.3f }, { 1.8f, 1.3f }, { 2.0f, 1.3f }
+};
+
+// Days simulated before a long-running case starts over, keeps the stocks away from their end state
+static constexpr int32_t SimBenchmarkEpochDays = 100;
+
+template <typename FBody>
+static double TimeSimBenchmark(FBody& Body, int64_t Iterations)
+{
+    const auto Start = std::chrono::steady_clock::now();
+    Body(Iterations);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+/** Body(Iterations) runs the measured operation Iterations times, ItemsPerOp is what one operation counts as. */
+template <typename FBody>
+static void RunSimBenchmarkCase(const FSimBenchmarkConfig& Config, std::vector<FSimBenchmarkResult>& Results,
+    const std::string& Name, double ItemsPerOp, FBody Body)
+{
+    if (!Config.Filter.empty() && Name.find(Config.Filter) == std::string::npos)
+        return;
+
+    // 1. - Grow the iteration count until one run fills MinSeconds
+    const double MinSeconds = std::max(1e-3, Config.MinSeconds);
+    int64_t Iterations = 1;
+    for (;;)
+    {
+        const double Seconds = TimeSimBenchmark(Body, Iterations);
+        if (Seconds >= MinSeconds || Iterations >= 1000000000)
+            break;
+
+        const double Scale = Seconds > 0.0 ? MinSeconds * 1.4 / Seconds : 10.0;
+        Iterations = static_cast<int64_t>(std::ceil(static_cast<double>(Iterations) * std::min(10.0, std::max(1.5, Scale))));
+    }
+
+    // 2. - Median of the repetitions, one slow run from a context switch does not move it
+    std::vector<double> NsPerOp;
+    for (int32_t Repeat = 0; Repeat < std::max(1, Config.Repetitions); ++Repeat)
+    {
+        NsPerOp.push_back(TimeSimBenchmark(Body, Iterations) * 1e9 / static_cast<double>(Iterations));
+    }
+    std::sort(NsPerOp.begin(), NsPerOp.end());
+
+    FSimBenchmarkResult Result;
+    Result.Name = Name;
+    Result.Iterations = Iterations;
+    Result.NsPerOp = NsPerOp[NsPerOp.size() / 2];
+    Result.ItemsPerSecond = Result.NsPerOp > 0.0 ? ItemsPerOp * 1e9 / Result.NsPerOp : 0.0;
+    Results.push_back(Result);
+}
+
+static FSDParams MakeSimBenchmarkParams()
+{
+    FSDParams Params;
+    Params.BittenCapacity = 100.f;
+    Params.LandArea = 1000.f;
+    return Params;
+}
+
+// Square grid with FenceDensity of the edges fenced and the given shares of humans and zombies
+static FGridStorage MakeSimBenchmarkGrid(int32_t Size, float FenceDensity, float HumanShare, float ZombieShare, uint64_t Seed)
+{
+    FGridStorage Grid;
+    Grid.Init(Size, Size);
+
+    std::mt19937_64 Random(Seed);
+    std::uniform_real_distribution<float> Unit(0.f, 1.f);
+    for (int32_t Y = 0; Y < Size; ++Y)
+    {
+        for (int32_t X = 0; X < Size; ++X)
+        {
+            Grid.SetFenceUp(X, Y, Y + 1 < Size && Unit(Random) < FenceDensity);
+            Grid.SetFenceRight(X, Y, X + 1 < Size && Unit(Random) < FenceDensity);
+
+            const float Roll = Unit(Random);
+            Grid.SetCell(X, Y, Roll < ZombieShare ? EGridCell::Zombie : Roll < ZombieShare + HumanShare ? EGridCell::Human : EGridCell::Empty);
+        }
+    }
+    return Grid;
+}
+
+static std::string MakeSimBenchmarkGridName(const char* Case, int32_t Size, float FenceDensity)
+{
+    char Name[128];
+    std::snprintf(Name, sizeof(Name), "Grid/%s/size:%d/fences:%.2f", Case, Size, FenceDensity);
+    return Name;
+}
+
+static void RunSimBenchmarkSD(const FSimBenchmarkConfig& Config, std::vector<FSimBenchmarkResult>& Results)
+{
+    FDensityEffectCurve Curve;
+    Curve.Build(SimBenchmarkGraph);
+    const FSDParams Params = MakeSimBenchmarkParams();
+    const FSDState Initial;
+
+    // What ASimulationController::PerformSimulationStep does every day
+    {
+        FSDEngine Engine;
+        Engine.SetCurve(Curve);
+        RunSimBenchmarkCase(Config, Results, "SD/PerformSimulationStep", 1.0, [&](int64_t Iterations)
+        {
+            for (int64_t Day = 0; Day < Iterations; ++Day)
+            {
+                if (Day % SimBenchmarkEpochDays == 0)
+                {
+                    Engine.Reset(Initial);
+                }
+                const FSDState& State = Engine.GetState();
+                Engine.SetParams(Params);
+                Engine.SetStocks(State.Susceptible, State.Zombies);
+                Engine.Step();
+            }
+            SimBenchmarkSink = SimBenchmarkSink + Engine.GetState().Zombies;
+        });
+    }
+
+    // The same day for a batch of scenarios, items are scenario days
+    for (const int32_t Lanes : { 64, 1024 })
+    {
+        FSDBatchEngine Batch;
+        Batch.SetCurve(Curve);
+        const std::vector<FSDParams> Scenarios(static_cast<size_t>(Lanes), Params);
+        char Name[96];
+        std::snprintf(Name, sizeof(Name), "SD/BatchStep/%s/lanes:%d", FSDBatchEngine::GetInstructionSet(), Lanes);
+        RunSimBenchmarkCase(Config, Results, Name, Lanes, [&](int64_t Iterations)
+        {
+            for (int64_t Day = 0; Day < Iterations; ++Day)
+            {
+                if (Day % SimBenchmarkEpochDays == 0)
+                {
+                    Batch.Reset(Scenarios, Initial);
+                }
+                Batch.Step();
+            }
+            SimBenchmarkSink = SimBenchmarkSink + Batch.GetZombies()[0];
+        });
+    }
+
+    // Lookups across and beyond the table; the shipped table is evenly spaced, an uneven one takes the binary search or gets resampled
+    std::vector<float> Densities(1024);
+    std::mt19937_64 Random(Config.Seed);
+    std::uniform_real_distribution<float> Range(-0.2f, 2.2f);
+    for (float& Density : Densities)
+    {
+        Density = Range(Random);
+    }
+
+    std::vector<std::pair<float, float>> Uneven = SimBenchmarkGraph;
+    Uneven[3].first = 0.55f;
+    FDensityEffectCurve NonUniform;
+    NonUniform.Build(Uneven);
+    FDensityEffectCurve Resampled;
+    Resampled.Build(Uneven, 256);
+
+    const std::pair<const char*, const FDensityEffectCurve*> Lookups[] =
+    {
+        { "SD/GraphLookup/uniform", &Curve }, { "SD/GraphLookup/nonuniform", &NonUniform }, { "SD/GraphLookup/resampled", &Resampled }
+    };
+    for (const auto& Lookup : Lookups)
+    {
+        const FDensityEffectCurve& LookupCurve = *Lookup.second;
+        RunSimBenchmarkCase(Config, Results, Lookup.first, static_cast<double>(Densities.size()), [&](int64_t Iterations)
+        {
+            float Sum = 0.f;
+            for (int64_t Iteration = 0; Iteration < Iterations; ++Iteration)
+            {
+                for (const float Density : Densities)
+                {
+                    Sum += LookupCurve.Evaluate(Density);
+                }
+            }
+            SimBenchmarkSink = SimBenchmarkSink + Sum;
+        });
+    }
+
+    // One day of the bitten conveyor
+    const std::pair<const char*, ESDConveyorDelay> Delays[] =
+    {
+        { "SD/ConveyorUpdate/discrete", ESDConveyorDelay::Discrete },
+        { "SD/ConveyorUpdate/fractional", ESDConveyorDelay::Fractional },
+        { "SD/ConveyorUpdate/distributed", ESDConveyorDelay::Distributed }
+    };
+    for (const auto& Delay : Delays)
+    {
+        FSDConveyor Conveyor;
+        Conveyor.SetDelay(15.5f, Delay.second, 4.f);
+        RunSimBenchmarkCase(Config, Results, Delay.first, 1.0, [&](int64_t Iterations)
+        {
+            float Sum = 0.f;
+            for (int64_t Day = 0; Day < Iterations; ++Day)
+            {
+                Sum += Conveyor.Advance();
+                Conveyor.Add(static_cast<float>(Day & 7));
+            }
+            SimBenchmarkSink = SimBenchmarkSink + Sum;
+        });
+    }
+}
+
+static void RunSimBenchmarkGrid(const FSimBenchmarkConfig& Config, std::vector<FSimBenchmarkResult>& Results)
+{
+    for (const int32_t Size : Config.GridSizes)
+    {
+        for (const float FenceDensity : Config.FenceDensities)
+        {
+            // A few zombies so walkability is actually checked, no humans to keep every other cell open
+            const FGridStorage Grid = MakeSimBenchmarkGrid(Size, FenceDensity, 0.f, 0.05f, Config.Seed);
+
+            std::vector<FGridPoint> Cells(4096);
+            std::mt19937_64 Random(Config.Seed ^ static_cast<uint64_t>(Size));
+            std::uniform_int_distribution<int32_t> Coordinate(0, Size - 1);
+            for (FGridPoint& Cell : Cells)
+            {
+                Cell = { Coordinate(Random), Coordinate(Random) };
+            }
+
+            RunSimBenchmarkCase(Config, Results, MakeSimBenchmarkGridName("GetNeighbors", Size, FenceDensity), static_cast<double>(Cells.size()), [&](int64_t Iterations)
+            {
+                int32_t Count = 0;
+                FGridPoint Neighbors[4];
+                for (int64_t Iteration = 0; Iteration < Iterations; ++Iteration)
+                {
+                    for (const FGridPoint& Cell : Cells)
+                    {
+                        Count += Grid.GetNeighbors(Cell.X, Cell.Y, Neighbors);
+                    }
+                }
+                SimBenchmarkSink = SimBenchmarkSink + static_cast<float>(Count);
+            });
+
+            RunSimBenchmarkCase(Config, Results, MakeSimBenchmarkGridName("CanMoveBetweenCells", Size, FenceDensity), static_cast<double>(Cells.size()), [&](int64_t Iterations)
+            {
+                int32_t Count = 0;
+                for (int64_t Iteration = 0; Iteration < Iterations; ++Iteration)
+                {
+                    for (const FGridPoint& Cell : Cells)
+                    {
+                        Count += Grid.CanMoveBetweenCells(Cell.X, Cell.Y, Cell.X + 1, Cell.Y);
+                        Count += Grid.CanMoveBetweenCells(Cell.X, Cell.Y, Cell.X, Cell.Y + 1);
+                    }
+                }
+                SimBenchmarkSink = SimBenchmarkSink + static_cast<float>(Count);
+            });
+
+            // Far apart endpoints, a failed search still costs its whole region
+            std::vector<std::pair<FGridPoint, FGridPoint>> Queries;
+            for (size_t Query = 0; Query < 16; ++Query)
+            {
+                Queries.push_back({ { Coordinate(Random) / 4, Coordinate(Random) / 4 }, { Size - 1 - Coordinate(Random) / 4, Size - 1 - Coordinate(Random) / 4 } });
+            }
+
+            FGridPathHierarchy Hierarchy;
+            Hierarchy.Build(Grid);
+            for (const EGridPathMode Mode : { EGridPathMode::BFS, EGridPathMode::AStar, EGridPathMode::Hierarchical })
+            {
+                FGridPathfinder Pathfinder;
+                Pathfinder.Reserve(Grid.GetNumCells());
+                const char* CaseName = Mode == EGridPathMode::BFS ? "FindPath/BFS" : Mode == EGridPathMode::AStar ? "FindPath/AStar" : "FindPath/Hierarchical";
+                RunSimBenchmarkCase(Config, Results, MakeSimBenchmarkGridName(CaseName, Size, FenceDensity), 1.0, [&](int64_t Iterations)
+                {
+                    int32_t Found = 0;
+                    for (int64_t Iteration = 0; Iteration < Iterations; ++Iteration)
+                    {
+                        const auto& Query = Queries[static_cast<size_t>(Iteration) % Queries.size()];
+                        Found += Pathfinder.FindPath(Grid, Query.first, Query.second, Mode, &Hierarchy);
+                    }
+                    SimBenchmarkSink = SimBenchmarkSink + static_cast<float>(Found);
+                });
+            }
+        }
+
+        // Straight-line queries ignore fences, one case per size
+        const FGridStorage Agents = MakeSimBenchmarkGrid(Size, 0.f, 0.2f, 0.02f, Config.Seed);
+        FGridSpatialIndex Index;
+        Index.Build(Agents);
+        std::vector<FGridNearestPair> Pairs;
+        RunSimBenchmarkCase(Config, Results, MakeSimBenchmarkGridName("NearestHumanForAll", Size, 0.f),
+            static_cast<double>(Agents.CountCells(EGridCell::Zombie)), [&](int64_t Iterations)
+        {
+            int64_t Found = 0;
+            for (int64_t Iteration = 0; Iteration < Iterations; ++Iteration)
+            {
+                Index.FindNearestForAll(Agents, EGridCell::Zombie, EGridCell::Human, 16, Pairs);
+                Found += static_cast<int64_t>(Pairs.size());
+            }
+            SimBenchmarkSink = SimBenchmarkSink + static_cast<float>(Found);
+        });
+    }
+}
+
+static void RunSimBenchmarkEndToEnd(const FSimBenchmarkConfig& Config, std::vector<FSimBenchmarkResult>& Results)
+{
+    FDensityEffectCurve Curve;
+    Curve.Build(SimBenchmarkGraph);
+
+    // Whole infection days on a populated grid, items are simulated days
+    auto RunGridDays = [&](const std::string& Name, int32_t Size, bool bFixedKernels)
+    {
+        const FGridStorage Start = MakeSimBenchmarkGrid(Size, Config.FenceDensities.empty() ? 0.f : Config.FenceDensities.front(), 0.3f, 0.01f, Config.Seed);
+        FGridInfectionParams Params;
+        Params.Seed = Config.Seed;
+
+        FGridStorage Grid = Start;
+        FGridInfectionModel Model;
+        Model.SetParams(Params);
+        Model.SetCurve(Curve);
+        Model.SetFixedKernels(bFixedKernels);
+
+        RunSimBenchmarkCase(Config, Results, Name, 1.0, [&](int64_t Iterations)
+        {
+            for (int64_t Day = 0; Day < Iterations; ++Day)
+            {
+                if (Day % SimBenchmarkEpochDays == 0)
+                {
+                    Grid = Start;
+                    Model.Reset(Grid);
+                }
+                Model.Step(Grid);
+                Model.Apply(Grid);
+            }
+            SimBenchmarkSink = SimBenchmarkSink + static_cast<float>(Model.GetCounts().Zombies);
+        });
+    };
+
+    for (const int32_t Size : Config.GridSizes)
+    {
+        char Name[96];
+        std::snprintf(Name, sizeof(Name), "EndToEnd/GridDays/size:%d", Size);
+        RunGridDays(Name, Size, true);
+    }
+
+    // AGridManager's default map, with the kernels compiled for its size and with the runtime-sized ones
+    for (const bool bFixedKernels : { true, false })
+    {
+        RunGridDays(bFixedKernels ? "EndToEnd/GridDays/size:10/kernel:fixed" : "EndToEnd/GridDays/size:10/kernel:runtime", 10, bFixedKernels);
+    }
+
+    // A parameter sweep on the shared pool, items are scenario days
+    for (const bool bVectorized : { false, true })
+    {
+        FSDSweepConfig Sweep;
+        Sweep.NumDays = SimBenchmarkEpochDays;
+        Sweep.bVectorized = bVectorized;
+        Sweep.bKeepTrajectories = false;
+        Sweep.GraphPts = SimBenchmarkGraph;
+
+        FSDParamRanges Ranges;
+        Ranges.Min = MakeSimBenchmarkParams();
+        Ranges.Max = Ranges.Min;
+        Ranges.Max.BittenCapacity = 400.f;
+        Ranges.Max.LandArea = 4000.f;
+        Ranges.Seed = Config.Seed;
+
+        const int64_t NumScenarios = 4096;
+        RunSimBenchmarkCase(Config, Results, bVectorized ? "EndToEnd/SweepDays/vectorized" : "EndToEnd/SweepDays/scalar",
+            static_cast<double>(NumScenarios * Sweep.NumDays), [&](int64_t Iterations)
+        {
+            for (int64_t Iteration = 0; Iteration < Iterations; ++Iteration)
+            {
+                const FSDSweepResult Result = RunSDSweep(Sweep, Ranges, NumScenarios);
+                SimBenchmarkSink = SimBenchmarkSink + Result.GetFinal(0).Zombies;
+            }
+        });
+    }
+}
+
+std::vector<FSimBenchmarkResult> RunSimulationBenchmarks(const FSimBenchmarkConfig& Config)
+{
+    std::vector<FSimBenchmarkResult> Results;
+    RunSimBenchmarkSD(Config, Results);
+    RunSimBenchmarkGrid(Config, Results);
+    RunSimBenchmarkEndToEnd(Config, Results);
+    return Results;
+}
+
+std::string FormatSimulationBenchmarkJson(const std::vector<FSimBenchmarkResult>& Results)
+{
+    std::string Json = "{\n  \"context\": {\n";
+    char Line[256];
+    std::snprintf(Line, sizeof(Line), "    \"library\": \"ZombieApocalypse\",\n    \"instruction_set\": \"%s\"\n  },\n", FSDBatchEngine::GetInstructionSet());
+    Json += Line;
+    Json += "  \"benchmarks\": [\n";
+    for (size_t Index = 0; Index < Results.size(); ++Index)
+    {
+        const FSimBenchmarkResult& Result = Results[Index];
+        std::snprintf(Line, sizeof(Line),
+            "    {\"name\": \"%s\", \"iterations\": %lld, \"real_time\": %.3f, \"time_unit\": \"ns\", \"items_per_second\": %.6e}%s\n",
+            Result.Name.c_str(), static_cast<long long>(Result.Iterations), Result.NsPerOp, Result.ItemsPerSecond,
+            Index + 1 < Results.size() ? "," : "");
+        Json += Line;
+    }
+    Json += "  ]\n}\n";
+    return Json;
+}
+
+// Raw value of the first "Key" between From and Until, string quotes stripped
+static bool FindSimBenchmarkJsonValue(const std::string& Json, size_t From, size_t Until, const char* Key, std::string& OutValue)
+{
+    const std::string Quoted = std::string("\"") + Key + "\"";
+    const size_t KeyAt = Json.find(Quoted, From);
+    if (KeyAt == std::string::npos || KeyAt >= Until)
+        return false;
+
+    size_t Begin = Json.find(':', KeyAt + Quoted.size());
+    if (Begin == std::string::npos)
+        return false;
+    Begin = Json.find_first_not_of(" \t\r\n", Begin + 1);
+    if (Begin == std::string::npos)
+        return false;
+
+    if (Json[Begin] == '"')
+    {
+        const size_t End = Json.find('"', Begin + 1);
+        if (End == std::string::npos)
+            return false;
+        OutValue = Json.substr(Begin + 1, End - Begin - 1);
+        return true;
+    }
+
+    const size_t End = Json.find_first_of(",}\r\n", Begin);
+    OutValue = Json.substr(Begin, End == std::string::npos ? std::string::npos : End - Begin);
+    return true;
+}
+
+bool ParseSimulationBenchmarkJson(const std::string& Json, std::vector<FSimBenchmarkResult>& OutResults, std::string* OutError)
+{
+    OutResults.clear();
+    const size_t Array = Json.find("\"benchmarks\"");
+    if (Array == std::string::npos)
+    {
+        if (OutError) *OutError = "no \"benchmarks\" array";
+        return false;
+    }
+
+    // Every entry is an object starting at its "name", fields are read up to the next entry
+    size_t At = Json.find("\"name\"", Array);
+    while (At != std::string::npos)
+    {
+        const size_t Next = Json.find("\"name\"", At + 1);
+        const size_t Until = Next == std::string::npos ? Json.size() : Next;
+
+        FSimBenchmarkResult Result;
+        std::string Time;
+        std::string Unit = "ns";
+        std::string Iterations;
+        if (!FindSimBenchmarkJsonValue(Json, At, Until, "name", Result.Name) || !FindSimBenchmarkJsonValue(Json, At, Until, "real_time", Time))
+        {
+            if (OutError) *OutError = "entry without name or real_time";
+            return false;
+        }
+        FindSimBenchmarkJsonValue(Json, At, Until, "time_unit", Unit);
+        if (FindSimBenchmarkJsonValue(Json, At, Until, "iterations", Iterations))
+        {
+            Result.Iterations = std::strtoll(Iterations.c_str(), nullptr, 10);
+        }
+
+        const double UnitNs = Unit == "s" ? 1e9 : Unit == "ms" ? 1e6 : Unit == "us" ? 1e3 : 1.0;
+        Result.NsPerOp = std::strtod(Time.c_str(), nullptr) * UnitNs;
+        OutResults.push_back(Result);
+        At = Next;
+    }
+    return true;
+}
+
+std::vector<FSimBenchmarkComparison> CompareSimulationBenchmarks(const std::vector<FSimBenchmarkResult>& Baseline,
+    const std::vector<FSimBenchmarkResult>& Current, double Threshold)
+{
+    std::vector<FSimBenchmarkComparison> Comparisons;
+    for (const FSimBenchmarkResult& Result : Current)
+    {
+        const auto Old = std::find_if(Baseline.begin(), Baseline.end(), [&](const FSimBenchmarkResult& Entry) { return Entry.Name == Result.Name; });
+        if (Old == Baseline.end() || Old->NsPerOp <= 0.0)
+            continue;
+
+        FSimBenchmarkComparison Comparison;
+        Comparison.Name = Result.Name;
+        Comparison.BaselineNs = Old->NsPerOp;
+        Comparison.CurrentNs = Result.NsPerOp;
+        Comparison.Change = Result.NsPerOp / Old->NsPerOp - 1.0;
+        Comparison.bRegressed = Comparison.Change > Threshold;
+        Comparisons.push_back(Comparison);
+    }
+    return Comparisons;
+}
+
+std::string FormatSimulationBenchmarkComparison(const std::vector<FSimBenchmarkComparison>& Comparisons)
+{
+    std::string Text;
+    char Line[256];
+    for (const FSimBenchmarkComparison& Comparison : Comparisons)
+    {
+        std::snprintf(Line, sizeof(Line), "%-52s %14.1f ns -> %14.1f ns %+7.1f%%%s\n", Comparison.Name.c_str(),
+            Comparison.BaselineNs, Comparison.CurrentNs, Comparison.Change * 100.0, Comparison.bRegressed ? "  REGRESSION" : "");
+        Text += Line;
+    }
+    return Text;
+}
@@ -0,0 +1,68 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Micro and macro benchmarks of the engine-free simulation core.
+ *
+ * Each case times a loop of one operation, growing the iteration count until a
+ * run takes MinSeconds, then keeps the median of Repetitions runs. Results are
+ * written as JSON in the Google Benchmark layout (name, iterations, real_time in
+ * ns, items_per_second), so the same tooling reads either, and a stored baseline
+ * in that layout can be compared against a new run to flag regressions.
+ */
+struct FSimBenchmarkConfig
+{
+	double MinSeconds{ 0.1 };
+	int32_t Repetitions{ 3 };
+
+	/** Only cases whose name contains this run, empty runs all. */
+	std::string Filter;
+
+	/** Square grid sides and the share of cell edges fenced, every combination is a case. */
+	std::vector<int32_t> GridSizes{ 64, 256, 1024 };
+	std::vector<float> FenceDensities{ 0.f, 0.1f, 0.3f };
+
+	uint64_t Seed{ 1 };
+};
+
+struct FSimBenchmarkResult
+{
+	std::string Name;
+	int64_t Iterations{ 0 };
+
+	/** Median wall time of one iteration. */
+	double NsPerOp{ 0.0 };
+
+	/** Days, lookups, cells... whatever the case counts, per second. */
+	double ItemsPerSecond{ 0.0 };
+};
+
+struct FSimBenchmarkComparison
+{
+	std::string Name;
+	double BaselineNs{ 0.0 };
+	double CurrentNs{ 0.0 };
+
+	/** Current / baseline - 1, so 0.25 is 25% slower. */
+	double Change{ 0.0 };
+	bool bRegressed{ false };
+};
+
+std::vector<FSimBenchmarkResult> RunSimulationBenchmarks(const FSimBenchmarkConfig& Config);
+
+std::string FormatSimulationBenchmarkJson(const std::vector<FSimBenchmarkResult>& Results);
+
+/** Reads name and real_time of every entry of a benchmark JSON file, ours or Google Benchmark's. */
+bool ParseSimulationBenchmarkJson(const std::string& Json, std::vector<FSimBenchmarkResult>& OutResults, std::string* OutError = nullptr);
+
+/** Pairs cases by name, a case slower than the baseline by more than Threshold (0.1 is 10%) counts as regressed. */
+std::vector<FSimBenchmarkComparison> CompareSimulationBenchmarks(const std::vector<FSimBenchmarkResult>& Baseline,
+	const std::vector<FSimBenchmarkResult>& Current, double Threshold);
+
+/** One line per compared case, regressions marked. */
+std::string FormatSimulationBenchmarkComparison(const std::vector<FSimBenchmarkComparison>& Comparisons);
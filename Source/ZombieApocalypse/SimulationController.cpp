@@ -1,7 +1,28 @@
 // Copyright University of Inland Norway
 
 #include "SimulationController.h"
+#include "GridManager.h"
+#include "SDIntegratorBenchmark.h"
+#include "WorkStealingPool.h"
+#include "ZombieSimStats.h"
 #include "Math/UnrealMathUtility.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+
+// "ZSNP", bumped whenever a SaveState anywhere changes its layout
+static constexpr uint32 SnapshotMagic = 0x504E535A;
+static constexpr uint32 SnapshotVersion = 1;
+
+static FTrajectoryRecord MakeControllerRecord(int32 Day, const FSDEngine& DayEngine)
+{
+    // Day 0 has no flows yet, the engine still holds whatever its last run left there
+    const FSDState& State = DayEngine.GetState();
+    const FSDFlows& Flows = DayEngine.GetLastFlows();
+    const bool bHasFlows = Day > 0;
+    return { 0, Day, State.Susceptible, State.Bitten, State.Zombies,
+        bHasFlows ? Flows.Inflow : 0.f, bHasFlows ? Flows.BecomingInfected : 0.f, bHasFlows ? Flows.DensityEffect : 0.f };
+}
 
 ASimulationController::ASimulationController()
 {
@@ -12,7 +33,17 @@ ASimulationController::ASimulationController()
 void ASimulationController::BeginPlay()
 {
     Super::BeginPlay();
-    
+
+    FSDState InitialState;
+    InitialState.Susceptible = Susceptible;
+    InitialState.Bitten = Bitten;
+    InitialState.Zombies = Zombies;
+    Engine.SetParams(MakeParams());
+    Engine.Reset(InitialState);
+    Scheduler.Configure(SimulationStepTime, SimulationDays, MaxStepsPerFrame);
+    Scheduler.Reset();
+    TimeStepsFinished = 0;
+    GridDaysFinished = 0;
 
     if (!PopulationDensityEffectTable)
     {
@@ -22,148 +53,540 @@ void ASimulationController::BeginPlay()
     {
        ReadDataFromTableToVectors();
     }
+
+    Snapshots.Clear();
+    NextSnapshotDay = 0;
+    TakeScheduledSnapshot();
+
+    TrajectorySegment = 0;
+    OpenTrajectory();
+}
+
+void ASimulationController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    CancelBurst();
+
+    if (Trajectory)
+    {
+        // Blocks until the writer thread has drained its queue
+        if (!Trajectory->Close())
+        {
+            UE_LOG(LogTemp, Error, TEXT("Trajectory output to %s failed, the file is incomplete"), *TrajectoryPath);
+        }
+        Trajectory.reset();
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void ASimulationController::CancelBurst()
+{
+    // The worker owns a reference to the run, but must not outlive the world either
+    if (!Burst)
+        return;
+
+    Burst->bCancel = true;
+    while (!Burst->bDone)
+    {
+        if (!FWorkStealingPool::Get().RunOneTask())
+            FPlatformProcess::Yield();
+    }
+    Burst.reset();
 }
 
 void ASimulationController::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_ControllerTick);
+    const int32 DaysBefore = TimeStepsFinished;
 
-    if (TimeStepsFinished < 50)
+    if (Burst)
     {
-        AccumulatedTime += DeltaTime;
-        // One full simulation day passed
-        if (AccumulatedTime >= SimulationStepTime)
+        PollBurst();
+    }
+    else
+    {
+        // Properties are BlueprintReadWrite, so the clock picks them up every frame
+        Scheduler.Configure(SimulationStepTime, SimulationDays, MaxStepsPerFrame);
+        Scheduler.SetTimeScale(TimeScale);
+
+        const int32 Steps = Scheduler.Advance(DeltaTime);
+        for (int32 Step = 0; Step < Steps; ++Step)
         {
-            AccumulatedTime = 0.f;
             PerformSimulationStep();
 
             ++TimeStepsFinished;
+            WriteTrajectoryDay(TimeStepsFinished, Engine);
             if (bShouldDebug)
             {
                 UE_LOG(LogTemp, Log, TEXT("Day %d | S:%.2f B:%.2f Z:%.2f"),
                     TimeStepsFinished, Susceptible, Bitten, Zombies);
             }
         }
+
+        if (Steps > 0 && Scheduler.IsFinished())
+        {
+            UE_LOG(LogTemp, Log, TEXT("Simulation finished after %d days | S:%.2f B:%.2f Z:%.2f"),
+                TimeStepsFinished, Susceptible, Bitten, Zombies);
+        }
     }
-    else
+
+    StepGridDays();
+    TakeScheduledSnapshot();
+
+    // Bursts count too, their days land in TimeStepsFinished through PollBurst
+    const int32 DaysThisFrame = TimeStepsFinished - DaysBefore;
+    ZOMBIESIM_COUNTER_ADD(STAT_ZombieSim_Steps, DaysThisFrame);
+    SET_FLOAT_STAT(STAT_ZombieSim_StepsPerSecond, DeltaTime > 0.f ? DaysThisFrame / DeltaTime : 0.f);
+    if (Trajectory)
     {
-    UE_LOG(LogTemp, Log, TEXT("Humans:%.2f"), Susceptible);
+        SET_DWORD_STAT(STAT_ZombieSim_TrajectoryQueueDepth, Trajectory->GetNumQueuedBlocks());
     }
 }
 
-// Function to read data from Unreal DataTable into the graphPts vector
-void ASimulationController::ReadDataFromTableToVectors()
+void ASimulationController::RunToCompletion()
 {
-    if (bShouldDebug) UE_LOG(LogTemp, Log, TEXT("ReadDataFromTableToVectors"));
+    if (Burst || SimulationDays <= 0 || TimeStepsFinished >= SimulationDays)
+        return;
 
-    const TArray<FName> RowNames = PopulationDensityEffectTable->GetRowNames();
+    // 1. - The worker steps its own copy, the game thread engine stays readable meanwhile
+    Engine.SetParams(MakeParams());
+    Engine.SetStocks(Susceptible, Zombies);
 
-    for (int32 Idx = 0; Idx < RowNames.Num(); ++Idx)
+    Burst = std::make_shared<FBurstRun>();
+    Burst->Engine = Engine;
+    Burst->TargetDays = SimulationDays - TimeStepsFinished;
+    Burst->Latest = Engine.GetState();
+    Burst->Output = Trajectory.get();
+    Burst->FirstDay = TimeStepsFinished;
+
+    std::shared_ptr<FBurstRun> Run = Burst;
+    FWorkStealingPool::Get().Submit([Run]()
     {
-        const FPopulationDensityEffect* Row = PopulationDensityEffectTable->FindRow<FPopulationDensityEffect>(RowNames[Idx], TEXT(""));
-        if (Row)
+        for (int32 Day = 0; Day < Run->TargetDays && !Run->bCancel; ++Day)
         {
-            graphPts.emplace_back(Row->PopulationDensity, Row->NormalPopulationDensity);
-
-            if (bShouldDebug)
+            ZOMBIESIM_SCOPE(STAT_ZombieSim_SimulationStep);
+            Run->Engine.Step();
+            if (Run->Output)
             {
-                const auto& P = graphPts.back();
-                UE_LOG(LogTemp, Warning, TEXT("Row %d -> (%.3f , %.3f)"), Idx, P.first, P.second);
+                Run->Output->Append(MakeControllerRecord(Run->FirstDay + Day + 1, Run->Engine));
+            }
+            {
+                FScopeLock Lock(&Run->Mutex);
+                Run->Latest = Run->Engine.GetState();
             }
+            Run->DaysDone = Day + 1;
         }
+        Run->bDone = true;
+    });
+}
+
+void ASimulationController::PollBurst()
+{
+    // 2. - Show the latest finished day, adopt the worker's engine once it is through
+    const bool bDone = Burst->bDone;
+    {
+        FScopeLock Lock(&Burst->Mutex);
+        Susceptible = Burst->Latest.Susceptible;
+        Bitten = Burst->Latest.Bitten;
+        Zombies = Burst->Latest.Zombies;
+    }
+    TimeStepsFinished = Scheduler.GetStepsDone() + Burst->DaysDone;
+
+    if (bDone)
+    {
+        Engine = Burst->Engine;
+        Scheduler.Reset(TimeStepsFinished);
+        Burst.reset();
+        UE_LOG(LogTemp, Log, TEXT("Simulation finished after %d days | S:%.2f B:%.2f Z:%.2f"),
+            TimeStepsFinished, Susceptible, Bitten, Zombies);
+    }
+}
+
+void ASimulationController::StepGridDays()
+{
+    // The grid stays on the game thread, it follows the finished days within the frame budget
+    if (!InfectionGrid)
+    {
+        GridDaysFinished = TimeStepsFinished;
+        return;
+    }
+
+    for (int32 Step = 0; Step < MaxStepsPerFrame && GridDaysFinished < TimeStepsFinished; ++Step)
+    {
+        InfectionGrid->StepInfectionDay(MakeGridParams(), Engine.GetCurve());
+        ++GridDaysFinished;
+
+        if (Trajectory && GridFrameEveryDays > 0 && GridDaysFinished % GridFrameEveryDays == 0)
+        {
+            Trajectory->AppendFrame(GridDaysFinished, InfectionGrid->GetStorage());
+        }
+    }
+}
+
+void ASimulationController::CatchUpGrid()
+{
+    // A snapshot pairs the grid with the aggregate model on the same day
+    while (InfectionGrid && GridDaysFinished < TimeStepsFinished)
+    {
+        InfectionGrid->StepInfectionDay(MakeGridParams(), Engine.GetCurve());
+        ++GridDaysFinished;
     }
-}   
+}
 
-float ASimulationController::GraphLookup(float X) const
+void ASimulationController::WriteSnapshot(std::vector<uint8_t>& OutBytes)
 {
-    if (graphPts.front().first) return 0.f;
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_Snapshot);
+
+    // The engine goes first so a load can check it before the grid is touched, the grid starts on its own page
+    OutBytes.clear();
+    FSnapshotWriter Writer(OutBytes);
+    Writer.Write(SnapshotMagic);
+    Writer.Write(SnapshotVersion);
+    Writer.Write(static_cast<int32>(TimeStepsFinished));
+    Writer.Write(GridDaysFinished);
+    Writer.Write(static_cast<uint8>(InfectionGrid ? 1 : 0));
+    Engine.SaveState(Writer);
+
+    if (InfectionGrid)
+    {
+        Writer.Pad(FSnapshotStore::PageSize);
+        InfectionGrid->SaveSnapshot(Writer);
+    }
+}
 
-    if (X <= graphPts.front().first)    return graphPts.front().second;
-    if (X >= graphPts.back().first)     return graphPts.back().second;
+bool ASimulationController::ReadSnapshot(const std::vector<uint8_t>& Bytes)
+{
+    FSnapshotReader Reader(Bytes);
+    uint32 Magic = 0;
+    uint32 Version = 0;
+    int32 SavedDays = 0;
+    int32 SavedGridDays = 0;
+    uint8 bSavedGrid = 0;
+    if (!Reader.Read(Magic) || !Reader.Read(Version) || Magic != SnapshotMagic || Version != SnapshotVersion)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Snapshot is not from this version of the simulation"));
+        return false;
+    }
 
-    for (size_t i = 1; i < graphPts.size(); ++i)
+    FSDEngine Loaded = Engine;
+    if (!Reader.Read(SavedDays) || !Reader.Read(SavedGridDays) || !Reader.Read(bSavedGrid) || !Loaded.LoadState(Reader))
     {
-        if (X <= graphPts[i].first)
+        UE_LOG(LogTemp, Error, TEXT("Snapshot is truncated"));
+        return false;
+    }
+
+    if (bSavedGrid && InfectionGrid)
+    {
+        if (!Reader.Pad(FSnapshotStore::PageSize) || !InfectionGrid->LoadSnapshot(Reader))
         {
-            const float x0 = graphPts[i - 1].first;
-            const float x1 = graphPts[i].first;
-            const float y0 = graphPts[i - 1].second;
-            const float y1 = graphPts[i].second;
-            const float t = (X - x0) / (x1 - x0);
-            return y0 + t * (y1 - y0);
+            UE_LOG(LogTemp, Error, TEXT("Snapshot grid could not be restored"));
+            return false;
         }
     }
+    else if (bSavedGrid != (InfectionGrid ? 1 : 0))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Snapshot and controller disagree on InfectionGrid, the grid is left as it is"));
+        SavedGridDays = SavedDays;
+    }
 
-    return graphPts.back().second;
+    // Constants always come from the properties, that is what makes a rewind a what-if
+    Engine = MoveTemp(Loaded);
+    Engine.SetParams(MakeParams());
+
+    const FSDState& State = Engine.GetState();
+    Susceptible = State.Susceptible;
+    Bitten = State.Bitten;
+    Zombies = State.Zombies;
+    TimeStepsFinished = SavedDays;
+    GridDaysFinished = SavedGridDays;
+    Scheduler.Reset(TimeStepsFinished);
+    return true;
 }
 
-float ASimulationController::ConveyorContent() const
+void ASimulationController::TakeScheduledSnapshot()
 {
-    float Sum = 0.f;
-    for (const FConveyorBatch& Batch : Conveyor)
-        Sum += Batch.AmountOfPeople;
-    return Sum;
+    if (SnapshotIntervalDays <= 0 || Burst || TimeStepsFinished < NextSnapshotDay)
+        return;
+
+    // Wait for the grid rather than stepping it ahead of its frame budget
+    if (InfectionGrid && GridDaysFinished < TimeStepsFinished)
+        return;
+
+    std::vector<uint8_t> Bytes;
+    WriteSnapshot(Bytes);
+    Snapshots.SetMemoryBudget(static_cast<size_t>(SnapshotMemoryBudgetMB) << 20);
+    Snapshots.Save(TimeStepsFinished, Bytes);
+    NextSnapshotDay = (TimeStepsFinished / SnapshotIntervalDays + 1) * SnapshotIntervalDays;
 }
 
-void ASimulationController::PerformSimulationStep()
+int32 ASimulationController::SaveCheckpoint()
 {
-    // 1. - Update bitten
-    Bitten = ConveyorContent();
+    if (Burst)
+        return INDEX_NONE;
 
-    // 2. - Auxiliaries
-    const float NonZombiePopulation = Bitten + Susceptible;
-    const float PopulationDensity   = NonZombiePopulation / LandArea;
-    const float X                   = PopulationDensity / NormalPopulationDensity;
+    CatchUpGrid();
 
-    const float DensityEffect = GraphLookup(X);
-    const float BitesPerZombieDay = NormalNumberOfBites * DensityEffect;
-    
-    const float TotalBittenPerDay = FMath::RoundToFloat(Zombies * BitesPerZombieDay);
+    std::vector<uint8_t> Bytes;
+    WriteSnapshot(Bytes);
+    Snapshots.SetMemoryBudget(static_cast<size_t>(SnapshotMemoryBudgetMB) << 20);
+    Snapshots.Save(TimeStepsFinished, Bytes);
+    return TimeStepsFinished;
+}
+
+bool ASimulationController::RewindToDay(int32 Day)
+{
+    CancelBurst();
 
-    const float Denom = FMath::Max(NonZombiePopulation, 1.f);
-    const float BitesOnSusceptible = FMath::RoundToFloat((Susceptible / Denom) * TotalBittenPerDay);
+    // 1. - Nearest snapshot at or before Day
+    const int32 SnapshotDay = Snapshots.FindAtOrBefore(FMath::Max(0, Day));
+    std::vector<uint8_t> Bytes;
+    if (SnapshotDay < 0 || !Snapshots.Load(SnapshotDay, Bytes) || !ReadSnapshot(Bytes))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("No snapshot to rewind to day %d from"), Day);
+        return false;
+    }
+
+    // 2. - Both models are deterministic, so replaying the gap lands on the same state as the first time;
+    // the trajectory branches at the snapshot and the replayed days are written on the new branch
+    BranchTrajectory();
+    while (TimeStepsFinished < Day)
+    {
+        PerformSimulationStep();
+        ++TimeStepsFinished;
+        WriteTrajectoryDay(TimeStepsFinished, Engine);
+    }
+    CatchUpGrid();
+
+    // 3. - Snapshots past this day belong to the abandoned future, a later rewind or fork must not find them
+    Snapshots.TruncateAfter(TimeStepsFinished);
+
+    Scheduler.Reset(TimeStepsFinished);
+    NextSnapshotDay = SnapshotIntervalDays > 0 ? (TimeStepsFinished / SnapshotIntervalDays + 1) * SnapshotIntervalDays : 0;
+
+    UE_LOG(LogTemp, Log, TEXT("Rewound to day %d from the snapshot of day %d | S:%.2f B:%.2f Z:%.2f"),
+        TimeStepsFinished, SnapshotDay, Susceptible, Bitten, Zombies);
+    return true;
+}
+
+bool ASimulationController::ForkInto(ASimulationController* Target, int32 Day) const
+{
+    if (!Target || Target == this)
+        return false;
+
+    if (InfectionGrid && Target->InfectionGrid == InfectionGrid)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("ForkInto: %s shares this controller's InfectionGrid, both runs will step it"), *Target->GetName());
+    }
+
+    // Copying the store only copies page pointers, the pages stay shared until either run saves again
+    Target->CancelBurst();
+    Target->Snapshots = Snapshots;
+    return Target->RewindToDay(Day);
+}
+
+bool ASimulationController::SaveCheckpointToFile(const FString& Path)
+{
+    if (Burst)
+        return false;
+
+    CatchUpGrid();
+
+    std::vector<uint8_t> Bytes;
+    WriteSnapshot(Bytes);
+    const TArray<uint8> Data(Bytes.data(), static_cast<int32>(Bytes.size()));
+    return FFileHelper::SaveArrayToFile(Data, *Path);
+}
+
+bool ASimulationController::LoadCheckpointFromFile(const FString& Path)
+{
+    TArray<uint8> Data;
+    if (!FFileHelper::LoadFileToArray(Data, *Path))
+        return false;
 
-    // 3. - Getting bitten
-    float GettingBitten = FMath::Min(BitesOnSusceptible, FMath::FloorToFloat(Susceptible));
+    CancelBurst();
 
-    // 4. - CONVEYOR MECHANICS
-    // 4.1 - Advance every batch
-    for (FConveyorBatch& Batch : Conveyor)
+    const std::vector<uint8_t> Bytes(Data.GetData(), Data.GetData() + Data.Num());
+    if (!ReadSnapshot(Bytes))
+        return false;
+
+    // Snapshots from the run before belong to a different history now, and so do the days written after this one
+    Snapshots.Clear();
+    Snapshots.Save(TimeStepsFinished, Bytes);
+    BranchTrajectory();
+    NextSnapshotDay = SnapshotIntervalDays > 0 ? (TimeStepsFinished / SnapshotIntervalDays + 1) * SnapshotIntervalDays : 0;
+    return true;
+}
+
+void ASimulationController::OpenTrajectory()
+{
+    Trajectory.reset();
+    if (!bWriteTrajectory)
+        return;
+
+    FString FullPath = FPaths::IsRelative(TrajectoryPath) ? FPaths::Combine(FPaths::ProjectSavedDir(), TrajectoryPath) : TrajectoryPath;
+    if (TrajectorySegment > 0)
     {
-        Batch.RemainingDays -= 1.f;
+        FullPath = FString::Printf(TEXT("%s.%d%s"), *FPaths::GetBaseFilename(FullPath, false), TrajectorySegment, *FPaths::GetExtension(FullPath, true));
     }
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(FullPath), true);
 
-    // 4.2 - Separate finished batches -> raw outflow
-    std::vector<FConveyorBatch> NextConveyor;
-    NextConveyor.reserve(Conveyor.size());
+    std::string Error;
+    Trajectory = std::make_unique<FTrajectoryWriter>();
+    if (!Trajectory->Open(TCHAR_TO_UTF8(*FullPath), bCsvTrajectory ? ETrajectoryFormat::Csv : ETrajectoryFormat::Columnar, FTrajectoryWriter::DefaultBlockRows, &Error))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Trajectory output disabled: %s"), UTF8_TO_TCHAR(Error.c_str()));
+        Trajectory.reset();
+        return;
+    }
 
-    float RawOutflowPeople = 0.f;
-    for (FConveyorBatch& Batch : Conveyor)
+    WriteTrajectoryDay(TimeStepsFinished, Engine);
+    if (InfectionGrid && GridFrameEveryDays > 0)
     {
-        if (Batch.RemainingDays <= 0.f)
-            RawOutflowPeople += Batch.AmountOfPeople;
-        else
-            NextConveyor.push_back(MoveTemp(Batch));
+        Trajectory->AppendFrame(GridDaysFinished, InfectionGrid->GetStorage());
     }
-    
-    Conveyor.swap(NextConveyor);
+}
+
+void ASimulationController::BranchTrajectory()
+{
+    if (!Trajectory)
+        return;
+
+    // Columnar files carry the branch point and ExportCsv drops the abandoned days; plain CSV
+    // cannot, so the branch goes on in a file of its own, starting with the current day
+    if (!Trajectory->AppendRewind(TimeStepsFinished))
+    {
+        if (!Trajectory->Close())
+        {
+            UE_LOG(LogTemp, Error, TEXT("Trajectory output to %s failed, the file is incomplete"), *TrajectoryPath);
+        }
+        ++TrajectorySegment;
+        OpenTrajectory();
+    }
+}
+
+void ASimulationController::WriteTrajectoryDay(int32 Day, const FSDEngine& DayEngine)
+{
+    if (Trajectory)
+    {
+        Trajectory->Append(MakeControllerRecord(Day, DayEngine));
+    }
+}
+
+bool ASimulationController::ExportTrajectoryToCsv(const FString& ColumnarPath, const FString& CsvPath)
+{
+    std::string Error;
+    if (!FTrajectoryWriter::ExportCsv(TCHAR_TO_UTF8(*ColumnarPath), TCHAR_TO_UTF8(*CsvPath), &Error))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Trajectory export failed: %s"), UTF8_TO_TCHAR(Error.c_str()));
+        return false;
+    }
+    return true;
+}
+
+// Function to read data from Unreal DataTable into the engine's density effect curve
+void ASimulationController::ReadDataFromTableToVectors()
+{
+    if (bShouldDebug) UE_LOG(LogTemp, Log, TEXT("ReadDataFromTableToVectors"));
+
+    const TArray<FName> RowNames = PopulationDensityEffectTable->GetRowNames();
+    std::vector<std::pair<float, float>> graphPts;
+    graphPts.reserve(RowNames.Num());
+
+    for (int32 Idx = 0; Idx < RowNames.Num(); ++Idx)
+    {
+        const FPopulationDensityEffect* Row = PopulationDensityEffectTable->FindRow<FPopulationDensityEffect>(RowNames[Idx], TEXT(""));
+        if (Row)
+        {
+            graphPts.emplace_back(Row->PopulationDensity, Row->NormalPopulationDensity);
+
+            if (bShouldDebug)
+            {
+                const auto& P = graphPts.back();
+                UE_LOG(LogTemp, Warning, TEXT("Row %d -> (%.3f , %.3f)"), Idx, P.first, P.second);
+            }
+        }
+    }
+
+    // Compiled once here, the engine rejects unsorted or degenerate rows instead of misreading them
+    std::string Error;
+    if (!Engine.SetGraph(graphPts, &Error))
+    {
+        UE_LOG(LogTemp, Error, TEXT("PopulationDensityEffectTable rejected: %s"), UTF8_TO_TCHAR(Error.c_str()));
+    }
+}
 
-    // 4.3 - inflow
-    const float CurrentContent = ConveyorContent();
-    const float FreeCapacity = FMath::Max(0.f, BittenCapacity - CurrentContent);
-    const float InflowPeople = FMath::Max(0.f, FMath::Min(GettingBitten, FreeCapacity));
+void ASimulationController::RunIntegratorBenchmark()
+{
+    // Also callable from the details panel, before BeginPlay has read the table
+    if (Engine.GetGraph().empty() && PopulationDensityEffectTable)
+    {
+        ReadDataFromTableToVectors();
+    }
 
-    if (InflowPeople > 0.f)
+    FSDIntegratorBenchmarkConfig Config;
+    Config.Params = MakeParams();
+    Config.InitialState.Susceptible = Susceptible;
+    Config.InitialState.Zombies = Zombies;
+    Config.GraphPts = Engine.GetGraph();
+    Config.NumDays = SimulationDays > 0 ? SimulationDays : 50;
+
+    const std::vector<FSDIntegratorBenchmarkRow> Rows = RunSDIntegratorBenchmark(Config);
+    if (Rows.empty())
     {
-        Conveyor.push_back({ InflowPeople, DaysToBecomeInfectedFromBite });
+        UE_LOG(LogTemp, Error, TEXT("Integrator benchmark needs a valid PopulationDensityEffectTable"));
+        return;
     }
 
-    // 4.4 - Outflow -> New Zombie
-    const float BecomingInfected = RawOutflowPeople;
+    TArray<FString> Lines;
+    FString(UTF8_TO_TCHAR(FormatSDIntegratorBenchmark(Rows).c_str())).ParseIntoArrayLines(Lines);
+    for (const FString& Line : Lines)
+    {
+        UE_LOG(LogTemp, Log, TEXT("%s"), *Line);
+    }
+}
+
+FSDParams ASimulationController::MakeParams() const
+{
+    FSDParams Params;
+    Params.DaysToBecomeInfectedFromBite = DaysToBecomeInfectedFromBite;
+    Params.BittenCapacity = BittenCapacity;
+    Params.NormalNumberOfBites = NormalNumberOfBites;
+    Params.LandArea = LandArea;
+    Params.NormalPopulationDensity = NormalPopulationDensity;
+    Params.DelayMode = static_cast<ESDConveyorDelay>(ConveyorDelayMode);
+    Params.DelaySpreadDays = DelaySpreadDays;
+    Params.bWholePeople = bWholePeople;
+    Params.Integrator = static_cast<ESDIntegrator>(Integrator);
+    Params.StepDays = IntegrationStepDays;
+    Params.Tolerance = IntegrationTolerance;
+    return Params;
+}
+
+FGridInfectionParams ASimulationController::MakeGridParams() const
+{
+    FGridInfectionParams Params;
+    Params.NormalNumberOfBites = NormalNumberOfBites;
+    Params.NormalPopulationDensity = NormalPopulationDensity;
+    Params.DaysToBecomeInfectedFromBite = DaysToBecomeInfectedFromBite;
+    Params.HumanMoveChance = HumanMoveChance;
+    Params.ZombieMoveChance = ZombieMoveChance;
+    Params.Seed = static_cast<uint64_t>(GridSeed);
+    return Params;
+}
+
+void ASimulationController::PerformSimulationStep()
+{
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_SimulationStep);
+
+    // Properties are BlueprintReadWrite, so push them in every day like the old inline step read them
+    Engine.SetParams(MakeParams());
+    Engine.SetStocks(Susceptible, Zombies);
 
-    // 5 - STOCK UPDATES
-    Susceptible = FMath::Max(0.f, Susceptible - GettingBitten);
-    Zombies = FMath::Max(0.f, Zombies + BecomingInfected);
+    Engine.Step();
 
-    Bitten = ConveyorContent();
+    const FSDState& State = Engine.GetState();
+    Susceptible = State.Susceptible;
+    Bitten = State.Bitten;
+    Zombies = State.Zombies;
 }
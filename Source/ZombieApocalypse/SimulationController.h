@@ -5,7 +5,13 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Engine/DataTable.h"
-#include <vector>
+#include "FixedStepScheduler.h"
+#include "GridInfectionModel.h"
+#include "SDModel.h"
+#include "SimulationSnapshot.h"
+#include "TrajectoryWriter.h"
+#include <atomic>
+#include <memory>
 #include "SimulationController.generated.h"
 
 
@@ -21,10 +27,23 @@ struct FPopulationDensityEffect : public FTableRowBase
 	float NormalPopulationDensity;
 };
 
-struct FConveyorBatch
+// Blueprint-facing mirror of ESDConveyorDelay
+UENUM(BlueprintType)
+enum class EConveyorDelayMode : uint8
 {
-	float AmountOfPeople = 0.f;
-	float RemainingDays = 0.f;
+	Discrete	UMETA(DisplayName = "Discrete"),
+	Fractional	UMETA(DisplayName = "Fractional"),
+	Distributed	UMETA(DisplayName = "Distributed")
+};
+
+// Blueprint-facing mirror of ESDIntegrator
+UENUM(BlueprintType)
+enum class ESimulationIntegrator : uint8
+{
+	Discrete	UMETA(DisplayName = "Discrete (classic)"),
+	Euler		UMETA(DisplayName = "Euler"),
+	RK4			UMETA(DisplayName = "RK4"),
+	RK45		UMETA(DisplayName = "Adaptive RK45")
 };
 
 
@@ -48,9 +67,22 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Variables")
 	class UDataTable* PopulationDensityEffectTable{ nullptr };
 
+	// Real seconds per simulated day at time scale 1
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Variables")
 	float SimulationStepTime{ 1.f };
 
+	// Days to simulate before stopping, 0 runs forever
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Variables", meta = (ClampMin = "0"))
+	int32 SimulationDays{ 50 };
+
+	// Fast-forward factor, 0 pauses
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Variables", meta = (ClampMin = "0"))
+	float TimeScale{ 1.f };
+
+	// Catch-up limit after a slow frame, days beyond about twice this are dropped
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Variables", meta = (ClampMin = "1"))
+	int32 MaxStepsPerFrame{ 64 };
+
 	UPROPERTY(EditAnywhere, Category = "Simulation Variables")
 	bool bShouldDebug{ false };
 
@@ -71,20 +103,167 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Constants")
 	float NormalPopulationDensity{ 0.1f };
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Constants")
+	EConveyorDelayMode ConveyorDelayMode{ EConveyorDelayMode::Discrete };
+
+	// Only used by the Distributed delay mode
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Constants")
+	float DelaySpreadDays{ 0.f };
+
+	// Discrete integrator only, off keeps the daily flows fractional instead of rounding to whole people
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Simulation Constants")
+	bool bWholePeople{ true };
+
+
+	/*=== integration ===*/
+	// Read when play starts, every mode but Discrete integrates the continuous model without rounding
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Integration")
+	ESimulationIntegrator Integrator{ ESimulationIntegrator::Discrete };
+
+	// Euler / RK4 step, the largest step RK45 may take
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Integration", meta = (ClampMin = "0.001", ClampMax = "1"))
+	float IntegrationStepDays{ 1.f };
+
+	// RK45 error allowed per step, relative to each stock
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Integration", meta = (ClampMin = "0"))
+	float IntegrationTolerance{ 1e-4f };
+
+	// Logs error against cost of every integrator for the current constants, as CSV
+	UFUNCTION(BlueprintCallable, CallInEditor, Category = "Integration")
+	void RunIntegratorBenchmark();
+
+
+	/*=== cell grid model ===*/
+	// Optional grid stepped by the per-cell automaton every simulated day, with the same bite and delay constants
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Model")
+	class AGridManager* InfectionGrid{ nullptr };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Model", meta = (ClampMin = "0", ClampMax = "1"))
+	float HumanMoveChance{ 0.25f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Model", meta = (ClampMin = "0", ClampMax = "1"))
+	float ZombieMoveChance{ 0.5f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid Model")
+	int32 GridSeed{ 1 };
+
+
+	/*=== snapshots ===*/
+	// Days between automatic snapshots, 0 only keeps the ones taken with SaveCheckpoint
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Snapshots", meta = (ClampMin = "0"))
+	int32 SnapshotIntervalDays{ 10 };
+
+	// Older snapshots are thinned out past this, 0 keeps them all
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Snapshots", meta = (ClampMin = "0"))
+	int32 SnapshotMemoryBudgetMB{ 256 };
+
+	// Snapshots the current day (grid included) and returns it
+	UFUNCTION(BlueprintCallable, Category = "Snapshots")
+	int32 SaveCheckpoint();
+
+	// Restores the latest snapshot at or before Day and replays the rest, keeping the current constants.
+	// Snapshots after Day are dropped, and the trajectory branches: later days written before the rewind are superseded
+	UFUNCTION(BlueprintCallable, Category = "Snapshots")
+	bool RewindToDay(int32 Day);
+
+	// Hands Target this run's snapshots and rewinds it to Day, so it can branch off with its own constants
+	UFUNCTION(BlueprintCallable, Category = "Snapshots")
+	bool ForkInto(ASimulationController* Target, int32 Day) const;
+
+	// Checkpoint of the current day on disk, loads back into a controller with the same grid setup
+	UFUNCTION(BlueprintCallable, Category = "Snapshots")
+	bool SaveCheckpointToFile(const FString& Path);
+
+	UFUNCTION(BlueprintCallable, Category = "Snapshots")
+	bool LoadCheckpointFromFile(const FString& Path);
+
+	const FSnapshotStore& GetSnapshots() const { return Snapshots; }
+
+
+	/*=== trajectory output ===*/
+	// Streams every simulated day to TrajectoryPath from a background thread, opened when play starts
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output")
+	bool bWriteTrajectory{ false };
+
+	// Relative paths are under the project's Saved directory. A rewind or checkpoint load branches the run: columnar
+	// files get a rewind marker and ExportTrajectoryToCsv leaves out the abandoned days, CSV output continues in
+	// a new file with the branch number before the extension (Run.1.csv, Run.2.csv, ...)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output")
+	FString TrajectoryPath{ TEXT("Trajectories/Run.ztrj") };
+
+	// Plain CSV instead of the columnar format, grid frames are left out
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output")
+	bool bCsvTrajectory{ false };
+
+	// Days between cell state frames of InfectionGrid, 0 writes none
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (ClampMin = "0"))
+	int32 GridFrameEveryDays{ 0 };
+
+	// Converts a columnar trajectory file to CSV, only the days of the branch the run ended on are kept
+	UFUNCTION(BlueprintCallable, Category = "Output")
+	static bool ExportTrajectoryToCsv(const FString& ColumnarPath, const FString& CsvPath);
+
 
 	/*=== Runtime data ===*/
-	std::vector<std::pair<float, float>> graphPts;
-	std::vector<FConveyorBatch> Conveyor;
-	float AccumulatedTime{ 0.f };
+	// The actor only drives this; all of the model math lives in SDModel
+	FSDEngine Engine;
+	FFixedStepScheduler Scheduler;
 	int TimeStepsFinished{ 0 };
 
+	// Runs the remaining days on a worker thread with the current constants, the HUD follows along
+	UFUNCTION(BlueprintCallable, Category = "Simulation")
+	void RunToCompletion();
+
+	UFUNCTION(BlueprintPure, Category = "Simulation")
+	bool IsRunningToCompletion() const { return Burst != nullptr; }
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
 	// Helpers
 	void ReadDataFromTableToVectors();
-	float GraphLookup(float X) const;
-	float ConveyorContent() const;
+	FSDParams MakeParams() const;
+	FGridInfectionParams MakeGridParams() const;
 	void PerformSimulationStep();
+	void PollBurst();
+	void CancelBurst();
+	void StepGridDays();
+	void CatchUpGrid();
+	void WriteSnapshot(std::vector<uint8_t>& OutBytes);
+	bool ReadSnapshot(const std::vector<uint8_t>& Bytes);
+	void TakeScheduledSnapshot();
+	void OpenTrajectory();
+	void BranchTrajectory();
+	void WriteTrajectoryDay(int32 Day, const FSDEngine& DayEngine);
+
+	// Shared with the worker thread during RunToCompletion
+	struct FBurstRun
+	{
+		FSDEngine Engine;
+		int32 TargetDays{ 0 };
+		std::atomic<int32> DaysDone{ 0 };
+		std::atomic<bool> bCancel{ false };
+		std::atomic<bool> bDone{ false };
+		FCriticalSection Mutex;
+		FSDState Latest;
+
+		// Appended to by the worker, the writer outlives the run since EndPlay cancels it first
+		FTrajectoryWriter* Output{ nullptr };
+		int32 FirstDay{ 0 };
+	};
+	std::shared_ptr<FBurstRun> Burst;
+
+	// Days the attached grid has been stepped, it catches up at MaxStepsPerFrame
+	int32 GridDaysFinished{ 0 };
+
+	// Copy-on-write snapshot pages, copying the store is what ForkInto does
+	FSnapshotStore Snapshots;
+	int32 NextSnapshotDay{ 0 };
+
+	std::unique_ptr<FTrajectoryWriter> Trajectory;
+
+	// Files started for branches of a CSV trajectory, 0 writes TrajectoryPath itself
+	int32 TrajectorySegment{ 0 };
 };
\ No newline at end of file
@@ -2,8 +2,12 @@
 
 
 #include "SimulationHUD.h"
+#include "CanvasTypes.h"
+#include "Engine/Canvas.h"
+#include "GridManager.h"
 #include "Kismet/GameplayStatics.h"
 #include "SimulationController.h"
+#include "ZombieSimStats.h"
 
 void ASimulationHUD::BeginPlay()
 {
@@ -13,6 +17,7 @@ void ASimulationHUD::BeginPlay()
     if (!SimulationController)
     {
         UE_LOG(LogTemp, Warning, TEXT("SimulationHUD: SimulationController not found!"));
+        return;
     }
     UE_LOG(LogTemp, Warning, TEXT("SimulationHUD: SimulationController found!"));
 }
@@ -20,27 +25,122 @@ void ASimulationHUD::BeginPlay()
 void ASimulationHUD::DrawHUD()
 {
 	Super::DrawHUD();
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_HUD);
+
+    if (!SimulationController)
+        return;
+
+    // Values only move once per simulated day, so the strings and chart points are rebuilt then and reused every other frame.
+    // The stocks are compared too, they can change without a new day, e.g. when the run is reset on day 0
+    const FVector3f Stocks(SimulationController->Susceptible, SimulationController->Bitten, SimulationController->Zombies);
+    if (SimulationController->TimeStepsFinished != CachedDay || Stocks != CachedStocks)
+    {
+        OnDayChanged();
+    }
 
     FVector2D screenPosition(50.0f, 50.0f); // X, Y position on screen
     FLinearColor textColor = FLinearColor::White;
     float textScale = 2.f;
 
-    //FString message = FString::Printf(TEXT("Day: %d, Humans: %f, Bitten: %f, Zombies: %f"),
-		//SimulationController->timeStepsFinished,
-        //SimulationController->Susceptible,
-        //SimulationController->Bitten,
-        //SimulationController->Zombies);
+    // Multiple lines for better organization
+    DrawText(DayText, textColor, screenPosition.X, screenPosition.Y, nullptr, textScale, true);
+    DrawText(HumansText, textColor, screenPosition.X, screenPosition.Y + 15.0f, nullptr, textScale, true);
+    DrawText(BittenText, textColor, screenPosition.X, screenPosition.Y + 30.0f, nullptr, textScale, true);
+    DrawText(ZombiesText, textColor, screenPosition.X, screenPosition.Y + 45.0f, nullptr, textScale, true);
+    if (!GridText.IsEmpty())
+    {
+        DrawText(GridText, textColor, screenPosition.X, screenPosition.Y + 60.0f, nullptr, textScale, true);
+    }
+
+    if (bShowChart)
+    {
+        DrawChart();
+    }
+}
 
-    //DrawText(message, textColor, screenPosition.X, screenPosition.Y, nullptr, textScale, true);
+void ASimulationHUD::OnDayChanged()
+{
+    const int32 Day = SimulationController->TimeStepsFinished;
 
-    // Multiple lines for better organization
-    FString stepMessage = FString::Printf(TEXT("Day: %d"), SimulationController->TimeStepsFinished);
-    FString humansMessage = FString::Printf(TEXT("Humans: %d"), (int)SimulationController->Susceptible);
-    FString bittenMessage = FString::Printf(TEXT("Bitten: %d"), (int)SimulationController->Bitten);
-    FString zombiesMessage = FString::Printf(TEXT("Zombies: %d"), (int)SimulationController->Zombies);
-
-    DrawText(stepMessage, textColor, screenPosition.X, screenPosition.Y, nullptr, textScale, true);
-    DrawText(humansMessage, textColor, screenPosition.X, screenPosition.Y + 15.0f, nullptr, textScale, true);
-    DrawText(bittenMessage, textColor, screenPosition.X, screenPosition.Y + 30.0f, nullptr, textScale, true);
-    DrawText(zombiesMessage, textColor, screenPosition.X, screenPosition.Y + 45.0f, nullptr, textScale, true);
+    // 1. - Text
+    DayText = FString::Printf(TEXT("Day: %d"), Day);
+    HumansText = FString::Printf(TEXT("Humans: %d"), (int)SimulationController->Susceptible);
+    BittenText = FString::Printf(TEXT("Bitten: %d"), (int)SimulationController->Bitten);
+    ZombiesText = FString::Printf(TEXT("Zombies: %d"), (int)SimulationController->Zombies);
+
+    // Population counters on the grid are kept per write, reading them is O(1)
+    const AGridManager* Grid = SimulationController->InfectionGrid;
+    GridText = Grid
+        ? FString::Printf(TEXT("Grid: %lld humans, %lld zombies"), Grid->CountCells(ECellState::Human), Grid->CountCells(ECellState::Zombie))
+        : FString();
+
+    // 2. - History, a rewind to an earlier day starts the chart over and new stocks for the same day replace its sample
+    if (History.Num() != HistoryLength || Day < CachedDay)
+    {
+        History.SetNumZeroed(HistoryLength);
+        HistoryHead = 0;
+        HistoryCount = 0;
+        HistoryMax = 1.f;
+    }
+    const bool bSameDay = Day == CachedDay && HistoryCount > 0;
+    const FVector3f Sample(SimulationController->Susceptible, SimulationController->Bitten, SimulationController->Zombies);
+    CachedDay = Day;
+    CachedStocks = Sample;
+
+    const int32 Slot = bSameDay ? (HistoryHead - 1 + HistoryLength) % HistoryLength : HistoryHead;
+    const float OverwrittenMax = (bSameDay || HistoryCount == HistoryLength) ? History[Slot].GetMax() : 0.f;
+    History[Slot] = Sample;
+    if (!bSameDay)
+    {
+        HistoryHead = (HistoryHead + 1) % HistoryLength;
+        HistoryCount = FMath::Min(HistoryCount + 1, HistoryLength);
+    }
+
+    // 3. - Running max of the scale; only overwriting the sample that held it takes a pass over the ring
+    if (Sample.GetMax() >= HistoryMax)
+    {
+        HistoryMax = Sample.GetMax();
+    }
+    else if (OverwrittenMax >= HistoryMax)
+    {
+        HistoryMax = 1.f;
+        for (int32 i = 0; i < HistoryCount; ++i)
+        {
+            HistoryMax = FMath::Max(HistoryMax, History[i].GetMax());
+        }
+    }
+}
+
+void ASimulationHUD::DrawChart()
+{
+    if (!Canvas || !Canvas->Canvas || HistoryCount < 2)
+        return;
+
+    // All three series go into the canvas's line batch, one draw for the whole chart
+    FBatchedElements* Lines = Canvas->Canvas->GetBatchedElements(FCanvas::ET_Line);
+    const FHitProxyId HitProxy = Canvas->Canvas->GetHitProxyId();
+
+    const float Left = ChartPosition.X;
+    const float Bottom = ChartPosition.Y + ChartSize.Y;
+    const float StepX = ChartSize.X / static_cast<float>(HistoryLength - 1);
+    const float ScaleY = ChartSize.Y / HistoryMax;
+
+    // Frame
+    const FLinearColor FrameColor(0.5f, 0.5f, 0.5f, 1.f);
+    Lines->AddLine(FVector(Left, ChartPosition.Y, 0.f), FVector(Left, Bottom, 0.f), FrameColor, HitProxy);
+    Lines->AddLine(FVector(Left, Bottom, 0.f), FVector(Left + ChartSize.X, Bottom, 0.f), FrameColor, HitProxy);
+
+    // Oldest sample on the left, walking the ring from its tail
+    const int32 First = (HistoryHead - HistoryCount + HistoryLength) % HistoryLength;
+    FVector3f Previous = History[First];
+    for (int32 i = 1; i < HistoryCount; ++i)
+    {
+        const FVector3f& Current = History[(First + i) % HistoryLength];
+        const float X0 = Left + StepX * (i - 1);
+        const float X1 = Left + StepX * i;
+        Lines->AddLine(FVector(X0, Bottom - Previous.X * ScaleY, 0.f), FVector(X1, Bottom - Current.X * ScaleY, 0.f), SusceptibleColor, HitProxy);
+        Lines->AddLine(FVector(X0, Bottom - Previous.Y * ScaleY, 0.f), FVector(X1, Bottom - Current.Y * ScaleY, 0.f), BittenColor, HitProxy);
+        Lines->AddLine(FVector(X0, Bottom - Previous.Z * ScaleY, 0.f), FVector(X1, Bottom - Current.Z * ScaleY, 0.f), ZombieColor, HitProxy);
+        Previous = Current;
+    }
 }
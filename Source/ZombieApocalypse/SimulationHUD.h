@@ -7,7 +7,12 @@
 #include "SimulationHUD.generated.h"
 
 /**
- * 
+ * Day and stock readout plus a line chart of the S/B/Z history.
+ *
+ * The text and the chart's points are rebuilt only when the controller's day
+ * or stocks change; any other frame just draws what is cached. The history
+ * is a fixed ring of HistoryLength samples, one per day the HUD sees, drawn as
+ * one batch of lines, so a frame costs the same however long the run is.
  */
 UCLASS()
 class ZOMBIEAPOCALYPSE_API ASimulationHUD : public AHUD
@@ -19,8 +24,50 @@ public:
 	virtual void BeginPlay() override;
 	virtual void DrawHUD() override;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chart")
+	bool bShowChart{ true };
+
+	// Days kept in the chart, the oldest drop off once it is full
+	UPROPERTY(EditAnywhere, Category = "Chart", meta = (ClampMin = "2", ClampMax = "4096"))
+	int32 HistoryLength{ 365 };
+
+	// Top left corner and size in screen pixels
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chart")
+	FVector2D ChartPosition{ 50.f, 140.f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chart")
+	FVector2D ChartSize{ 400.f, 160.f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chart")
+	FLinearColor SusceptibleColor{ FLinearColor::Green };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chart")
+	FLinearColor BittenColor{ FLinearColor::Yellow };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chart")
+	FLinearColor ZombieColor{ FLinearColor::Red };
+
 private:
+	void OnDayChanged();
+	void DrawChart();
+
+	UPROPERTY(Transient)
 	class ASimulationController* SimulationController{ nullptr };
 
+	// Day and S/B/Z the cached text and chart show, CachedDay is -1 before the first frame
+	int32 CachedDay{ -1 };
+	FVector3f CachedStocks{ FVector3f::ZeroVector };
+	FString DayText;
+	FString HumansText;
+	FString BittenText;
+	FString ZombiesText;
+	FString GridText;
+
+	// Ring of S/B/Z samples, HistoryHead is where the next one goes
+	TArray<FVector3f> History;
+	int32 HistoryHead{ 0 };
+	int32 HistoryCount{ 0 };
 
+	// Largest stock in the ring and at least 1, the chart's vertical scale
+	float HistoryMax{ 1.f };
 };
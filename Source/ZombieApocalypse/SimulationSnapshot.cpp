@@ -0,0 +1,136 @@
+// Copyright University of Inland Norway
+
+#include "SimulationSnapshot.h"
+#include <algorithm>
+
+void FSnapshotStore::SetMemoryBudget(size_t InBytes)
+{
+    MemoryBudget = InBytes;
+    EnforceBudget();
+}
+
+void FSnapshotStore::Save(int32_t Day, const std::vector<uint8_t>& Bytes)
+{
+    TruncateAfter(Day - 1);
+
+    // 1. - Share every page that matches the same page of the latest snapshot
+    const FSnapshot* Previous = Snapshots.empty() ? nullptr : &Snapshots.rbegin()->second;
+
+    FSnapshot Snapshot;
+    Snapshot.Size = Bytes.size();
+    const size_t NumPages = (Bytes.size() + PageSize - 1) / PageSize;
+    Snapshot.Pages.reserve(NumPages);
+    for (size_t Page = 0; Page < NumPages; ++Page)
+    {
+        const size_t Offset = Page * PageSize;
+        const size_t Length = std::min(PageSize, Bytes.size() - Offset);
+        const uint8_t* Data = Bytes.data() + Offset;
+
+        if (Previous && Page < Previous->Pages.size())
+        {
+            const std::vector<uint8_t>& Old = *Previous->Pages[Page];
+            if (Old.size() == Length && std::equal(Old.begin(), Old.end(), Data))
+            {
+                Snapshot.Pages.push_back(Previous->Pages[Page]);
+                AddRef(Snapshot.Pages.back());
+                continue;
+            }
+        }
+
+        Snapshot.Pages.push_back(std::make_shared<const std::vector<uint8_t>>(Data, Data + Length));
+        AddRef(Snapshot.Pages.back());
+    }
+
+    // 2. - Then make room, the new snapshot is never the one thinned out
+    Snapshots[Day] = std::move(Snapshot);
+    EnforceBudget();
+}
+
+int32_t FSnapshotStore::FindAtOrBefore(int32_t Day) const
+{
+    auto It = Snapshots.upper_bound(Day);
+    if (It == Snapshots.begin())
+        return -1;
+    return (--It)->first;
+}
+
+bool FSnapshotStore::Load(int32_t Day, std::vector<uint8_t>& OutBytes) const
+{
+    const auto It = Snapshots.find(Day);
+    if (It == Snapshots.end())
+        return false;
+
+    OutBytes.clear();
+    OutBytes.reserve(It->second.Size);
+    for (const FPage& Page : It->second.Pages)
+    {
+        OutBytes.insert(OutBytes.end(), Page->begin(), Page->end());
+    }
+    return true;
+}
+
+void FSnapshotStore::TruncateAfter(int32_t Day)
+{
+    auto It = Snapshots.upper_bound(Day);
+    while (It != Snapshots.end())
+    {
+        Release(It->second);
+        It = Snapshots.erase(It);
+    }
+}
+
+void FSnapshotStore::Clear()
+{
+    Snapshots.clear();
+    PageRefs.clear();
+    PageBytes = 0;
+}
+
+void FSnapshotStore::AddRef(const FPage& Page)
+{
+    if (PageRefs[Page.get()]++ == 0)
+    {
+        PageBytes += Page->size();
+    }
+}
+
+void FSnapshotStore::Release(const FSnapshot& Snapshot)
+{
+    for (const FPage& Page : Snapshot.Pages)
+    {
+        const auto It = PageRefs.find(Page.get());
+        if (It != PageRefs.end() && --It->second == 0)
+        {
+            PageBytes -= Page->size();
+            PageRefs.erase(It);
+        }
+    }
+}
+
+void FSnapshotStore::EnforceBudget()
+{
+    while (MemoryBudget > 0 && PageBytes > MemoryBudget && Snapshots.size() > 2)
+    {
+        // Every other snapshot in the older half, the first one stays as the run's starting point; with three
+        // left the half is widened to two, or the middle one could never go and the budget would stay exceeded
+        const size_t OlderHalf = std::max<size_t>(2, Snapshots.size() / 2);
+        size_t Index = 0;
+        bool bDroppedAny = false;
+        for (auto It = Snapshots.begin(); It != Snapshots.end() && Index < OlderHalf; ++Index)
+        {
+            if (Index % 2 == 1)
+            {
+                Release(It->second);
+                It = Snapshots.erase(It);
+                bDroppedAny = true;
+            }
+            else
+            {
+                ++It;
+            }
+        }
+
+        if (!bDroppedAny)
+            break;
+    }
+}
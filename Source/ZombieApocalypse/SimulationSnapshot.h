@@ -0,0 +1,195 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Flat binary snapshots of simulation state, engine-free like the models they hold.
+ *
+ * Every stateful piece (FSDEngine, FGridStorage, FGridInfectionModel, ...) writes
+ * its fields in order through FSnapshotWriter and reads them back through
+ * FSnapshotReader. Values are raw native-endian copies, so a snapshot is meant
+ * for rewinding and forking within a build, not as a file format across machines.
+ */
+class FSnapshotWriter
+{
+public:
+	explicit FSnapshotWriter(std::vector<uint8_t>& InBytes) : Bytes(InBytes) {}
+
+	template <typename T>
+	void Write(const T& Value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshots copy raw bytes");
+		WriteBytes(&Value, sizeof(T));
+	}
+
+	/** Element count followed by the elements. */
+	template <typename T>
+	void WriteArray(const T* Data, size_t Count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshots copy raw bytes");
+		Write<uint64_t>(Count);
+		WriteBytes(Data, Count * sizeof(T));
+	}
+
+	template <typename T>
+	void WriteArray(const std::vector<T>& Values) { WriteArray(Values.data(), Values.size()); }
+
+	/** Zero padding up to a multiple of Alignment, so a section that follows a variable-length one stays page aligned. */
+	void Pad(size_t Alignment)
+	{
+		Bytes.resize((Bytes.size() + Alignment - 1) / Alignment * Alignment, 0);
+	}
+
+	void WriteBytes(const void* Data, size_t Size)
+	{
+		const size_t Offset = Bytes.size();
+		Bytes.resize(Offset + Size);
+		if (Size > 0)
+		{
+			std::memcpy(Bytes.data() + Offset, Data, Size);
+		}
+	}
+
+private:
+	std::vector<uint8_t>& Bytes;
+};
+
+/** Reads what FSnapshotWriter wrote; every read fails, and keeps failing, once the data runs out. */
+class FSnapshotReader
+{
+public:
+	FSnapshotReader(const uint8_t* InData, size_t InSize) : Data(InData), Size(InSize) {}
+	explicit FSnapshotReader(const std::vector<uint8_t>& Bytes) : Data(Bytes.data()), Size(Bytes.size()) {}
+
+	template <typename T>
+	bool Read(T& OutValue)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshots copy raw bytes");
+		return ReadBytes(&OutValue, sizeof(T));
+	}
+
+	/** Counts above MaxCount are treated as corrupt rather than allocated. */
+	template <typename T>
+	bool ReadArray(std::vector<T>& OutValues, size_t MaxCount)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Snapshots copy raw bytes");
+		uint64_t Count = 0;
+		if (!Read(Count) || Count > MaxCount || Count * sizeof(T) > Size - Offset)
+		{
+			bFailed = true;
+			return false;
+		}
+
+		OutValues.resize(static_cast<size_t>(Count));
+		return ReadBytes(OutValues.data(), static_cast<size_t>(Count) * sizeof(T));
+	}
+
+	bool ReadBytes(void* OutData, size_t Count)
+	{
+		if (bFailed || Count > Size - Offset)
+		{
+			bFailed = true;
+			return false;
+		}
+
+		if (Count > 0)
+		{
+			std::memcpy(OutData, Data + Offset, Count);
+		}
+		Offset += Count;
+		return true;
+	}
+
+	/** Skips the padding FSnapshotWriter::Pad wrote. */
+	bool Pad(size_t Alignment)
+	{
+		const size_t Target = (Offset + Alignment - 1) / Alignment * Alignment;
+		if (bFailed || Target > Size)
+		{
+			bFailed = true;
+			return false;
+		}
+		Offset = Target;
+		return true;
+	}
+
+	bool HasFailed() const { return bFailed; }
+	bool IsAtEnd() const { return Offset == Size; }
+
+private:
+	const uint8_t* Data;
+	size_t Size;
+	size_t Offset{ 0 };
+	bool bFailed{ false };
+};
+
+/**
+ * Day-indexed snapshot history with copy-on-write pages.
+ *
+ * Each snapshot is cut into fixed pages and a page identical to the one at the
+ * same offset in the previous snapshot is shared instead of stored again, so a
+ * snapshot costs only the pages that changed since the last one, yet every
+ * snapshot is complete: restoring is one concatenation, never a replay of a
+ * delta chain. Copying the store is a fork, both copies share every page until
+ * one of them saves. When the unique pages exceed the memory budget, every
+ * other snapshot in the older half is dropped, so long runs keep dense recent
+ * history and thinning keyframes further back.
+ */
+class FSnapshotStore
+{
+public:
+	static constexpr size_t PageSize = 4096;
+
+	/** 0 keeps everything. */
+	void SetMemoryBudget(size_t InBytes);
+	size_t GetMemoryBudget() const { return MemoryBudget; }
+
+	/** Stores Bytes as the state after Day, dropping any snapshots from Day on first. */
+	void Save(int32_t Day, const std::vector<uint8_t>& Bytes);
+
+	/** Latest day with a snapshot at or before Day, -1 if there is none. */
+	int32_t FindAtOrBefore(int32_t Day) const;
+
+	/** Rebuilds the snapshot saved for exactly Day. */
+	bool Load(int32_t Day, std::vector<uint8_t>& OutBytes) const;
+
+	/** Drops every snapshot after Day, for when a rewound run takes a different branch. */
+	void TruncateAfter(int32_t Day);
+
+	void Clear();
+
+	int32_t GetNumSnapshots() const { return static_cast<int32_t>(Snapshots.size()); }
+	int32_t GetLatestDay() const { return Snapshots.empty() ? -1 : Snapshots.rbegin()->first; }
+
+	/** Bytes of the distinct pages this store holds, pages shared with a fork count for both. */
+	size_t GetMemoryBytes() const { return PageBytes; }
+
+private:
+	using FPage = std::shared_ptr<const std::vector<uint8_t>>;
+
+	struct FSnapshot
+	{
+		std::vector<FPage> Pages;
+		size_t Size{ 0 };
+	};
+
+	void AddRef(const FPage& Page);
+	void Release(const FSnapshot& Snapshot);
+	void EnforceBudget();
+
+	std::map<int32_t, FSnapshot> Snapshots;
+
+	// Snapshots in this store holding each page, so a fork's references never skew the budget
+	std::unordered_map<const void*, int32_t> PageRefs;
+	size_t MemoryBudget{ 0 };
+	size_t PageBytes{ 0 };
+};
@@ -0,0 +1,72 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "DensityEffectCurve.h"
+#include "SDBatchEngine.h"
+#include "SDModel.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDensityEffectCurveNaNTest, "ZombieApocalypse.Kernels.DensityEffectNaN",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDensityEffectCurveNaNTest::RunTest(const FString& Parameters)
+{
+    const std::vector<std::pair<float, float>> Points = { { 0.f, 0.1f }, { 0.5f, 0.4f }, { 1.f, 1.f }, { 2.f, 1.3f } };
+    const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+    // 1. - Both compiled layouts, uniform after resampling and as given
+    for (const int32_t ResampleCount : { 0, 64 })
+    {
+        FDensityEffectCurve Curve;
+        TestTrue(TEXT("Curve builds"), Curve.Build(Points, ResampleCount));
+        TestEqual(FString::Printf(TEXT("NaN takes the last y, %d resampled"), ResampleCount), Curve.Evaluate(NaN), 1.3f);
+        TestEqual(TEXT("Below the table"), Curve.Evaluate(-1.f), 0.1f);
+        TestEqual(TEXT("Above the table"), Curve.Evaluate(5.f), 1.3f);
+    }
+
+    // 2. - A zero LandArea makes the density infinite and a zero NormalPopulationDensity with no people makes
+    // it NaN; the batch lanes must step exactly like the scalar engine through both
+    std::vector<FSDParams> Scenarios(3);
+    Scenarios[0].LandArea = 0.f;
+    Scenarios[1].NormalPopulationDensity = 0.f;
+    FSDState Empty;
+    Empty.Susceptible = 0.f;
+    Empty.Zombies = 5.f;
+
+    for (const FSDState& Initial : { FSDState(), Empty })
+    {
+        FSDBatchEngine Batch;
+        Batch.SetGraph(Points);
+        Batch.Reset(Scenarios, Initial);
+        std::vector<FSDEngine> Scalar(Scenarios.size());
+        for (size_t i = 0; i < Scenarios.size(); ++i)
+        {
+            Scalar[i].SetGraph(Points);
+            Scalar[i].SetParams(Scenarios[i]);
+            Scalar[i].Reset(Initial);
+        }
+
+        for (int32_t Day = 0; Day < 30; ++Day)
+        {
+            Batch.Step();
+            for (FSDEngine& Engine : Scalar)
+            {
+                Engine.Step();
+            }
+        }
+
+        for (size_t i = 0; i < Scenarios.size(); ++i)
+        {
+            const FSDState& State = Scalar[i].GetState();
+            TestTrue(FString::Printf(TEXT("Scenario %d matches the scalar engine"), static_cast<int32>(i)),
+                State.Susceptible == Batch.GetSusceptible()[i] && State.Bitten == Batch.GetBitten()[i] && State.Zombies == Batch.GetZombies()[i]);
+        }
+    }
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
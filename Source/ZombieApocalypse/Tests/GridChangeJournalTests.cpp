@@ -0,0 +1,109 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "GridChangeJournal.h"
+#include "GridStorage.h"
+#include "ZombieTestRandom.h"
+#include <algorithm>
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridChangeJournalTest, "ZombieApocalypse.Grid.ChangeJournal",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGridChangeJournalTest::RunTest(const FString& Parameters)
+{
+    FZombieTestRandom Random(1618);
+    const int32_t TilesX = 5;
+    const int32_t TilesY = 3;
+    const int32_t Width = TilesX << FGridStorage::TileShift;
+    const int32_t Height = TilesY << FGridStorage::TileShift;
+
+    // 1. - A fresh journal has nothing to replay and every tile dirty, so readers rescan once
+    FGridChangeJournal Journal;
+    Journal.Reset(TilesX, TilesY, 64);
+    const FGridChange* Changes = nullptr;
+    size_t NumChanges = 0;
+    TestFalse(TEXT("Readers from before Reset rescan"), Journal.GetChangesSince(0, Changes, NumChanges));
+    TestTrue(TEXT("Reset dirties every tile"), Journal.AreAllTilesDirty() && Journal.IsTileDirty(TilesX * TilesY - 1));
+    Journal.BeginFrame();
+    TestTrue(TEXT("The frame after Reset knows"), Journal.WereAllTilesDirty() && !Journal.AreAllTilesDirty());
+
+    // 2. - Each frame's log replays in order, and its tiles are dirty for that frame and the next
+    std::vector<int32_t> LastFrameTiles;
+    for (int32_t Frame = 0; Frame < 4; ++Frame)
+    {
+        const uint64_t Since = Journal.GetSequence();
+        std::vector<FGridChange> Expected;
+        std::vector<int32_t> ExpectedTiles;
+        for (int32_t i = 0; i < 1 + Random.Next(12); ++i)
+        {
+            const int32_t X = Random.Next(Width);
+            const int32_t Y = Random.Next(Height);
+            if (Random.Next(2) == 0)
+            {
+                const EGridCell Before = static_cast<EGridCell>(Random.Next(3));
+                const EGridCell After = static_cast<EGridCell>(Random.Next(3));
+                Journal.RecordCell(X, Y, Before, After);
+                Expected.push_back({ X, Y, EGridChangeKind::Cell, static_cast<uint8_t>(Before), static_cast<uint8_t>(After) });
+            }
+            else
+            {
+                const EGridEdge Edge = static_cast<EGridEdge>(Random.Next(4));
+                Journal.RecordFence(X, Y, Edge);
+                Expected.push_back({ X, Y, EGridChangeKind::Fence, 0, static_cast<uint8_t>(Edge) });
+            }
+            ExpectedTiles.push_back((Y >> FGridStorage::TileShift) * TilesX + (X >> FGridStorage::TileShift));
+        }
+
+        bool bSameLog = Journal.GetChangesSince(Since, Changes, NumChanges) && NumChanges == Expected.size();
+        for (size_t i = 0; bSameLog && i < NumChanges; ++i)
+        {
+            bSameLog = Changes[i].X == Expected[i].X && Changes[i].Y == Expected[i].Y && Changes[i].Kind == Expected[i].Kind
+                && Changes[i].Before == Expected[i].Before && Changes[i].After == Expected[i].After;
+        }
+        TestTrue(FString::Printf(TEXT("Frame %d replays its changes"), Frame), bSameLog);
+
+        std::sort(ExpectedTiles.begin(), ExpectedTiles.end());
+        ExpectedTiles.erase(std::unique(ExpectedTiles.begin(), ExpectedTiles.end()), ExpectedTiles.end());
+        std::vector<int32_t> Dirty = Journal.GetDirtyTiles();
+        std::sort(Dirty.begin(), Dirty.end());
+        TestTrue(FString::Printf(TEXT("Frame %d lists each touched tile once"), Frame), Dirty == ExpectedTiles);
+        for (int32_t TileIndex = 0; TileIndex < TilesX * TilesY; ++TileIndex)
+        {
+            TestEqual(TEXT("Dirty bit"), Journal.IsTileDirty(TileIndex), std::binary_search(ExpectedTiles.begin(), ExpectedTiles.end(), TileIndex));
+        }
+
+        std::vector<int32_t> Previous = Journal.GetPreviousDirtyTiles();
+        std::sort(Previous.begin(), Previous.end());
+        TestTrue(FString::Printf(TEXT("Frame %d still has the frame before"), Frame), Previous == LastFrameTiles);
+
+        Journal.BeginFrame();
+        LastFrameTiles = ExpectedTiles;
+        TestTrue(TEXT("BeginFrame clears the frame"), Journal.GetDirtyTiles().empty());
+    }
+
+    // 3. - A full log drops its older half, readers that fell behind rescan and recent ones still replay
+    const uint64_t Behind = Journal.GetSequence();
+    for (int32_t i = 0; i < 64; ++i)
+    {
+        Journal.RecordCell(i % Width, 0, EGridCell::Empty, EGridCell::Human);
+    }
+    const uint64_t Recent = Journal.GetSequence();
+    Journal.RecordCell(1, 2, EGridCell::Human, EGridCell::Zombie);
+    TestFalse(TEXT("Trimmed range rescans"), Journal.GetChangesSince(Behind, Changes, NumChanges));
+    TestTrue(TEXT("Recent reader replays"), Journal.GetChangesSince(Recent, Changes, NumChanges) && NumChanges == 1
+        && Changes[0].X == 1 && Changes[0].Y == 2 && Changes[0].After == static_cast<uint8_t>(EGridCell::Zombie));
+    TestFalse(TEXT("A sequence from the future is refused"), Journal.GetChangesSince(Journal.GetSequence() + 1, Changes, NumChanges));
+
+    // 4. - Invalidate sends every reader back to a rescan and dirties everything
+    const uint64_t BeforeBulk = Journal.GetSequence();
+    Journal.Invalidate();
+    TestFalse(TEXT("Invalidate forces a rescan"), Journal.GetChangesSince(BeforeBulk, Changes, NumChanges));
+    TestTrue(TEXT("Caught up after the rescan"), Journal.GetChangesSince(Journal.GetSequence(), Changes, NumChanges) && NumChanges == 0);
+    TestTrue(TEXT("Invalidate dirties every tile"), Journal.AreAllTilesDirty() && Journal.IsTileDirty(0));
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,99 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "GridConnectivity.h"
+#include "GridPathfinder.h"
+#include "GridStorage.h"
+#include "ZombieTestRandom.h"
+#include <unordered_map>
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridConnectivityEditTest, "ZombieApocalypse.Grid.ConnectivityAfterEdits",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGridConnectivityEditTest::RunTest(const FString& Parameters)
+{
+    FZombieTestRandom Random(2718);
+
+    for (const int32_t Size : { 6, 21, 64 })
+    {
+        FGridStorage Grid;
+        Grid.Init(Size, Size);
+        for (int32_t i = 0; i < Size * Size / 5; ++i)
+        {
+            Grid.SetCell(Random.Next(Size), Random.Next(Size), static_cast<EGridCell>(Random.Next(3)));
+        }
+
+        FGridConnectivity Patched;
+        Patched.Build(Grid);
+        FGridPathfinder Pathfinder;
+
+        for (int32_t Round = 0; Round < 8; ++Round)
+        {
+            // 1. - Edits through the labels, cells that open and close links and fences that cut regions
+            for (int32_t i = 0; i < 1 + Random.Next(2 * Size); ++i)
+            {
+                const int32_t X = Random.Next(Size);
+                const int32_t Y = Random.Next(Size);
+                if (Random.Next(3) == 0)
+                {
+                    Patched.PlaceFence(Grid, X, Y, static_cast<EGridEdge>(Random.Next(4)));
+                }
+                else
+                {
+                    Patched.SetCell(Grid, X, Y, static_cast<EGridCell>(Random.Next(3)));
+                }
+            }
+
+            FGridConnectivity Fresh;
+            Fresh.Build(Grid);
+
+            // 2. - Labels may be numbered differently, but must split the cells the same way
+            std::unordered_map<int32_t, int32_t> PatchedToFresh;
+            std::unordered_map<int32_t, int32_t> FreshToPatched;
+            bool bSamePartition = Patched.GetNumRegions() == Fresh.GetNumRegions();
+            for (int32_t Y = 0; bSamePartition && Y < Size; ++Y)
+            {
+                for (int32_t X = 0; bSamePartition && X < Size; ++X)
+                {
+                    const int32_t A = Patched.GetRegion(X, Y);
+                    const int32_t B = Fresh.GetRegion(X, Y);
+                    if (A == FGridConnectivity::NoRegion || B == FGridConnectivity::NoRegion)
+                    {
+                        bSamePartition = A == B;
+                        continue;
+                    }
+                    bSamePartition = PatchedToFresh.emplace(A, B).first->second == B && FreshToPatched.emplace(B, A).first->second == A;
+                }
+            }
+            if (!bSamePartition)
+            {
+                AddError(FString::Printf(TEXT("%dx%d, round %d: regions differ from a fresh Build"), Size, Size, Round));
+                continue;
+            }
+
+            // 3. - Each region keeps the same totals, so the safe human count agrees too
+            for (const auto& Pair : PatchedToFresh)
+            {
+                TestEqual(TEXT("Region cells"), Patched.GetRegionCells(Pair.first), Fresh.GetRegionCells(Pair.second));
+                TestEqual(TEXT("Region humans"), Patched.GetRegionHumans(Pair.first), Fresh.GetRegionHumans(Pair.second));
+                TestEqual(TEXT("Region exposure"), Patched.IsRegionExposed(Pair.first), Fresh.IsRegionExposed(Pair.second));
+            }
+            TestEqual(TEXT("Safe humans"), Patched.GetSafeHumans(), Fresh.GetSafeHumans());
+
+            // 4. - CanReach answers like a search
+            for (int32_t Query = 0; Query < 30; ++Query)
+            {
+                const FGridPoint Start = { Random.Next(Size), Random.Next(Size) };
+                const FGridPoint End = { Random.Next(Size), Random.Next(Size) };
+                TestEqual(FString::Printf(TEXT("%dx%d: (%d, %d) -> (%d, %d) reachable"), Size, Size, Start.X, Start.Y, End.X, End.Y),
+                    Patched.CanReach(Grid, Start, End), Pathfinder.FindPath(Grid, Start, End, EGridPathMode::AStar));
+            }
+        }
+    }
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,95 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "GridFlowField.h"
+#include "GridStorage.h"
+#include "ZombieTestRandom.h"
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridFlowFieldUpdateTest, "ZombieApocalypse.Pathfinding.FlowFieldUpdate",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGridFlowFieldUpdateTest::RunTest(const FString& Parameters)
+{
+    FZombieTestRandom Random(31337);
+
+    for (const int32_t Size : { 9, 33, 80 })
+    {
+        const int32_t Height = Size + 3;
+        FGridStorage Grid;
+        Grid.Init(Size, Height);
+        for (int32_t i = 0; i < Size * Height / 6; ++i)
+        {
+            Grid.SetCell(Random.Next(Size), Random.Next(Height), static_cast<EGridCell>(Random.Next(3)));
+            Grid.PlaceFence(Random.Next(Size), Random.Next(Height), static_cast<EGridEdge>(Random.Next(4)));
+        }
+
+        for (const EGridCell Target : { EGridCell::Human, EGridCell::Zombie })
+        {
+            FGridFlowField Patched;
+            Patched.Build(Grid, Target);
+
+            for (int32_t Round = 0; Round < 6; ++Round)
+            {
+                // 1. - Cell edits that add and remove targets, and fences reported with the cells on both sides
+                std::vector<FGridPoint> Changed;
+                for (int32_t i = 0; i < 1 + Random.Next(Size); ++i)
+                {
+                    const int32_t X = Random.Next(Size);
+                    const int32_t Y = Random.Next(Height);
+                    if (Random.Next(2) == 0)
+                    {
+                        Grid.SetCell(X, Y, static_cast<EGridCell>(Random.Next(3)));
+                        Changed.push_back({ X, Y });
+                    }
+                    else
+                    {
+                        const EGridEdge Edge = static_cast<EGridEdge>(Random.Next(4));
+                        FGridPoint A;
+                        FGridPoint B;
+                        FGridStorage::GetEdgeCells(X, Y, Edge, A, B);
+                        Grid.PlaceFence(X, Y, Edge);
+                        Changed.push_back(A);
+                        Changed.push_back(B);
+                    }
+                }
+                Patched.Update(Grid, Changed);
+
+                FGridFlowField Fresh;
+                Fresh.Build(Grid, Target);
+
+                // 2. - Every distance matches the fresh sweep, and every next step is a legal move one closer
+                int32_t Mismatches = 0;
+                for (int32_t Y = 0; Y < Height; ++Y)
+                {
+                    for (int32_t X = 0; X < Size; ++X)
+                    {
+                        const uint32_t Distance = Patched.GetDistance(X, Y);
+                        Mismatches += Distance != Fresh.GetDistance(X, Y);
+
+                        FGridPoint Next;
+                        if (Patched.GetNextStep(Grid, X, Y, Next))
+                        {
+                            TestTrue(TEXT("Next step is an open neighbour"), Grid.CanMoveBetweenCells(X, Y, Next.X, Next.Y));
+                            TestTrue(TEXT("Next step is one closer"), Patched.GetDistance(Next.X, Next.Y) + 1 == Distance);
+                        }
+                        else
+                        {
+                            TestTrue(TEXT("No step only at a target or where none is reachable"), Distance == 0 || Distance == FGridFlowField::Unreachable);
+                        }
+                    }
+                }
+                if (Mismatches > 0)
+                {
+                    AddError(FString::Printf(TEXT("%dx%d, target %d, round %d: %d distances differ from a fresh Build"),
+                        Size, Height, static_cast<int32>(Target), Round, Mismatches));
+                }
+            }
+        }
+    }
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,90 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "GridPathfinder.h"
+#include "GridPathHierarchy.h"
+#include "GridStorage.h"
+#include "ZombieTestRandom.h"
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridPathHierarchyFenceEditTest, "ZombieApocalypse.Pathfinding.HierarchyAfterFenceEdits",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGridPathHierarchyFenceEditTest::RunTest(const FString& Parameters)
+{
+    FZombieTestRandom Random(4242);
+
+    // Hierarchical paths are near-shortest by design, so A* only bounds their cost from below. What must
+    // hold exactly is that a hierarchy patched with Update plans the same paths as one built from scratch
+    for (const int32_t Size : { 24, 40, 97 })
+    {
+        FGridStorage Grid;
+        Grid.Init(Size, Size);
+        for (int32_t i = 0; i < Size * Size / 4; ++i)
+        {
+            Grid.PlaceFence(Random.Next(Size), Random.Next(Size), static_cast<EGridEdge>(Random.Next(4)));
+        }
+
+        FGridPathHierarchy Patched;
+        Patched.Build(Grid, 8);
+        FGridPathfinder Flat;
+        FGridPathfinder FromPatched;
+        FGridPathfinder FromFresh;
+
+        for (int32_t Round = 0; Round < 3; ++Round)
+        {
+            // 1. - New fences, each reported with the cells on both of its sides
+            std::vector<FGridPoint> Changed;
+            for (int32_t i = 0; i < 20; ++i)
+            {
+                const int32_t X = Random.Next(Size);
+                const int32_t Y = Random.Next(Size);
+                const EGridEdge Edge = static_cast<EGridEdge>(Random.Next(4));
+                FGridPoint A;
+                FGridPoint B;
+                FGridStorage::GetEdgeCells(X, Y, Edge, A, B);
+                Grid.PlaceFence(X, Y, Edge);
+                Changed.push_back(A);
+                Changed.push_back(B);
+            }
+            Patched.Update(Grid, Changed);
+
+            FGridPathHierarchy Fresh;
+            Fresh.Build(Grid, 8);
+
+            // 2. - Same reachability as A*, never shorter, and the patched hierarchy agrees with the fresh one
+            for (int32_t Query = 0; Query < 100; ++Query)
+            {
+                const FGridPoint Start = { Random.Next(Size), Random.Next(Size) };
+                const FGridPoint End = { Random.Next(Size), Random.Next(Size) };
+                const bool bFlatFound = Flat.FindPath(Grid, Start, End, EGridPathMode::AStar);
+                const bool bPatchedFound = FromPatched.FindPath(Grid, Start, End, EGridPathMode::Hierarchical, &Patched);
+                const bool bFreshFound = FromFresh.FindPath(Grid, Start, End, EGridPathMode::Hierarchical, &Fresh);
+
+                if (bFlatFound != bPatchedFound || bPatchedFound != bFreshFound)
+                {
+                    AddError(FString::Printf(TEXT("%d, round %d: (%d, %d) -> (%d, %d) found by A* %d, patched %d, fresh %d"),
+                        Size, Round, Start.X, Start.Y, End.X, End.Y, bFlatFound, bPatchedFound, bFreshFound));
+                    continue;
+                }
+                if (!bFlatFound)
+                    continue;
+
+                const std::vector<FGridPoint>& Path = FromPatched.GetPath();
+                bool bValid = Path.front() == Start && Path.back() == End;
+                for (size_t i = 1; bValid && i < Path.size(); ++i)
+                {
+                    bValid = Grid.CanMoveBetweenCells(Path[i - 1].X, Path[i - 1].Y, Path[i].X, Path[i].Y);
+                }
+                TestTrue(TEXT("Hierarchical path steps only between open neighbours"), bValid);
+                TestTrue(TEXT("Hierarchical path is no shorter than A*"), Path.size() >= Flat.GetPath().size());
+                TestTrue(TEXT("Patched and fresh hierarchies plan the same path"), Path == FromFresh.GetPath());
+            }
+        }
+    }
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
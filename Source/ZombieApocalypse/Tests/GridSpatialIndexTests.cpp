@@ -0,0 +1,118 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "GridSpatialIndex.h"
+#include "GridStorage.h"
+#include "ZombieTestRandom.h"
+#include <algorithm>
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridSpatialIndexQueryTest, "ZombieApocalypse.Grid.SpatialIndexQueries",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGridSpatialIndexQueryTest::RunTest(const FString& Parameters)
+{
+    FZombieTestRandom Random(777);
+
+    for (const int32_t Width : { 5, 16, 50, 130 })
+    {
+        const int32_t Height = Width * 3 / 4 + 1;
+        FGridStorage Grid;
+        Grid.Init(Width, Height);
+        for (int32_t i = 0; i < Width * Height / 20; ++i)
+        {
+            Grid.SetCell(Random.Next(Width), Random.Next(Height), static_cast<EGridCell>(1 + Random.Next(2)));
+        }
+
+        FGridSpatialIndex Index;
+        Index.Build(Grid);
+
+        // The second round runs on an index caught up through Update instead of Build
+        for (int32_t Round = 0; Round < 2; ++Round)
+        {
+            for (int32_t Query = 0; Query < 100; ++Query)
+            {
+                const int32_t X = Random.Next(Width);
+                const int32_t Y = Random.Next(Height);
+                const int32_t Radius = Random.Next(20) - 2;
+                const EGridCell State = static_cast<EGridCell>(1 + Random.Next(2));
+
+                // 1. - Linear scan in row-major order, a stable sort keeps ties on the lower index like the index does
+                std::vector<FGridNeighbor> Expected;
+                for (int32_t CellY = 0; CellY < Height; ++CellY)
+                {
+                    for (int32_t CellX = 0; CellX < Width; ++CellX)
+                    {
+                        const int32_t DistanceSq = (CellX - X) * (CellX - X) + (CellY - Y) * (CellY - Y);
+                        if (Grid.GetCell(CellX, CellY) == State && (Radius < 0 || DistanceSq <= Radius * Radius))
+                        {
+                            Expected.push_back({ { CellX, CellY }, DistanceSq });
+                        }
+                    }
+                }
+                std::stable_sort(Expected.begin(), Expected.end(), [](const FGridNeighbor& A, const FGridNeighbor& B) { return A.DistanceSq < B.DistanceSq; });
+
+                // 2. - Nearest K, closest first
+                const int32_t K = 1 + Random.Next(5);
+                std::vector<FGridNeighbor> Nearest;
+                Index.FindNearest(Grid, X, Y, State, K, Radius, Nearest);
+                bool bNearestMatches = Nearest.size() == std::min<size_t>(K, Expected.size());
+                for (size_t i = 0; bNearestMatches && i < Nearest.size(); ++i)
+                {
+                    bNearestMatches = Nearest[i].Cell == Expected[i].Cell && Nearest[i].DistanceSq == Expected[i].DistanceSq;
+                }
+                if (!bNearestMatches)
+                {
+                    AddError(FString::Printf(TEXT("%dx%d: %d nearest of state %d to (%d, %d) within %d differ from the linear scan"),
+                        Width, Height, K, static_cast<int32>(State), X, Y, Radius));
+                }
+
+                if (Radius < 0)
+                    continue;
+
+                // 3. - Radius query and count, compared as sets since the index returns tile order
+                std::vector<FGridNeighbor> InRadius;
+                Index.FindInRadius(Grid, X, Y, Radius, State, InRadius);
+                const auto ToCellIndices = [Width](const std::vector<FGridNeighbor>& Cells)
+                {
+                    std::vector<int32_t> Indices;
+                    for (const FGridNeighbor& Cell : Cells)
+                    {
+                        Indices.push_back(Cell.Cell.X + Cell.Cell.Y * Width);
+                    }
+                    std::sort(Indices.begin(), Indices.end());
+                    return Indices;
+                };
+                if (ToCellIndices(InRadius) != ToCellIndices(Expected))
+                {
+                    AddError(FString::Printf(TEXT("%dx%d: cells of state %d within %d of (%d, %d) differ from the linear scan"),
+                        Width, Height, static_cast<int32>(State), Radius, X, Y));
+                }
+                TestEqual(TEXT("CountInRadius"), Index.CountInRadius(Grid, X, Y, Radius, State), static_cast<int32_t>(Expected.size()));
+            }
+
+            std::vector<FGridPoint> Changed;
+            for (int32_t i = 0; i < Width; ++i)
+            {
+                const FGridPoint Cell = { Random.Next(Width), Random.Next(Height) };
+                Grid.SetCell(Cell.X, Cell.Y, static_cast<EGridCell>(Random.Next(3)));
+                Changed.push_back(Cell);
+            }
+            // Fences on the border report a cell off the map, Update must pass over it
+            for (const EGridEdge Edge : { EGridEdge::Top, EGridEdge::Bottom, EGridEdge::Left, EGridEdge::Right })
+            {
+                FGridPoint A;
+                FGridPoint B;
+                FGridStorage::GetEdgeCells(Edge == EGridEdge::Right ? Width - 1 : 0, Edge == EGridEdge::Top ? Height - 1 : 0, Edge, A, B);
+                Changed.push_back(A);
+                Changed.push_back(B);
+            }
+            Index.Update(Grid, Changed);
+        }
+    }
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,60 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "GridStorage.h"
+#include "ZombieTestRandom.h"
+#include <algorithm>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridCountCellsInRectTest, "ZombieApocalypse.Grid.CountCellsInRect",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGridCountCellsInRectTest::RunTest(const FString& Parameters)
+{
+    FZombieTestRandom Random(12345);
+
+    // Sizes around the 8-cell tile edge, so rectangles cut through partial tiles on every side
+    for (const int32_t Width : { 1, 7, 8, 9, 37, 64, 100 })
+    {
+        for (const int32_t Height : { 1, 8, 13, 70 })
+        {
+            FGridStorage Grid;
+            Grid.Init(Width, Height);
+            for (int32_t i = 0; i < Width * Height / 2; ++i)
+            {
+                Grid.SetCell(Random.Next(Width), Random.Next(Height), static_cast<EGridCell>(Random.Next(3)));
+            }
+
+            // Corners may fall outside the grid or come in the wrong order, both must clamp like the brute force
+            for (int32_t Query = 0; Query < 50; ++Query)
+            {
+                const int32_t MinX = Random.Next(Width + 4) - 2;
+                const int32_t MaxX = Random.Next(Width + 4) - 2;
+                const int32_t MinY = Random.Next(Height + 4) - 2;
+                const int32_t MaxY = Random.Next(Height + 4) - 2;
+                for (const EGridCell State : { EGridCell::Empty, EGridCell::Human, EGridCell::Zombie })
+                {
+                    int64 Expected = 0;
+                    for (int32_t Y = std::max(0, MinY); Y <= std::min(Height - 1, MaxY); ++Y)
+                    {
+                        for (int32_t X = std::max(0, MinX); X <= std::min(Width - 1, MaxX); ++X)
+                        {
+                            Expected += Grid.GetCell(X, Y) == State;
+                        }
+                    }
+
+                    const int64 Counted = Grid.CountCellsInRect(State, MinX, MinY, MaxX, MaxY);
+                    if (Counted != Expected)
+                    {
+                        AddError(FString::Printf(TEXT("%dx%d, [%d, %d]-[%d, %d], state %d: %lld cells, brute force %lld"),
+                            Width, Height, MinX, MinY, MaxX, MaxY, static_cast<int32>(State), Counted, Expected));
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
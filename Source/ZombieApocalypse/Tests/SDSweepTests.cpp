@@ -0,0 +1,66 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "SDModel.h"
+#include "SDSweep.h"
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSDSweepFinalDayTest, "ZombieApocalypse.Sweeps.FinalDay",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSDSweepFinalDayTest::RunTest(const FString& Parameters)
+{
+    const std::vector<std::pair<float, float>> Points = { { 0.f, 0.1f }, { 0.5f, 0.4f }, { 1.f, 1.f }, { 2.f, 1.3f } };
+    FSDParamGrid Grid;
+    Grid.LandArea = { 250.f, 1000.f, 4000.f };
+
+    // Day counts RecordEvery divides and does not, including no days at all
+    for (const int32_t NumDays : { 0, 9, 10, 11 })
+    {
+        std::vector<FSDState> Expected;
+        for (int64_t Scenario = 0; Scenario < Grid.NumScenarios(); ++Scenario)
+        {
+            FSDEngine Engine;
+            Engine.SetGraph(Points);
+            Engine.SetParams(Grid.GetScenario(Scenario));
+            Engine.Reset(FSDState());
+            for (int32_t Day = 0; Day < NumDays; ++Day)
+            {
+                Engine.Step();
+            }
+            Expected.push_back(Engine.GetState());
+        }
+
+        for (const bool bVectorized : { false, true })
+        {
+            for (const bool bKeepTrajectories : { true, false })
+            {
+                FSDSweepConfig Config;
+                Config.NumDays = NumDays;
+                Config.RecordEvery = 3;
+                Config.bVectorized = bVectorized;
+                Config.bKeepTrajectories = bKeepTrajectories;
+                Config.GraphPts = Points;
+                const FSDSweepResult Result = RunSDSweep(Config, Grid);
+
+                // 1. - Day 0, every third day, then the final day unless it was already one of them
+                TestEqual(FString::Printf(TEXT("%d days, samples"), NumDays), Result.SamplesPerScenario,
+                    bKeepTrajectories ? 1 + (NumDays + 2) / 3 : 1);
+
+                // 2. - GetFinal is the state after NumDays, in both engines
+                for (int64_t Scenario = 0; Scenario < Result.NumScenarios; ++Scenario)
+                {
+                    const FSDTrajectoryPoint& Final = Result.GetFinal(Scenario);
+                    const FSDState& State = Expected[static_cast<size_t>(Scenario)];
+                    TestTrue(FString::Printf(TEXT("%d days, vectorized %d, scenario %d is the final day"), NumDays, bVectorized, static_cast<int32>(Scenario)),
+                        Final.Susceptible == State.Susceptible && Final.Bitten == State.Bitten && Final.Zombies == State.Zombies);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
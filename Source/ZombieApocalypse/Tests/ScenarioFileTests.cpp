@@ -0,0 +1,79 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "MappedFile.h"
+#include "ScenarioFile.h"
+#include "ZombieTestFiles.h"
+#include <cmath>
+#include <cstdio>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+static bool SameScenarioParams(const FSDParams& A, const FSDParams& B)
+{
+    return A.DaysToBecomeInfectedFromBite == B.DaysToBecomeInfectedFromBite
+        && A.BittenCapacity == B.BittenCapacity
+        && A.NormalNumberOfBites == B.NormalNumberOfBites
+        && A.LandArea == B.LandArea
+        && A.NormalPopulationDensity == B.NormalPopulationDensity
+        && A.DelayMode == B.DelayMode
+        && A.DelaySpreadDays == B.DelaySpreadDays
+        && A.Integrator == B.Integrator
+        && A.StepDays == B.StepDays
+        && A.Tolerance == B.Tolerance
+        && A.bWholePeople == B.bWholePeople;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FScenarioFileBinaryRoundTripTest, "ZombieApocalypse.Scenarios.BinaryRoundTrip",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FScenarioFileBinaryRoundTripTest::RunTest(const FString& Parameters)
+{
+    const std::string CsvPath = GetZombieTestFilePath(TEXT("ScenarioRoundTrip.csv"));
+    const std::string BinaryPath = GetZombieTestFilePath(TEXT("ScenarioRoundTrip.zscn"));
+
+    // 1. - Every field, the longest names included, plus an ignored column too long for a name slot and an empty cell
+    {
+        std::FILE* Csv = OpenUtf8File(CsvPath, "wb");
+        if (!TestNotNull(TEXT("CSV created"), Csv))
+            return false;
+        std::fputs("DaysToBecomeInfectedFromBite,BittenCapacity,NormalNumberOfBites,LandArea,NormalPopulationDensity,"
+            "DelayMode,DelaySpreadDays,Integrator,StepDays,Tolerance,bWholePeople,Curve,NotAFieldButFarLongerThanAnyNameSlot\n", Csv);
+        std::fputs("9,80,4,500,0.25,1,2,0,1,0.001,0,1,7\n", Csv);
+        std::fputs("3,,2.5,2000,0.05,0,0,2,0.5,0.0001,1,0,8\n", Csv);
+        std::fclose(Csv);
+    }
+
+    std::string Error;
+    if (!TestTrue(TEXT("Converted"), FScenarioFile::ConvertCsvToBinary(CsvPath, BinaryPath, &Error)))
+    {
+        AddError(FString(UTF8_TO_TCHAR(Error.c_str())));
+        return false;
+    }
+
+    FScenarioFile Csv;
+    FScenarioFile Binary;
+    TestTrue(TEXT("CSV opens"), Csv.Open(CsvPath));
+    TestTrue(TEXT("Binary opens"), Binary.Open(BinaryPath));
+    TestTrue(TEXT("Binary is binary"), Binary.IsBinary());
+    TestEqual(TEXT("Rows"), Binary.GetNumScenarios(), Csv.GetNumScenarios());
+    TestEqual(TEXT("Rows"), Csv.GetNumScenarios(), static_cast<int64_t>(2));
+
+    // 2. - Both formats give the same scenarios, and those are the file's values, not Base
+    const FSDParams First = Binary.GetScenario(0);
+    TestEqual(TEXT("DaysToBecomeInfectedFromBite survives the binary header"), First.DaysToBecomeInfectedFromBite, 9.f);
+    TestEqual(TEXT("NormalNumberOfBites survives the binary header"), First.NormalNumberOfBites, 4.f);
+    TestEqual(TEXT("NormalPopulationDensity survives the binary header"), First.NormalPopulationDensity, 0.25f);
+    TestFalse(TEXT("bWholePeople survives the binary header"), First.bWholePeople);
+    TestEqual(TEXT("Empty cell keeps Base"), Binary.GetScenario(1).BittenCapacity, Binary.Base.BittenCapacity);
+
+    for (int64_t Row = 0; Row < Csv.GetNumScenarios(); ++Row)
+    {
+        TestTrue(FString::Printf(TEXT("Row %lld matches the CSV"), static_cast<long long>(Row)), SameScenarioParams(Csv.GetScenario(Row), Binary.GetScenario(Row)));
+        TestEqual(TEXT("Curve index"), Binary.GetCurveIndex(Row), Csv.GetCurveIndex(Row));
+    }
+    TestEqual(TEXT("No malformed rows"), Binary.GetNumMalformedRows() + Csv.GetNumMalformedRows(), static_cast<int64_t>(0));
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,208 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "DensityEffectCurve.h"
+#include "GridInfectionModel.h"
+#include "GridStorage.h"
+#include "SDBatchEngine.h"
+#include "SDModel.h"
+#include "ZombieTestRandom.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Same table as the simulation benchmark
+static const std::vector<std::pair<float, float>> KernelTestGraph =
+{
+    { 0.0f, 0.014f }, { 0.2f, 0.041f }, { 0.4f, 0.101f }, { 0.6f, 0.189f }, { 0.8f, 0.433f }, { 1.0f, 1.0f },
+    { 1.2f, 1.217f }, { 1.4f, 1.282f }, { 1.6f, 1.3f }, { 1.8f, 1.3f }, { 2.0f, 1.3f }
+};
+
+// Deterministic map with about 30% humans, 3% zombies and scattered fences
+static FGridStorage MakeKernelTestGrid(int32_t Size)
+{
+    FGridStorage Grid;
+    Grid.Init(Size, Size);
+    FZombieTestRandom Random(static_cast<uint32_t>(Size));
+    for (int32_t Y = 0; Y < Size; ++Y)
+    {
+        for (int32_t X = 0; X < Size; ++X)
+        {
+            const int32_t Roll = Random.Next(100);
+            if (Roll < 30)
+                Grid.SetCell(X, Y, EGridCell::Human);
+            else if (Roll < 33)
+                Grid.SetCell(X, Y, EGridCell::Zombie);
+            if (Roll % 10 == 0)
+                Grid.SetFenceUp(X, Y, true);
+            if (Roll % 7 == 0)
+                Grid.SetFenceRight(X, Y, true);
+        }
+    }
+    return Grid;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGridInfectionFixedKernelsTest, "ZombieApocalypse.Kernels.GridInfectionFixedKernels",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FGridInfectionFixedKernelsTest::RunTest(const FString& Parameters)
+{
+    FDensityEffectCurve Curve;
+    Curve.Build(KernelTestGraph);
+
+    FGridInfectionParams Params;
+    Params.NormalNumberOfBites = 3.f;
+
+    // Every size with a compiled kernel must step exactly like the runtime-sized one, day after day
+    for (const int32_t Size : { 10, 16, 32, 64 })
+    {
+        TestTrue(FString::Printf(TEXT("%d has a fixed kernel"), Size), FGridInfectionModel::HasFixedKernel(Size, Size));
+
+        FGridStorage FixedGrid = MakeKernelTestGrid(Size);
+        FGridStorage RuntimeGrid = FixedGrid;
+        FGridInfectionModel Fixed;
+        FGridInfectionModel Runtime;
+        Fixed.SetParams(Params);
+        Runtime.SetParams(Params);
+        Fixed.SetCurve(Curve);
+        Runtime.SetCurve(Curve);
+        Runtime.SetFixedKernels(false);
+        Fixed.Reset(FixedGrid);
+        Runtime.Reset(RuntimeGrid);
+
+        for (int32_t Day = 0; Day < 60; ++Day)
+        {
+            Fixed.Step(FixedGrid);
+            Runtime.Step(RuntimeGrid);
+            Fixed.Apply(FixedGrid);
+            Runtime.Apply(RuntimeGrid);
+
+            const bool bSame = Fixed.GetChangedCells().size() == Runtime.GetChangedCells().size()
+                && std::memcmp(FixedGrid.GetTiles().data(), RuntimeGrid.GetTiles().data(), FixedGrid.GetTiles().size() * sizeof(FixedGrid.GetTiles()[0])) == 0;
+            if (!bSame)
+            {
+                AddError(FString::Printf(TEXT("%dx%d: fixed and runtime kernels differ on day %d"), Size, Size, Day));
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Steps eleven lanes of the batch engine next to one FSDEngine each, and returns the largest
+ * difference in any stock relative to the starting Susceptible. The scalar engines run with
+ * ReferenceCapacity, which picks the variant they are compared against.
+ */
+static float RunKernelTestSDLanes(const FSDParams& Params, const FSDState& Initial, float ReferenceCapacity)
+{
+    constexpr int32_t NumLanes = 11;
+    std::vector<FSDParams> Scenarios(NumLanes, Params);
+    for (int32_t i = 0; i < NumLanes; ++i)
+    {
+        Scenarios[i].LandArea = 200.f + 100.f * i;
+    }
+
+    FSDBatchEngine Batch;
+    Batch.SetGraph(KernelTestGraph);
+    Batch.Reset(Scenarios, Initial);
+
+    std::vector<FSDEngine> Scalar(NumLanes);
+    for (int32_t i = 0; i < NumLanes; ++i)
+    {
+        FSDParams Reference = Scenarios[i];
+        Reference.BittenCapacity = ReferenceCapacity;
+        Scalar[i].SetGraph(KernelTestGraph);
+        Scalar[i].SetParams(Reference);
+        Scalar[i].Reset(Initial);
+    }
+
+    float MaxError = 0.f;
+    for (int32_t Day = 0; Day < 200; ++Day)
+    {
+        Batch.Step();
+        for (int32_t i = 0; i < NumLanes; ++i)
+        {
+            Scalar[i].Step();
+            const FSDState& State = Scalar[i].GetState();
+            const float Error = std::fabs(State.Susceptible - Batch.GetSusceptible()[i])
+                + std::fabs(State.Bitten - Batch.GetBitten()[i])
+                + std::fabs(State.Zombies - Batch.GetZombies()[i]);
+            MaxError = std::fmax(MaxError, Error / std::fmax(1.f, Initial.Susceptible));
+        }
+    }
+    return MaxError;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSDStepPolicyTest, "ZombieApocalypse.Kernels.SDStepPolicies",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSDStepPolicyTest::RunTest(const FString& Parameters)
+{
+    FSDParams Params;
+    Params.NormalNumberOfBites = 2.f;
+    FSDState Initial;
+
+    // 1. - Whole people against the classic clamped step, bit for bit. A capacity of at least the starting
+    // Susceptible, or an infinite one, drops the clamp in the batch; the scalar reference keeps it
+    Params.bWholePeople = true;
+    Params.BittenCapacity = 50.f;
+    TestEqual(TEXT("Whole people, binding capacity"), RunKernelTestSDLanes(Params, Initial, 50.f), 0.f);
+    Params.BittenCapacity = Initial.Susceptible;
+    TestEqual(TEXT("Whole people, capacity == S0"), RunKernelTestSDLanes(Params, Initial, Initial.Susceptible), 0.f);
+    Params.BittenCapacity = INFINITY;
+    TestEqual(TEXT("Whole people, infinite capacity"), RunKernelTestSDLanes(Params, Initial, 1e30f), 0.f);
+
+    // 2. - Floats stop counting whole people past 2^24, so the clamp must stay from there on
+    FSDState Large;
+    Large.Susceptible = 16777216.f;
+    Large.Zombies = 1000.f;
+    Params.BittenCapacity = Large.Susceptible;
+    TestEqual(TEXT("Whole people, S0 == 2^24"), RunKernelTestSDLanes(Params, Large, Large.Susceptible), 0.f);
+    Large.Susceptible = 16777218.f;
+    Params.BittenCapacity = Large.Susceptible;
+    TestEqual(TEXT("Whole people, S0 > 2^24"), RunKernelTestSDLanes(Params, Large, Large.Susceptible), 0.f);
+
+    // 3. - Unrounded flows keep the last-bit differences between the two engines' arithmetic, so only close
+    Params.bWholePeople = false;
+    Params.BittenCapacity = 50.f;
+    TestTrue(TEXT("Fractional people, binding capacity"), RunKernelTestSDLanes(Params, Initial, 50.f) < 1e-4f);
+    Params.BittenCapacity = INFINITY;
+    TestTrue(TEXT("Fractional people, infinite capacity"), RunKernelTestSDLanes(Params, Initial, 1e30f) < 1e-4f);
+
+    // 4. - A mixed batch must give every lane what a batch of only its own kind gives
+    FSDParams Whole = Params;
+    Whole.bWholePeople = true;
+    FSDParams Fractional = Params;
+    Fractional.bWholePeople = false;
+    const std::vector<FSDParams> Mixed = { Whole, Fractional, Whole, Fractional, Fractional, Whole, Whole, Fractional, Whole };
+
+    FSDBatchEngine Batch;
+    Batch.SetGraph(KernelTestGraph);
+    Batch.Reset(Mixed, Initial);
+    std::vector<FSDBatchEngine> Pure(Mixed.size());
+    for (size_t i = 0; i < Mixed.size(); ++i)
+    {
+        Pure[i].SetGraph(KernelTestGraph);
+        Pure[i].Reset({ Mixed[i] }, Initial);
+    }
+
+    bool bMixedMatches = true;
+    for (int32_t Day = 0; Day < 200; ++Day)
+    {
+        Batch.Step();
+        for (size_t i = 0; i < Mixed.size(); ++i)
+        {
+            Pure[i].Step();
+            bMixedMatches &= Pure[i].GetSusceptible()[0] == Batch.GetSusceptible()[i]
+                && Pure[i].GetBitten()[0] == Batch.GetBitten()[i]
+                && Pure[i].GetZombies()[0] == Batch.GetZombies()[i];
+        }
+    }
+    TestTrue(TEXT("Mixed bWholePeople lanes match pure batches"), bMixedMatches);
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,85 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "SimulationSnapshot.h"
+#include "ZombieTestRandom.h"
+#include <map>
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSnapshotStoreTest, "ZombieApocalypse.Snapshots.Store",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSnapshotStoreTest::RunTest(const FString& Parameters)
+{
+    FZombieTestRandom Random(9001);
+
+    // Each day changes a byte of a state a little over five pages long, so most pages are shared
+    std::map<int32_t, std::vector<uint8_t>> Saved;
+    std::vector<uint8_t> State(FSnapshotStore::PageSize * 5 + 123);
+    for (uint8_t& Byte : State)
+    {
+        Byte = static_cast<uint8_t>(Random.Next(256));
+    }
+
+    FSnapshotStore Store;
+    for (int32_t Day = 0; Day <= 40; Day += 2)
+    {
+        State[static_cast<size_t>(Random.Next(static_cast<int32_t>(State.size())))] ^= 0x5a;
+        Store.Save(Day, State);
+        Saved[Day] = State;
+    }
+
+    // 1. - Every day loads back byte for byte, and lookups land on the saved days
+    std::vector<uint8_t> Bytes;
+    for (const auto& Entry : Saved)
+    {
+        TestTrue(FString::Printf(TEXT("Day %d loads"), Entry.first), Store.Load(Entry.first, Bytes) && Bytes == Entry.second);
+    }
+    TestFalse(TEXT("A day without a snapshot does not load"), Store.Load(3, Bytes));
+    TestEqual(TEXT("Between snapshots"), Store.FindAtOrBefore(5), 4);
+    TestEqual(TEXT("After the last"), Store.FindAtOrBefore(100), 40);
+    TestEqual(TEXT("Before the first"), Store.FindAtOrBefore(-1), -1);
+    TestTrue(TEXT("Shared pages are counted once"), Store.GetMemoryBytes() < Saved.size() * State.size() / 2);
+
+    // 2. - A fork shares the pages, and a branch saved in it leaves the original alone
+    FSnapshotStore Fork = Store;
+    Fork.TruncateAfter(20);
+    TestEqual(TEXT("Fork drops the later days"), Fork.GetLatestDay(), 20);
+    std::vector<uint8_t> Branch = Saved[20];
+    Branch[0] ^= 0xff;
+    Fork.Save(22, Branch);
+    TestTrue(TEXT("Fork has its branch"), Fork.Load(22, Bytes) && Bytes == Branch);
+    TestTrue(TEXT("Original keeps its day"), Store.Load(22, Bytes) && Bytes == Saved[22]);
+    TestEqual(TEXT("Original keeps its later days"), Store.GetLatestDay(), 40);
+
+    // 3. - A budget thins out the older snapshots but keeps the first and the latest, all still intact
+    const size_t Unbudgeted = Store.GetMemoryBytes();
+    Store.SetMemoryBudget(State.size() * 2);
+    TestTrue(TEXT("Within budget"), Store.GetMemoryBytes() <= Store.GetMemoryBudget());
+    TestTrue(TEXT("Budget freed pages"), Store.GetMemoryBytes() < Unbudgeted);
+    TestEqual(TEXT("First kept"), Store.FindAtOrBefore(0), 0);
+    TestEqual(TEXT("Latest kept"), Store.GetLatestDay(), 40);
+    for (const auto& Entry : Saved)
+    {
+        if (Store.FindAtOrBefore(Entry.first) == Entry.first)
+        {
+            TestTrue(FString::Printf(TEXT("Day %d survives the budget intact"), Entry.first), Store.Load(Entry.first, Bytes) && Bytes == Entry.second);
+        }
+    }
+
+    // 4. - Saving an earlier day in the fork replaces everything from it on
+    Fork.Save(10, Saved[40]);
+    TestEqual(TEXT("Save truncates"), Fork.GetLatestDay(), 10);
+    TestFalse(TEXT("Later days are gone"), Fork.Load(22, Bytes));
+    TestTrue(TEXT("The saved day is the new one"), Fork.Load(10, Bytes) && Bytes == Saved[40]);
+    TestTrue(TEXT("Earlier days are untouched"), Fork.Load(8, Bytes) && Bytes == Saved[8]);
+
+    Store.Clear();
+    TestEqual(TEXT("Clear empties"), Store.GetNumSnapshots(), 0);
+    TestEqual(TEXT("Clear frees"), Store.GetMemoryBytes(), static_cast<size_t>(0));
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
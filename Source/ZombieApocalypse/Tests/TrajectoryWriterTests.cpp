@@ -0,0 +1,211 @@
+// Copyright University of Inland Norway
+
+#include "Misc/AutomationTest.h"
+#include "GridStorage.h"
+#include "MappedFile.h"
+#include "TrajectoryWriter.h"
+#include "ZombieTestFiles.h"
+#include "ZombieTestRandom.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Rows of an exported CSV, the header skipped
+static std::vector<FTrajectoryRecord> ReadTrajectoryTestCsv(const std::string& Path)
+{
+    std::vector<FTrajectoryRecord> Records;
+    std::FILE* File = OpenUtf8File(Path, "rb");
+    if (!File)
+        return Records;
+
+    char Line[256];
+    bool bHeader = true;
+    while (std::fgets(Line, sizeof(Line), File))
+    {
+        if (bHeader)
+        {
+            bHeader = false;
+            continue;
+        }
+
+        FTrajectoryRecord Record;
+        long long Scenario = 0;
+        if (std::sscanf(Line, "%lld,%d,%g,%g,%g,%g,%g,%g", &Scenario, &Record.Day, &Record.Susceptible, &Record.Bitten,
+            &Record.Zombies, &Record.Inflow, &Record.Outflow, &Record.DensityEffect) == 8)
+        {
+            Record.Scenario = Scenario;
+            Records.push_back(Record);
+        }
+    }
+    std::fclose(File);
+    return Records;
+}
+
+static std::string ReadTrajectoryTestFile(const std::string& Path)
+{
+    std::ifstream File(Path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryWriterRoundTripTest, "ZombieApocalypse.Output.TrajectoryRoundTrip",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryWriterRoundTripTest::RunTest(const FString& Parameters)
+{
+    const std::string ColumnarPath = GetZombieTestFilePath(TEXT("TrajectoryRoundTrip.ztrj"));
+    const std::string ExportedPath = GetZombieTestFilePath(TEXT("TrajectoryRoundTrip.exported.csv"));
+    const std::string DirectPath = GetZombieTestFilePath(TEXT("TrajectoryRoundTrip.csv"));
+    FZombieTestRandom Random(606);
+
+    FGridStorage Grid;
+    Grid.Init(17, 9);
+
+    // Awkward values on purpose: large scenario ids, negative and tiny floats, and NaN flows as vectorized sweeps write
+    std::vector<FTrajectoryRecord> Records(1000);
+    for (size_t i = 0; i < Records.size(); ++i)
+    {
+        FTrajectoryRecord& Record = Records[i];
+        Record.Scenario = (static_cast<int64_t>(Random.Next(1 << 20)) << 20) + static_cast<int64_t>(i);
+        Record.Day = static_cast<int32_t>(i / 10);
+        Record.Susceptible = static_cast<float>(Random.Next(1 << 20)) / 7.f;
+        Record.Bitten = -static_cast<float>(Random.Next(1000)) * 1e-7f;
+        Record.Zombies = static_cast<float>(Random.Next(1 << 16)) * 1e9f;
+        Record.Inflow = i % 3 == 0 ? std::numeric_limits<float>::quiet_NaN() : 1.f / static_cast<float>(1 + i);
+        Record.Outflow = static_cast<float>(i) * 0.1f;
+        Record.DensityEffect = i % 3 == 0 ? std::numeric_limits<float>::quiet_NaN() : 1.3f;
+    }
+
+    // 1. - The same records in uneven batches to a columnar and a CSV writer, blocks far smaller than the run
+    {
+        FTrajectoryWriter Columnar;
+        FTrajectoryWriter Direct;
+        if (!TestTrue(TEXT("Columnar opens"), Columnar.Open(ColumnarPath, ETrajectoryFormat::Columnar, 64))
+            || !TestTrue(TEXT("CSV opens"), Direct.Open(DirectPath, ETrajectoryFormat::Csv, 64)))
+        {
+            return false;
+        }
+
+        for (size_t First = 0; First < Records.size();)
+        {
+            const size_t Count = std::min<size_t>(1 + static_cast<size_t>(Random.Next(150)), Records.size() - First);
+            Columnar.Append(Records.data() + First, Count);
+            Direct.Append(Records.data() + First, Count);
+            First += Count;
+            if (Random.Next(4) == 0)
+            {
+                Columnar.AppendFrame(Records[First - 1].Day, Grid);
+                Direct.AppendFrame(Records[First - 1].Day, Grid);
+            }
+        }
+        TestTrue(TEXT("Columnar closes"), Columnar.Close());
+        TestTrue(TEXT("CSV closes"), Direct.Close());
+        TestEqual(TEXT("Columnar counts every record"), Columnar.GetRecordsWritten(), static_cast<uint64_t>(Records.size()));
+        TestEqual(TEXT("CSV counts every record"), Direct.GetRecordsWritten(), static_cast<uint64_t>(Records.size()));
+    }
+
+    // 2. - Exporting the columnar file gives the CSV writer's file byte for byte
+    std::string Error;
+    if (!TestTrue(TEXT("Exported"), FTrajectoryWriter::ExportCsv(ColumnarPath, ExportedPath, &Error)))
+    {
+        AddError(FString(UTF8_TO_TCHAR(Error.c_str())));
+        return false;
+    }
+    TestTrue(TEXT("Export matches the direct CSV"), ReadTrajectoryTestFile(ExportedPath) == ReadTrajectoryTestFile(DirectPath));
+
+    // 3. - And the rows read back as the records that went in, NaN included
+    const std::vector<FTrajectoryRecord> ReadBack = ReadTrajectoryTestCsv(ExportedPath);
+    const auto Same = [](float A, float B) { return A == B || (std::isnan(A) && std::isnan(B)); };
+    if (TestEqual(TEXT("Row count"), ReadBack.size(), Records.size()))
+    {
+        for (size_t i = 0; i < Records.size(); ++i)
+        {
+            const FTrajectoryRecord& A = Records[i];
+            const FTrajectoryRecord& B = ReadBack[i];
+            if (A.Scenario != B.Scenario || A.Day != B.Day || !Same(A.Susceptible, B.Susceptible) || !Same(A.Bitten, B.Bitten)
+                || !Same(A.Zombies, B.Zombies) || !Same(A.Inflow, B.Inflow) || !Same(A.Outflow, B.Outflow) || !Same(A.DensityEffect, B.DensityEffect))
+            {
+                AddError(FString::Printf(TEXT("Row %d does not round-trip"), static_cast<int32>(i)));
+                break;
+            }
+        }
+    }
+
+    // 4. - Anything that is not a trajectory file is refused
+    TestFalse(TEXT("A CSV is not a columnar file"), FTrajectoryWriter::ExportCsv(DirectPath, ExportedPath));
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryWriterRewindTest, "ZombieApocalypse.Output.TrajectoryRewind",
+    EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryWriterRewindTest::RunTest(const FString& Parameters)
+{
+    const std::string ColumnarPath = GetZombieTestFilePath(TEXT("TrajectoryRewind.ztrj"));
+    const std::string CsvPath = GetZombieTestFilePath(TEXT("TrajectoryRewind.csv"));
+
+    FGridStorage Grid;
+    Grid.Init(20, 20);
+
+    // Susceptible holds the branch, so the export shows which branch each day came from
+    auto Append = [](FTrajectoryWriter& Writer, int32_t Branch, int32_t FirstDay, int32_t LastDay)
+    {
+        for (int32_t Day = FirstDay; Day <= LastDay; ++Day)
+        {
+            FTrajectoryRecord Record;
+            Record.Day = Day;
+            Record.Susceptible = static_cast<float>(Branch);
+            Writer.Append(Record);
+        }
+    };
+
+    // 1. - Days 0-9, back to 4 and on to 7, back to 6 and on to 8; three rows a block so rewinds fall mid-block
+    {
+        FTrajectoryWriter Writer;
+        std::string Error;
+        if (!TestTrue(TEXT("Columnar file opens"), Writer.Open(ColumnarPath, ETrajectoryFormat::Columnar, 3, &Error)))
+            return false;
+
+        Append(Writer, 0, 0, 9);
+        Writer.AppendFrame(9, Grid);
+        TestTrue(TEXT("Columnar takes a rewind"), Writer.AppendRewind(4));
+        Append(Writer, 1, 5, 7);
+        TestTrue(TEXT("Columnar takes a second rewind"), Writer.AppendRewind(6));
+        Writer.AppendFrame(6, Grid);
+        Append(Writer, 2, 7, 8);
+        TestTrue(TEXT("Writer closes"), Writer.Close());
+    }
+
+    // 2. - Every day once, from the branch the run ended on
+    std::string Error;
+    if (!TestTrue(TEXT("Exported"), FTrajectoryWriter::ExportCsv(ColumnarPath, CsvPath, &Error)))
+    {
+        AddError(FString(UTF8_TO_TCHAR(Error.c_str())));
+        return false;
+    }
+    const std::vector<FTrajectoryRecord> Records = ReadTrajectoryTestCsv(CsvPath);
+    const int32_t ExpectedBranch[] = { 0, 0, 0, 0, 0, 1, 1, 2, 2 };
+    if (TestEqual(TEXT("One row a day"), Records.size(), sizeof(ExpectedBranch) / sizeof(ExpectedBranch[0])))
+    {
+        for (size_t Day = 0; Day < Records.size(); ++Day)
+        {
+            TestEqual(TEXT("Days in order"), Records[Day].Day, static_cast<int32_t>(Day));
+            TestEqual(FString::Printf(TEXT("Day %d comes from the surviving branch"), static_cast<int32>(Day)),
+                Records[Day].Susceptible, static_cast<float>(ExpectedBranch[Day]));
+        }
+    }
+
+    // 3. - Plain CSV has no room for the marker, the caller is told to start a new file
+    FTrajectoryWriter CsvWriter;
+    TestTrue(TEXT("CSV file opens"), CsvWriter.Open(CsvPath, ETrajectoryFormat::Csv));
+    TestFalse(TEXT("CSV refuses a rewind"), CsvWriter.AppendRewind(0));
+    TestTrue(TEXT("CSV closes"), CsvWriter.Close());
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,16 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include <string>
+
+/** UTF-8 path of a scratch file in the automation transient directory, for the engine-free readers and writers. */
+inline std::string GetZombieTestFilePath(const TCHAR* FileName)
+{
+	const FString Path = FPaths::ConvertRelativePathToFull(FPaths::Combine(FPaths::AutomationTransientDir(), FileName));
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+	return std::string(TCHAR_TO_UTF8(*Path));
+}
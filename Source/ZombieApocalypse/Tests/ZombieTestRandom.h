@@ -0,0 +1,29 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Linear congruential generator for the automation tests: fixed seeds give the
+ * same maps and queries on every platform and compiler, unlike std::
+ * distributions, so a failure always reproduces.
+ */
+class FZombieTestRandom
+{
+public:
+	explicit FZombieTestRandom(uint32_t Seed) : State(Seed) {}
+
+	/** Next value in [0, 2^24). */
+	uint32_t Next()
+	{
+		State = State * 1664525u + 1013904223u;
+		return State >> 8;
+	}
+
+	/** Next value in [0, Bound), Bound > 0. */
+	int32_t Next(int32_t Bound) { return static_cast<int32_t>(Next() % static_cast<uint32_t>(Bound)); }
+
+private:
+	uint32_t State;
+};
@@ -0,0 +1,507 @@
+// Copyright University of Inland Norway
+
+#include "TrajectoryWriter.h"
+#include "GridStorage.h"
+#include "MappedFile.h"
+#include "ZombieSimStats.h"
+#include <algorithm>
+#include <cstring>
+
+static constexpr char TrajectoryMagic[4] = { 'Z', 'T', 'R', 'J' };
+// Version 2 added rewind chunks, version 1 files read the same otherwise
+static constexpr uint32_t TrajectoryVersion = 2;
+static constexpr uint32_t TrajectoryRecordsChunk = 1;
+static constexpr uint32_t TrajectoryFrameChunk = 2;
+static constexpr uint32_t TrajectoryRewindChunk = 3;
+
+// Blocks kept around for reuse, enough for the double buffer plus a little slack
+static constexpr size_t TrajectoryFreeBlocks = 4;
+
+struct FTrajectoryColumn
+{
+	const char* Name;
+	uint8_t Type;
+};
+
+static constexpr FTrajectoryColumn TrajectoryColumns[] =
+{
+	{ "Scenario", 0 },
+	{ "Day", 1 },
+	{ "Susceptible", 2 },
+	{ "Bitten", 2 },
+	{ "Zombies", 2 },
+	{ "Inflow", 2 },
+	{ "Outflow", 2 },
+	{ "DensityEffect", 2 },
+};
+static constexpr uint32_t NumTrajectoryColumns = sizeof(TrajectoryColumns) / sizeof(TrajectoryColumns[0]);
+
+static const char* TrajectoryCsvHeader = "Scenario,Day,Susceptible,Bitten,Zombies,Inflow,Outflow,DensityEffect\n";
+
+template <typename T>
+static void AppendTrajectoryBytes(std::vector<uint8_t>& Out, const T& Value)
+{
+    const size_t Offset = Out.size();
+    Out.resize(Offset + sizeof(T));
+    std::memcpy(Out.data() + Offset, &Value, sizeof(T));
+}
+
+// Gathers one field of every record into a contiguous column
+template <typename T, typename FGetter>
+static void AppendTrajectoryColumn(std::vector<uint8_t>& Out, const std::vector<FTrajectoryRecord>& Records, FGetter Get)
+{
+    const size_t Offset = Out.size();
+    Out.resize(Offset + Records.size() * sizeof(T));
+    uint8_t* Dest = Out.data() + Offset;
+    for (const FTrajectoryRecord& Record : Records)
+    {
+        const T Value = Get(Record);
+        std::memcpy(Dest, &Value, sizeof(T));
+        Dest += sizeof(T);
+    }
+}
+
+static void AppendTrajectoryCsvRow(std::string& Out, const FTrajectoryRecord& Record)
+{
+    char Line[256];
+    const int Length = std::snprintf(Line, sizeof(Line), "%lld,%d,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n",
+        static_cast<long long>(Record.Scenario), Record.Day, Record.Susceptible, Record.Bitten, Record.Zombies,
+        Record.Inflow, Record.Outflow, Record.DensityEffect);
+    Out.append(Line, static_cast<size_t>(std::max(0, std::min(Length, static_cast<int>(sizeof(Line)) - 1))));
+}
+
+bool FTrajectoryWriter::Open(const std::string& Path, ETrajectoryFormat InFormat, int32_t InBlockRows, std::string* OutError)
+{
+    if (IsOpen())
+    {
+        if (OutError) *OutError = "a trajectory file is already open";
+        return false;
+    }
+
+    File = OpenUtf8File(Path.c_str(), "wb");
+    if (!File)
+    {
+        if (OutError) *OutError = "cannot create " + Path;
+        return false;
+    }
+
+    Format = InFormat;
+    BlockRows = static_cast<size_t>(std::max(1, InBlockRows));
+    bStopping = false;
+    bFailed = false;
+    RecordsWritten = 0;
+    BytesWritten = 0;
+    Stalls = 0;
+    Active = TakeBlock();
+
+    // 1. - Header, written here so even an empty run leaves a readable file
+    if (Format == ETrajectoryFormat::Columnar)
+    {
+        WriteRaw(TrajectoryMagic, sizeof(TrajectoryMagic));
+        WriteRaw(&TrajectoryVersion, sizeof(TrajectoryVersion));
+        WriteRaw(&NumTrajectoryColumns, sizeof(NumTrajectoryColumns));
+        for (const FTrajectoryColumn& Column : TrajectoryColumns)
+        {
+            char Name[15] = {};
+            std::memcpy(Name, Column.Name, std::min(sizeof(Name), std::strlen(Column.Name)));
+            WriteRaw(Name, sizeof(Name));
+            WriteRaw(&Column.Type, sizeof(Column.Type));
+        }
+    }
+    else
+    {
+        WriteRaw(TrajectoryCsvHeader, std::strlen(TrajectoryCsvHeader));
+    }
+
+    Thread = std::thread([this]() { Run(); });
+    return true;
+}
+
+std::unique_ptr<FTrajectoryWriter::FBlock> FTrajectoryWriter::TakeBlock()
+{
+    // Called with Mutex held, or before the thread exists
+    if (!Free.empty())
+    {
+        std::unique_ptr<FBlock> Block = std::move(Free.back());
+        Free.pop_back();
+        return Block;
+    }
+
+    std::unique_ptr<FBlock> Block(new FBlock());
+    Block->Records.reserve(BlockRows);
+    return Block;
+}
+
+void FTrajectoryWriter::QueueBlock(std::unique_lock<std::mutex>& Lock, std::unique_ptr<FBlock> Block)
+{
+    // Called with Mutex held; a full queue holds the producer back instead of growing
+    if (Pending.size() >= MaxQueuedBlocks)
+    {
+        ++Stalls;
+        Drained.wait(Lock, [this]() { return Pending.size() < MaxQueuedBlocks; });
+    }
+
+    Pending.push_back(std::move(Block));
+    Wake.notify_one();
+}
+
+void FTrajectoryWriter::QueueActive(std::unique_lock<std::mutex>& Lock)
+{
+    // Called with Mutex held
+    if (Active->Records.empty())
+        return;
+
+    // The next block is taken first, another producer may append while this one waits
+    std::unique_ptr<FBlock> Full = std::move(Active);
+    Active = TakeBlock();
+    QueueBlock(Lock, std::move(Full));
+}
+
+void FTrajectoryWriter::Append(const FTrajectoryRecord* Records, size_t Count)
+{
+    std::unique_lock<std::mutex> Lock(Mutex);
+    if (!Active)
+        return;
+
+    while (Count > 0)
+    {
+        const size_t Room = BlockRows - Active->Records.size();
+        const size_t Taken = std::min(Room, Count);
+        Active->Records.insert(Active->Records.end(), Records, Records + Taken);
+        Records += Taken;
+        Count -= Taken;
+
+        if (Active->Records.size() >= BlockRows)
+        {
+            QueueActive(Lock);
+        }
+    }
+}
+
+void FTrajectoryWriter::AppendFrame(int32_t Day, const FGridStorage& Grid)
+{
+    // The planes are copied on the calling thread, the grid may change as soon as this returns
+    std::unique_ptr<FBlock> Frame(new FBlock());
+    Frame->bFrame = true;
+    Frame->FrameDay = Day;
+    Frame->FrameWidth = Grid.GetWidth();
+    Frame->FrameHeight = Grid.GetHeight();
+
+    const std::vector<FGridTile>& Tiles = Grid.GetTiles();
+    Frame->FrameLo.resize(Tiles.size());
+    Frame->FrameHi.resize(Tiles.size());
+    for (size_t Tile = 0; Tile < Tiles.size(); ++Tile)
+    {
+        Frame->FrameLo[Tile] = Tiles[Tile].StateLo;
+        Frame->FrameHi[Tile] = Tiles[Tile].StateHi;
+    }
+
+    std::unique_lock<std::mutex> Lock(Mutex);
+    if (!Active)
+        return;
+
+    // Records before the frame stay before it in the file
+    QueueActive(Lock);
+    QueueBlock(Lock, std::move(Frame));
+}
+
+bool FTrajectoryWriter::AppendRewind(int32_t Day)
+{
+    if (Format != ETrajectoryFormat::Columnar)
+        return false;
+
+    std::unique_ptr<FBlock> Rewind(new FBlock());
+    Rewind->bRewind = true;
+    Rewind->RewindDay = Day;
+
+    std::unique_lock<std::mutex> Lock(Mutex);
+    if (!Active)
+        return false;
+
+    // Records of the abandoned branch stay before the marker
+    QueueActive(Lock);
+    QueueBlock(Lock, std::move(Rewind));
+    return true;
+}
+
+void FTrajectoryWriter::Flush()
+{
+    std::unique_lock<std::mutex> Lock(Mutex);
+    if (Active)
+    {
+        QueueActive(Lock);
+    }
+}
+
+int32_t FTrajectoryWriter::GetNumQueuedBlocks()
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return static_cast<int32_t>(Pending.size());
+}
+
+bool FTrajectoryWriter::Close()
+{
+    if (!IsOpen())
+        return !bFailed;
+
+    {
+        std::unique_lock<std::mutex> Lock(Mutex);
+        QueueActive(Lock);
+        bStopping = true;
+        Wake.notify_one();
+    }
+    Thread.join();
+
+    if (std::fclose(File) != 0)
+    {
+        bFailed = true;
+    }
+    File = nullptr;
+
+    Active.reset();
+    Free.clear();
+    return !bFailed;
+}
+
+void FTrajectoryWriter::Run()
+{
+    std::unique_lock<std::mutex> Lock(Mutex);
+    for (;;)
+    {
+        Wake.wait(Lock, [this]() { return bStopping || !Pending.empty(); });
+        if (Pending.empty())
+            return;
+
+        std::unique_ptr<FBlock> Block = std::move(Pending.front());
+        Pending.pop_front();
+        Drained.notify_all();
+
+        // Disk time is spent without the lock, producers keep filling the next block
+        Lock.unlock();
+        WriteBlock(*Block);
+        Lock.lock();
+
+        if (!Block->bFrame && !Block->bRewind && Free.size() < TrajectoryFreeBlocks)
+        {
+            Block->Records.clear();
+            Free.push_back(std::move(Block));
+        }
+    }
+}
+
+void FTrajectoryWriter::WriteBlock(const FBlock& Block)
+{
+    ZOMBIESIM_SCOPE(STAT_ZombieSim_TrajectoryWrite);
+    Encoded.clear();
+
+    if (Block.bRewind)
+    {
+        AppendTrajectoryBytes(Encoded, TrajectoryRewindChunk);
+        AppendTrajectoryBytes(Encoded, Block.RewindDay);
+        WriteRaw(Encoded.data(), Encoded.size());
+        return;
+    }
+
+    if (Block.bFrame)
+    {
+        if (Format != ETrajectoryFormat::Columnar)
+            return;
+
+        const uint32_t NumTiles = static_cast<uint32_t>(Block.FrameLo.size());
+        AppendTrajectoryBytes(Encoded, TrajectoryFrameChunk);
+        AppendTrajectoryBytes(Encoded, Block.FrameDay);
+        AppendTrajectoryBytes(Encoded, Block.FrameWidth);
+        AppendTrajectoryBytes(Encoded, Block.FrameHeight);
+        AppendTrajectoryBytes(Encoded, NumTiles);
+        WriteRaw(Encoded.data(), Encoded.size());
+        WriteRaw(Block.FrameLo.data(), Block.FrameLo.size() * sizeof(uint64_t));
+        WriteRaw(Block.FrameHi.data(), Block.FrameHi.size() * sizeof(uint64_t));
+        return;
+    }
+
+    const std::vector<FTrajectoryRecord>& Records = Block.Records;
+    if (Format == ETrajectoryFormat::Columnar)
+    {
+        AppendTrajectoryBytes(Encoded, TrajectoryRecordsChunk);
+        AppendTrajectoryBytes(Encoded, static_cast<uint32_t>(Records.size()));
+        AppendTrajectoryColumn<int64_t>(Encoded, Records, [](const FTrajectoryRecord& R) { return R.Scenario; });
+        AppendTrajectoryColumn<int32_t>(Encoded, Records, [](const FTrajectoryRecord& R) { return R.Day; });
+        AppendTrajectoryColumn<float>(Encoded, Records, [](const FTrajectoryRecord& R) { return R.Susceptible; });
+        AppendTrajectoryColumn<float>(Encoded, Records, [](const FTrajectoryRecord& R) { return R.Bitten; });
+        AppendTrajectoryColumn<float>(Encoded, Records, [](const FTrajectoryRecord& R) { return R.Zombies; });
+        AppendTrajectoryColumn<float>(Encoded, Records, [](const FTrajectoryRecord& R) { return R.Inflow; });
+        AppendTrajectoryColumn<float>(Encoded, Records, [](const FTrajectoryRecord& R) { return R.Outflow; });
+        AppendTrajectoryColumn<float>(Encoded, Records, [](const FTrajectoryRecord& R) { return R.DensityEffect; });
+        WriteRaw(Encoded.data(), Encoded.size());
+    }
+    else
+    {
+        std::string Text;
+        Text.reserve(Records.size() * 64);
+        for (const FTrajectoryRecord& Record : Records)
+        {
+            AppendTrajectoryCsvRow(Text, Record);
+        }
+        WriteRaw(Text.data(), Text.size());
+    }
+    RecordsWritten += Records.size();
+}
+
+void FTrajectoryWriter::WriteRaw(const void* Data, size_t Size)
+{
+    if (Size == 0 || bFailed)
+        return;
+
+    if (std::fwrite(Data, 1, Size, File) != Size)
+    {
+        bFailed = true;
+        return;
+    }
+    BytesWritten += Size;
+}
+
+bool FTrajectoryWriter::ExportCsv(const std::string& ColumnarPath, const std::string& CsvPath, std::string* OutError)
+{
+    auto Fail = [OutError](const std::string& Reason)
+    {
+        if (OutError) *OutError = Reason;
+        return false;
+    };
+
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> In(OpenUtf8File(ColumnarPath.c_str(), "rb"), &std::fclose);
+    if (!In)
+        return Fail("cannot open " + ColumnarPath);
+
+    // 1. - Header must match what this build writes, or the version before rewinds
+    char Magic[4] = {};
+    uint32_t Version = 0;
+    uint32_t NumColumns = 0;
+    if (std::fread(Magic, 1, 4, In.get()) != 4 || std::memcmp(Magic, TrajectoryMagic, 4) != 0
+        || std::fread(&Version, sizeof(Version), 1, In.get()) != 1 || Version < 1 || Version > TrajectoryVersion
+        || std::fread(&NumColumns, sizeof(NumColumns), 1, In.get()) != 1 || NumColumns != NumTrajectoryColumns
+        || std::fseek(In.get(), static_cast<long>(NumColumns * 16), SEEK_CUR) != 0)
+    {
+        return Fail(ColumnarPath + " is not a trajectory file of this version");
+    }
+    const long FirstChunk = std::ftell(In.get());
+
+    // 2. - Skim the chunks for rewinds, a record survives when no later rewind went back before its day
+    const size_t RowBytes = sizeof(int64_t) + sizeof(int32_t) + 6 * sizeof(float);
+    std::vector<std::pair<size_t, int32_t>> Rewinds;
+    size_t NumRecordChunks = 0;
+    uint32_t Kind = 0;
+    while (std::fread(&Kind, sizeof(Kind), 1, In.get()) == 1)
+    {
+        if (Kind == TrajectoryFrameChunk)
+        {
+            int32_t Header[3];
+            uint32_t NumTiles = 0;
+            if (std::fread(Header, sizeof(Header), 1, In.get()) != 1 || std::fread(&NumTiles, sizeof(NumTiles), 1, In.get()) != 1
+                || std::fseek(In.get(), static_cast<long>(NumTiles) * 2 * static_cast<long>(sizeof(uint64_t)), SEEK_CUR) != 0)
+            {
+                return Fail(ColumnarPath + " has a truncated frame");
+            }
+            continue;
+        }
+
+        if (Kind == TrajectoryRewindChunk)
+        {
+            int32_t Day = 0;
+            if (std::fread(&Day, sizeof(Day), 1, In.get()) != 1)
+                return Fail(ColumnarPath + " has a truncated rewind");
+            Rewinds.push_back({ NumRecordChunks, Day });
+            continue;
+        }
+
+        uint32_t NumRows = 0;
+        if (Kind != TrajectoryRecordsChunk || std::fread(&NumRows, sizeof(NumRows), 1, In.get()) != 1
+            || std::fseek(In.get(), static_cast<long>(NumRows * RowBytes), SEEK_CUR) != 0)
+        {
+            return Fail(ColumnarPath + " has a corrupt chunk");
+        }
+        ++NumRecordChunks;
+    }
+
+    // Walking back, each chunk keeps the days up to the lowest rewind that follows it
+    std::vector<int32_t> KeepThroughDay(NumRecordChunks, INT32_MAX);
+    int32_t Limit = INT32_MAX;
+    size_t NextRewind = Rewinds.size();
+    for (size_t Chunk = NumRecordChunks; Chunk-- > 0;)
+    {
+        while (NextRewind > 0 && Rewinds[NextRewind - 1].first > Chunk)
+        {
+            Limit = std::min(Limit, Rewinds[--NextRewind].second);
+        }
+        KeepThroughDay[Chunk] = Limit;
+    }
+
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> Out(OpenUtf8File(CsvPath.c_str(), "wb"), &std::fclose);
+    if (!Out)
+        return Fail("cannot create " + CsvPath);
+    std::fputs(TrajectoryCsvHeader, Out.get());
+
+    // 3. - Records chunk by chunk, frames and rewinds were checked above and are skipped over
+    if (std::fseek(In.get(), FirstChunk, SEEK_SET) != 0)
+        return Fail("cannot read " + ColumnarPath);
+
+    std::vector<uint8_t> Columns;
+    std::vector<FTrajectoryRecord> Records;
+    std::string Text;
+    size_t Chunk = 0;
+    while (std::fread(&Kind, sizeof(Kind), 1, In.get()) == 1)
+    {
+        if (Kind == TrajectoryFrameChunk)
+        {
+            int32_t Header[3];
+            uint32_t NumTiles = 0;
+            if (std::fread(Header, sizeof(Header), 1, In.get()) != 1 || std::fread(&NumTiles, sizeof(NumTiles), 1, In.get()) != 1
+                || std::fseek(In.get(), static_cast<long>(NumTiles) * 2 * static_cast<long>(sizeof(uint64_t)), SEEK_CUR) != 0)
+            {
+                return Fail(ColumnarPath + " has a truncated frame");
+            }
+            continue;
+        }
+        if (Kind == TrajectoryRewindChunk)
+        {
+            if (std::fseek(In.get(), static_cast<long>(sizeof(int32_t)), SEEK_CUR) != 0)
+                return Fail(ColumnarPath + " has a truncated rewind");
+            continue;
+        }
+
+        uint32_t NumRows = 0;
+        if (std::fread(&NumRows, sizeof(NumRows), 1, In.get()) != 1)
+            return Fail(ColumnarPath + " has a corrupt chunk");
+
+        Columns.resize(static_cast<size_t>(NumRows) * RowBytes);
+        if (std::fread(Columns.data(), 1, Columns.size(), In.get()) != Columns.size())
+            return Fail(ColumnarPath + " has a truncated chunk");
+
+        // Transpose back, each column starts where the previous one ended
+        Records.assign(NumRows, FTrajectoryRecord());
+        const uint8_t* Column = Columns.data();
+        for (uint32_t Row = 0; Row < NumRows; ++Row) std::memcpy(&Records[Row].Scenario, Column + Row * sizeof(int64_t), sizeof(int64_t));
+        Column += NumRows * sizeof(int64_t);
+        for (uint32_t Row = 0; Row < NumRows; ++Row) std::memcpy(&Records[Row].Day, Column + Row * sizeof(int32_t), sizeof(int32_t));
+        Column += NumRows * sizeof(int32_t);
+        float FTrajectoryRecord::* const FloatFields[] = { &FTrajectoryRecord::Susceptible, &FTrajectoryRecord::Bitten, &FTrajectoryRecord::Zombies,
+            &FTrajectoryRecord::Inflow, &FTrajectoryRecord::Outflow, &FTrajectoryRecord::DensityEffect };
+        for (float FTrajectoryRecord::* Field : FloatFields)
+        {
+            for (uint32_t Row = 0; Row < NumRows; ++Row) std::memcpy(&(Records[Row].*Field), Column + Row * sizeof(float), sizeof(float));
+            Column += NumRows * sizeof(float);
+        }
+
+        Text.clear();
+        for (const FTrajectoryRecord& Record : Records)
+        {
+            if (Record.Day <= KeepThroughDay[Chunk])
+            {
+                AppendTrajectoryCsvRow(Text, Record);
+            }
+        }
+        ++Chunk;
+        if (std::fwrite(Text.data(), 1, Text.size(), Out.get()) != Text.size())
+            return Fail("cannot write " + CsvPath);
+    }
+    return true;
+}
@@ -0,0 +1,154 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FGridStorage;
+
+/** One day of one scenario, Inflow / Outflow / DensityEffect are NaN where the source does not track flows. */
+struct FTrajectoryRecord
+{
+	int64_t Scenario{ 0 };
+	int32_t Day{ 0 };
+	float Susceptible{ 0.f };
+	float Bitten{ 0.f };
+	float Zombies{ 0.f };
+	float Inflow{ 0.f };
+	float Outflow{ 0.f };
+	float DensityEffect{ 0.f };
+};
+
+enum class ETrajectoryFormat : uint8_t
+{
+	// Blocks of columns, see FTrajectoryWriter
+	Columnar,
+	// One text row per record, grid frames are skipped
+	Csv
+};
+
+/**
+ * Streams trajectory records and grid frames to disk from a background thread.
+ *
+ * Append copies records into the open block and returns; full blocks go to the
+ * writer thread, which transposes them into columns (or formats CSV) and writes
+ * them while the simulation fills the next block. Written blocks are recycled,
+ * so with a disk that keeps up only two blocks are ever in use. At most
+ * MaxQueuedBlocks wait for the disk: once that many are queued, Append and
+ * AppendFrame block until the writer catches up, so memory stays bounded on
+ * any run length and GetNumStalls counts how often that happened. Append and
+ * AppendFrame are safe to call from several threads, sweeps append one chunk
+ * at a time.
+ *
+ * Columnar layout, native endian:
+ *   "ZTRJ", uint32 version, uint32 column count, then per column 15 name bytes + 1 type byte (0 i64, 1 i32, 2 f32)
+ *   chunks of: uint32 kind
+ *     kind 1, records: uint32 rows, then each column as rows contiguous values
+ *     kind 2, grid frame: int32 day, width, height, uint32 tiles, then the StateLo and StateHi planes of every tile
+ *     kind 3, rewind: int32 day, records and frames before it with a later day were abandoned (version 2)
+ */
+class FTrajectoryWriter
+{
+public:
+	static constexpr int32_t DefaultBlockRows = 1 << 16;
+
+	/** Blocks (and grid frames) allowed to wait for the disk before producers are held back. */
+	static constexpr size_t MaxQueuedBlocks = 4;
+
+	FTrajectoryWriter() = default;
+	~FTrajectoryWriter() { Close(); }
+
+	FTrajectoryWriter(const FTrajectoryWriter&) = delete;
+	FTrajectoryWriter& operator=(const FTrajectoryWriter&) = delete;
+
+	/** Creates Path (UTF-8, also on Windows) and starts the writer thread. False if the file cannot be created or a file is already open. */
+	bool Open(const std::string& Path, ETrajectoryFormat InFormat, int32_t InBlockRows = DefaultBlockRows, std::string* OutError = nullptr);
+
+	bool IsOpen() const { return Thread.joinable(); }
+
+	void Append(const FTrajectoryRecord& Record) { Append(&Record, 1); }
+	void Append(const FTrajectoryRecord* Records, size_t Count);
+
+	/** Queues the cell states of Grid as of Day, fences are not written. */
+	void AppendFrame(int32_t Day, const FGridStorage& Grid);
+
+	/**
+	 * Marks that the run went back to Day, so records and frames already written for later days belong
+	 * to an abandoned branch; ExportCsv leaves them out. Plain CSV has nowhere to put the marker, in that
+	 * format nothing is written and false is returned, the caller starts a new file for the branch instead.
+	 */
+	bool AppendRewind(int32_t Day);
+
+	/** Hands the partly filled block to the writer thread. */
+	void Flush();
+
+	/** Writes everything queued, stops the thread and closes the file. False if any write failed. */
+	bool Close();
+
+	/** Blocks handed to the writer thread and not written yet, never more than MaxQueuedBlocks. */
+	int32_t GetNumQueuedBlocks();
+
+	/** Times a producer had to wait for the writer because the queue was full. */
+	uint64_t GetNumStalls() const { return Stalls; }
+
+	uint64_t GetRecordsWritten() const { return RecordsWritten; }
+	uint64_t GetBytesWritten() const { return BytesWritten; }
+	bool HasFailed() const { return bFailed; }
+
+	/** Converts a columnar file to CSV, frames and days abandoned by a rewind are left out. */
+	static bool ExportCsv(const std::string& ColumnarPath, const std::string& CsvPath, std::string* OutError = nullptr);
+
+private:
+	struct FBlock
+	{
+		std::vector<FTrajectoryRecord> Records;
+
+		// Set for a grid frame or a rewind marker, which carry no records
+		bool bFrame{ false };
+		bool bRewind{ false };
+		int32_t RewindDay{ 0 };
+		int32_t FrameDay{ 0 };
+		int32_t FrameWidth{ 0 };
+		int32_t FrameHeight{ 0 };
+		std::vector<uint64_t> FrameLo;
+		std::vector<uint64_t> FrameHi;
+	};
+
+	std::unique_ptr<FBlock> TakeBlock();
+	void QueueActive(std::unique_lock<std::mutex>& Lock);
+	void QueueBlock(std::unique_lock<std::mutex>& Lock, std::unique_ptr<FBlock> Block);
+	void Run();
+	void WriteBlock(const FBlock& Block);
+	void WriteRaw(const void* Data, size_t Size);
+
+	ETrajectoryFormat Format{ ETrajectoryFormat::Columnar };
+	size_t BlockRows{ DefaultBlockRows };
+	std::FILE* File{ nullptr };
+	std::thread Thread;
+
+	// Everything below the mutex is shared with the writer thread
+	std::mutex Mutex;
+	std::condition_variable Wake;
+	std::condition_variable Drained;
+	std::unique_ptr<FBlock> Active;
+	std::deque<std::unique_ptr<FBlock>> Pending;
+	std::vector<std::unique_ptr<FBlock>> Free;
+	bool bStopping{ false };
+
+	std::atomic<bool> bFailed{ false };
+	std::atomic<uint64_t> RecordsWritten{ 0 };
+	std::atomic<uint64_t> BytesWritten{ 0 };
+	std::atomic<uint64_t> Stalls{ 0 };
+
+	// Writer thread scratch, reused between blocks
+	std::vector<uint8_t> Encoded;
+};
@@ -0,0 +1,221 @@
+// Copyright University of Inland Norway
+
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+// Which pool and queue the current thread belongs to, -1 for outside threads
+static thread_local const FWorkStealingPool* GCurrentPool = nullptr;
+static thread_local int32_t GCurrentWorker = -1;
+static thread_local uint32_t GStealSeed = 0x9E3779B9u;
+
+static uint32_t NextStealVictim(uint32_t NumQueues)
+{
+    // xorshift32, only used to spread thieves over the victims
+    GStealSeed ^= GStealSeed << 13;
+    GStealSeed ^= GStealSeed >> 17;
+    GStealSeed ^= GStealSeed << 5;
+    return GStealSeed % NumQueues;
+}
+
+FWorkStealingPool::FWorkStealingPool(int32_t NumThreads)
+{
+    if (NumThreads <= 0)
+    {
+        NumThreads = std::max(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+    }
+
+    Queues.reserve(NumThreads);
+    for (int32_t i = 0; i < NumThreads; ++i)
+    {
+        Queues.push_back(std::make_unique<FWorkerQueue>());
+    }
+
+    Threads.reserve(NumThreads);
+    for (int32_t i = 0; i < NumThreads; ++i)
+    {
+        Threads.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+FWorkStealingPool::~FWorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> Lock(SleepMutex);
+        bStopping = true;
+    }
+    WakeUp.notify_all();
+
+    for (std::thread& Thread : Threads)
+    {
+        Thread.join();
+    }
+}
+
+// Created by Get and only destroyed by Shutdown, never by a static destructor (inside a DLL that runs under the loader lock)
+static std::atomic<FWorkStealingPool*> GSharedPool{ nullptr };
+static std::mutex GSharedPoolMutex;
+
+FWorkStealingPool& FWorkStealingPool::Get()
+{
+    FWorkStealingPool* Pool = GSharedPool.load(std::memory_order_acquire);
+    if (Pool)
+        return *Pool;
+
+    std::lock_guard<std::mutex> Lock(GSharedPoolMutex);
+    Pool = GSharedPool.load(std::memory_order_relaxed);
+    if (!Pool)
+    {
+        Pool = new FWorkStealingPool();
+        GSharedPool.store(Pool, std::memory_order_release);
+    }
+    return *Pool;
+}
+
+void FWorkStealingPool::Shutdown()
+{
+    std::lock_guard<std::mutex> Lock(GSharedPoolMutex);
+    delete GSharedPool.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void FWorkStealingPool::Push(std::function<void()> Task)
+{
+    // Workers keep their own work local, outside threads deal round-robin
+    const uint32_t NumQueues = static_cast<uint32_t>(Queues.size());
+    const uint32_t Target = (GCurrentPool == this)
+        ? static_cast<uint32_t>(GCurrentWorker)
+        : NextQueue.fetch_add(1, std::memory_order_relaxed) % NumQueues;
+
+    {
+        std::lock_guard<std::mutex> Lock(Queues[Target]->Mutex);
+        Queues[Target]->Tasks.push_back(std::move(Task));
+    }
+    QueuedTasks.fetch_add(1, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> Lock(SleepMutex);
+    }
+    WakeUp.notify_one();
+}
+
+void FWorkStealingPool::Submit(std::function<void()> Task)
+{
+    Push(std::move(Task));
+}
+
+bool FWorkStealingPool::TryTake(int32_t Home, std::function<void()>& OutTask)
+{
+    if (QueuedTasks.load(std::memory_order_acquire) <= 0)
+        return false;
+
+    // 1. - Own queue, newest first (still warm in cache)
+    if (Home >= 0)
+    {
+        FWorkerQueue& Own = *Queues[Home];
+        std::lock_guard<std::mutex> Lock(Own.Mutex);
+        if (!Own.Tasks.empty())
+        {
+            OutTask = std::move(Own.Tasks.back());
+            Own.Tasks.pop_back();
+            QueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // 2. - Steal the oldest task of someone else
+    const uint32_t NumQueues = static_cast<uint32_t>(Queues.size());
+    const uint32_t Start = NextStealVictim(NumQueues);
+    for (uint32_t i = 0; i < NumQueues; ++i)
+    {
+        const int32_t Victim = static_cast<int32_t>((Start + i) % NumQueues);
+        if (Victim == Home)
+            continue;
+
+        FWorkerQueue& Other = *Queues[Victim];
+        std::lock_guard<std::mutex> Lock(Other.Mutex);
+        if (!Other.Tasks.empty())
+        {
+            OutTask = std::move(Other.Tasks.front());
+            Other.Tasks.pop_front();
+            QueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FWorkStealingPool::RunOneTask()
+{
+    const int32_t Home = (GCurrentPool == this) ? GCurrentWorker : -1;
+
+    std::function<void()> Task;
+    if (!TryTake(Home, Task))
+        return false;
+
+    Task();
+    return true;
+}
+
+void FWorkStealingPool::WorkerLoop(int32_t Index)
+{
+    GCurrentPool = this;
+    GCurrentWorker = Index;
+    GStealSeed = 0x9E3779B9u * static_cast<uint32_t>(Index + 1);
+
+    std::function<void()> Task;
+    while (true)
+    {
+        if (TryTake(Index, Task))
+        {
+            Task();
+            Task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Lock(SleepMutex);
+        WakeUp.wait(Lock, [this]()
+        {
+            return bStopping.load() || QueuedTasks.load(std::memory_order_acquire) > 0;
+        });
+
+        if (bStopping && QueuedTasks.load() <= 0)
+            return;
+    }
+}
+
+void FWorkStealingPool::ParallelFor(int64_t Count, int64_t Grain, const std::function<void(int64_t Begin, int64_t End)>& Body)
+{
+    if (Count <= 0)
+        return;
+
+    if (Grain <= 0)
+    {
+        // ~8 chunks per worker leaves room for stealing without drowning in tasks
+        Grain = std::max<int64_t>(1, Count / (static_cast<int64_t>(GetNumThreads()) * 8));
+    }
+
+    const int64_t NumChunks = (Count + Grain - 1) / Grain;
+    if (NumChunks == 1)
+    {
+        Body(0, Count);
+        return;
+    }
+
+    std::atomic<int64_t> Remaining{ NumChunks };
+    for (int64_t Chunk = 0; Chunk < NumChunks; ++Chunk)
+    {
+        const int64_t Begin = Chunk * Grain;
+        const int64_t End = std::min(Count, Begin + Grain);
+        Push([&Body, &Remaining, Begin, End]()
+        {
+            Body(Begin, End);
+            Remaining.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    // Help instead of sleeping, this also keeps nested ParallelFor calls from deadlocking
+    while (Remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!RunOneTask())
+            std::this_thread::yield();
+    }
+}
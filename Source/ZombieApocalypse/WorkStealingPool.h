@@ -0,0 +1,80 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Small engine-free thread pool with one task deque per worker.
+ *
+ * Workers pop their own deque from the back and steal from the front of the
+ * others when they run dry, so uneven scenario costs even out on their own.
+ * Threads calling ParallelFor help out instead of blocking.
+ */
+class FWorkStealingPool
+{
+public:
+	/** NumThreads <= 0 uses one worker per hardware thread. */
+	explicit FWorkStealingPool(int32_t NumThreads = 0);
+	~FWorkStealingPool();
+
+	FWorkStealingPool(const FWorkStealingPool&) = delete;
+	FWorkStealingPool& operator=(const FWorkStealingPool&) = delete;
+
+	/**
+	 * Process-wide pool shared by the sweep and grid jobs, started on first use so
+	 * nothing spawns threads until work actually arrives.
+	 */
+	static FWorkStealingPool& Get();
+
+	/**
+	 * Finishes the queued tasks, joins the shared pool's threads and frees it; a later
+	 * Get starts a new one. Owners of the process-wide pool (the game module's
+	 * ShutdownModule) call this so the threads are never joined during static destruction.
+	 */
+	static void Shutdown();
+
+	int32_t GetNumThreads() const { return static_cast<int32_t>(Threads.size()); }
+
+	/** Queues a fire-and-forget task. */
+	void Submit(std::function<void()> Task);
+
+	/**
+	 * Calls Body(Begin, End) over [0, Count) split into chunks of Grain items and
+	 * returns once every chunk has run. Grain <= 0 picks a chunk size that gives
+	 * each worker several chunks to balance with.
+	 */
+	void ParallelFor(int64_t Count, int64_t Grain, const std::function<void(int64_t Begin, int64_t End)>& Body);
+
+	/** Runs one queued task on the calling thread, returns false if there was none. */
+	bool RunOneTask();
+
+private:
+	struct FWorkerQueue
+	{
+		std::mutex Mutex;
+		std::deque<std::function<void()>> Tasks;
+	};
+
+	void WorkerLoop(int32_t Index);
+	void Push(std::function<void()> Task);
+	bool TryTake(int32_t Home, std::function<void()>& OutTask);
+
+	std::vector<std::unique_ptr<FWorkerQueue>> Queues;
+	std::vector<std::thread> Threads;
+
+	std::atomic<int64_t> QueuedTasks{ 0 };
+	std::atomic<uint32_t> NextQueue{ 0 };
+	std::atomic<bool> bStopping{ false };
+
+	std::mutex SleepMutex;
+	std::condition_variable WakeUp;
+};
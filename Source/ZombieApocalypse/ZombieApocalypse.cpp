@@ -1,6 +1,44 @@
 // Copyright University of Inland Norway
 
 #include "ZombieApocalypse.h"
+#include "WorkStealingPool.h"
+#include "ZombieSimStats.h"
 #include "Modules/ModuleManager.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ZombieApocalypse, "ZombieApocalypse" );
+/** Owns the shared worker pool's lifetime; the pool itself starts lazily on first use. */
+class FZombieApocalypseModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void ShutdownModule() override
+	{
+		// Join the workers here rather than in a static destructor at DLL unload (hot reload, Live Coding)
+		FWorkStealingPool::Shutdown();
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FZombieApocalypseModule, ZombieApocalypse, "ZombieApocalypse" );
+
+// Storage for everything ZombieSimStats.h declares
+DEFINE_STAT(STAT_ZombieSim_ControllerTick);
+DEFINE_STAT(STAT_ZombieSim_SimulationStep);
+DEFINE_STAT(STAT_ZombieSim_GridDay);
+DEFINE_STAT(STAT_ZombieSim_GridUpdate);
+DEFINE_STAT(STAT_ZombieSim_PathQuery);
+DEFINE_STAT(STAT_ZombieSim_PathDispatch);
+DEFINE_STAT(STAT_ZombieSim_FlowField);
+DEFINE_STAT(STAT_ZombieSim_SpatialQuery);
+DEFINE_STAT(STAT_ZombieSim_Snapshot);
+DEFINE_STAT(STAT_ZombieSim_SweepChunk);
+DEFINE_STAT(STAT_ZombieSim_TrajectoryWrite);
+DEFINE_STAT(STAT_ZombieSim_OccupantRenderer);
+DEFINE_STAT(STAT_ZombieSim_HUD);
+DEFINE_STAT(STAT_ZombieSim_Steps);
+DEFINE_STAT(STAT_ZombieSim_StepsPerSecond);
+DEFINE_STAT(STAT_ZombieSim_CellsChanged);
+DEFINE_STAT(STAT_ZombieSim_PathQueries);
+DEFINE_STAT(STAT_ZombieSim_NodesExpanded);
+DEFINE_STAT(STAT_ZombieSim_PathQueueDepth);
+DEFINE_STAT(STAT_ZombieSim_PathsInFlight);
+DEFINE_STAT(STAT_ZombieSim_TrajectoryQueueDepth);
+
+UE_TRACE_CHANNEL_DEFINE(ZombieSimChannel);
@@ -0,0 +1,81 @@
+// Copyright University of Inland Norway
+
+#include "ZombieBenchmarkCommandlet.h"
+#include "SimulationBenchmark.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include <algorithm>
+
+UZombieBenchmarkCommandlet::UZombieBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = false;
+    LogToConsole = true;
+}
+
+int32 UZombieBenchmarkCommandlet::Main(const FString& Params)
+{
+    // 1. - Options, the defaults match FSimBenchmarkConfig
+    FSimBenchmarkConfig Config;
+    FString Filter;
+    if (FParse::Value(*Params, TEXT("Filter="), Filter))
+    {
+        Config.Filter = TCHAR_TO_UTF8(*Filter);
+    }
+    FParse::Value(*Params, TEXT("MinTime="), Config.MinSeconds);
+    FParse::Value(*Params, TEXT("Repetitions="), Config.Repetitions);
+
+    FString OutPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("Results.json"));
+    FParse::Value(*Params, TEXT("Out="), OutPath);
+
+    // 2. - Run and write the results before anything can fail on the baseline
+    const std::vector<FSimBenchmarkResult> Results = RunSimulationBenchmarks(Config);
+    const std::string Json = FormatSimulationBenchmarkJson(Results);
+    if (!FFileHelper::SaveStringToFile(UTF8_TO_TCHAR(Json.c_str()), *OutPath))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Cannot write benchmark results to %s"), *OutPath);
+        return 1;
+    }
+    UE_LOG(LogTemp, Display, TEXT("%d benchmark cases written to %s"), static_cast<int32>(Results.size()), *OutPath);
+
+    // 3. - Compare against the baseline when one is given
+    FString BaselinePath;
+    if (!FParse::Value(*Params, TEXT("Baseline="), BaselinePath))
+        return 0;
+
+    FString BaselineText;
+    std::vector<FSimBenchmarkResult> Baseline;
+    std::string Error;
+    if (!FFileHelper::LoadFileToString(BaselineText, *BaselinePath))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Cannot read benchmark baseline %s"), *BaselinePath);
+        return 1;
+    }
+    if (!ParseSimulationBenchmarkJson(TCHAR_TO_UTF8(*BaselineText), Baseline, &Error))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Benchmark baseline %s rejected: %s"), *BaselinePath, UTF8_TO_TCHAR(Error.c_str()));
+        return 1;
+    }
+
+    double Threshold = 0.1;
+    FParse::Value(*Params, TEXT("Threshold="), Threshold);
+    const std::vector<FSimBenchmarkComparison> Comparisons = CompareSimulationBenchmarks(Baseline, Results, Threshold);
+
+    TArray<FString> Lines;
+    FString(UTF8_TO_TCHAR(FormatSimulationBenchmarkComparison(Comparisons).c_str())).ParseIntoArrayLines(Lines);
+    for (const FString& Line : Lines)
+    {
+        UE_LOG(LogTemp, Display, TEXT("%s"), *Line);
+    }
+
+    const int32 NumRegressed = static_cast<int32>(std::count_if(Comparisons.begin(), Comparisons.end(),
+        [](const FSimBenchmarkComparison& Comparison) { return Comparison.bRegressed; }));
+    if (NumRegressed > 0)
+    {
+        UE_LOG(LogTemp, Error, TEXT("%d of %d benchmark cases regressed by more than %.0f%%"), NumRegressed, static_cast<int32>(Comparisons.size()), Threshold * 100.0);
+        return 1;
+    }
+    return 0;
+}
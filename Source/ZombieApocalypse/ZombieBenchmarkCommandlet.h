@@ -0,0 +1,23 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ZombieBenchmarkCommandlet.generated.h"
+
+/**
+ * Runs the simulation benchmark suite headless, for CI and before/after comparisons:
+ *   UnrealEditor-Cmd ZombieApocalypse.uproject -run=ZombieBenchmark [-Out=Results.json] [-Baseline=Baseline.json]
+ *       [-Threshold=0.1] [-Filter=Grid/] [-MinTime=0.1] [-Repetitions=3]
+ * Returns 1 when any case is slower than the baseline by more than Threshold.
+ */
+UCLASS()
+class ZOMBIEAPOCALYPSE_API UZombieBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UZombieBenchmarkCommandlet();
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,63 @@
+// Copyright University of Inland Norway
+
+#pragma once
+
+/**
+ * "ZombieSim" stat group and trace channel.
+ *
+ * `stat ZombieSim` shows the timers and per-frame counters below; in Insights
+ * the same scopes appear on the ZombieSim channel (-trace=default,ZombieSim)
+ * and the counters under Counters when the stats channel is traced too.
+ *
+ * Engine-free files include this as well: outside a module build every macro
+ * is empty, so they still compile on their own.
+ */
+#if defined(WITH_ENGINE)
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
+DECLARE_STATS_GROUP(TEXT("ZombieSim"), STATGROUP_ZombieSim, STATCAT_Advanced);
+
+// Timers
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Controller Tick"), STAT_ZombieSim_ControllerTick, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simulation Step"), STAT_ZombieSim_SimulationStep, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Grid Infection Day"), STAT_ZombieSim_GridDay, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Grid Update"), STAT_ZombieSim_GridUpdate, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Path Query"), STAT_ZombieSim_PathQuery, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Path Dispatch"), STAT_ZombieSim_PathDispatch, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Flow Field"), STAT_ZombieSim_FlowField, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spatial Query"), STAT_ZombieSim_SpatialQuery, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Snapshot"), STAT_ZombieSim_Snapshot, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Sweep Chunk"), STAT_ZombieSim_SweepChunk, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Trajectory Write"), STAT_ZombieSim_TrajectoryWrite, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Occupant Renderer"), STAT_ZombieSim_OccupantRenderer, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HUD Draw"), STAT_ZombieSim_HUD, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+
+// Counters, cleared every frame
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Steps This Frame"), STAT_ZombieSim_Steps, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Steps Per Second"), STAT_ZombieSim_StepsPerSecond, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Grid Cells Changed"), STAT_ZombieSim_CellsChanged, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Path Queries"), STAT_ZombieSim_PathQueries, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Path Nodes Expanded"), STAT_ZombieSim_NodesExpanded, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Path Queue Depth"), STAT_ZombieSim_PathQueueDepth, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Paths In Flight"), STAT_ZombieSim_PathsInFlight, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Trajectory Blocks Queued"), STAT_ZombieSim_TrajectoryQueueDepth, STATGROUP_ZombieSim, ZOMBIEAPOCALYPSE_API);
+
+UE_TRACE_CHANNEL_EXTERN(ZombieSimChannel, ZOMBIEAPOCALYPSE_API);
+
+/** Times the rest of the enclosing scope under Stat, in both `stat ZombieSim` and Insights. */
+#define ZOMBIESIM_SCOPE(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, ZombieSimChannel)
+
+#define ZOMBIESIM_COUNTER_ADD(Stat, Amount) INC_DWORD_STAT_BY(Stat, Amount)
+
+#else
+
+#define ZOMBIESIM_SCOPE(Stat)
+#define ZOMBIESIM_COUNTER_ADD(Stat, Amount)
+
+#endif